@@ -8,6 +8,7 @@
 #include <atomic>
 #include <cstdint>
 #include <functional> 
+#include <memory>
 #include <vector>
 
 #include "CommandKeys.h"
@@ -37,6 +38,11 @@ namespace cb
         {
             return key.material();
         }
+
+        CB_FORCE_INLINE cb::MaterialId operator()(const cb::WideDrawKey& key) const
+        {
+            return key.material();
+        }
     };
 
     template<typename T>
@@ -48,6 +54,43 @@ namespace cb
         }
     };
 
+    namespace detail
+    {
+        /// Key types without viewport bits always dispatch for the first view.
+        template <typename KeyType>
+        CB_FORCE_INLINE uint32_t viewportId(const KeyType&)
+        {
+            return 0;
+        }
+
+        CB_FORCE_INLINE uint32_t viewportId(const cb::DrawKey& key)
+        {
+            return key.viewportId;
+        }
+
+        CB_FORCE_INLINE uint32_t viewportId(const cb::WideDrawKey& key)
+        {
+            return key.viewportId();
+        }
+
+        /// Key types without viewport bits can't be dispatched for other views than the first.
+        template <typename KeyType>
+        CB_FORCE_INLINE void setViewportId(KeyType&, uint32_t view)
+        {
+            assert(view == 0);
+        }
+
+        CB_FORCE_INLINE void setViewportId(cb::DrawKey& key, uint32_t view)
+        {
+            key.viewportId = view;
+        }
+
+        CB_FORCE_INLINE void setViewportId(cb::WideDrawKey& key, uint32_t view)
+        {
+            key.setViewportId(view);
+        }
+    }
+
     /// Utility to create global functions for commands with execute member method.
     template<class CommandClass>
     void makeExecuteFunction(const void* data, cb::RenderContext* rc)
@@ -76,18 +119,31 @@ namespace cb
     };
 
     /// The command buffer is composed of more CommandPackets and their corresponding keys.
-    template <typename KeyType = cb::DrawKey, class KeyDecoderClass = DefaultKeyDecoder, class MaterialBinderClass = DefaultMaterialBinder>
+    ///@note The memory source allocates the commands arena, i.e. cb::VirtualMemorySource for huge pages.
+    template <typename KeyType = cb::DrawKey, class KeyDecoderClass = DefaultKeyDecoder, class MaterialBinderClass = DefaultMaterialBinder,
+              class MemorySourceClass = HeapMemorySource<>>
     class CommandBuffer
     {
     public:
         typedef KeyType key_t;
         typedef CommandPair<key_t> command_t;
         typedef std::function<void(command_t*, command_t*)> sort_func_t;
+        typedef std::function<command_t*(command_t*, command_t*)> compile_func_t;
+        /// Runs task(0) .. task(taskCount - 1) concurrently and returns once all have finished.
+        typedef std::function<void(uint32_t taskCount, const std::function<void(uint32_t)>& task)> parallel_func_t;
+        /// Seeds the material binder of a chunk, i.e. resets its redundancy state for the chunk's context.
+        typedef std::function<void(MaterialBinderClass& binder, uint32_t chunk)> binder_seed_func_t;
+        /// Folds the material binder of a chunk back into the buffer's binder, i.e. accumulates its statistics.
+        typedef std::function<void(MaterialBinderClass& binder, const MaterialBinderClass& chunkBinder, uint32_t chunk)>
+            binder_fold_func_t;
         typedef MaterialBinderClass binder_t;
         typedef KeyDecoderClass decoder_t;
         typedef int(*log_function_t)(const char* fmt, ...);
 
-        explicit CommandBuffer(uint32_t commandCount = 5000, uint32_t commandKBytes = 512);
+        static const uint32_t kDefaultCommandCount = 5000;
+        static const uint32_t kDefaultCommandKBs = 512;
+
+        explicit CommandBuffer(uint32_t commandCount = kDefaultCommandCount, uint32_t commandKBytes = kDefaultCommandKBs);
         explicit CommandBuffer(const MaterialBinderClass& materialBinder);
 
         MaterialBinderClass& materialBinder();
@@ -102,6 +158,19 @@ namespace cb
         void resize(uint32_t commandCount, uint32_t commandKBs);
         /// Sorts the created commands based on their key priority.
         void sort(sort_func_t sortFunc = std::sort<command_t*>);
+        /// Submits the sorted commands split in contiguous chunks, each chunk is dispatched by a task of
+        /// parallelFunc into its own render context with its own copy of the material binder.
+        ///@param contexts One render context per chunk, the caller must execute their outputs in order.
+        ///@param foldFunc Called in chunk order once all of the chunks were dispatched, without it the buffer's
+        /// binder is replaced by the last chunk's one, whose redundancy state matches the executed contexts.
+        ///@note The chunks are split where the material changes when possible, so that few materials are
+        /// bound by more than one chunk.
+        void submitParallel(cb::RenderContext* const* contexts, uint32_t chunkCount, const parallel_func_t& parallelFunc,
+                            const binder_seed_func_t& seedFunc = binder_seed_func_t(),
+                            const binder_fold_func_t& foldFunc = binder_fold_func_t(), bool clearBuffer = true);
+        /// Runs a compilation stage over the sorted commands, i.e. merging runs of draws(@see cmds::MultiDrawCompiler).
+        ///@param compileFunc Receives the sorted range, may rewrite or drop entries in place and returns its new end.
+        void compile(const compile_func_t& compileFunc);
         /// Submits the sorted commands to the GPU.
         /// @param clearBuffer - clear all created commands from the buffer.
         void submit(cb::RenderContext* rc, bool clearBuffer = true);
@@ -121,6 +190,12 @@ namespace cb
         CommandClass* addCommandData(const key_t& key, const std::vector<AuxilaryData>& data);
         template <class CommandClass, typename AuxilaryData>
         CommandClass* addCommandData(const key_t& key, const AuxilaryData* data, uint32_t count);
+        /// Creates a new command that is recorded once but sorted and dispatched once per view.
+        ///@param viewMask Each set bit i emits a sort entry with the key's viewport id set to i.
+        ///@note All views share the same packet, payload and chained commands, the dispatch
+        /// function can query the view it's dispatched for via cb::RenderContext::viewportId.
+        template <class CommandClass>
+        CommandClass* addMultiViewCommand(const key_t& key, uint8_t viewMask, uint32_t auxilarySize = 0);
         /// Adds the given command packet with the given key.
         ///@note Only references the original packet's auxiliary data.
         cb::CommandPacket* addCommandFrom(const key_t& key, const cb::CommandPacket* referencePacket);
@@ -151,12 +226,31 @@ namespace cb
         template <class CommandClass, typename AuxilaryData>
         cb::CommandPacket* createCommandPacketData(const AuxilaryData& data);
 
+        /// Stores a block of constants shared by several commands, i.e. uniform buffer data, and returns its handle.
+        /// Blocks with the same content recorded before the buffer is cleared are stored once and share the handle.
+        ///@note The commands store the handle and resolve it at dispatch with cb::RenderContext::constantBlock,
+        /// the block lives until the buffer is cleared.
+        template <typename T>
+        uint32_t addConstantBlock(const T& data);
+        uint32_t addConstantBlock(const void* data, uint32_t size);
+        template <typename T>
+        const T& constantBlock(uint32_t handle) const;
+        /// Returns the count of distinct constant blocks in the buffer.
+        uint32_t constantBlockCount() const;
+        /// Sets the count of distinct blocks that are deduplicated, the ones above it are always stored.
+        ///@warning Should never resize when adding constant blocks, only before.
+        void resizeConstantBlocks(uint32_t blockCount);
+
 #if CB_DEBUG_COMMANDS_PRINT
         void setLogFunction(log_function_t logger) { m_logger = logger; }
 #endif
 
     private:
         void clear();
+        void dispatchCommands(const command_t* begin, const command_t* end, cb::RenderContext* rc,
+                              MaterialBinderClass& materialBinder);
+        static bool isSameMaterial(const command_t& first, const command_t& second);
+        uint32_t storeConstantBlock(const void* data, uint32_t size);
 
     private:
         struct CommandPacketReference
@@ -169,14 +263,20 @@ namespace cb
 #else
         static const uint32_t kALignment = 0;
 #endif
-
-        cb::LinearAllocator<kALignment> m_allocator;
-        MaterialBinderClass             m_materialBinder;
-        std::vector<command_t>          m_commands;
-        std::atomic<uint32_t>           m_currentIndex;
+        // the data of a constant block is preceded by its size
+        static const uint32_t kConstantBlockHeader = kALignment > sizeof(uint32_t) ? kALignment : 16;
+        // a slot is the block's hash in the high bits and its handle in the low ones
+        static const uint32_t kPendingConstantBlock = 0xFFFFFFFF;
+
+        cb::LinearAllocator<kALignment, MemorySourceClass> m_allocator;
+        MaterialBinderClass                                m_materialBinder;
+        std::vector<command_t>                             m_commands;
+        std::atomic<uint32_t>                              m_currentIndex;
+        std::unique_ptr<std::atomic<uint64_t>[]>           m_constantSlots;
+        uint32_t                                           m_constantSlotCount;
+        std::atomic<uint32_t>                              m_constantBlockCount;
 #if CB_DEBUG_COMMANDS_PRINT
         log_function_t m_logger = printf;
-        std::stringstream m_stringStream;
 #endif
     private:
         CommandBuffer(const CommandBuffer&) = delete;
@@ -185,16 +285,19 @@ namespace cb
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define COMMAND_TEMPLATE template <typename KeyType, class KeyDecoderClass, class MaterialBinderClass>
-#define COMMAND_QUAL CommandBuffer<KeyType, KeyDecoderClass, MaterialBinderClass>
+#define COMMAND_TEMPLATE template <typename KeyType, class KeyDecoderClass, class MaterialBinderClass, class MemorySourceClass>
+#define COMMAND_QUAL CommandBuffer<KeyType, KeyDecoderClass, MaterialBinderClass, MemorySourceClass>
 
     COMMAND_TEMPLATE
         COMMAND_QUAL::CommandBuffer(uint32_t commandCount, uint32_t commandKBytes)
         : m_allocator(commandKBytes * 1024)  // TODO: can use TLS to avoid false sharing
         , m_materialBinder()
         , m_currentIndex(0)
+        , m_constantSlotCount(0)
+        , m_constantBlockCount(0)
     {
         assert(m_currentIndex.is_lock_free());
+        resizeConstantBlocks(256);
 
         m_commands.resize(commandCount);
     }
@@ -204,8 +307,11 @@ namespace cb
         : m_allocator(kDefaultCommandKBs * 1024)  // TODO: can use TLS to avoid false sharing
         , m_materialBinder(materialBinder)
         , m_currentIndex(0)
+        , m_constantSlotCount(0)
+        , m_constantBlockCount(0)
     {
         assert(m_currentIndex.is_lock_free());
+        resizeConstantBlocks(256);
 
         m_commands.resize(kDefaultCommandCount);
     }
@@ -254,6 +360,8 @@ namespace cb
         assert(m_currentIndex == 0);
         m_commands.resize(commandCount);
         m_allocator.resize(commandKBs * 1024);
+        // the blocks were in the previous arena
+        resizeConstantBlocks(m_constantSlotCount / 2);
     }
 
     COMMAND_TEMPLATE
@@ -263,8 +371,71 @@ namespace cb
 #if CB_DEBUG_COMMANDS_PRINT
         (*m_logger)("\n\n++++ Submit ++++\n\n");
 #endif
-        const auto end = m_commands.begin() + (int)m_currentIndex.load(std::memory_order_acquire);
-        for (auto it = m_commands.begin(); it != end; ++it)
+        const command_t* begin = m_commands.data();
+        const command_t* end = begin + (int)m_currentIndex.load(std::memory_order_acquire);
+        dispatchCommands(begin, end, rc, m_materialBinder);
+
+        // safe to dealloc all
+        if (clearBuffer)
+            clear();
+    }
+
+    COMMAND_TEMPLATE
+        void COMMAND_QUAL::submitParallel(cb::RenderContext* const* contexts, uint32_t chunkCount,
+                                          const parallel_func_t& parallelFunc, const binder_seed_func_t& seedFunc,
+                                          const binder_fold_func_t& foldFunc, bool clearBuffer /*= true*/)
+    {
+        assert(chunkCount);
+
+        const command_t* begin = m_commands.data();
+        const command_t* end = begin + (int)m_currentIndex.load(std::memory_order_acquire);
+        const size_t count = end - begin;
+
+        std::vector<const command_t*> splits(chunkCount + 1);
+        splits[0] = begin;
+        splits[chunkCount] = end;
+        for (uint32_t i = 1; i < chunkCount; ++i)
+        {
+            const command_t* split = std::max(begin + count * i / chunkCount, splits[i - 1]);
+            // look ahead up to a quarter of a chunk for a material change
+            const command_t* limit = std::min(split + std::max<size_t>(count / chunkCount / 4, 1), end);
+
+            const command_t* boundary = split;
+            while (boundary != limit && boundary != begin && isSameMaterial(boundary[-1], boundary[0]))
+                ++boundary;
+            splits[i] = boundary != limit ? boundary : split;
+        }
+
+        std::vector<MaterialBinderClass> binders(chunkCount, m_materialBinder);
+        parallelFunc(chunkCount, [&](uint32_t chunk) {
+            MaterialBinderClass& materialBinder = binders[chunk];
+            if (seedFunc)
+                seedFunc(materialBinder, chunk);
+
+            dispatchCommands(splits[chunk], splits[chunk + 1], contexts[chunk], materialBinder);
+        });
+
+        if (foldFunc)
+        {
+            for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+                foldFunc(m_materialBinder, binders[chunk], chunk);
+        }
+        else
+            m_materialBinder = binders.back();
+
+        // safe to dealloc all
+        if (clearBuffer)
+            clear();
+    }
+
+    COMMAND_TEMPLATE
+        void COMMAND_QUAL::dispatchCommands(const command_t* begin, const command_t* end, cb::RenderContext* rc,
+                                            MaterialBinderClass& materialBinder)
+    {
+        if (rc)
+            rc->setConstantBlocks(m_allocator.data());
+
+        for (const command_t* it = begin; it != end; ++it)
         {
             const key_t& key = it->key;
 
@@ -272,30 +443,36 @@ namespace cb
             cb::MaterialId material = KeyDecoderClass()(key);
 
 #if CB_DEBUG_COMMANDS_PRINT
-            m_stringStream.str(std::string());
-            m_stringStream.clear();
-            m_stringStream << key;
-            (*m_logger)("%s\n", m_stringStream.str().c_str());
+            std::stringstream stringStream;
+            stringStream << key;
+            (*m_logger)("%s\n", stringStream.str().c_str());
 #endif
+            if (rc)
+                rc->setViewportId(cb::detail::viewportId(key));
+
             const CommandPacket* packet = it->cmd;
             // apply the material dispatch commands
             bool nextPass;
             do
             {
                 // if true then we have more passes presents in the material
-                nextPass = m_materialBinder(material);
+                nextPass = materialBinder(material);
 #if CB_DEBUG_COMMANDS_PRINT
-                m_materialBinder.debugMsg(material);
+                materialBinder.debugMsg(material);
                 CommandPacket::log(packet, *m_logger);
 #endif
                 CommandPacket::dispatch(packet, rc);
                 ++material.pass;
             } while (nextPass);
         }
+    }
 
-        // safe to dealloc all
-        if (clearBuffer)
-            clear();
+    COMMAND_TEMPLATE
+        bool COMMAND_QUAL::isSameMaterial(const command_t& first, const command_t& second)
+    {
+        const cb::MaterialId material = KeyDecoderClass()(first.key);
+        const cb::MaterialId otherMaterial = KeyDecoderClass()(second.key);
+        return material.id == otherMaterial.id && material.pass == otherMaterial.pass;
     }
 
     COMMAND_TEMPLATE
@@ -317,6 +494,39 @@ namespace cb
         return CommandPacket::getCommandData<CommandClass>(packet);
     }
 
+    COMMAND_TEMPLATE
+        template <class CommandClass>
+    CommandClass* COMMAND_QUAL::addMultiViewCommand(const key_t& key, uint8_t viewMask, uint32_t auxilarySize)
+    {
+        assert(viewMask);
+
+        CommandPacket* packet = CommandPacket::create<CommandClass>(m_allocator, auxilarySize);
+        packet->dispatchFunction = CommandClass::kDispatchFunction;
+        assert(packet->dispatchFunction);
+
+        uint32_t viewCount = 0;
+        for (uint32_t mask = viewMask; mask; mask &= mask - 1)
+            ++viewCount;
+
+        // reserve the entries of all views at once, they only differ by their viewport id
+        uint32_t currentIndex = m_currentIndex.fetch_add(viewCount, std::memory_order_relaxed);
+        assert(currentIndex + viewCount <= (uint32_t)m_commands.size());
+        for (uint32_t view = 0; viewMask; ++view, viewMask >>= 1)
+        {
+            if ((viewMask & 1) == 0)
+                continue;
+
+            command_t& pair = m_commands[currentIndex++];
+            pair.cmd = packet;
+            pair.key = key;
+            detail::setViewportId(pair.key, view);
+            // the view must fit the viewport bits of the key
+            assert(detail::viewportId(pair.key) == view);
+        }
+
+        return CommandPacket::getCommandData<CommandClass>(packet);
+    }
+
     COMMAND_TEMPLATE
         template <class CommandClass, typename AuxilaryData>
     CommandClass* COMMAND_QUAL::addCommandData(const key_t& key, const AuxilaryData& data)
@@ -357,10 +567,9 @@ namespace cb
         CommandPacket* packet = CommandPacket::create<CommandPacketReference>(m_allocator, 0);
         // store the key and command packet ptr
         {
-            const uint32_t currentIndex = m_currentIndex.fetch_add(1, boost::memory_order_relaxed);
-            assert(m_commands.size() > currentIndex);
+            const uint32_t currentIndex = m_currentIndex.fetch_add(1, std::memory_order_relaxed);
             assert(currentIndex < (uint32_t)m_commands.size());
-            CommandPair& pair = m_commands[currentIndex];
+            command_t& pair = m_commands[currentIndex];
             pair.cmd = packet;
             pair.key = key;
         }
@@ -472,6 +681,97 @@ namespace cb
         return packet;
     }
 
+    COMMAND_TEMPLATE
+        template <typename T>
+    uint32_t COMMAND_QUAL::addConstantBlock(const T& data)
+    {
+        static_assert(cb::detail::is_pod<T>::value, "CONSTANT_BLOCK_INVALID_TYPE");
+        return addConstantBlock(&data, sizeof(T));
+    }
+
+    COMMAND_TEMPLATE
+        uint32_t COMMAND_QUAL::addConstantBlock(const void* data, uint32_t size)
+    {
+        assert(size);
+
+        uint32_t hash = cb::mem::hash(data, size);
+        hash = hash ? hash : 1;  // zero marks the empty slots
+        const uint64_t tag = (uint64_t)hash << 32;
+
+        const uint32_t mask = m_constantSlotCount - 1;
+        for (uint32_t probe = 0, slot = hash & mask; probe < m_constantSlotCount; ++probe, slot = (slot + 1) & mask)
+        {
+            std::atomic<uint64_t>& entry = m_constantSlots[slot];
+            uint64_t value = entry.load(std::memory_order_acquire);
+            if (value == 0 && entry.compare_exchange_strong(value, tag | kPendingConstantBlock, std::memory_order_acq_rel))
+            {
+                const uint32_t handle = storeConstantBlock(data, size);
+                entry.store(tag | handle, std::memory_order_release);
+                m_constantBlockCount.fetch_add(1, std::memory_order_relaxed);
+                return handle;
+            }
+            if ((uint32_t)(value >> 32) != hash)
+                continue;
+
+            // wait for the block to be copied by the thread that claimed the slot
+            while ((uint32_t)value == kPendingConstantBlock)
+                value = entry.load(std::memory_order_acquire);
+
+            const uint32_t handle = (uint32_t)value;
+            const uint8_t* block = m_allocator.data() + handle;
+            if (*reinterpret_cast<const uint32_t*>(block - sizeof(uint32_t)) == size && memcmp(block, data, size) == 0)
+                return handle;
+        }
+
+        // out of slots, stored without deduplication
+        return storeConstantBlock(data, size);
+    }
+
+    COMMAND_TEMPLATE
+        uint32_t COMMAND_QUAL::storeConstantBlock(const void* data, uint32_t size)
+    {
+        // padded so the allocations that follow stay aligned
+        const uint32_t bytes = kConstantBlockHeader + ((size + kConstantBlockHeader - 1) & ~(kConstantBlockHeader - 1));
+        uint8_t* allocation = m_allocator.alloc(bytes, kALignment ? kALignment : 16);
+        assert(allocation);
+        uint8_t* block = allocation + kConstantBlockHeader;
+        *reinterpret_cast<uint32_t*>(block - sizeof(uint32_t)) = size;
+        memcpy(block, data, size);
+        return (uint32_t)(block - m_allocator.data());
+    }
+
+    COMMAND_TEMPLATE
+        template <typename T>
+    const T& COMMAND_QUAL::constantBlock(uint32_t handle) const
+    {
+        assert(handle < m_allocator.size());
+        return *reinterpret_cast<const T*>(m_allocator.data() + handle);
+    }
+
+    COMMAND_TEMPLATE
+        uint32_t COMMAND_QUAL::constantBlockCount() const
+    {
+        return m_constantBlockCount.load(std::memory_order_acquire);
+    }
+
+    COMMAND_TEMPLATE
+        void COMMAND_QUAL::resizeConstantBlocks(uint32_t blockCount)
+    {
+        // at most half full to keep the probe sequences short
+        uint32_t slotCount = 1;
+        while (slotCount < blockCount * 2)
+            slotCount <<= 1;
+
+        if (slotCount != m_constantSlotCount)
+        {
+            m_constantSlots.reset(new std::atomic<uint64_t>[slotCount]);
+            m_constantSlotCount = slotCount;
+        }
+        for (uint32_t i = 0; i < m_constantSlotCount; ++i)
+            m_constantSlots[i].store(0, std::memory_order_relaxed);
+        m_constantBlockCount.store(0, std::memory_order_release);
+    }
+
     COMMAND_TEMPLATE
         void COMMAND_QUAL::sort(sort_func_t sortFunc /*= std::sort<CommandPair*>*/)
     {
@@ -480,11 +780,25 @@ namespace cb
         assert(m_commands.size() > m_currentIndex.load(std::memory_order_acquire));
     }
 
+    COMMAND_TEMPLATE
+        void COMMAND_QUAL::compile(const compile_func_t& compileFunc)
+    {
+        command_t* begin = m_commands.data();
+        command_t* end = begin + (int)m_currentIndex.load(std::memory_order_acquire);
+
+        command_t* compiledEnd = compileFunc(begin, end);
+        assert(begin <= compiledEnd && compiledEnd <= end);
+        m_currentIndex.store((uint32_t)(compiledEnd - begin), std::memory_order_release);
+    }
+
     COMMAND_TEMPLATE
         void COMMAND_QUAL::clear()
     {
         m_allocator.deallocAll();
         m_currentIndex = 0;
+
+        if (m_constantBlockCount.load(std::memory_order_acquire))
+            resizeConstantBlocks(m_constantSlotCount / 2);
     }
 
 #undef COMMAND_TEMPLATE
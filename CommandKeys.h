@@ -6,9 +6,14 @@
 
 #include <cassert>
 #include <cstdint>
+#include <ostream>
 #ifndef NDEBUG
 #include "MemoryUtil.h"
 #endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CB_KEY_SSE 1
+#include <emmintrin.h>
+#endif
 
 namespace cb
 {
@@ -147,6 +152,90 @@ namespace cb
     };  // struct DrawKey
 #pragma pack(pop)
 
+    ///@brief A 128-bit key for draw commands, for scenes that overflow the fields of DrawKey.
+    /// From the most significant bits: viewport id(3), view layer(3), translucency(2) and the custom command bit,
+    /// followed by the mode fields:
+    /// - opaque: material id(32), material pass(8), mesh id(24), depth(32) and secondary depth(23)
+    /// - transparent: depth(32), material id(32), material pass(8), mesh id(24) and secondary depth(23)
+    /// - custom: priority(16)
+    ///@note The mesh id keeps the draws of a material sorted by vao, the secondary depth can be used i.e. by
+    /// shadow views. Setting a value that doesn't fit its field asserts.
+    struct WideDrawKey
+    {
+        static const uint32_t kPriorityBits = 16;
+
+        /// The least significant bits, stored first so the key's bytes are in little-endian order.
+        uint64_t low;
+        uint64_t high;
+
+        WideDrawKey();
+        WideDrawKey(uint64_t high, uint64_t low);
+        explicit WideDrawKey(cb::ViewLayerType viewLayer);
+        WideDrawKey(cb::ViewLayerType viewLayer, cb::TranslucencyType translucency);
+
+        void setView(uint32_t viewportId, cb::ViewLayerType viewLayer, cb::TranslucencyType translucency);
+        void setViewportId(uint32_t viewportId);
+        void setViewLayer(cb::ViewLayerType viewLayer, cb::TranslucencyType translucency);
+
+        void setMaterial(uint32_t materialId);
+        void setMaterialPass(uint32_t materialPass);
+        void setMesh(uint32_t meshId);
+        void setDepth(uint32_t depth);
+        void setSecondaryDepth(uint32_t depth);
+        void setMaterialDepth(uint32_t materialdId, uint32_t depth);
+
+        uint32_t viewportId() const;
+        cb::ViewLayerType viewLayer() const;
+        cb::TranslucencyType translucency() const;
+        bool isCustom() const;
+        uint32_t priority() const;
+        uint32_t mesh() const;
+        uint32_t depth() const;
+        uint32_t secondaryDepth() const;
+
+        ///@return The actual material based on the active mode, opaque or transparent.
+        cb::MaterialId material() const;
+        bool isOpaqueMode() const;
+
+        ///@note Used for sorting commands based on their precedence order, same as DrawKey higher keys are first.
+        bool operator<(const WideDrawKey& other) const;
+        bool operator==(const WideDrawKey& other) const;
+
+        static WideDrawKey makeDefault(cb::ViewLayerType viewLayer);
+        static WideDrawKey makeDefault(uint32_t viewportId, cb::ViewLayerType viewLayer = ViewLayerType::e3D);
+        ///@note The priority is inversed, i.e. lower values have highest priority.
+        static WideDrawKey makeCustom(cb::ViewLayerType viewLayer, uint32_t priority);
+        static WideDrawKey makeCustom(uint32_t viewportId, cb::ViewLayerType viewLayer, uint32_t priority);
+
+        static void sanityChecks();
+
+    private:
+        enum Field
+        {
+            // offset and width of the fields, from the least significant bit
+            eViewportId = (125 << 8) | 3,
+            eViewLayer = (122 << 8) | 3,
+            eTranslucency = (120 << 8) | 2,
+            eCustom = (119 << 8) | 1,
+            ePriority = (103 << 8) | kPriorityBits,
+
+            eOpaqueMaterialId = (87 << 8) | 32,
+            eOpaqueMaterialPass = (79 << 8) | 8,
+            eOpaqueMesh = (55 << 8) | 24,
+            eOpaqueDepth = (23 << 8) | 32,
+
+            eTransparentDepth = (87 << 8) | 32,
+            eTransparentMaterialId = (55 << 8) | 32,
+            eTransparentMaterialPass = (47 << 8) | 8,
+            eTransparentMesh = (23 << 8) | 24,
+
+            eSecondaryDepth = (0 << 8) | 23
+        };
+
+        uint32_t get(Field field) const;
+        void set(Field field, uint32_t value);
+    };
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     inline DrawKey::DrawKey()
@@ -186,6 +275,7 @@ namespace cb
 
     inline void DrawKey::setMaterial(uint32_t materialId)
     {
+        assert(materialId < (1u << 23));
         if (isOpaqueMode())
             opaque.materialId = materialId;
         else
@@ -195,6 +285,8 @@ namespace cb
 
     inline void DrawKey::setDepth(uint32_t depth)
     {
+        // the depth has 24 bits, @see WideDrawKey for more
+        assert(depth < (1u << 24));
         if (isOpaqueMode())
             opaque.depth = depth;
         else
@@ -310,6 +402,232 @@ namespace cb
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+    inline WideDrawKey::WideDrawKey()
+    {
+        static_assert(sizeof(WideDrawKey) == 2 * sizeof(uint64_t), "INVALID_DRAW_KEY_SIZE");
+    }
+
+    inline WideDrawKey::WideDrawKey(uint64_t high, uint64_t low)
+        : low(low)
+        , high(high)
+    {
+    }
+
+    inline WideDrawKey::WideDrawKey(cb::ViewLayerType viewLayer)
+        : low(0)
+        , high(0)
+    {
+        set(eViewLayer, static_cast<uint32_t>(viewLayer));
+    }
+
+    inline WideDrawKey::WideDrawKey(cb::ViewLayerType viewLayer, cb::TranslucencyType translucency)
+        : low(0)
+        , high(0)
+    {
+        setViewLayer(viewLayer, translucency);
+    }
+
+    inline void WideDrawKey::setView(uint32_t viewportId, cb::ViewLayerType viewLayer, cb::TranslucencyType translucency)
+    {
+        setViewportId(viewportId);
+        setViewLayer(viewLayer, translucency);
+    }
+
+    inline void WideDrawKey::setViewportId(uint32_t viewportId)
+    {
+        set(eViewportId, viewportId);
+    }
+
+    inline void WideDrawKey::setViewLayer(cb::ViewLayerType viewLayer, cb::TranslucencyType translucency)
+    {
+        set(eViewLayer, static_cast<uint32_t>(viewLayer));
+        set(eTranslucency, static_cast<uint32_t>(translucency));
+    }
+
+    inline void WideDrawKey::setMaterial(uint32_t materialId)
+    {
+        set(isOpaqueMode() ? eOpaqueMaterialId : eTransparentMaterialId, materialId);
+    }
+
+    inline void WideDrawKey::setMaterialPass(uint32_t materialPass)
+    {
+        set(isOpaqueMode() ? eOpaqueMaterialPass : eTransparentMaterialPass, materialPass);
+    }
+
+    inline void WideDrawKey::setMesh(uint32_t meshId)
+    {
+        set(isOpaqueMode() ? eOpaqueMesh : eTransparentMesh, meshId);
+    }
+
+    inline void WideDrawKey::setDepth(uint32_t depth)
+    {
+        set(isOpaqueMode() ? eOpaqueDepth : eTransparentDepth, depth);
+    }
+
+    inline void WideDrawKey::setSecondaryDepth(uint32_t depth)
+    {
+        set(eSecondaryDepth, depth);
+    }
+
+    inline void WideDrawKey::setMaterialDepth(uint32_t materialdId, uint32_t depth)
+    {
+        setMaterial(materialdId);
+        setDepth(depth);
+    }
+
+    inline uint32_t WideDrawKey::viewportId() const
+    {
+        return get(eViewportId);
+    }
+
+    inline cb::ViewLayerType WideDrawKey::viewLayer() const
+    {
+        return cb::ViewLayerType(get(eViewLayer));
+    }
+
+    inline cb::TranslucencyType WideDrawKey::translucency() const
+    {
+        return cb::TranslucencyType(get(eTranslucency));
+    }
+
+    inline bool WideDrawKey::isCustom() const
+    {
+        return get(eCustom) != 0;
+    }
+
+    inline uint32_t WideDrawKey::priority() const
+    {
+        return get(ePriority);
+    }
+
+    inline uint32_t WideDrawKey::mesh() const
+    {
+        return get(isOpaqueMode() ? eOpaqueMesh : eTransparentMesh);
+    }
+
+    inline uint32_t WideDrawKey::depth() const
+    {
+        return get(isOpaqueMode() ? eOpaqueDepth : eTransparentDepth);
+    }
+
+    inline uint32_t WideDrawKey::secondaryDepth() const
+    {
+        return get(eSecondaryDepth);
+    }
+
+    inline cb::MaterialId WideDrawKey::material() const
+    {
+        return isOpaqueMode() ? cb::MaterialId(get(eOpaqueMaterialId), get(eOpaqueMaterialPass))
+            : cb::MaterialId(get(eTransparentMaterialId), get(eTransparentMaterialPass));
+    }
+
+    inline bool WideDrawKey::isOpaqueMode() const
+    {
+        return !isCustom() && translucency() == cb::TranslucencyType::eOpaque;
+    }
+
+    inline bool WideDrawKey::operator<(const WideDrawKey& other) const
+    {
+#if CB_KEY_SSE
+        // unsigned compare of the 32-bit lanes, the most significant differing lane decides
+        const __m128i bias = _mm_set1_epi32((int)0x80000000);
+        const __m128i a = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(this)), bias);
+        const __m128i b = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&other)), bias);
+        const int greater = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, b)));
+        const int less = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(a, b)));
+        return greater > less;
+#else
+        return high != other.high ? high > other.high : low > other.low;
+#endif
+    }
+
+    inline bool WideDrawKey::operator==(const WideDrawKey& other) const
+    {
+        return high == other.high && low == other.low;
+    }
+
+    inline WideDrawKey WideDrawKey::makeDefault(cb::ViewLayerType viewLayer)
+    {
+        return WideDrawKey(viewLayer);
+    }
+
+    inline WideDrawKey WideDrawKey::makeDefault(uint32_t viewportId, cb::ViewLayerType viewLayer)
+    {
+        WideDrawKey key(viewLayer);
+        key.set(eViewportId, viewportId);
+        return key;
+    }
+
+    inline WideDrawKey WideDrawKey::makeCustom(cb::ViewLayerType viewLayer, uint32_t priority)
+    {
+        return makeCustom(0, viewLayer, priority);
+    }
+
+    inline WideDrawKey WideDrawKey::makeCustom(uint32_t viewportId, cb::ViewLayerType viewLayer, uint32_t priority)
+    {
+        assert(priority < (1u << kPriorityBits));
+
+        WideDrawKey key = makeDefault(viewportId, viewLayer);
+        key.set(eCustom, 1);
+        key.set(ePriority, (1u << kPriorityBits) - 1 - priority);
+        return key;
+    }
+
+    inline uint32_t WideDrawKey::get(Field field) const
+    {
+        const uint32_t offset = field >> 8;
+        const uint64_t mask = (1ull << (field & 0xFF)) - 1;
+        if (offset >= 64)
+            return (uint32_t)((high >> (offset - 64)) & mask);
+        if (offset == 0)
+            return (uint32_t)(low & mask);
+        return (uint32_t)(((low >> offset) | (high << (64 - offset))) & mask);
+    }
+
+    inline void WideDrawKey::set(Field field, uint32_t value)
+    {
+        const uint32_t offset = field >> 8;
+        const uint64_t mask = (1ull << (field & 0xFF)) - 1;
+        assert(value <= mask);
+
+        const uint64_t bits = value & mask;
+        if (offset >= 64)
+        {
+            high = (high & ~(mask << (offset - 64))) | (bits << (offset - 64));
+            return;
+        }
+        low = (low & ~(mask << offset)) | (bits << offset);
+        // fields that straddle both words
+        if (offset + (field & 0xFF) > 64)
+            high = (high & ~(mask >> (64 - offset))) | (bits >> (64 - offset));
+    }
+
+    inline void WideDrawKey::sanityChecks()
+    {
+        WideDrawKey key(0, 0);
+        key.setView(5, cb::ViewLayerType::eSkybox, cb::TranslucencyType::eOpaque);
+        assert(key.high == 0xA700000000000000 && key.low == 0);
+        key.setMaterialDepth(0x89ABCDEF, 0x12345678);
+        key.setMaterialPass(0x42);
+        key.setMesh(0xFEDCBA);
+        key.setSecondaryDepth(0x7FFFFF);
+        assert(key.high == 0xA744D5E6F7A17F6E && key.low == 0x5D091A2B3C7FFFFF);
+        assert(key.material().id == 0x89ABCDEF && key.material().pass == 0x42);
+        assert(key.mesh() == 0xFEDCBA && key.depth() == 0x12345678 && key.secondaryDepth() == 0x7FFFFF);
+
+        WideDrawKey other = key;
+        other.setSecondaryDepth(0x7FFFFE);
+        assert(!(other < key) && key < other);
+        other.setMaterial(0x89ABCDF0);
+        assert(other < key && !(key < other));
+        assert(!(key < key));
+
+        key = makeCustom(cb::ViewLayerType::e3D, 1);
+        assert(key.isCustom() && !key.isOpaqueMode() && key.priority() == 0xFFFE);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
     inline const char* toString(cb::ViewLayerType type)
     {
         switch (type)
@@ -352,9 +670,21 @@ namespace cb
         if (key.custom.enabled)
             stream << "custom command, priority: " << key.custom.priority;
         else if (cb::TranslucencyType(key.translucency) != cb::TranslucencyType::eOpaque)
-            stream << ", depth: " << key.transparent.depth << ", material id: " << key.transparent.materialId;
+            stream << "depth: " << key.transparent.depth << ", material id: " << key.transparent.materialId;
         else if (key.isOpaqueMode())
-            stream << ", depth: " << key.opaque.depth << ", material id: " << key.opaque.materialId;
+            stream << "depth: " << key.opaque.depth << ", material id: " << key.opaque.materialId;
+        return stream;
+    }
+
+    inline std::ostream& operator<<(std::ostream& stream, const cb::WideDrawKey& key)
+    {
+        stream << key.viewportId() << ", layer: " << cb::toString(key.viewLayer()) << "-"
+            << cb::toString(key.translucency()) << ", ";
+
+        if (key.isCustom())
+            stream << "custom command, priority: " << key.priority();
+        else
+            stream << "depth: " << key.depth() << ", material id: " << key.material().id << ", mesh id: " << key.mesh();
         return stream;
     }
 } // namespace cb
@@ -0,0 +1,198 @@
+//
+//  FrameComposer.h
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <vector>
+
+#include "RenderContext.h"
+
+namespace cb
+{
+    /// Sorts several command buffers concurrently and submits them in their declared order.
+    ///@note Buffers may use different key types, they're submitted in registration order unless
+    /// a dependency requires a buffer to be submitted later.
+    class FrameComposer
+    {
+    public:
+        /// Runs task(0) .. task(taskCount - 1) concurrently and returns once all have finished.
+        typedef std::function<void(uint32_t taskCount, const std::function<void(uint32_t)>& task)> parallel_func_t;
+
+        struct Timing
+        {
+            /// Time spent sorting the buffer in the last frame, in milliseconds.
+            float sortTime;
+            /// Time spent submitting the buffer in the last frame, in milliseconds.
+            float submitTime;
+        };
+
+        ///@param parallelFunc Used to run the sorts, should hand them to the application's worker threads.
+        ///@note The default, runAsync, is only a fallback as it starts a thread per sort on every frame.
+        explicit FrameComposer(parallel_func_t parallelFunc = &FrameComposer::runAsync);
+
+        /// Registers a command buffer and returns its handle.
+        ///@param sortFunc The sort function used for the buffer, @see CommandBuffer::sort.
+        template <class CommandBufferClass>
+        uint32_t add(CommandBufferClass& buffer,
+                     typename CommandBufferClass::sort_func_t sortFunc = std::sort<typename CommandBufferClass::command_t*>,
+                     const char* name = "");
+        /// Declares that the buffer must be submitted after the dependency.
+        void addDependency(uint32_t buffer, uint32_t dependency);
+
+        /// Sorts all buffers concurrently.
+        void sort();
+        /// Submits all sorted buffers, in order, through the same render context.
+        void submit(cb::RenderContext* rc, bool clearBuffers = true);
+
+        size_t count() const;
+        const char* name(uint32_t buffer) const;
+        const Timing& timing(uint32_t buffer) const;
+
+        /// Fallback parallel function, runs the first task on the calling thread and each other one on
+        /// a new std::async thread.
+        static void runAsync(uint32_t taskCount, const std::function<void(uint32_t)>& task);
+
+    private:
+        void updateSubmitOrder();
+
+    private:
+        typedef std::chrono::high_resolution_clock clock_t;
+
+        struct Entry
+        {
+            std::function<void()> sort;
+            std::function<void(cb::RenderContext*, bool)> submit;
+            std::vector<uint32_t> dependencies;
+            const char* name;
+            Timing timing;
+        };
+
+        parallel_func_t       m_parallelFunc;
+        std::vector<Entry>    m_entries;
+        std::vector<uint32_t> m_submitOrder;
+
+        FrameComposer(const FrameComposer&) = delete;
+        void operator=(const FrameComposer&) = delete;
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline FrameComposer::FrameComposer(parallel_func_t parallelFunc)
+        : m_parallelFunc(parallelFunc)
+    {
+        assert(m_parallelFunc);
+    }
+
+    template <class CommandBufferClass>
+    inline uint32_t FrameComposer::add(CommandBufferClass& buffer, typename CommandBufferClass::sort_func_t sortFunc,
+                                       const char* name)
+    {
+        Entry entry;
+        entry.sort = [&buffer, sortFunc]() { buffer.sort(sortFunc); };
+        entry.submit = [&buffer](cb::RenderContext* rc, bool clearBuffer) { buffer.submit(rc, clearBuffer); };
+        entry.name = name;
+        entry.timing = Timing();
+        m_entries.push_back(entry);
+
+        updateSubmitOrder();
+        return (uint32_t)m_entries.size() - 1;
+    }
+
+    inline void FrameComposer::addDependency(uint32_t buffer, uint32_t dependency)
+    {
+        assert(buffer < m_entries.size() && dependency < m_entries.size());
+        assert(buffer != dependency);
+
+        m_entries[buffer].dependencies.push_back(dependency);
+        updateSubmitOrder();
+    }
+
+    inline void FrameComposer::sort()
+    {
+        m_parallelFunc((uint32_t)m_entries.size(), [this](uint32_t index) {
+            Entry& entry = m_entries[index];
+
+            const auto start = clock_t::now();
+            entry.sort();
+            entry.timing.sortTime = std::chrono::duration<float, std::milli>(clock_t::now() - start).count();
+        });
+    }
+
+    inline void FrameComposer::submit(cb::RenderContext* rc, bool clearBuffers /*= true*/)
+    {
+        for (uint32_t index : m_submitOrder)
+        {
+            Entry& entry = m_entries[index];
+
+            const auto start = clock_t::now();
+            entry.submit(rc, clearBuffers);
+            entry.timing.submitTime = std::chrono::duration<float, std::milli>(clock_t::now() - start).count();
+        }
+    }
+
+    inline size_t FrameComposer::count() const
+    {
+        return m_entries.size();
+    }
+
+    inline const char* FrameComposer::name(uint32_t buffer) const
+    {
+        return m_entries[buffer].name;
+    }
+
+    inline const FrameComposer::Timing& FrameComposer::timing(uint32_t buffer) const
+    {
+        return m_entries[buffer].timing;
+    }
+
+    inline void FrameComposer::runAsync(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+    {
+        std::vector<std::future<void>> futures;
+        futures.reserve(taskCount);
+        for (uint32_t i = 1; i < taskCount; ++i)
+            futures.push_back(std::async(std::launch::async, task, i));
+
+        if (taskCount)
+            task(0);
+        for (auto& future : futures)
+            future.wait();
+    }
+
+    inline void FrameComposer::updateSubmitOrder()
+    {
+        // stable topological order, the first registered buffer whose dependencies were submitted goes next
+        const size_t count = m_entries.size();
+        std::vector<bool> submitted(count, false);
+
+        m_submitOrder.clear();
+        while (m_submitOrder.size() < count)
+        {
+            size_t next = count;
+            for (size_t i = 0; i < count && next == count; ++i)
+            {
+                if (submitted[i])
+                    continue;
+
+                const auto& dependencies = m_entries[i].dependencies;
+                const bool ready = std::all_of(dependencies.begin(), dependencies.end(),
+                                               [&submitted](uint32_t dependency) { return submitted[dependency]; });
+                if (ready)
+                    next = i;
+            }
+            // circular dependencies
+            assert(next != count);
+            if (next == count)
+                return;
+
+            submitted[next] = true;
+            m_submitOrder.push_back((uint32_t)next);
+        }
+    }
+}  // namespace cb
@@ -6,13 +6,15 @@
 
 #include <atomic>
 
+#include "MemorySource.h"
 #include "MemoryUtil.h"
 
 namespace cb
 {
     /// Thread safe linear allocator.
     ///@note If alignment is zero then it'll auto align.
-    template <int Alignment = 0>
+    ///@note The memory source allocates the arena(@see MemorySource.h), by default it's not zero filled.
+    template <int Alignment = 0, class MemorySourceClass = HeapMemorySource<>>
     class LinearAllocator
     {
     public:
@@ -27,11 +29,14 @@ namespace cb
         void resize(uint32_t size);
 
         size_t size() const;
+        /// Returns the start of the arena, allocations can be referenced by their offset from it.
+        uint8_t* data() const;
 
     private:
         uint32_t              m_size;  // total size of the allocated memory
         uint8_t*              m_start;
         std::atomic<uint32_t> m_current;
+        bool                  m_ownsData;
 
         LinearAllocator(const LinearAllocator&) = delete;
         void operator=(const LinearAllocator&) = delete;
@@ -39,34 +44,37 @@ namespace cb
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    template <int Alignment>
-    inline LinearAllocator<Alignment>::LinearAllocator(uint32_t size)
+    template <int Alignment, class MemorySourceClass>
+    inline LinearAllocator<Alignment, MemorySourceClass>::LinearAllocator(uint32_t size)
         : m_size(size + size % (Alignment ? Alignment : sizeof(uint32_t)))  // aligned to the given alignment or to 4 bytes
-        , m_start(new uint8_t[m_size]())
+        , m_start(MemorySourceClass::allocate(m_size))
         , m_current(0)
+        , m_ownsData(true)
     {
         assert(m_current.is_lock_free());
         assert(m_size % sizeof(uint32_t) == 0);
     }
 
-    template <int Alignment>
-    inline LinearAllocator<Alignment>::LinearAllocator(uint8_t* data, uint32_t size)
+    template <int Alignment, class MemorySourceClass>
+    inline LinearAllocator<Alignment, MemorySourceClass>::LinearAllocator(uint8_t* data, uint32_t size)
         : m_size(size)
         , m_start(data)
         , m_current(0)
+        , m_ownsData(false)
     {
         assert(m_current.is_lock_free());
         assert(m_size % sizeof(uint32_t) == 0);
     }
 
-    template <int Alignment>
-    inline LinearAllocator<Alignment>::~LinearAllocator()
+    template <int Alignment, class MemorySourceClass>
+    inline LinearAllocator<Alignment, MemorySourceClass>::~LinearAllocator()
     {
-        delete[] m_start;
+        if (m_ownsData)
+            MemorySourceClass::deallocate(m_start, m_size);
     }
 
-    template <int Alignment>
-    inline uint8_t* LinearAllocator<Alignment>::alloc(uint32_t bytes, uint32_t alignment)
+    template <int Alignment, class MemorySourceClass>
+    inline uint8_t* LinearAllocator<Alignment, MemorySourceClass>::alloc(uint32_t bytes, uint32_t alignment)
     {
         assert(bytes);
 
@@ -104,36 +112,44 @@ namespace cb
         return currentOffset;
     }
 
-    template <int Alignment>
-    inline void LinearAllocator<Alignment>::dealloc(uint8_t*)
+    template <int Alignment, class MemorySourceClass>
+    inline void LinearAllocator<Alignment, MemorySourceClass>::dealloc(uint8_t*)
     {
         // must use deallocAll
         assert(false);
     }
 
-    template <int Alignment>
-    inline void LinearAllocator<Alignment>::deallocAll()
+    template <int Alignment, class MemorySourceClass>
+    inline void LinearAllocator<Alignment, MemorySourceClass>::deallocAll()
     {
         m_current.store(0, std::memory_order_release);
     }
 
-    template <int Alignment>
-    inline void LinearAllocator<Alignment>::resize(uint32_t size)
+    template <int Alignment, class MemorySourceClass>
+    inline void LinearAllocator<Alignment, MemorySourceClass>::resize(uint32_t size)
     {
         if (size == m_size)
             return;
 
         deallocAll();
 
-        delete[] m_start;
+        if (m_ownsData)
+            MemorySourceClass::deallocate(m_start, m_size);
 
         m_size = size + size % (Alignment ? Alignment : sizeof(uint32_t));
-        m_start = new uint8_t[m_size]();
+        m_start = MemorySourceClass::allocate(m_size);
+        m_ownsData = true;
     }
 
-    template <int Alignment>
-    inline size_t LinearAllocator<Alignment>::size() const
+    template <int Alignment, class MemorySourceClass>
+    inline size_t LinearAllocator<Alignment, MemorySourceClass>::size() const
     {
         return m_current;
     }
+
+    template <int Alignment, class MemorySourceClass>
+    inline uint8_t* LinearAllocator<Alignment, MemorySourceClass>::data() const
+    {
+        return m_start;
+    }
 }  // namespace cb
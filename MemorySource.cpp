@@ -0,0 +1,109 @@
+#include "MemorySource.h"
+
+#include <cassert>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cb
+{
+    namespace mem
+    {
+        static size_t pageAlignedSize(size_t size, uint32_t flags)
+        {
+            const size_t pageSize = (flags & kMemoryHugePages) ? kHugePageSize : kPageSize;
+            return (size + pageSize - 1) & ~(pageSize - 1);
+        }
+
+#if defined(_WIN32)
+        uint8_t* virtualAllocate(size_t size, uint32_t flags, int numaNode)
+        {
+            const DWORD node = numaNode < 0 ? NUMA_NO_PREFERRED_NODE : (DWORD)numaNode;
+            void* data = nullptr;
+            size_t alignedSize = 0;
+            // large pages require the SeLockMemoryPrivilege, fallback to regular pages otherwise
+            const SIZE_T largePageSize = (flags & kMemoryHugePages) ? GetLargePageMinimum() : 0;
+            if (largePageSize)
+            {
+                alignedSize = (size + largePageSize - 1) & ~(largePageSize - 1);
+                data = VirtualAllocExNuma(GetCurrentProcess(), nullptr, alignedSize,
+                                          MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, node);
+            }
+            if (!data)
+            {
+                alignedSize = pageAlignedSize(size, flags);
+                data = VirtualAllocExNuma(GetCurrentProcess(), nullptr, alignedSize, MEM_RESERVE | MEM_COMMIT,
+                                          PAGE_READWRITE, node);
+            }
+            assert(data);
+            if (!data)
+                return nullptr;
+
+            if (flags & kMemoryLocked)
+                VirtualLock(data, alignedSize);
+            if (flags & (kMemoryPrefault | kMemoryLocked))
+                prefault(static_cast<uint8_t*>(data), alignedSize);
+            return static_cast<uint8_t*>(data);
+        }
+
+        void virtualDeallocate(uint8_t* data, size_t, uint32_t)
+        {
+            if (data)
+                VirtualFree(data, 0, MEM_RELEASE);
+        }
+#else
+        uint8_t* virtualAllocate(size_t size, uint32_t flags, int numaNode)
+        {
+            const size_t alignedSize = pageAlignedSize(size, flags);
+            void* data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+            // requires reserved huge pages, i.e. /proc/sys/vm/nr_hugepages
+            if (flags & kMemoryHugePages)
+                data = mmap(nullptr, alignedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+            if (data == MAP_FAILED)
+            {
+                data = mmap(nullptr, alignedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                assert(data != MAP_FAILED);
+                if (data == MAP_FAILED)
+                    return nullptr;
+#ifdef MADV_HUGEPAGE
+                if (flags & kMemoryHugePages)
+                    madvise(data, alignedSize, MADV_HUGEPAGE);
+#endif
+            }
+
+#ifdef SYS_mbind
+            if (numaNode >= 0)
+            {
+                // must be set before the pages are faulted, MPOL_BIND is 2
+                const unsigned long nodeMask = 1ul << numaNode;
+                syscall(SYS_mbind, data, alignedSize, 2, &nodeMask, sizeof(nodeMask) * 8, 0);
+            }
+#endif
+            if (flags & kMemoryLocked)
+                mlock(data, alignedSize);
+            if (flags & (kMemoryPrefault | kMemoryLocked))
+                prefault(static_cast<uint8_t*>(data), alignedSize);
+            return static_cast<uint8_t*>(data);
+        }
+
+        void virtualDeallocate(uint8_t* data, size_t size, uint32_t flags)
+        {
+            if (data)
+                munmap(data, pageAlignedSize(size, flags));
+        }
+#endif
+    }  // namespace mem
+}  // namespace cb
@@ -0,0 +1,91 @@
+//
+//  MemorySource.h
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cb
+{
+    /// Flags of the memory sources.
+    enum MemorySourceFlags : uint32_t
+    {
+        /// The memory is zero filled.
+        kMemoryZeroed = 1 << 0,
+        /// All the pages are touched on allocation, so there are no page faults when first written.
+        kMemoryPrefault = 1 << 1,
+        /// Backed by huge pages(large pages on Windows), falls back to transparent huge pages or to regular pages.
+        kMemoryHugePages = 1 << 2,
+        /// Locked in physical memory, implies kMemoryPrefault.
+        kMemoryLocked = 1 << 3,
+    };
+
+    namespace mem
+    {
+        static const size_t kPageSize = 4 * 1024;
+        static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+        inline void prefault(uint8_t* data, size_t size)
+        {
+            // writing is required, reading maps the shared zero page
+            for (size_t offset = 0; offset < size; offset += kPageSize)
+                data[offset] = 0;
+        }
+
+        /// Platform implementation of VirtualMemorySource, in MemorySource.cpp.
+        uint8_t* virtualAllocate(size_t size, uint32_t flags, int numaNode);
+        void virtualDeallocate(uint8_t* data, size_t size, uint32_t flags);
+    }
+
+    /// Allocates from the heap, the default memory source of the allocators.
+    ///@note Supports kMemoryZeroed and kMemoryPrefault.
+    template <uint32_t Flags = 0>
+    struct HeapMemorySource
+    {
+        static_assert((Flags & ~(kMemoryZeroed | kMemoryPrefault)) == 0, "unsupported flags");
+
+        static uint8_t* allocate(size_t size);
+        static void deallocate(uint8_t* data, size_t size);
+    };
+
+    /// Allocates pages directly from the OS, the memory is always zero filled.
+    ///@param NumaNode If not negative the pages are placed on the given NUMA node.
+    ///@note The OS calls are made in MemorySource.cpp, which must be compiled with the application.
+    template <uint32_t Flags = 0, int NumaNode = -1>
+    struct VirtualMemorySource
+    {
+        static uint8_t* allocate(size_t size);
+        static void deallocate(uint8_t* data, size_t size);
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    template <uint32_t Flags>
+    inline uint8_t* HeapMemorySource<Flags>::allocate(size_t size)
+    {
+        uint8_t* data = (Flags & kMemoryZeroed) ? new uint8_t[size]() : new uint8_t[size];
+        if ((Flags & kMemoryPrefault) && !(Flags & kMemoryZeroed))
+            mem::prefault(data, size);
+        return data;
+    }
+
+    template <uint32_t Flags>
+    inline void HeapMemorySource<Flags>::deallocate(uint8_t* data, size_t)
+    {
+        delete[] data;
+    }
+
+    template <uint32_t Flags, int NumaNode>
+    inline uint8_t* VirtualMemorySource<Flags, NumaNode>::allocate(size_t size)
+    {
+        return mem::virtualAllocate(size, Flags, NumaNode);
+    }
+
+    template <uint32_t Flags, int NumaNode>
+    inline void VirtualMemorySource<Flags, NumaNode>::deallocate(uint8_t* data, size_t size)
+    {
+        mem::virtualDeallocate(data, size, Flags);
+    }
+}  // namespace cb
@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 namespace cb
 {
@@ -83,5 +84,23 @@ namespace cb
             return static_cast<uint32_t>(adjustment);
         }
 
+        /// @brief FNV-1a hash of a memory block, consumes 4 bytes per step.
+        inline uint32_t hash(const void* data, size_t size)
+        {
+            const uint32_t kPrime = 16777619u;
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+            uint32_t h = 2166136261u ^ static_cast<uint32_t>(size);
+            for (; size >= sizeof(uint32_t); size -= sizeof(uint32_t), bytes += sizeof(uint32_t))
+            {
+                uint32_t word;
+                memcpy(&word, bytes, sizeof(word));
+                h = (h ^ word) * kPrime;
+            }
+            for (; size; --size, ++bytes)
+                h = (h ^ *bytes) * kPrime;
+            return h;
+        }
+
     }  // end of namespace mem
 }  // end of namespace cb
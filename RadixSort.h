@@ -0,0 +1,93 @@
+//
+//  RadixSort.h
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "CommandKeys.h"
+
+namespace cb
+{
+    /// The radix sort order of a key type, must match the order of its operator<.
+    template <typename KeyType>
+    struct RadixKeyTraits
+    {
+        static const bool kDescending = false;
+    };
+
+    template <>
+    struct RadixKeyTraits<cb::DrawKey>
+    {
+        static const bool kDescending = true;
+    };
+
+    template <>
+    struct RadixKeyTraits<cb::WideDrawKey>
+    {
+        static const bool kDescending = true;
+    };
+
+    /// Stable LSD radix sort of commands by the bytes of their keys, can be used as a command buffer's sort function.
+    ///@note The bytes of the key must be in little-endian order of significance. Digits that are the same for all
+    /// the keys are skipped, i.e. the unused high bits of the material id or a single viewport.
+    template <class CommandPairClass>
+    void radixSort(CommandPairClass* begin, CommandPairClass* end);
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    template <class CommandPairClass>
+    inline void radixSort(CommandPairClass* begin, CommandPairClass* end)
+    {
+        typedef decltype(begin->key) key_t;
+        const uint32_t kDigitCount = sizeof(key_t);
+        const bool kDescending = RadixKeyTraits<key_t>::kDescending;
+
+        const size_t count = end - begin;
+        if (count < 2)
+            return;
+
+        // the histograms of all digits are built in a single pass
+        uint32_t histograms[kDigitCount][256];
+        memset(histograms, 0, sizeof(histograms));
+        for (const CommandPairClass* it = begin; it != end; ++it)
+        {
+            const uint8_t* digits = reinterpret_cast<const uint8_t*>(&it->key);
+            for (uint32_t digit = 0; digit < kDigitCount; ++digit)
+                ++histograms[digit][digits[digit]];
+        }
+
+        static thread_local std::vector<CommandPairClass> scratch;
+        scratch.resize(count);
+
+        CommandPairClass* src = begin;
+        CommandPairClass* dst = scratch.data();
+        for (uint32_t digit = 0; digit < kDigitCount; ++digit)
+        {
+            uint32_t* histogram = histograms[digit];
+            if (histogram[reinterpret_cast<const uint8_t*>(&src->key)[digit]] == count)
+                continue;
+
+            // bucket offsets, in reverse order for descending keys
+            uint32_t offset = 0;
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                const uint32_t bucket = kDescending ? 255 - i : i;
+                const uint32_t bucketCount = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += bucketCount;
+            }
+
+            for (const CommandPairClass* it = src; it != src + count; ++it)
+                dst[histogram[reinterpret_cast<const uint8_t*>(&it->key)[digit]]++] = *it;
+            std::swap(src, dst);
+        }
+
+        if (src != begin)
+            std::copy(src, src + count, begin);
+    }
+}  // namespace cb
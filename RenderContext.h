@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <cassert>
+#include <cstdint>
+
 namespace cb
 {
     struct RenderContext
@@ -16,12 +19,27 @@ namespace cb
         ContextClass& data();
         template <class ContextClass>
         const ContextClass& data() const;
+
+        /// The viewport id of the command being dispatched, lets commands added with
+        /// CommandBuffer::addMultiViewCommand select their per view state.
+        uint32_t viewportId() const;
+        void setViewportId(uint32_t viewportId);
+
+        /// Resolves a handle returned by CommandBuffer::addConstantBlock, only valid while
+        /// dispatching the commands of the buffer that recorded the block.
+        template <typename T>
+        const T& constantBlock(uint32_t handle) const;
+        void setConstantBlocks(const uint8_t* constantBlocks);
     private:
         void* m_contextData;
+        const uint8_t* m_constantBlocks;
+        uint32_t m_viewportId;
     };
 
     inline RenderContext::RenderContext(void* contextData)
         : m_contextData(contextData)
+        , m_constantBlocks(nullptr)
+        , m_viewportId(0)
     {}
 
     template <class ContextClass>
@@ -35,5 +53,27 @@ namespace cb
     {
         return *reinterpret_cast<const ContextClass*>(m_contextData);
     }
+
+    inline uint32_t RenderContext::viewportId() const
+    {
+        return m_viewportId;
+    }
+
+    inline void RenderContext::setViewportId(uint32_t viewportId)
+    {
+        m_viewportId = viewportId;
+    }
+
+    template <typename T>
+    inline const T& RenderContext::constantBlock(uint32_t handle) const
+    {
+        assert(m_constantBlocks);
+        return *reinterpret_cast<const T*>(m_constantBlocks + handle);
+    }
+
+    inline void RenderContext::setConstantBlocks(const uint8_t* constantBlocks)
+    {
+        m_constantBlocks = constantBlocks;
+    }
 }
 
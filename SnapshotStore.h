@@ -0,0 +1,329 @@
+//
+//  SnapshotStore.h
+//
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace cb
+{
+    /// Lock-free ring of versions of an array, each tagged with the epoch it was published at.
+    /// The next version is written while any number of readers pin published ones, a reader always
+    /// sees a consistent version as it's only rewritten once no reader pins it.
+    ///@note With N versions the writer can publish the N - 1 epochs after the oldest pinned one, E, and
+    /// only waits in beginWrite(E + N), i.e. with 3 versions it publishes E + 1 and E + 2 while readers
+    /// consume epoch E, and blocks in beginWrite(E + 3).
+    template <typename T>
+    class SnapshotStore
+    {
+        struct Version;
+
+    public:
+        /// A pinned version, unchanged until the snapshot is released or destroyed.
+        class Snapshot
+        {
+        public:
+            Snapshot();
+            Snapshot(Snapshot&& other);
+            Snapshot& operator=(Snapshot&& other);
+            ~Snapshot();
+
+            /// False if nothing was published yet or the requested epoch was already recycled.
+            bool valid() const;
+            const T* data() const;
+            uint32_t count() const;
+            /// The epoch the version was published at, 0 if invalid.
+            uint64_t epoch() const;
+            const T& operator[](uint32_t index) const;
+
+            void release();
+
+        private:
+            friend class SnapshotStore;
+            Snapshot(Version* version, uint64_t epoch, const T* data);
+
+            Version* m_version;
+            uint64_t m_epoch;
+            const T* m_data;
+
+            Snapshot(const Snapshot&) = delete;
+            void operator=(const Snapshot&) = delete;
+        };
+
+        explicit SnapshotStore(uint32_t capacity = 0, uint32_t versionCount = 3);
+
+        ///@note Not thread safe, discards all the versions.
+        void resize(uint32_t capacity, uint32_t versionCount);
+
+        /// Returns the array of the next version, waits until its previous epoch is released by its readers.
+        ///@note Only one version is written at a time, the array may be filled by several threads as long
+        /// as they are done before publish. Its content is the one of an older version.
+        T* beginWrite(uint32_t count);
+        /// Same as beginWrite but returns nullptr instead of waiting.
+        T* tryBeginWrite(uint32_t count);
+        /// Makes the written version the latest one and returns its epoch.
+        uint64_t publish();
+
+        /// Pins the latest published version.
+        Snapshot acquire() const;
+        /// Pins the version published at epoch, if it wasn't recycled or started being rewritten.
+        Snapshot acquire(uint64_t epoch) const;
+
+        /// Returns the epoch of the latest published version, 0 if none.
+        uint64_t publishedEpoch() const;
+        uint32_t capacity() const;
+        uint32_t versionCount() const;
+
+    private:
+        struct Version
+        {
+            std::atomic<uint64_t> epoch;  // 0 while written
+            std::atomic<uint32_t> readers;
+            uint32_t              count;
+        };
+
+        Version& versionOf(uint64_t epoch) const;
+        bool     tryLockNext(Version& version);
+
+        std::unique_ptr<Version[]> m_versions;
+        std::vector<T>             m_data;
+        uint32_t                   m_capacity;
+        uint32_t                   m_versionCount;
+        std::atomic<uint64_t>      m_published;
+        bool                       m_writing;
+
+        SnapshotStore(const SnapshotStore&) = delete;
+        void operator=(const SnapshotStore&) = delete;
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    template <typename T>
+    inline SnapshotStore<T>::Snapshot::Snapshot()
+        : m_version(nullptr)
+        , m_epoch(0)
+        , m_data(nullptr)
+    {
+    }
+
+    template <typename T>
+    inline SnapshotStore<T>::Snapshot::Snapshot(Version* version, uint64_t epoch, const T* data)
+        : m_version(version)
+        , m_epoch(epoch)
+        , m_data(data)
+    {
+    }
+
+    template <typename T>
+    inline SnapshotStore<T>::Snapshot::Snapshot(Snapshot&& other)
+        : m_version(other.m_version)
+        , m_epoch(other.m_epoch)
+        , m_data(other.m_data)
+    {
+        other.m_version = nullptr;
+        other.m_epoch = 0;
+        other.m_data = nullptr;
+    }
+
+    template <typename T>
+    inline typename SnapshotStore<T>::Snapshot& SnapshotStore<T>::Snapshot::operator=(Snapshot&& other)
+    {
+        if (this != &other)
+        {
+            release();
+            m_version = other.m_version;
+            m_epoch = other.m_epoch;
+            m_data = other.m_data;
+            other.m_version = nullptr;
+            other.m_epoch = 0;
+            other.m_data = nullptr;
+        }
+        return *this;
+    }
+
+    template <typename T>
+    inline SnapshotStore<T>::Snapshot::~Snapshot()
+    {
+        release();
+    }
+
+    template <typename T>
+    inline bool SnapshotStore<T>::Snapshot::valid() const
+    {
+        return m_version != nullptr;
+    }
+
+    template <typename T>
+    inline const T* SnapshotStore<T>::Snapshot::data() const
+    {
+        return m_data;
+    }
+
+    template <typename T>
+    inline uint32_t SnapshotStore<T>::Snapshot::count() const
+    {
+        return m_version ? m_version->count : 0;
+    }
+
+    template <typename T>
+    inline uint64_t SnapshotStore<T>::Snapshot::epoch() const
+    {
+        return m_epoch;
+    }
+
+    template <typename T>
+    inline const T& SnapshotStore<T>::Snapshot::operator[](uint32_t index) const
+    {
+        assert(index < count());
+        return m_data[index];
+    }
+
+    template <typename T>
+    inline void SnapshotStore<T>::Snapshot::release()
+    {
+        if (!m_version)
+            return;
+        // the writer acquires it before reusing the version
+        m_version->readers.fetch_sub(1, std::memory_order_release);
+        m_version = nullptr;
+        m_epoch = 0;
+        m_data = nullptr;
+    }
+
+    template <typename T>
+    inline SnapshotStore<T>::SnapshotStore(uint32_t capacity, uint32_t versionCount)
+        : m_capacity(0)
+        , m_versionCount(0)
+        , m_published(0)
+        , m_writing(false)
+    {
+        assert(m_published.is_lock_free());
+        resize(capacity, versionCount);
+    }
+
+    template <typename T>
+    inline void SnapshotStore<T>::resize(uint32_t capacity, uint32_t versionCount)
+    {
+        assert(versionCount >= 2);
+
+        m_capacity = capacity;
+        m_versionCount = versionCount;
+        m_data.assign((size_t)capacity * versionCount, T());
+        m_versions.reset(new Version[versionCount]);
+        for (uint32_t i = 0; i < versionCount; ++i)
+        {
+            m_versions[i].epoch.store(0, std::memory_order_relaxed);
+            m_versions[i].readers.store(0, std::memory_order_relaxed);
+            m_versions[i].count = 0;
+        }
+        m_published.store(0, std::memory_order_release);
+        m_writing = false;
+    }
+
+    template <typename T>
+    inline typename SnapshotStore<T>::Version& SnapshotStore<T>::versionOf(uint64_t epoch) const
+    {
+        return m_versions[epoch % m_versionCount];
+    }
+
+    template <typename T>
+    inline bool SnapshotStore<T>::tryLockNext(Version& version)
+    {
+        // Clearing the epoch first fails the readers that are about to pin it, the ones that pinned it
+        // before are seen in the count (both sides are sequentially consistent).
+        version.epoch.store(0, std::memory_order_seq_cst);
+        return version.readers.load(std::memory_order_seq_cst) == 0;
+    }
+
+    template <typename T>
+    inline T* SnapshotStore<T>::beginWrite(uint32_t count)
+    {
+        T* data;
+        while (!(data = tryBeginWrite(count)))
+            std::this_thread::yield();
+        return data;
+    }
+
+    template <typename T>
+    inline T* SnapshotStore<T>::tryBeginWrite(uint32_t count)
+    {
+        assert(count <= m_capacity);
+
+        const uint64_t epoch = m_published.load(std::memory_order_relaxed) + 1;
+        Version&       version = versionOf(epoch);
+        if (!tryLockNext(version))
+            return nullptr;
+
+        m_writing = true;
+        version.count = count;
+        return m_data.data() + (size_t)(epoch % m_versionCount) * m_capacity;
+    }
+
+    template <typename T>
+    inline uint64_t SnapshotStore<T>::publish()
+    {
+        assert(m_writing);
+
+        const uint64_t epoch = m_published.load(std::memory_order_relaxed) + 1;
+        // the readers acquire the epoch, then the content written before it
+        versionOf(epoch).epoch.store(epoch, std::memory_order_release);
+        m_published.store(epoch, std::memory_order_release);
+        m_writing = false;
+        return epoch;
+    }
+
+    template <typename T>
+    inline typename SnapshotStore<T>::Snapshot SnapshotStore<T>::acquire() const
+    {
+        for (;;)
+        {
+            const uint64_t epoch = m_published.load(std::memory_order_acquire);
+            if (!epoch)
+                return Snapshot();
+            Snapshot snapshot = acquire(epoch);
+            // else the writer lapped the ring meanwhile, retry with its latest version
+            if (snapshot.valid())
+                return snapshot;
+        }
+    }
+
+    template <typename T>
+    inline typename SnapshotStore<T>::Snapshot SnapshotStore<T>::acquire(uint64_t epoch) const
+    {
+        if (!epoch || epoch > m_published.load(std::memory_order_acquire))
+            return Snapshot();
+
+        Version& version = versionOf(epoch);
+        version.readers.fetch_add(1, std::memory_order_seq_cst);
+        if (version.epoch.load(std::memory_order_seq_cst) != epoch)
+        {
+            version.readers.fetch_sub(1, std::memory_order_release);
+            return Snapshot();
+        }
+        return Snapshot(&version, epoch, m_data.data() + (size_t)(epoch % m_versionCount) * m_capacity);
+    }
+
+    template <typename T>
+    inline uint64_t SnapshotStore<T>::publishedEpoch() const
+    {
+        return m_published.load(std::memory_order_acquire);
+    }
+
+    template <typename T>
+    inline uint32_t SnapshotStore<T>::capacity() const
+    {
+        return m_capacity;
+    }
+
+    template <typename T>
+    inline uint32_t SnapshotStore<T>::versionCount() const
+    {
+        return m_versionCount;
+    }
+}  // namespace cb
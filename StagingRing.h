@@ -0,0 +1,158 @@
+//
+//  StagingRing.h
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+
+#include "MemoryUtil.h"
+
+namespace cb
+{
+    /// Thread safe per frame staging memory, i.e. for data that's written at record time by the worker
+    /// threads and read by commands at submit.
+    ///@note Each frame has its own region, a region is reused framesInFlight frames after it was recorded
+    /// so its data must have been consumed by then, or the wait function must block until it was.
+    class StagingRing
+    {
+    public:
+        /// Blocks until the given frame was consumed, i.e. waits on the fence of a render thread's submit.
+        typedef std::function<void(uint32_t frame)> wait_func_t;
+
+        ///@param waitFunc Optional, called by nextFrame before reusing the region of a recorded frame.
+        explicit StagingRing(uint32_t frameBytes = 0, uint32_t framesInFlight = 2,
+                             const wait_func_t& waitFunc = wait_func_t());
+        ~StagingRing();
+
+        /// Allocates from the region of the current frame, returns nullptr if the region is full.
+        uint8_t* alloc(uint32_t bytes, uint32_t alignment = 16);
+        template <typename T>
+        T* alloc(uint32_t count);
+
+        /// Moves to the next frame and recycles its region, if there's a wait function then it's called
+        /// with the frame that last used the region.
+        ///@note Must not be called while allocating.
+        void nextFrame();
+
+        ///@note Discards all the allocations.
+        void resize(uint32_t frameBytes, uint32_t framesInFlight);
+
+        /// Returns the count of recorded frames.
+        uint32_t frameIndex() const;
+        uint32_t framesInFlight() const;
+        uint32_t frameBytes() const;
+        /// Returns the allocated bytes in the current frame.
+        uint32_t frameUsed() const;
+        /// Returns how many times nextFrame called the wait function.
+        uint32_t waitCount() const;
+
+    private:
+        uint8_t*              m_data;
+        uint32_t              m_frameBytes;
+        uint32_t              m_framesInFlight;
+        uint32_t              m_frameIndex;
+        uint32_t              m_waitCount;
+        wait_func_t           m_waitFunc;
+        std::atomic<uint32_t> m_current;
+
+        StagingRing(const StagingRing&) = delete;
+        void operator=(const StagingRing&) = delete;
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline StagingRing::StagingRing(uint32_t frameBytes, uint32_t framesInFlight, const wait_func_t& waitFunc)
+        : m_data(nullptr)
+        , m_frameBytes(0)
+        , m_framesInFlight(0)
+        , m_frameIndex(0)
+        , m_waitCount(0)
+        , m_waitFunc(waitFunc)
+        , m_current(0)
+    {
+        assert(m_current.is_lock_free());
+        resize(frameBytes, framesInFlight);
+    }
+
+    inline StagingRing::~StagingRing()
+    {
+        delete[] m_data;
+    }
+
+    inline uint8_t* StagingRing::alloc(uint32_t bytes, uint32_t alignment /*= 16*/)
+    {
+        assert(bytes);
+        assert(alignment && (alignment & (alignment - 1)) == 0);
+
+        uint8_t* region = m_data + (m_frameIndex % m_framesInFlight) * m_frameBytes;
+        uint32_t current, padding;
+        do
+        {
+            current = m_current.load(std::memory_order_acquire);
+            padding = cb::mem::alignForwardPadding(region + current, alignment);
+            if (current + padding + bytes > m_frameBytes)
+                return nullptr;
+            // retry if the current offset has changed
+        } while (!m_current.compare_exchange_weak(current, current + padding + bytes, std::memory_order_release));
+
+        return region + current + padding;
+    }
+
+    template <typename T>
+    inline T* StagingRing::alloc(uint32_t count)
+    {
+        return reinterpret_cast<T*>(alloc(count * sizeof(T), alignof(T) < 16 ? 16 : alignof(T)));
+    }
+
+    inline void StagingRing::nextFrame()
+    {
+        ++m_frameIndex;
+        if (m_waitFunc && m_frameIndex >= m_framesInFlight)
+        {
+            m_waitFunc(m_frameIndex - m_framesInFlight);
+            ++m_waitCount;
+        }
+        m_current.store(0, std::memory_order_release);
+    }
+
+    inline void StagingRing::resize(uint32_t frameBytes, uint32_t framesInFlight)
+    {
+        assert(framesInFlight);
+
+        delete[] m_data;
+        m_frameBytes = frameBytes;
+        m_framesInFlight = framesInFlight;
+        m_data = frameBytes ? new uint8_t[(size_t)frameBytes * framesInFlight] : nullptr;
+        m_current.store(0, std::memory_order_release);
+    }
+
+    inline uint32_t StagingRing::frameIndex() const
+    {
+        return m_frameIndex;
+    }
+
+    inline uint32_t StagingRing::framesInFlight() const
+    {
+        return m_framesInFlight;
+    }
+
+    inline uint32_t StagingRing::frameBytes() const
+    {
+        return m_frameBytes;
+    }
+
+    inline uint32_t StagingRing::frameUsed() const
+    {
+        return std::min(m_current.load(std::memory_order_acquire), m_frameBytes);
+    }
+
+    inline uint32_t StagingRing::waitCount() const
+    {
+        return m_waitCount;
+    }
+}  // namespace cb
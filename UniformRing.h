@@ -0,0 +1,222 @@
+//
+//  UniformRing.h
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace cb
+{
+    /// A block of the uniform ring, commands store its offset and size to bind it i.e. with glBindBufferRange.
+    struct UniformBlock
+    {
+        uint8_t* data;    // nullptr if the frame's region is full, the block must not be bound then
+        uint32_t offset;  // from the start of the buffer
+        uint32_t size;
+    };
+
+    /// Thread safe ring of uniform blocks in a persistently mapped buffer, written by the worker threads at
+    /// record time so the commands only bind their range.
+    ///@note The buffer is split in one region per frame, a region is reused regionCount frames after it was
+    /// recorded and beginFrame waits until the GPU has completed that frame.
+    class UniformRing
+    {
+    public:
+        /// Blocks until the GPU has completed the given frame, i.e. waits on the fence signaled after its submit.
+        typedef std::function<void(uint32_t frame)> wait_func_t;
+
+        UniformRing();
+        ~UniformRing();
+
+        ///@param data The mapped buffer of regionCount * frameBytes bytes, if null the ring allocates it.
+        ///@param waitFunc Called by beginFrame before reusing the region of a frame the GPU might still read.
+        ///@param offsetAlignment The alignment of the block offsets, i.e. GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+        ///@note The frame bytes are rounded up to the offset alignment, discards all the blocks.
+        void reset(uint8_t* data, uint32_t frameBytes, uint32_t regionCount, const wait_func_t& waitFunc,
+                   uint32_t offsetAlignment = 256);
+
+        /// Allocates a block in the region of the current frame, returns a null block if the region is full.
+        UniformBlock alloc(uint32_t size);
+        /// Allocates a block and copies the data into it.
+        template <typename T>
+        UniformBlock write(const T& data);
+
+        /// Moves to the next frame and its region, if the GPU might still read the region then the wait function
+        /// is called with the frame that last used it.
+        ///@note Must not be called while allocating.
+        void beginFrame();
+        /// Marks the frames up to the given one as completed by the GPU, their regions are reused without waiting.
+        ///@note Only an optimization, i.e. when the fence of the frame was already found signaled.
+        void frameCompleted(uint32_t frame);
+
+        /// Returns the current frame, starting from one.
+        uint32_t frame() const;
+        uint32_t region() const;
+        uint32_t regionCount() const;
+        uint32_t frameBytes() const;
+        /// Returns the size of the whole buffer, in bytes.
+        uint32_t bufferBytes() const;
+        /// Returns the allocated bytes in the current frame.
+        uint32_t frameUsed() const;
+        /// Returns how many times beginFrame called the wait function.
+        uint32_t waitCount() const;
+        uint8_t* data() const;
+
+    private:
+        uint8_t*              m_data;
+        bool                  m_ownsData;
+        uint32_t              m_frameBytes;
+        uint32_t              m_offsetAlignment;
+        uint32_t              m_frame;
+        uint32_t              m_completedFrame;
+        uint32_t              m_waitCount;
+        wait_func_t           m_waitFunc;
+        std::vector<uint32_t> m_regionFrames;  // the frame that last used each region, zero if none
+        std::atomic<uint32_t> m_current;
+
+        UniformRing(const UniformRing&) = delete;
+        void operator=(const UniformRing&) = delete;
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline UniformRing::UniformRing()
+        : m_data(nullptr)
+        , m_ownsData(false)
+        , m_frameBytes(0)
+        , m_offsetAlignment(1)
+        , m_frame(1)
+        , m_completedFrame(0)
+        , m_waitCount(0)
+        , m_current(0)
+    {
+        assert(m_current.is_lock_free());
+    }
+
+    inline UniformRing::~UniformRing()
+    {
+        if (m_ownsData)
+            delete[] m_data;
+    }
+
+    inline void UniformRing::reset(uint8_t* data, uint32_t frameBytes, uint32_t regionCount, const wait_func_t& waitFunc,
+                                   uint32_t offsetAlignment)
+    {
+        assert(regionCount > 1);
+        assert(waitFunc);
+        assert(offsetAlignment && (offsetAlignment & (offsetAlignment - 1)) == 0);
+
+        if (m_ownsData)
+            delete[] m_data;
+
+        m_offsetAlignment = offsetAlignment;
+        m_frameBytes = (frameBytes + offsetAlignment - 1) & ~(offsetAlignment - 1);
+        m_ownsData = data == nullptr;
+        m_data = data ? data : new uint8_t[(size_t)m_frameBytes * regionCount];
+
+        m_frame = 1;
+        m_completedFrame = 0;
+        m_waitCount = 0;
+        m_waitFunc = waitFunc;
+        m_regionFrames.assign(regionCount, 0);
+        m_regionFrames[m_frame % regionCount] = m_frame;
+        m_current.store(0, std::memory_order_release);
+    }
+
+    inline UniformBlock UniformRing::alloc(uint32_t size)
+    {
+        assert(size);
+
+        const uint32_t mask = m_offsetAlignment - 1;
+        const uint32_t alignedSize = (size + mask) & ~mask;
+        // offsets are kept aligned so the next block doesn't need padding
+        const uint32_t current = m_current.fetch_add(alignedSize, std::memory_order_relaxed);
+        if (current + alignedSize > m_frameBytes)
+        {
+            UniformBlock block = { nullptr, 0, 0 };
+            return block;
+        }
+
+        const uint32_t offset = region() * m_frameBytes + current;
+        UniformBlock block = { m_data + offset, offset, size };
+        return block;
+    }
+
+    template <typename T>
+    inline UniformBlock UniformRing::write(const T& data)
+    {
+        UniformBlock block = alloc(sizeof(T));
+        if (block.data)
+            memcpy(block.data, &data, sizeof(T));
+        return block;
+    }
+
+    inline void UniformRing::beginFrame()
+    {
+        ++m_frame;
+
+        uint32_t& regionFrame = m_regionFrames[region()];
+        if (regionFrame > m_completedFrame)
+        {
+            // the frames complete in order, so the previous ones are also done
+            m_waitFunc(regionFrame);
+            m_completedFrame = regionFrame;
+            ++m_waitCount;
+        }
+        regionFrame = m_frame;
+        m_current.store(0, std::memory_order_release);
+    }
+
+    inline void UniformRing::frameCompleted(uint32_t frame)
+    {
+        assert(frame < m_frame);
+        m_completedFrame = std::max(m_completedFrame, frame);
+    }
+
+    inline uint32_t UniformRing::frame() const
+    {
+        return m_frame;
+    }
+
+    inline uint32_t UniformRing::region() const
+    {
+        return m_frame % (uint32_t)m_regionFrames.size();
+    }
+
+    inline uint32_t UniformRing::regionCount() const
+    {
+        return (uint32_t)m_regionFrames.size();
+    }
+
+    inline uint32_t UniformRing::frameBytes() const
+    {
+        return m_frameBytes;
+    }
+
+    inline uint32_t UniformRing::bufferBytes() const
+    {
+        return m_frameBytes * regionCount();
+    }
+
+    inline uint32_t UniformRing::frameUsed() const
+    {
+        return std::min(m_current.load(std::memory_order_acquire), m_frameBytes);
+    }
+
+    inline uint32_t UniformRing::waitCount() const
+    {
+        return m_waitCount;
+    }
+
+    inline uint8_t* UniformRing::data() const
+    {
+        return m_data;
+    }
+}  // namespace cb
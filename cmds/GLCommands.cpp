@@ -5,7 +5,7 @@
 
 #ifndef USE_GLEW
 #define GL_GLEXT_PROTOTYPES
-#include <gl/glext.h>
+#include <GL/glext.h>
 #endif
 
 #if _WIN32 || _WIN64
@@ -64,6 +64,38 @@ namespace cmds
         glDrawArraysInstanced(cmd.primitive, cmd.base, cmd.count, cmd.instanceCount);
     }
 
+    // Streams the records to the indirect buffer, if any, and returns the indirect pointer for the draw.
+    const void* bindIndirectData(GLuint indirectBuffer, const void* data, size_t size)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        if (indirectBuffer == 0)
+            return data;
+
+        // orphan the previous records
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, (GLsizeiptr)size, data, GL_STREAM_DRAW);
+        return NULL;
+    }
+
+    void multiDrawElementsIndirect(const void* commandData, cb::RenderContext*)
+    {
+        const auto& cmd = *reinterpret_cast<const cmds::MultiDrawElementsIndirect*>(commandData);
+
+        const void* indirect =
+            bindIndirectData(cmd.indirectBuffer, cmd.data, cmd.drawCount * sizeof(DrawElementsIndirectCommand));
+        glBindVertexArray(cmd.vao);
+        glMultiDrawElementsIndirect(cmd.primitive, kIndexTypes[cmd.useShortIndices], indirect, cmd.drawCount, 0);
+    }
+
+    void multiDrawArraysIndirect(const void* commandData, cb::RenderContext*)
+    {
+        const auto& cmd = *reinterpret_cast<const cmds::MultiDrawArraysIndirect*>(commandData);
+
+        const void* indirect =
+            bindIndirectData(cmd.indirectBuffer, cmd.data, cmd.drawCount * sizeof(DrawArraysIndirectCommand));
+        glBindVertexArray(cmd.vao);
+        glMultiDrawArraysIndirect(cmd.primitive, indirect, cmd.drawCount, 0);
+    }
+
     void clearColor(const void* commandData, cb::RenderContext*)
     {
         const auto& cmd = *reinterpret_cast<const cmds::ClearColor*>(commandData);
@@ -190,6 +222,8 @@ namespace cmds
     const cb::RenderContext::function_t DrawArrays::kDispatchFunction = &drawArrays;
     const cb::RenderContext::function_t DrawIndexed::kDispatchFunction = &drawIndexed;
     const cb::RenderContext::function_t DrawInstanced::kDispatchFunction = &drawInstanced;
+    const cb::RenderContext::function_t MultiDrawElementsIndirect::kDispatchFunction = &multiDrawElementsIndirect;
+    const cb::RenderContext::function_t MultiDrawArraysIndirect::kDispatchFunction = &multiDrawArraysIndirect;
     const cb::RenderContext::function_t ClearColor::kDispatchFunction = &clearColor;
     const cb::RenderContext::function_t DepthSetup::kDispatchFunction = &depthSetup;
     const cb::RenderContext::function_t BlendSetup::kDispatchFunction = &blendSetup;
@@ -9,9 +9,9 @@
 #include <cstdint>
 
 #ifdef USE_GLEW
-#include <gl/glew.h>
+#include <GL/glew.h>
 #else
-#include <gl/GL.h>
+#include <GL/gl.h>
 #endif
 
 namespace cmds
@@ -24,6 +24,8 @@ namespace cmds
         uint32_t base;
         uint32_t count;
         GLenum primitive;
+
+        CB_COMMAND_PACKET_ALIGN()
     };
 
     struct DrawIndexed
@@ -35,6 +37,8 @@ namespace cmds
         uint32_t count;
         GLenum primitive : 24;
         uint32_t useShortIndices : 8; // bool
+
+        CB_COMMAND_PACKET_ALIGN()
     };
 
     struct DrawInstanced
@@ -46,6 +50,53 @@ namespace cmds
         uint32_t count;
         GLenum primitive : 8;
         uint32_t instanceCount : 24;
+
+        CB_COMMAND_PACKET_ALIGN()
+    };
+
+    /// Indirect draw records, laid out as expected by glMultiDrawElementsIndirect/glMultiDrawArraysIndirect.
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    struct DrawArraysIndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint first;
+        GLuint baseInstance;
+    };
+
+    ///@note Usually created by the cmds::MultiDrawCompiler from runs of DrawIndexed commands.
+    struct MultiDrawElementsIndirect
+    {
+        static const cb::RenderContext::function_t kDispatchFunction;
+
+        GLuint vao;
+        GLenum primitive : 24;
+        uint32_t useShortIndices : 8; // bool
+        uint32_t drawCount;
+        /// Buffer the records are streamed to, if 0 they're read from client memory(compatibility profile only).
+        GLuint indirectBuffer;
+        const DrawElementsIndirectCommand* data;
+    };
+
+    ///@note Usually created by the cmds::MultiDrawCompiler from runs of DrawArrays/DrawInstanced commands.
+    struct MultiDrawArraysIndirect
+    {
+        static const cb::RenderContext::function_t kDispatchFunction;
+
+        GLuint vao;
+        GLenum primitive;
+        uint32_t drawCount;
+        /// Buffer the records are streamed to, if 0 they're read from client memory(compatibility profile only).
+        GLuint indirectBuffer;
+        const DrawArraysIndirectCommand* data;
     };
 
     struct ClearColor
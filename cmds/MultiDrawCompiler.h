@@ -0,0 +1,258 @@
+#pragma once
+
+#include "GLCommands.h"
+
+#include <cassert>
+#include <chrono>
+
+namespace cmds
+{
+    /// Compilation stage that replaces runs of compatible draws in the sorted commands by a single
+    /// multi draw indirect command, @see cb::CommandBuffer::compile.
+    ///@note A run is made of adjacent DrawIndexed commands or adjacent DrawArrays/DrawInstanced commands
+    /// with the same material, viewport, vao, primitive and index type, that aren't chained to other commands.
+    /// The indirect records are packed into the auxiliary memory of the new command, in the buffer's arena.
+    ///@note For multi pass materials the run's draws are dispatched per pass instead of per draw.
+    template <class CommandBufferClass>
+    class MultiDrawCompiler
+    {
+    public:
+        typedef typename CommandBufferClass::command_t command_t;
+
+        struct Stats
+        {
+            /// Draw commands in the compiled range.
+            uint32_t drawCount;
+            /// Draw commands merged into multi draw commands.
+            uint32_t mergedCount;
+            /// Multi draw commands emitted.
+            uint32_t multiDrawCount;
+            /// Duration of the last compilation, in milliseconds.
+            float compileTime;
+
+            /// Draw calls removed by the compilation.
+            uint32_t savedCalls() const { return mergedCount - multiDrawCount; }
+        };
+
+        ///@param indirectBuffer The indirect buffer to stream the records to, @see MultiDrawElementsIndirect.
+        ///@param minRunLength Runs that are shorter are left untouched.
+        explicit MultiDrawCompiler(CommandBufferClass& buffer, GLuint indirectBuffer = 0, uint32_t minRunLength = 2);
+
+        /// Compiles the sorted range, returns its new end.
+        ///@note Pass with std::ref to cb::CommandBuffer::compile to keep the stats.
+        command_t* operator()(command_t* begin, command_t* end);
+
+        const Stats& stats() const;
+
+    private:
+        enum class DrawType
+        {
+            eNone,
+            eElements,
+            eArrays
+        };
+
+        struct DrawInfo
+        {
+            DrawType type;
+            GLuint vao;
+            GLenum primitive;
+            uint32_t useShortIndices;
+
+            bool operator==(const DrawInfo& other) const
+            {
+                return type == other.type && vao == other.vao && primitive == other.primitive &&
+                    useShortIndices == other.useShortIndices;
+            }
+        };
+
+        static DrawInfo drawInfo(const cb::CommandPacket* packet);
+        static bool isSameBatch(const command_t& first, const command_t& other);
+
+        cb::CommandPacket* createElementsCommand(const DrawInfo& info, const command_t* begin, uint32_t count);
+        cb::CommandPacket* createArraysCommand(const DrawInfo& info, const command_t* begin, uint32_t count);
+
+    private:
+        CommandBufferClass& m_buffer;
+        GLuint m_indirectBuffer;
+        uint32_t m_minRunLength;
+        Stats m_stats;
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    template <class CommandBufferClass>
+    MultiDrawCompiler<CommandBufferClass>::MultiDrawCompiler(CommandBufferClass& buffer, GLuint indirectBuffer,
+        uint32_t minRunLength)
+        : m_buffer(buffer)
+        , m_indirectBuffer(indirectBuffer)
+        , m_minRunLength(minRunLength < 2 ? 2 : minRunLength)
+        , m_stats()
+    {
+    }
+
+    template <class CommandBufferClass>
+    typename MultiDrawCompiler<CommandBufferClass>::command_t* MultiDrawCompiler<CommandBufferClass>::operator()(
+        command_t* begin, command_t* end)
+    {
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        m_stats = Stats();
+
+        command_t* out = begin;
+        for (command_t* it = begin; it != end;)
+        {
+            const DrawInfo info = drawInfo(it->cmd);
+            if (info.type == DrawType::eNone)
+            {
+                *out++ = *it++;
+                continue;
+            }
+
+            command_t* runEnd = it + 1;
+            while (runEnd != end && isSameBatch(*it, *runEnd) && drawInfo(runEnd->cmd) == info)
+                ++runEnd;
+
+            const uint32_t runLength = (uint32_t)(runEnd - it);
+            m_stats.drawCount += runLength;
+            if (runLength < m_minRunLength)
+            {
+                while (it != runEnd)
+                    *out++ = *it++;
+                continue;
+            }
+
+            // the run is replaced by the first entry, its key is kept for the material and view
+            command_t compiled = *it;
+            compiled.cmd = info.type == DrawType::eElements ? createElementsCommand(info, it, runLength)
+                : createArraysCommand(info, it, runLength);
+            *out++ = compiled;
+
+            m_stats.mergedCount += runLength;
+            ++m_stats.multiDrawCount;
+            it = runEnd;
+        }
+
+        const auto endTime = std::chrono::high_resolution_clock::now();
+        m_stats.compileTime = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+        return out;
+    }
+
+    template <class CommandBufferClass>
+    const typename MultiDrawCompiler<CommandBufferClass>::Stats& MultiDrawCompiler<CommandBufferClass>::stats() const
+    {
+        return m_stats;
+    }
+
+    template <class CommandBufferClass>
+    typename MultiDrawCompiler<CommandBufferClass>::DrawInfo MultiDrawCompiler<CommandBufferClass>::drawInfo(
+        const cb::CommandPacket* packet)
+    {
+        DrawInfo info = { DrawType::eNone, 0, 0, 0 };
+        // chained commands must stay in order with their draw
+        if (packet->nextCommand != NULL)
+            return info;
+
+        if (packet->dispatchFunction == DrawIndexed::kDispatchFunction)
+        {
+            const auto& cmd = *reinterpret_cast<const DrawIndexed*>(packet->commandData);
+            info.type = DrawType::eElements;
+            info.vao = cmd.vao;
+            info.primitive = cmd.primitive;
+            info.useShortIndices = cmd.useShortIndices;
+        }
+        else if (packet->dispatchFunction == DrawArrays::kDispatchFunction)
+        {
+            const auto& cmd = *reinterpret_cast<const DrawArrays*>(packet->commandData);
+            info.type = DrawType::eArrays;
+            info.vao = cmd.vao;
+            info.primitive = cmd.primitive;
+        }
+        else if (packet->dispatchFunction == DrawInstanced::kDispatchFunction)
+        {
+            const auto& cmd = *reinterpret_cast<const DrawInstanced*>(packet->commandData);
+            info.type = DrawType::eArrays;
+            info.vao = cmd.vao;
+            info.primitive = cmd.primitive;
+        }
+        return info;
+    }
+
+    template <class CommandBufferClass>
+    bool MultiDrawCompiler<CommandBufferClass>::isSameBatch(const command_t& first, const command_t& other)
+    {
+        typedef typename CommandBufferClass::decoder_t decoder_t;
+
+        const cb::MaterialId material = decoder_t()(first.key);
+        const cb::MaterialId otherMaterial = decoder_t()(other.key);
+        return material.id == otherMaterial.id && material.pass == otherMaterial.pass &&
+            cb::detail::viewportId(first.key) == cb::detail::viewportId(other.key);
+    }
+
+    template <class CommandBufferClass>
+    cb::CommandPacket* MultiDrawCompiler<CommandBufferClass>::createElementsCommand(const DrawInfo& info,
+        const command_t* begin, uint32_t count)
+    {
+        cb::CommandPacket* packet =
+            m_buffer.template createCommandPacket<MultiDrawElementsIndirect>(count * sizeof(DrawElementsIndirectCommand));
+        auto* records = reinterpret_cast<DrawElementsIndirectCommand*>(packet->auxilaryData);
+        const uint32_t indexSize = info.useShortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const auto& draw = *reinterpret_cast<const DrawIndexed*>(begin[i].cmd->commandData);
+            DrawElementsIndirectCommand& record = records[i];
+            record.count = draw.count;
+            record.instanceCount = 1;
+            record.firstIndex = draw.base / indexSize;
+            record.baseVertex = 0;
+            record.baseInstance = 0;
+        }
+
+        auto& cmd = *cb::CommandPacket::getCommandData<MultiDrawElementsIndirect>(packet);
+        cmd.vao = info.vao;
+        cmd.primitive = info.primitive;
+        cmd.useShortIndices = info.useShortIndices;
+        cmd.drawCount = count;
+        cmd.indirectBuffer = m_indirectBuffer;
+        cmd.data = records;
+        return packet;
+    }
+
+    template <class CommandBufferClass>
+    cb::CommandPacket* MultiDrawCompiler<CommandBufferClass>::createArraysCommand(const DrawInfo& info,
+        const command_t* begin, uint32_t count)
+    {
+        cb::CommandPacket* packet =
+            m_buffer.template createCommandPacket<MultiDrawArraysIndirect>(count * sizeof(DrawArraysIndirectCommand));
+        auto* records = reinterpret_cast<DrawArraysIndirectCommand*>(packet->auxilaryData);
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const cb::CommandPacket* drawPacket = begin[i].cmd;
+            DrawArraysIndirectCommand& record = records[i];
+            if (drawPacket->dispatchFunction == DrawInstanced::kDispatchFunction)
+            {
+                const auto& draw = *reinterpret_cast<const DrawInstanced*>(drawPacket->commandData);
+                record.count = draw.count;
+                record.instanceCount = draw.instanceCount;
+                record.first = draw.base;
+            }
+            else
+            {
+                const auto& draw = *reinterpret_cast<const DrawArrays*>(drawPacket->commandData);
+                record.count = draw.count;
+                record.instanceCount = 1;
+                record.first = draw.base;
+            }
+            record.baseInstance = 0;
+        }
+
+        auto& cmd = *cb::CommandPacket::getCommandData<MultiDrawArraysIndirect>(packet);
+        cmd.vao = info.vao;
+        cmd.primitive = info.primitive;
+        cmd.drawCount = count;
+        cmd.indirectBuffer = m_indirectBuffer;
+        cmd.data = records;
+        return packet;
+    }
+}  // namespace cmds
@@ -8,6 +8,7 @@ NvModel_cppfiles   += ./../../src/NvModel/NvModelExtBuilder.cpp
 NvModel_cppfiles   += ./../../src/NvModel/NvModelExtObj.cpp
 NvModel_cppfiles   += ./../../src/NvModel/NvModelMeshFace.cpp
 NvModel_cppfiles   += ./../../src/NvModel/NvModelObj.cpp
+NvModel_cppfiles   += ./../../src/NvModel/NvModelSimplifier.cpp
 NvModel_cppfiles   += ./../../src/NvModel/NvModelSubMeshObj.cpp
 NvModel_cppfiles   += ./../../src/NvModel/NvSkeleton.cpp
 
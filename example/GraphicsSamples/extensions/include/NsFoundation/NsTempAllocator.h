@@ -59,6 +59,14 @@ class TempAllocator
 void initializeTempAllocatorGlobals();
 void terminateTempAllocatorGlobals();
 
+// Number of size classes served from the per-thread caches (256B to 128kB chunks)
+static const uint32_t TempAllocatorSizeClassCount = 9;
+
+// Fills hits and misses (TempAllocatorSizeClassCount entries each) with the number of
+// allocations per size class that were served from a thread's cache, and of those that
+// had to go to the shared free lists or the base allocator, summed over all threads.
+NV_FOUNDATION_API void getTempAllocatorStats(uint32_t* hits, uint32_t* misses);
+
 } // namespace shdfnd
 } // namespace nvidia
 
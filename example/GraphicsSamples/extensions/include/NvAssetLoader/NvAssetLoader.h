@@ -123,6 +123,25 @@ char *NvAssetLoaderRead(const char *filePath, int32_t &length);
 /// \return true on success and false on failure
 bool NvAssetLoaderFree(char* asset);
 
+/// Maps an asset file into memory.
+/// Maps an asset file into the address space of the process rather
+/// than reading it, so that the pages are only brought in as they are
+/// touched.  The mapping is private and copy-on-write: the contents
+/// may be modified in place without affecting the file
+/// \param[in] filePath the partial path (below "assets") to the file
+/// \param[out] length the length of the file in bytes
+/// \return a pointer to the start of the mapping or NULL on error or if
+/// the platform cannot map assets (e.g. Android, where they live in the
+/// APK), in which case #NvAssetLoaderRead should be used instead. The
+/// mapping must be released with #NvAssetLoaderUnmap
+char *NvAssetLoaderMap(const char *filePath, int64_t &length);
+
+/// Releases a mapping created by #NvAssetLoaderMap
+/// \param[in] asset a pointer returned by #NvAssetLoaderMap
+/// \param[in] length the length returned by #NvAssetLoaderMap
+/// \return true on success and false on failure
+bool NvAssetLoaderUnmap(char* asset, int64_t length);
+
 /// Returns a boolean indicating whether the desired file exists
 /// \param[in] filePath the partial path to the file to be tested
 /// \return true if file exists and is readable, false otherwise
@@ -37,6 +37,8 @@
 
 #include "NV/NvPlatformGL.h"
 #include <NvSimpleTypes.h>
+#include <string>
+#include <vector>
 
 /// \file
 /// GLSL shader program wrapper
@@ -57,6 +59,21 @@ public:
         GLint type; ///< The GL_*_SHADER enum representing the shader type
     };
 
+    /// Handle of a uniform resolved when the program is linked.
+    /// A POD that can be stored in render commands, setting a uniform by handle
+    /// needs no name lookup and skips the upload if the value is unchanged.
+    struct Uniform {
+        int32_t slot; ///< Index in the program's uniform table, -1 if the uniform is not active
+    };
+
+    /// Counters of the uniform name lookups and uploads, i.e. to report them per frame.
+    struct UniformStats {
+        uint32_t lookups; ///< Names looked up, in the program's uniform table or by the GL
+        uint32_t glLookups; ///< Names resolved by the GL, i.e. array elements
+        uint32_t uploads; ///< Values uploaded through a handle
+        uint32_t skipped; ///< Redundant values not uploaded through a handle
+    };
+
     /// Default constructor.
     /// Creates an empty object with no shader program, because we cannot set the source
     /// in the constructor.  Doing so would require the possibility of failure, and we cannot
@@ -343,6 +360,37 @@ public:
     /// \return the non-negative index of the uniform if found.  -1 if not found
     GLint getUniformLocation(const char* uniform, bool isOptional = false);
 
+    /// Returns the handle of the named uniform, resolved from the table built at link time
+    /// \param[in] uniform the null-terminated string name of the uniform
+    /// \param[in] isOptional if true, the function logs an error if the uniform is not found
+    /// \return the handle of the uniform, its slot is -1 if not found
+    Uniform getUniform(const char* uniform, bool isOptional = false);
+
+    //@{
+    /// Set program uniforms by handle, the value is only uploaded if it differs from the last one
+    /// set by handle.  Assumes that the given shader is bound via #enable
+    /// \param[in] uniform the handle of the uniform, ignored if its slot is -1
+    void setUniform1i(Uniform uniform, int32_t value);
+    void setUniform1f(Uniform uniform, float value);
+    void setUniform3fv(Uniform uniform, const float *value);
+    void setUniform4fv(Uniform uniform, const float *value);
+    void setUniformMatrix4fv(Uniform uniform, const GLfloat *m);
+    //@}
+
+    //@{
+    /// Binds a texture to a shader uniform by handle, the texture is always bound but the
+    /// unit is only set if it changed.  Assumes that the given shader is bound via #enable
+    void bindTexture2D(Uniform uniform, int32_t unit, GLuint tex);
+    void bindTextureRect(Uniform uniform, int32_t unit, GLuint tex);
+    //@}
+
+    /// Forgets the values cached for the handles, required if the uniforms were set by index
+    void invalidateUniforms();
+
+    /// Returns the uniform counters of all the programs since the last reset
+    static const UniformStats& getUniformStats() { return ms_uniformStats; }
+    static void resetUniformStats();
+
     /// Returns the GL program object for the shader
     /// \return the GL shader object ID
     GLuint getProgram() { return m_program; }
@@ -362,11 +410,27 @@ protected:
         const char** fragSrcArray, int32_t fragSrcCount);
     GLuint compileProgram(ShaderSourceItem* src, int32_t count);
 
+    /// Builds the uniform table of the linked program
+    void cacheUniforms();
+    int32_t findUniform(const char* uniform) const;
+    /// Returns true if the value differs from the cached one and updates it
+    bool updateUniform(Uniform uniform, GLenum type, const void* value, uint32_t size);
+
+    struct UniformEntry {
+        std::string name;
+        GLint location;
+        GLenum type;
+        bool cached;
+        uint32_t value[16]; // large enough for a 4x4 matrix
+    };
+
     bool m_strict;
     GLuint m_program;
+    std::vector<UniformEntry> m_uniforms;
 
     static bool ms_logAllMissing;
     static const char* ms_shaderHeader;
+    static UniformStats ms_uniformStats;
 };
 
 /// Convenience class to automatically push and pop a shader prefix
@@ -62,6 +62,12 @@ namespace Nv
 	class NvMeshExtGL
     {
     public:
+        /// Counters of the submitted draws, i.e. to report them per frame.
+        struct DrawStats {
+            uint32_t drawCalls; ///< Draw calls of the meshes
+            uint64_t indices; ///< Indices submitted by the draws, over all of their instances
+        };
+
 		NvMeshExtGL();
 		NvMeshExtGL(const NvMeshExtGL& other);
 		~NvMeshExtGL();
@@ -77,7 +83,8 @@ namespace Nv
 
         const SubMesh* GetSubMesh() const { return m_pSrcMesh; }
 
-		void DrawElements(uint32_t instanceCount, GLint positionHandle, GLint normalHandle = -1, GLint texcoordHandle = -1, GLint tangentHandle = -1);
+		// Draws the given level of detail of the mesh, the levels past the last one draw the last one
+		void DrawElements(uint32_t instanceCount, GLint positionHandle, GLint normalHandle = -1, GLint texcoordHandle = -1, GLint tangentHandle = -1, uint32_t lod = 0);
 
 		/// Returns the model-relative transform of the mesh
 		const nv::matrix4f& GetMeshOffset() const { return m_offsetMatrix; }
@@ -90,6 +97,10 @@ namespace Nv
 		///         the given skeleton, false if they could not.
         bool UpdateBoneTransforms(Nv::NvSkeleton* pSrcSkel);
 
+        /// Returns the draw counters of all the meshes since the last reset
+        static const DrawStats& GetDrawStats() { return ms_drawStats; }
+        static void ResetDrawStats();
+
         // Draw the mesh, using the given handles for vertex elements
 
         // Returns a bool indicating whether or not the mesh's vertices contain normals
@@ -106,6 +117,15 @@ namespace Nv
         /// Get the index count
         /// \return the index count
         uint32_t GetIndexCount() const { return m_indexCount; }    
+
+        /// Get the number of levels of detail, including the full detail one
+        /// \return the level count
+        uint32_t GetLodCount() const { return 1 + (uint32_t)m_lodIndexCounts.size(); }
+
+        /// Get the index count of a level of detail
+        /// \param lod the level, 0 being the full detail one
+        /// \return the index count
+        uint32_t GetLodIndexCount(uint32_t lod) const { return lod == 0 ? m_indexCount : m_lodIndexCounts[lod - 1]; }
         
         /// Get the vertex count
         /// \return the vertex count
@@ -176,6 +196,8 @@ namespace Nv
 
 		void Clear();
 
+        static DrawStats ms_drawStats;
+
 		SubMesh* m_pSrcMesh;
 
         // Index of the material used by this mesh
@@ -186,6 +208,10 @@ namespace Nv
         GLuint m_iboID;
         GLsizei m_indexCount;
 
+        // Index counts and byte offsets in the index buffer of the lower levels of detail
+        std::vector<GLsizei> m_lodIndexCounts;
+        std::vector<intptr_t> m_lodIndexOffsets;
+
         uint32_t m_vertexCount;
         int32_t m_vertexSize;       // in floats
 
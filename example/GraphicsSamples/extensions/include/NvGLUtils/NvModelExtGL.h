@@ -65,7 +65,12 @@ namespace Nv
 		/// \param[in] normalHandle the vertex attribute array index that represents normals in the current shader
         /// \param[in] texcoordHandle the vertex attribute array index that represents UVs in the current shader
         /// \param[in] tangentHandle the vertex attribute array index that represents tangents in the current shader
-		void DrawElements(uint32_t instanceCount, GLint positionHandle, GLint normalHandle = -1, GLint texcoordHandle = -1, GLint tangentHandle = -1);
+        /// \param[in] lod the level of detail to draw, meshes with fewer levels draw their last one
+		void DrawElements(uint32_t instanceCount, GLint positionHandle, GLint normalHandle = -1, GLint texcoordHandle = -1, GLint tangentHandle = -1, uint32_t lod = 0);
+
+        /// Returns the number of levels of detail of the mesh with the most
+        /// \return Number of levels of detail, 1 when there are no lower levels
+        uint32_t GetLodCount();
 
 		/// Get the low-level geometry data.
 		/// Returns the underlying geometry model data instance
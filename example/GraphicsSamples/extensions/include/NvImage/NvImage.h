@@ -273,7 +273,8 @@ public:
     static bool GetVerticalFlip() { return vertFlip; }
 
     /// Create a new NvImage (no texture) directly from DDS file
-    /// Uses #NvAssetLoaderRead for opening the file.  See the documentation for
+    /// Uses #NvAssetLoaderMap for opening the file, falling back to
+    /// #NvAssetLoaderRead where mapping isn't supported.  See the documentation for
     /// that package to understand the correct paths
     /// \param[in] filename the image filename (and path) to load
     /// \return a pointer to the NvImage representing the file or null on failure
@@ -63,11 +63,37 @@ namespace Nv
         /// Releases the memory used by the file loader
         /// \param[in] pData Pointer to the data to release
         virtual void ReleaseData(char* pData) = 0;
+
+        /// Method to be called to map a resource file directly into memory, so that
+        /// loaders can reference its contents in place instead of copying them out
+        /// \param[in] fileName Name of the file to map
+        /// \param[out] length Size, in bytes, of the mapped file
+        /// \return A pointer to the start of the mapping or null if the loader does
+        ///         not support mapping, in which case LoadDataFromFile() is used.
+        ///         Pages must be writable copy-on-write, as loaded meshes expose
+        ///         their vertex and index arrays as mutable.
+        virtual char* MapDataFromFile(const char* /*fileName*/, size_t& /*length*/) { return NULL; }
+
+        /// Releases a mapping returned by MapDataFromFile()
+        /// \param[in] pData Pointer to the start of the mapping
+        /// \param[in] length Size, in bytes, of the mapping
+        virtual void UnmapData(char* /*pData*/, size_t /*length*/) {}
     };
 
 	class NvModelExt
 	{
 	public:
+		/// Methods used to find the vertex components to merge while loading OBJ data.
+		/// Both merge the positions and texture coordinates closer than the vertex threshold the same way.
+		/// The normals differ: the sorted axis only considers the normals whose x is within the normal
+		/// threshold, while the hash grid merges all the unit normals whose 1 - dot is below it, in any
+		/// direction.  The hash grid thus yields fewer normals, and vertices, on curved meshes.
+		enum WeldMethod
+		{
+			WeldMethod_SortedAxis = 0x0, /// Candidates sorted along the x axis in a map
+			WeldMethod_HashGrid = 0x1, /// Candidates in the neighboring cells of a spatial hash, faster on large or axis aligned meshes
+		};
+
 		/// Create a model from OBJ data
 		/// \param[in] filename path/name of the OBJ file data
 		/// \param[in] scale the target radius to which we want the model scaled, or <0 if no scaling should be done
@@ -76,15 +102,20 @@ namespace Nv
 		/// \param[in] vertMergeThreshold the distance between vertices that should be considered "the same" and allow for merging
 		/// \param[in] normMergeThreshold the distance between normals that should be considered "the same" and allow for merging
 		/// \param[in] initialVertCount the scaling of the internal structures for expected vertex count
+		/// \param[in] weldMethod the method used to find the vertices and normals to merge
 		/// \return a pointer to the new model
 		static NvModelExt* CreateFromObj(const char* filename, float scale,
 			bool generateNormals, bool generateTangents,
-			float vertMergeThreshold = 0.01f, float normMergeThreshold = 0.001f, uint32_t initialVertCount = 3000);
+			float vertMergeThreshold = 0.01f, float normMergeThreshold = 0.001f, uint32_t initialVertCount = 3000,
+			WeldMethod weldMethod = WeldMethod_SortedAxis);
 
 		/// Create a model from a preprocessed "NVE" file, which is much faster and more efficient to load than OBJ
 		/// \param[in] filename path/name of the NVE file data
+		/// \param[in] mapData if true and the file loader supports it, the file is mapped and the
+		///            sub-mesh vertex and index arrays reference the mapping instead of being copied.
+		///            The mapping is then owned by the model and released along with it.
 		/// \return a pointer to the new model
-		static NvModelExt* CreateFromPreprocessed(const char* filename);
+		static NvModelExt* CreateFromPreprocessed(const char* filename, bool mapData = false);
 
 		virtual ~NvModelExt();
 
@@ -142,6 +173,17 @@ namespace Nv
         ///         does not have one.
         virtual NvSkeleton* GetSkeleton() { return m_pSkeleton; }
 
+        /// Generates the lower levels of detail of the meshes, by simplifying the
+        /// triangles of each level down to a fraction of the previous one.  The levels
+        /// share the vertices of the mesh and are stored in its SubMesh::m_lodIndices.
+        /// \param lodCount Number of levels to generate, including the full detail one
+        /// \param reduction Fraction of the triangles of the previous level to keep
+        /// \param maxError Largest distance the surface may move, relative to the largest
+        ///                 extent of the mesh.  Simplification stops early when reached.
+        /// \return The number of levels of the mesh with the most, a level is dropped
+        ///         when it could not remove any triangle
+        uint32_t GenerateLods(uint32_t lodCount, float reduction, float maxError);
+
         /// Serializes the model out to a file in a binary format that 
         /// can quickly be loaded back in
         /// \param filename Name of the file in which to write the model's data
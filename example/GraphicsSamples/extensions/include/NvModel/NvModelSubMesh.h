@@ -125,6 +125,10 @@ namespace Nv
 		/// \return the number of indices in the given array
 		virtual int32_t getIndexCount() const { return m_indexCount; }
 
+		/// The number of levels of detail, including the full detail triangles
+		/// \return 1 plus the number of simplified triangle lists
+		uint32_t getLodCount() const { return 1 + (uint32_t)m_lodIndexCounts.size(); }
+
 
         // Material Id used by the sub mesh
         uint32_t m_materialId;
@@ -156,6 +160,11 @@ namespace Nv
         int32_t m_boneIndexOffset;   // in floats (zero == no component)
         int32_t m_boneWeightOffset; //  in floats (zero == no component)
 		int32_t m_vertSize; // in floats
+
+        // Simplified triangle lists of the lower levels of detail, one after the other,
+        // indexing the same vertices as m_indices.  Filled by NvModelExt::GenerateLods
+        std::vector<uint32_t> m_lodIndices;
+        std::vector<uint32_t> m_lodIndexCounts;
 	};
 }
 #endif
\ No newline at end of file
@@ -122,6 +122,25 @@ namespace Nv
         ///         was invalid.
         nv::matrix4f* GetTransform(uint32_t index);
 
+        /// Evaluates the model-space transforms of many instances of the
+        /// skeleton at once.  Transforms are stored by node, so that the
+        /// matrices of one node for all of the instances are contiguous,
+        /// and the nodes keep the skeleton order, where parents come first.
+        /// \param pLocalTransforms Pointer to the parent-relative transforms,
+        ///                         where node n of instance i is at index
+        ///                         n * instanceCount + i
+        /// \param instanceCount Number of skeleton instances to evaluate
+        /// \param pTransforms Pointer to an array receiving the model-space
+        ///                    transforms, in the same layout as pLocalTransforms
+        /// \param pSkinningTransforms Optional pointer to an array, i.e. a mapped
+        ///                            skinning buffer, that also receives the
+        ///                            model-space transforms stored by instance,
+        ///                            where node n of instance i is at index
+        ///                            i * GetNumNodes() + n.  It is only written
+        ///                            to, sequentially.
+        void EvaluatePoses(const nv::matrix4f* pLocalTransforms, uint32_t instanceCount,
+            nv::matrix4f* pTransforms, nv::matrix4f* pSkinningTransforms = NULL) const;
+
     protected:
         // Convenience typedefs
         typedef std::vector<NvSkeletonNode> NodeArray;
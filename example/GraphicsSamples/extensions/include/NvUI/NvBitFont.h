@@ -363,9 +363,13 @@ public:
     /* @} */
 
 private:
+    friend class NvBFTextBatch;
+
     void AdjustGlyphsForAlignment();
     void TrackOutputLines(float lineWidth);
     void UpdateTextPosition();
+    void GenerateGlyphs();
+    int32_t PrepareGlyphs();
 
 protected:
     int32_t m_stringChars;
@@ -385,6 +389,8 @@ protected:
     NvPackedColor m_charColor; // base color.  set in vertices, can override with escape codes.
 
     bool m_cached; // all vbo burn-in bits ready.
+    bool m_uploaded; // vertices uploaded to the vbo.
+    uint32_t m_generation; // incremented each time the vertices are regenerated.
     bool m_visible;
     uint8_t m_fontNum;
     float m_fontSize;
@@ -420,4 +426,65 @@ protected:
     NvBFTextRender* m_render;
 };
 
+/** Draws many bftexts with one draw call per font.
+
+    Queue the bftexts to draw each frame with @ref Add, then draw them with @ref Render.
+    The queued bftexts that changed since they were last drawn regenerate their glyphs,
+    then the glyph quads of all of them are copied at their text position into one shared
+    vertex arena, which is uploaded once.  The bftexts using the same font and outline are
+    drawn with a single call.
+    @note The bftexts keep their own vertices, so they can still be drawn on their own.
+    A matrix set with @ref NvBFText::SetMatrix applies to the whole batch.
+ */
+class NvBFTextBatch
+{
+public:
+    NvBFTextBatch();
+    virtual ~NvBFTextBatch();
+
+    /** Queue a bftext to be drawn by the next @ref Render call. */
+    void Add(NvBFText *text);
+
+    /** Generate the glyph quads of the queued bftexts into the vertex arena.
+
+        Makes no rendering calls, @ref Render calls it when needed.
+        @return the number of glyph quads in the vertex arena.
+     */
+    int32_t Build();
+
+    /** Draw the queued bftexts, then clear the queue. */
+    void Render();
+
+    /** Get the number of glyph quads built. */
+    int32_t GetGlyphCount() const { return m_glyphCount; }
+    /** Get the built vertices, four per glyph quad. */
+    const BFVert *GetVertices() const { return m_verts; }
+    /** Get the number of draw calls needed to render the built glyph quads. */
+    int32_t GetDrawCount() const { return m_runCount; }
+
+protected:
+    struct Run;
+    struct Slot;
+
+    NvBFText **m_texts;
+    int32_t m_textCount;
+    int32_t m_textMax;
+
+    Slot *m_slots; // what was copied into the arena for each sorted bftext, to skip the unchanged ones.
+    int32_t m_slotCount;
+    int32_t m_slotMax;
+
+    BFVert *m_verts;
+    int32_t m_glyphCount;
+    int32_t m_glyphMax; // size of buffer allocated, in glyph quads.
+
+    Run *m_runs;
+    int32_t m_runCount;
+    int32_t m_runMax;
+
+    bool m_built;
+    bool m_uploaded; // the arena didn't change since it was last uploaded.
+    NvBFTextRender* m_render;
+};
+
 #endif //_nvbitfont_h_
@@ -48,6 +48,7 @@
 
 // fwd decl of BFText class so we don't need to include header at all.
 class NvBFText;
+class NvBFTextBatch;
 
 /** @file NvUI.h
     @brief A cross-platform, GL/GLES-based, simple user interface widget framework.
@@ -1001,6 +1002,7 @@ private:
 
 protected:
     NvBFText *m_bftext; /**< The NvBitFont BFText object that does actual text rendering. */
+    NvBFTextBatch *m_batch; /**< If set, the batch our text is queued into instead of drawn right away. */
     float m_size; /**< Local cache of the original font size. */
     NvPackedColor m_color; /**< Modulation of the text with an RGB color */
     bool m_wrap; /**< Whether we wrap or truncate if exceed drawable width. */
@@ -1059,6 +1061,10 @@ public:
     /** Make proper calls to the text rendering system to draw our text to the viewport. */
     virtual void Draw(const NvUIDrawState &drawState); // leaf, needs to implement!
 
+    /** Queue our text into a batch when drawn, so it renders with the other texts of the batch.
+        @param batch The batch the owner renders each frame after drawing the UI, or NULL to draw on our own. */
+    void SetBatch(NvBFTextBatch *batch) { m_batch = batch; }
+
     /** Set the string to be drawn. */
     void SetString(const char* in);
     /** Set the font size to use for our text. */
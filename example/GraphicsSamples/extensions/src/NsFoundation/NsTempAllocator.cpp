@@ -29,9 +29,9 @@
 
 #include "NsTempAllocator.h"
 
-#include "NsArray.h"
-#include "NsMutex.h"
 #include "NsAtomic.h"
+#include "NsSList.h"
+#include "NsThread.h"
 #include "NvMath.h"
 #include "NsIntrinsics.h"
 #include "NsBitUtils.h"
@@ -47,32 +47,163 @@ namespace shdfnd
 namespace
 {
 typedef TempAllocatorChunk Chunk;
-typedef Array<Chunk*, NonTrackingAllocator> AllocFreeTable;
+
+const uint32_t sMinIndex = 8;  // 256B min
+const uint32_t sMaxIndex = 17; // 128kB max
+const uint32_t sClassCount = sMaxIndex - sMinIndex;
+const uint32_t sBatchSize = 8; // chunks moved between a thread cache and the global lists at once
+
+static_assert(TempAllocatorSizeClassCount == sClassCount, "TempAllocatorSizeClassCount must match the size classes");
+
+// Free chunks are at least 2^sMinIndex bytes, so the first chunk of a batch
+// in the global lists also holds the list entry and the rest of the batch.
+struct ChunkBatch : public SListEntry
+{
+	Chunk* mRest; // remaining sBatchSize - 1 chunks, linked through mNext
+};
+
+// Free lists of a single thread, only ever touched by their owner apart
+// from the statistics, which are read racily.
+struct ThreadCache
+{
+	Chunk* mFree[sClassCount];
+	uint32_t mCount[sClassCount];
+	uint32_t mHits[sClassCount];
+	uint32_t mMisses[sClassCount];
+	volatile int32_t mIdle;  // 1 once its thread exited, until another thread claims it
+	ThreadCache* mNextCache; // all caches, so they can be released on termination
+};
+
+typedef SListT<NonTrackingAllocator> BatchList;
 
 class TempAllocatorGlobals
 {
 	NV_NOCOPY(TempAllocatorGlobals)
   public:
-	TempAllocatorGlobals()
+	TempAllocatorGlobals() : tlsIndex(TlsAlloc()), caches(0)
 	{
 	}
-	AllocFreeTable allocFreeTable;
-	Mutex allocMutex;
+	BatchList batches[sClassCount];
+	uint32_t tlsIndex;
+	ThreadCache* volatile caches;
 };
 
 TempAllocatorGlobals* gTempAllocatorGlobals = 0;
 
-NV_INLINE AllocFreeTable& getFreeTable()
+NV_INLINE BatchList& getBatchList(uint32_t classIndex)
+{
+	return gTempAllocatorGlobals->batches[classIndex];
+}
+
+void retireThreadCache();
+
+// Hands the cache of a thread back when the thread exits, see getThreadCache().
+struct ThreadExitHook
+{
+	bool mArmed;
+	~ThreadExitHook()
+	{
+		if(mArmed && gTempAllocatorGlobals)
+			retireThreadCache();
+	}
+};
+
+thread_local ThreadExitHook gThreadExitHook;
+
+ThreadCache& getThreadCache()
 {
-	return gTempAllocatorGlobals->allocFreeTable;
+	ThreadCache* cache = reinterpret_cast<ThreadCache*>(TlsGet(gTempAllocatorGlobals->tlsIndex));
+	if(!cache)
+	{
+		// reuse the cache of an exited thread, they stay registered (without chunks) until termination
+		for(cache = gTempAllocatorGlobals->caches; cache; cache = cache->mNextCache)
+		{
+			if(cache->mIdle && atomicCompareExchange(&cache->mIdle, 0, 1) == 1)
+				break;
+		}
+
+		if(!cache)
+		{
+			cache = reinterpret_cast<ThreadCache*>(NonTrackingAllocator().allocate(sizeof(ThreadCache), __FILE__, __LINE__));
+			memset(cache, 0, sizeof(ThreadCache));
+
+			ThreadCache* head;
+			do
+			{
+				head = gTempAllocatorGlobals->caches;
+				cache->mNextCache = head;
+			} while(atomicCompareExchangePointer((volatile void**)&gTempAllocatorGlobals->caches, cache, head) != head);
+		}
+
+		TlsSet(gTempAllocatorGlobals->tlsIndex, cache);
+		gThreadExitHook.mArmed = true;
+	}
+	return *cache;
 }
-NV_INLINE Mutex& getMutex()
+
+// move sBatchSize chunks from the thread's free list to the global list
+void spill(ThreadCache& cache, uint32_t classIndex)
 {
-	return gTempAllocatorGlobals->allocMutex;
+	Chunk* head = cache.mFree[classIndex];
+	Chunk* last = head;
+	for(uint32_t i = 1; i < sBatchSize; ++i)
+		last = last->mNext;
+
+	cache.mFree[classIndex] = last->mNext;
+	cache.mCount[classIndex] -= sBatchSize;
+	last->mNext = 0;
+
+	Chunk* rest = head->mNext;
+	ChunkBatch* batch = NV_PLACEMENT_NEW(head, ChunkBatch)();
+	batch->mRest = rest;
+	getBatchList(classIndex).push(*batch);
 }
 
-const uint32_t sMinIndex = 8;  // 256B min
-const uint32_t sMaxIndex = 17; // 128kB max
+// move a batch from the global list to the thread's (empty) free list
+bool refill(ThreadCache& cache, uint32_t classIndex)
+{
+	ChunkBatch* batch = static_cast<ChunkBatch*>(getBatchList(classIndex).pop());
+	if(!batch)
+		return false;
+
+	Chunk* head = reinterpret_cast<Chunk*>(batch);
+	head->mNext = batch->mRest;
+	cache.mFree[classIndex] = head;
+	cache.mCount[classIndex] = sBatchSize;
+	return true;
+}
+
+void releaseChunks(Chunk* ptr)
+{
+	NonTrackingAllocator alloc;
+	while(ptr)
+	{
+		Chunk* next = ptr->mNext;
+		alloc.deallocate(ptr);
+		ptr = next;
+	}
+}
+
+// Called on the exit of a thread which used the temp allocator: its full batches go to
+// the global lists, the rest to the base allocator, and its cache to the next new thread.
+void retireThreadCache()
+{
+	ThreadCache* cache = reinterpret_cast<ThreadCache*>(TlsGet(gTempAllocatorGlobals->tlsIndex));
+	if(!cache)
+		return;
+
+	for(uint32_t i = 0; i < sClassCount; ++i)
+	{
+		while(cache->mCount[i] >= sBatchSize)
+			spill(*cache, i);
+		releaseChunks(cache->mFree[i]);
+		cache->mFree[i] = 0;
+		cache->mCount[i] = 0;
+	}
+
+	TlsSet(gTempAllocatorGlobals->tlsIndex, 0);
+	atomicExchange(&cache->mIdle, 1);
+}
 }
 
 void initializeTempAllocatorGlobals()
@@ -84,25 +215,47 @@ void initializeTempAllocatorGlobals()
 
 void terminateTempAllocatorGlobals()
 {
-	AllocFreeTable& table = getFreeTable();
-
-	NonTrackingAllocator alloc;
-	for(uint32_t i = 0; i < table.size(); ++i)
+	for(uint32_t i = 0; i < sClassCount; ++i)
 	{
-		for(TempAllocatorChunk* ptr = table[i]; ptr;)
+		while(ChunkBatch* batch = static_cast<ChunkBatch*>(getBatchList(i).pop()))
 		{
-			TempAllocatorChunk* next = ptr->mNext;
-			alloc.deallocate(ptr);
-			ptr = next;
+			Chunk* rest = batch->mRest;
+			NonTrackingAllocator().deallocate(batch);
+			releaseChunks(rest);
 		}
 	}
-	table.reset();
+
+	for(ThreadCache* cache = gTempAllocatorGlobals->caches; cache;)
+	{
+		ThreadCache* next = cache->mNextCache;
+		for(uint32_t i = 0; i < sClassCount; ++i)
+			releaseChunks(cache->mFree[i]);
+		NonTrackingAllocator().deallocate(cache);
+		cache = next;
+	}
+
+	TlsFree(gTempAllocatorGlobals->tlsIndex);
 
 	gTempAllocatorGlobals->~TempAllocatorGlobals();
 	NV_FREE(gTempAllocatorGlobals);
 	gTempAllocatorGlobals = 0;
 }
 
+void getTempAllocatorStats(uint32_t* hits, uint32_t* misses)
+{
+	for(uint32_t i = 0; i < sClassCount; ++i)
+		hits[i] = misses[i] = 0;
+
+	for(ThreadCache* cache = gTempAllocatorGlobals->caches; cache; cache = cache->mNextCache)
+	{
+		for(uint32_t i = 0; i < sClassCount; ++i)
+		{
+			hits[i] += cache->mHits[i];
+			misses[i] += cache->mMisses[i];
+		}
+	}
+}
+
 void* TempAllocator::allocate(size_t size, const char* filename, int line)
 {
 	if(!size)
@@ -113,17 +266,29 @@ void* TempAllocator::allocate(size_t size, const char* filename, int line)
 	Chunk* chunk = 0;
 	if(index < sMaxIndex)
 	{
-		Mutex::ScopedLock lock(getMutex());
+		ThreadCache& cache = getThreadCache();
 
 		// find chunk up to 16x bigger than necessary
-		Chunk** it = getFreeTable().begin() + index - sMinIndex;
-		Chunk** end = NvMin(it + 3, getFreeTable().end());
-		while(it < end && !(*it))
+		uint32_t it = index - sMinIndex;
+		uint32_t end = NvMin(it + 3, sClassCount);
+		while(it < end && !cache.mFree[it])
 			++it;
 
 		if(it < end)
-			// pop top off freelist
-			chunk = *it, *it = chunk->mNext, index = uint32_t(it - getFreeTable().begin() + sMinIndex);
+		{
+			++cache.mHits[index - sMinIndex];
+		}
+		else
+		{
+			++cache.mMisses[index - sMinIndex];
+			it = index - sMinIndex;
+			if(!refill(cache, it))
+				it = sClassCount;
+		}
+
+		if(it < sClassCount)
+			// pop top off the thread's freelist
+			chunk = cache.mFree[it], cache.mFree[it] = chunk->mNext, --cache.mCount[it], index = it + sMinIndex;
 		else
 			// create new chunk
 			chunk = (Chunk*)NonTrackingAllocator().allocate(size_t(2 << index), filename, line);
@@ -151,14 +316,15 @@ void TempAllocator::deallocate(void* ptr)
 	if(index >= sMaxIndex)
 		return NonTrackingAllocator().deallocate(chunk);
 
-	Mutex::ScopedLock lock(getMutex());
+	ThreadCache& cache = getThreadCache();
 
 	index -= sMinIndex;
-	if(getFreeTable().size() <= index)
-		getFreeTable().resize(index + 1);
+	chunk->mNext = cache.mFree[index];
+	cache.mFree[index] = chunk;
 
-	chunk->mNext = getFreeTable()[index];
-	getFreeTable()[index] = chunk;
+	// hand surplus chunks back so other threads can reuse them
+	if(++cache.mCount[index] >= 2 * sBatchSize)
+		spill(cache, index);
 }
 
 } // namespace shdfnd
@@ -96,6 +96,17 @@ bool NvAssetLoaderFree(char* asset)
     return true;
 }
 
+char *NvAssetLoaderMap(const char* /*filePath*/, int64_t& /*length*/)
+{
+    // Assets are stored in the APK and can't be mapped copy-on-write
+    return NULL;
+}
+
+bool NvAssetLoaderUnmap(char* /*asset*/, int64_t /*length*/)
+{
+    return false;
+}
+
 bool NvAssetLoaderFileExists(const char *filePath) {
     NvAssetFilePtr fp = NvAssetLoaderOpenFile(filePath);
     if (fp != NULL) {
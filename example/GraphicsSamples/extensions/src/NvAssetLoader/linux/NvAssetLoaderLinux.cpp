@@ -36,6 +36,7 @@
 #include <string>
 #include <stdio.h>
 #include <vector>
+#include <sys/mman.h>
 
 static std::vector<std::string> s_searchPath;
 
@@ -109,6 +110,29 @@ bool NvAssetLoaderFree(char* asset)
     return true;
 }
 
+char *NvAssetLoaderMap(const char *filePath, int64_t &length)
+{
+    FILE* fp = (FILE*)NvAssetLoaderOpenFile(filePath);
+
+    if (!fp) {
+        fprintf(stderr, "Error opening file '%s'\n", filePath);
+        return NULL;
+    }
+
+    length = NvAssetFileGetSize64(fp);
+
+    void* data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp), 0);
+
+    NvAssetLoaderCloseFile(fp);
+
+    return (data != MAP_FAILED) ? (char*)data : NULL;
+}
+
+bool NvAssetLoaderUnmap(char* asset, int64_t length)
+{
+    return munmap(asset, length) == 0;
+}
+
 bool NvAssetLoaderFileExists(const char *filePath) {
     NvAssetFilePtr fp = NvAssetLoaderOpenFile(filePath);
     if (fp != NULL) {
@@ -35,6 +35,7 @@
 #include "NV/NvLogs.h"
 
 #include <io.h>
+#include <windows.h>
 #include <string>
 #include <stdio.h>
 #include <vector>
@@ -111,6 +112,35 @@ bool NvAssetLoaderFree(char* asset)
     return true;
 }
 
+char *NvAssetLoaderMap(const char *filePath, int64_t &length)
+{
+    FILE* fp = (FILE*)NvAssetLoaderOpenFile(filePath);
+
+    if (!fp) {
+        fprintf(stderr, "Error opening file '%s'\n", filePath);
+        return NULL;
+    }
+
+    length = NvAssetFileGetSize64(fp);
+
+    char* data = NULL;
+    HANDLE mapping = CreateFileMapping((HANDLE)_get_osfhandle(_fileno(fp)), NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (mapping != NULL) {
+        // The view holds a reference on the mapping object
+        data = (char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+
+    NvAssetLoaderCloseFile(fp);
+
+    return data;
+}
+
+bool NvAssetLoaderUnmap(char* asset, int64_t length)
+{
+    return UnmapViewOfFile(asset) != 0;
+}
+
 bool NvAssetLoaderFileExists(const char *filePath) {
     NvAssetFilePtr fp = NvAssetLoaderOpenFile(filePath);
     if (fp != NULL) {
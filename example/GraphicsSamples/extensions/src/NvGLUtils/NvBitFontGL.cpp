@@ -77,6 +77,7 @@ public:
     virtual ~NvBFTextRenderGL();
     virtual void RenderPrep();
     virtual void Render(const float* matrix, const NvPackedColor& color, NvBitFont* font, bool outline, int count);
+    virtual void RenderRange(const float* matrix, const NvPackedColor& color, NvBitFont* font, bool outline, int first, int count);
     virtual void UpdateText(int count, const BFVert* data, bool midrender);
     virtual void RenderDone();
 
@@ -335,6 +336,12 @@ void NvBFTextRenderGL::RenderPrep()
 
 
 void NvBFTextRenderGL::Render(const float* matrix, const NvPackedColor& color, NvBitFont* font, bool outline, int count)
+{
+    RenderRange(matrix, color, font, outline, 0, count);
+}
+
+
+void NvBFTextRenderGL::RenderRange(const float* matrix, const NvPackedColor& color, NvBitFont* font, bool outline, int first, int count)
 {
 
     // we're past all early-exits here.
@@ -351,7 +358,9 @@ void NvBFTextRenderGL::Render(const float* matrix, const NvPackedColor& color, N
 
     // set up master rendering state
     {
+        // the master indices start at the first quad, so offset the vertices instead
         uint8_t *offset = NULL;
+        offset += first * sizeof(BFVert) * VERT_PER_QUAD;
         glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 
         glVertexAttribPointer(prog->fontProgAttribPos, 2, GL_FLOAT, 0, sizeof(BFVert), (void *)offset);
@@ -34,10 +34,12 @@
 #include "NvGLUtils/NvGLSLProgram.h"
 #include "NV/NvLogs.h"
 #include "NvAssetLoader/NvAssetLoader.h"
+#include <string.h>
 #include <string>
 
 bool NvGLSLProgram::ms_logAllMissing = false;
 const char* NvGLSLProgram::ms_shaderHeader = NULL;
+NvGLSLProgram::UniformStats NvGLSLProgram::ms_uniformStats = { 0, 0, 0, 0 };
 
 NvGLSLProgram::NvGLSLProgram()
     : m_program(0), m_strict(false)
@@ -116,6 +118,7 @@ bool NvGLSLProgram::setSourceFromStrings(const char* vertSrc, const char* fragSr
     m_strict = strict;
 
     m_program = compileProgram(vertSrc, fragSrc);
+    cacheUniforms();
 
     return m_program != 0;
 }
@@ -131,6 +134,7 @@ bool NvGLSLProgram::setSourceFromStrings(const char** vertSrcArray, int32_t vert
     m_strict = strict;
 
     m_program = compileProgram(vertSrcArray, vertSrcCount, fragSrcArray, fragSrcCount);
+    cacheUniforms();
 
     return m_program != 0;
 }
@@ -145,6 +149,7 @@ bool NvGLSLProgram::setSourceFromStrings(ShaderSourceItem* src, int32_t count, b
     m_strict = strict;
 
     m_program = compileProgram(src, count);
+    cacheUniforms();
 
     return m_program != 0;
 }
@@ -400,8 +405,11 @@ bool NvGLSLProgram::relink()
                 delete [] buf;
             }
         }
+        m_uniforms.clear();
         return false;
     }
+    // the locations may have changed
+    cacheUniforms();
     return true;
 }
 
@@ -426,7 +434,18 @@ GLint NvGLSLProgram::getAttribLocation(const char* attribute, bool isOptional)
 
 GLint NvGLSLProgram::getUniformLocation(const char* uniform, bool isOptional)
 {
-    GLint result = glGetUniformLocation(m_program, uniform);
+    GLint result = -1;
+    ms_uniformStats.lookups++;
+    const int32_t slot = findUniform(uniform);
+    if (slot >= 0) {
+        result = m_uniforms[slot].location;
+        // set by location, the cached value of the handle becomes stale
+        m_uniforms[slot].cached = false;
+    } else if (strchr(uniform, '[')) {
+        // only the array elements aren't in the table
+        ms_uniformStats.glLookups++;
+        result = glGetUniformLocation(m_program, uniform);
+    }
 
     if (result == -1)
     {
@@ -443,6 +462,147 @@ GLint NvGLSLProgram::getUniformLocation(const char* uniform, bool isOptional)
     return result;
 }
 
+NvGLSLProgram::Uniform NvGLSLProgram::getUniform(const char* uniform, bool isOptional)
+{
+    ms_uniformStats.lookups++;
+    Uniform handle = { findUniform(uniform) };
+    if (handle.slot < 0 && (ms_logAllMissing || m_strict) && !isOptional) {
+        LOGI("could not find uniform \"%s\" in program %d", uniform, m_program);
+    }
+    return handle;
+}
+
+void NvGLSLProgram::cacheUniforms()
+{
+    m_uniforms.clear();
+    if (!m_program)
+        return;
+
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<char> name(maxLength + 1);
+    m_uniforms.reserve(count);
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_program, i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+
+        UniformEntry entry;
+        entry.name.assign(&name[0], length);
+        // arrays are reported by their first element
+        if (entry.name.size() > 3 && entry.name.compare(entry.name.size() - 3, 3, "[0]") == 0)
+            entry.name.resize(entry.name.size() - 3);
+        entry.location = glGetUniformLocation(m_program, entry.name.c_str());
+        // members of uniform blocks don't have a location
+        if (entry.location < 0)
+            continue;
+        entry.type = type;
+        entry.cached = false;
+        m_uniforms.push_back(entry);
+    }
+}
+
+int32_t NvGLSLProgram::findUniform(const char* uniform) const
+{
+    // programs have few uniforms, a linear search beats hashing the name
+    for (size_t i = 0; i < m_uniforms.size(); ++i) {
+        if (m_uniforms[i].name == uniform)
+            return (int32_t)i;
+    }
+    return -1;
+}
+
+bool NvGLSLProgram::updateUniform(Uniform uniform, GLenum type, const void* value, uint32_t size)
+{
+    UniformEntry& entry = m_uniforms[uniform.slot];
+#ifdef _DEBUG
+    // samplers are set as integers
+    if (entry.type != type && type != GL_INT) {
+        LOGI("uniform \"%s\" of program %d set with the wrong type", entry.name.c_str(), m_program);
+    }
+#endif
+    if (entry.cached && memcmp(entry.value, value, size) == 0) {
+        ms_uniformStats.skipped++;
+        return false;
+    }
+
+    memcpy(entry.value, value, size);
+    entry.cached = true;
+    ms_uniformStats.uploads++;
+    return true;
+}
+
+void NvGLSLProgram::setUniform1i(Uniform uniform, int32_t value)
+{
+    if (uniform.slot >= 0 && updateUniform(uniform, GL_INT, &value, sizeof(value))) {
+        glUniform1i(m_uniforms[uniform.slot].location, value);
+    }
+}
+
+void NvGLSLProgram::setUniform1f(Uniform uniform, float value)
+{
+    if (uniform.slot >= 0 && updateUniform(uniform, GL_FLOAT, &value, sizeof(value))) {
+        glUniform1f(m_uniforms[uniform.slot].location, value);
+    }
+}
+
+void NvGLSLProgram::setUniform3fv(Uniform uniform, const float *value)
+{
+    if (uniform.slot >= 0 && updateUniform(uniform, GL_FLOAT_VEC3, value, 3 * sizeof(float))) {
+        glUniform3fv(m_uniforms[uniform.slot].location, 1, value);
+    }
+}
+
+void NvGLSLProgram::setUniform4fv(Uniform uniform, const float *value)
+{
+    if (uniform.slot >= 0 && updateUniform(uniform, GL_FLOAT_VEC4, value, 4 * sizeof(float))) {
+        glUniform4fv(m_uniforms[uniform.slot].location, 1, value);
+    }
+}
+
+void NvGLSLProgram::setUniformMatrix4fv(Uniform uniform, const GLfloat *m)
+{
+    if (uniform.slot >= 0 && updateUniform(uniform, GL_FLOAT_MAT4, m, 16 * sizeof(GLfloat))) {
+        glUniformMatrix4fv(m_uniforms[uniform.slot].location, 1, false, m);
+    }
+}
+
+void NvGLSLProgram::bindTexture2D(Uniform uniform, int32_t unit, GLuint tex)
+{
+    if (uniform.slot >= 0) {
+        setUniform1i(uniform, unit);
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, tex);
+    }
+}
+
+void NvGLSLProgram::bindTextureRect(Uniform uniform, int32_t unit, GLuint tex)
+{
+    if (uniform.slot >= 0) {
+        setUniform1i(uniform, unit);
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(0x84F5/*GL_TEXTURE_RECT*/, tex);
+    }
+}
+
+void NvGLSLProgram::invalidateUniforms()
+{
+    for (size_t i = 0; i < m_uniforms.size(); ++i)
+        m_uniforms[i].cached = false;
+}
+
+void NvGLSLProgram::resetUniformStats()
+{
+    ms_uniformStats.lookups = 0;
+    ms_uniformStats.glLookups = 0;
+    ms_uniformStats.uploads = 0;
+    ms_uniformStats.skipped = 0;
+}
+
 void NvGLSLProgram::bindTexture2D(const char *name, int32_t unit, GLuint tex)
 {
     GLint loc = getUniformLocation(name, false);
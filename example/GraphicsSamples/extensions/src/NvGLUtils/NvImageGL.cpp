@@ -43,15 +43,14 @@ namespace NvImageGL {
 	static bool s_supportsConversion = false;
 
     uint32_t UploadTextureFromDDSFile(const char* filename) {
-        int32_t len;
-        char* ddsData = NvAssetLoaderRead(filename, len);
+        NvImage* image = NvImage::CreateFromDDSFile(filename);
 
-        if (!ddsData)
+        if (!image)
             return 0;
 
-        GLuint result = UploadTextureFromDDSData(ddsData, len);
+        GLuint result = UploadTexture(image);
 
-        NvAssetLoaderFree(ddsData);
+        delete image;
 
         return result;
     }
@@ -37,6 +37,7 @@
 #include "NvModel/NvModelSubMesh.h"
 #include "../../src/NvModel/NvModelExtObj.h"
 #include "NvModel/NvSkeleton.h"
+#include <algorithm>
 
 namespace Nv
 {
@@ -44,6 +45,8 @@ namespace Nv
     NvGLInstancingSupport::PFNDrawElementsInstanced NvGLInstancingSupport::glDrawElementsInstancedInternal = nullptr;
     NvGLInstancingSupport::PFNVertexAttribDivisor NvGLInstancingSupport::glVertexAttribDivisorInternal = nullptr;
 
+    NvMeshExtGL::DrawStats NvMeshExtGL::ms_drawStats = { 0, 0 };
+
 	NvMeshExtGL::NvMeshExtGL() :
 		m_pSrcMesh(NULL),
         m_materialID(-1),
@@ -72,6 +75,8 @@ namespace Nv
 		m_vboID(other.m_vboID),
 		m_iboID(other.m_iboID),
 		m_indexCount(other.m_indexCount),
+		m_lodIndexCounts(other.m_lodIndexCounts),
+		m_lodIndexOffsets(other.m_lodIndexOffsets),
 		m_vertexCount(other.m_vertexCount),
 		m_vertexSize(other.m_vertexSize),
 		m_positionSize(other.m_positionSize),
@@ -149,11 +154,28 @@ namespace Nv
 
         // Allocate a large enough index buffer to hold the indices for all primitives in the mesh
 		m_indexCount = m_pSrcMesh->m_indexCount;
+
+        // The lower levels of detail follow the full detail indices in the same buffer
+        m_lodIndexCounts.clear();
+        m_lodIndexOffsets.clear();
+        intptr_t lodOffset = sizeof(uint32_t) * m_indexCount;
+        for (uint32_t lodIndexCount : m_pSrcMesh->m_lodIndexCounts)
+        {
+            m_lodIndexCounts.push_back(lodIndexCount);
+            m_lodIndexOffsets.push_back(lodOffset);
+            lodOffset += sizeof(uint32_t) * lodIndexCount;
+        }
         
         // Set up the GL data structures necessary for the index buffer object
         glGenBuffers(1, &m_iboID);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_iboID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * m_indexCount, m_pSrcMesh->m_indices, GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, lodOffset, NULL, GL_STATIC_DRAW);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(uint32_t) * m_indexCount, m_pSrcMesh->m_indices);
+        if (!m_pSrcMesh->m_lodIndices.empty())
+        {
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * m_indexCount,
+                sizeof(uint32_t) * m_pSrcMesh->m_lodIndices.size(), &m_pSrcMesh->m_lodIndices[0]);
+        }
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
         return true;
     }
@@ -174,10 +196,22 @@ namespace Nv
         return true;
     }
 
-	void NvMeshExtGL::DrawElements(uint32_t instanceCount, GLint positionHandle, GLint normalHandle, GLint texcoordHandle, GLint tangentHandle)
+	void NvMeshExtGL::DrawElements(uint32_t instanceCount, GLint positionHandle, GLint normalHandle, GLint texcoordHandle, GLint tangentHandle, uint32_t lod)
     {
         int32_t vertexSizeInBytes = m_vertexSize * sizeof(float);
 
+        // Select the range of the index buffer holding the level of detail
+        GLsizei indexCount = m_indexCount;
+        intptr_t indexOffset = 0;
+        lod = std::min(lod, (uint32_t)m_lodIndexCounts.size());
+        if (lod > 0)
+        {
+            indexCount = m_lodIndexCounts[lod - 1];
+            indexOffset = m_lodIndexOffsets[lod - 1];
+        }
+        ms_drawStats.drawCalls++;
+        ms_drawStats.indices += uint64_t(indexCount) * std::max(instanceCount, 1u);
+
         // Bind our vertex/index buffers
         glBindBuffer(GL_ARRAY_BUFFER, m_vboID);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_iboID);
@@ -202,11 +236,11 @@ namespace Nv
 
 		if (instanceCount >= 1 && (NvGLInstancingSupport::glDrawElementsInstancedInternal != nullptr))
         {
-            NvGLInstancingSupport::glDrawElementsInstancedInternal(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, nullptr, instanceCount);
+            NvGLInstancingSupport::glDrawElementsInstancedInternal(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (GLvoid*)indexOffset, instanceCount);
         }
         else
         {
-            glDrawElements(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, 0);
+            glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (GLvoid*)indexOffset);
         }
 
         // Unbind our vertex/index buffers
@@ -223,6 +257,12 @@ namespace Nv
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 
+    void NvMeshExtGL::ResetDrawStats()
+    {
+        ms_drawStats.drawCalls = 0;
+        ms_drawStats.indices = 0;
+    }
+
 	void NvMeshExtGL::Clear()
     {
         if (m_vboID != 0)
@@ -238,6 +278,8 @@ namespace Nv
         }
 
         m_indexCount = 0;
+        m_lodIndexCounts.clear();
+        m_lodIndexOffsets.clear();
         m_vertexCount = 0;
         m_vertexSize = 0;
         m_positionSize = 0;
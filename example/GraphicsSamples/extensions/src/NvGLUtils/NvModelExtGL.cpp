@@ -35,6 +35,7 @@
 #include "NvGLUtils/NvModelExtGL.h"
 #include "NvModel/NvModelExt.h"
 #include "NvGLUtils/NvImageGL.h"
+#include <algorithm>
 
 bool Nv::NvModelExtGL::ms_loadTextures = true;
 
@@ -127,7 +128,7 @@ namespace Nv
 		}
 	}
 
-	void NvModelExtGL::DrawElements(uint32_t instanceCount, GLint positionHandle, GLint normalHandle, GLint texcoordHandle, GLint tangentHandle)
+	void NvModelExtGL::DrawElements(uint32_t instanceCount, GLint positionHandle, GLint normalHandle, GLint texcoordHandle, GLint tangentHandle, uint32_t lod)
     {
 		uint32_t numMeshes = GetMeshCount();
 		for (uint32_t meshIndex = 0; meshIndex < numMeshes; ++meshIndex)
@@ -135,10 +136,21 @@ namespace Nv
 			Nv::NvMeshExtGL* pMesh = GetMesh(meshIndex);
 			uint32_t matId = pMesh->GetMaterialID();
             ActivateMaterial(matId);
-            pMesh->DrawElements(instanceCount, positionHandle, normalHandle, texcoordHandle, tangentHandle);
+            pMesh->DrawElements(instanceCount, positionHandle, normalHandle, texcoordHandle, tangentHandle, lod);
 		}
     }
 
+    uint32_t NvModelExtGL::GetLodCount()
+    {
+        uint32_t lodCount = 1;
+        uint32_t numMeshes = GetMeshCount();
+        for (uint32_t meshIndex = 0; meshIndex < numMeshes; ++meshIndex)
+        {
+            lodCount = std::max(lodCount, GetMesh(meshIndex)->GetLodCount());
+        }
+        return lodCount;
+    }
+
 	// Currently we only support setting a single diffuse texture.  This needs
 	// to be replaced by a general materials system for binding shader
 	// parameters
@@ -156,6 +156,25 @@ void BlockDXT1::decodeBlock(ColorBlock * block) const
     Color32 color_array[4];
     evaluatePalette(color_array);
     
+#if NV_IMAGE_SSE2
+    // Write color block a row at a time, selecting each texel's palette
+    // entry by comparing its 2bit index against all four entries.
+    const __m128i pal0 = _mm_set1_epi32(color_array[0].u);
+    const __m128i pal1 = _mm_set1_epi32(color_array[1].u);
+    const __m128i pal2 = _mm_set1_epi32(color_array[2].u);
+    const __m128i pal3 = _mm_set1_epi32(color_array[3].u);
+    const __m128i shifts = _mm_set_epi32(1 << 2, 1 << 4, 1 << 6, 1 << 8);
+    const __m128i three = _mm_set1_epi32(3);
+    for( uint32_t j = 0; j < 4; j++ ) {
+        // multiply by 2^(8 - 2i) then shift down by 8 to get index i in lane i
+        __m128i idx = _mm_and_si128(_mm_srli_epi32(_mm_mullo_epi16(_mm_set1_epi32(row[j]), shifts), 8), three);
+        __m128i c = _mm_and_si128(_mm_cmpeq_epi32(idx, _mm_setzero_si128()), pal0);
+        c = _mm_or_si128(c, _mm_and_si128(_mm_cmpeq_epi32(idx, _mm_set1_epi32(1)), pal1));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_cmpeq_epi32(idx, _mm_set1_epi32(2)), pal2));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_cmpeq_epi32(idx, three), pal3));
+        _mm_storeu_si128((__m128i*)&block->color(0, j), c);
+    }
+#else
     // Write color block.
     for( uint32_t j = 0; j < 4; j++ ) {
         for( uint32_t i = 0; i < 4; i++ ) {
@@ -163,6 +182,7 @@ void BlockDXT1::decodeBlock(ColorBlock * block) const
             block->color(i, j) = color_array[idx];
         }
     }    
+#endif
 }
 
 void BlockDXT1::setIndices(int * idx)
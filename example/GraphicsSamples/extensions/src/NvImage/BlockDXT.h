@@ -37,6 +37,14 @@
 
 #include "ColorBlock.h"
 
+// SSE2 is used to decode and flip blocks where it is guaranteed to be available
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NV_IMAGE_SSE2 1
+#include <emmintrin.h>
+#else
+#define NV_IMAGE_SSE2 0
+#endif
+
 namespace nv
 {
     /// DXT1 block.
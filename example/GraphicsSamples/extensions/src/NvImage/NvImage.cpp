@@ -385,100 +385,69 @@ static inline int32_t min(int32_t a, int32_t b) {
 }
 
 //
-//
+// Decodes all of the blocks of a DXT surface into 32bit texels.  Blocks
+// fully inside the surface are written a row at a time, only the ones
+// clipped by the surface edges are written texel by texel.
 ////////////////////////////////////////////////////////////
-void NvImage::expandDXT(uint8_t *surf, int32_t width, int32_t height, int32_t depth, int32_t srcSize)
+template <typename BlockType>
+static void expandDXTBlocks(const uint8_t* src, uint32_t* plane, int32_t width, int32_t height, int32_t depth)
 {
-    depth = (depth) ? depth : 1;
-
-	uint32_t* dest = (uint32_t*)surf;
-    uint32_t* plane = dest;
-
-	uint8_t* srcBlock = new uint8_t[srcSize];
-	uint8_t* src = srcBlock;
-	memcpy(src, surf, srcSize);
-
     int32_t bh = (height + 3) / 4;
     int32_t bw = (width + 3) / 4;
 
-    if (_format == NVIMAGE_COMPRESSED_RGBA_S3TC_DXT1) {
-        for (int32_t k = 0; k < depth; k++) {
+    for (int32_t k = 0; k < depth; k++) {
 
-            for (int32_t j = 0; j < bh; j++) {
-                int32_t yBlockSize = min(4, height - 4 * j);
+        for (int32_t j = 0; j < bh; j++) {
+            int32_t yBlockSize = min(4, height - 4 * j);
 
-                for (int32_t i = 0; i < bw; i++) {
-                    int32_t xBlockSize = min(4, width - 4 * i);
-                    nv::BlockDXT1* block = (nv::BlockDXT1*)src;
-                    nv::ColorBlock color;
+            for (int32_t i = 0; i < bw; i++) {
+                int32_t xBlockSize = min(4, width - 4 * i);
+                const BlockType* block = (const BlockType*)src;
+                nv::ColorBlock color;
 
-                    block->decodeBlock(&color);
+                block->decodeBlock(&color);
 
-                    // Write color block.
-                    for (int32_t y = 0; y < yBlockSize; y++) {
-                        for (int32_t x = 0; x < xBlockSize; x++) {
-                            plane[4*i+x + (4*j+y)*width] = (uint32_t)color.color(x, y);
-                        }
+                // Write color block.
+                uint32_t* dest = plane + 4*i + 4*j*width;
+                if (xBlockSize == 4 && yBlockSize == 4) {
+                    for (int32_t y = 0; y < 4; y++) {
+                        memcpy(dest + y*width, color.colors() + 4*y, 4 * sizeof(uint32_t));
                     }
-
-                    src += sizeof(nv::BlockDXT1); // 64bits
                 }
-            }
-
-            plane += width * height;
-        }
-    } else if (_format == NVIMAGE_COMPRESSED_RGBA_S3TC_DXT3) {
-        for (int32_t k = 0; k < depth; k++) {
-
-            for (int32_t j = 0; j < bh; j++) {
-                int32_t yBlockSize = min(4, height - 4 * j);
-
-                for (int32_t i = 0; i < bw; i++) {
-                    int32_t xBlockSize = min(4, width - 4 * i);
-                    nv::BlockDXT3* block = (nv::BlockDXT3*)src;
-                    nv::ColorBlock color;
-
-                    block->decodeBlock(&color);
-
-                    // Write color block.
+                else {
                     for (int32_t y = 0; y < yBlockSize; y++) {
                         for (int32_t x = 0; x < xBlockSize; x++) {
-                            plane[4*i+x + (4*j+y)*width] = (uint32_t)color.color(x, y);
+                            dest[x + y*width] = (uint32_t)color.color(x, y);
                         }
                     }
-
-                    src += sizeof(nv::BlockDXT3); // 64bits
                 }
-            }
 
-            plane += width * height;
+                src += sizeof(BlockType);
+            }
         }
-    } else {
-        for (int32_t k = 0; k < depth; k++) {
-
-            for (int32_t j = 0; j < bh; j++) {
-                int32_t yBlockSize = min(4U, height - 4 * j);
 
-                for (int32_t i = 0; i < bw; i++) {
-                    int32_t xBlockSize = min(4, width - 4 * i);
-                    nv::BlockDXT5* block = (nv::BlockDXT5*)src;
-                    nv::ColorBlock color;
+        plane += width * height;
+    }
+}
 
-                    block->decodeBlock(&color);
+//
+//
+////////////////////////////////////////////////////////////
+void NvImage::expandDXT(uint8_t *surf, int32_t width, int32_t height, int32_t depth, int32_t srcSize)
+{
+    depth = (depth) ? depth : 1;
 
-                    // Write color block.
-                    for (int32_t y = 0; y < yBlockSize; y++) {
-                        for (int32_t x = 0; x < xBlockSize; x++) {
-                            plane[4*i+x + (4*j+y)*width] = (uint32_t)color.color(x, y);
-                        }
-                    }
+	uint32_t* dest = (uint32_t*)surf;
 
-                    src += sizeof(nv::BlockDXT5); // 64bits
-                }
-            }
+	uint8_t* srcBlock = new uint8_t[srcSize];
+	memcpy(srcBlock, surf, srcSize);
 
-            plane += width * height;
-        }
+    if (_format == NVIMAGE_COMPRESSED_RGBA_S3TC_DXT1) {
+        expandDXTBlocks<nv::BlockDXT1>(srcBlock, dest, width, height, depth);
+    } else if (_format == NVIMAGE_COMPRESSED_RGBA_S3TC_DXT3) {
+        expandDXTBlocks<nv::BlockDXT3>(srcBlock, dest, width, height, depth);
+    } else {
+        expandDXTBlocks<nv::BlockDXT5>(srcBlock, dest, width, height, depth);
     }
 
 	delete[] srcBlock;
@@ -807,8 +776,15 @@ bool NvImage::hasAlpha() const {
 }
 
 NvImage* NvImage::CreateFromDDSFile(const char* filename) {
-    int32_t len;
-    char* ddsData = NvAssetLoaderRead(filename, len);
+    // The surfaces are copied out of the file data, so map it rather than
+    // reading the whole file into an intermediate buffer first
+    int64_t mappedLen = 0;
+    char* ddsData = NvAssetLoaderMap(filename, mappedLen);
+    bool mapped = (ddsData != NULL);
+    int32_t len = (int32_t)mappedLen;
+
+    if (!mapped)
+        ddsData = NvAssetLoaderRead(filename, len);
 
     if (!ddsData)
         return NULL;
@@ -816,7 +792,10 @@ NvImage* NvImage::CreateFromDDSFile(const char* filename) {
     NvImage* image = new NvImage;
     bool result = image->loadImageFromFileData((const uint8_t*)ddsData, len, "dds");
 
-    NvAssetLoaderFree(ddsData);
+    if (mapped)
+        NvAssetLoaderUnmap(ddsData, mappedLen);
+    else
+        NvAssetLoaderFree(ddsData);
     if (!result) {
         delete image;
         image = NULL;
@@ -38,6 +38,7 @@
 #include "NvImage/NvImage.h"
 #include "NvFilePtr.h"
 #include "NV/NvLogs.h"
+#include "BlockDXT.h"
 
 using std::vector;
 
@@ -1444,131 +1445,120 @@ bool NvImage::readDDS(const uint8_t* data, size_t length, NvImage& i) {
 }
 
 //
-// flip a DXT1 color block
+// Block flip helpers
+//
+// All of the block formats store their rows in a single 64bit word,
+// so a vertical flip of a block is a fixed permutation of bit fields
+// within that word.  The SSE2 paths flip two 64bit words at a time.
 ////////////////////////////////////////////////////////////
-void NvImage::flip_blocks_dxtc1(uint8_t *ptr, uint32_t numBlocks)
+
+// Color blocks: 2x 565 endpoints followed by four 8bit rows of indices
+static inline uint64_t flip_color_word(uint64_t block)
 {
-    DXTColBlock *curblock = (DXTColBlock*)ptr;
-    uint8_t temp;
-
-    for (uint32_t i = 0; i < numBlocks; i++) {
-        temp = curblock->row[0];
-        curblock->row[0] = curblock->row[3];
-        curblock->row[3] = temp;
-        temp = curblock->row[1];
-        curblock->row[1] = curblock->row[2];
-        curblock->row[2] = temp;
-
-        curblock++;
-    }
+    uint64_t rows = block >> 32;
+    rows = ((rows & 0x000000ffULL) << 24) | ((rows & 0x0000ff00ULL) << 8) |
+           ((rows & 0x00ff0000ULL) >> 8)  | ((rows & 0xff000000ULL) >> 24);
+    return (block & 0xffffffffULL) | (rows << 32);
 }
 
-//
-// flip a DXT3 color block
-////////////////////////////////////////////////////////////
-void NvImage::flip_blocks_dxtc3(uint8_t *ptr, uint32_t numBlocks)
+// DXT3 alpha blocks: four 16bit rows of 4bit alphas
+static inline uint64_t flip_dxt3_alpha_word(uint64_t block)
 {
-    DXTColBlock *curblock = (DXTColBlock*)ptr;
-    DXT3AlphaBlock *alphablock;
-    uint16_t tempS;
-    uint8_t tempB;
+    return ((block & 0x000000000000ffffULL) << 48) | ((block & 0x00000000ffff0000ULL) << 16) |
+           ((block & 0x0000ffff00000000ULL) >> 16) | ((block & 0xffff000000000000ULL) >> 48);
+}
 
-    for (uint32_t i = 0; i < numBlocks; i++)
-    {
-        alphablock = (DXT3AlphaBlock*)curblock;
+// DXT5/BC4 alpha blocks: 2x 8bit endpoints followed by four 12bit rows of 3bit indices
+static inline uint64_t flip_dxt5_alpha_word(uint64_t block)
+{
+    return (block & 0x000000000000ffffULL) |
+           ((block << 36) & 0xfff0000000000000ULL) |
+           ((block << 12) & 0x000fff0000000000ULL) |
+           ((block >> 12) & 0x000000fff0000000ULL) |
+           ((block >> 36) & 0x000000000fff0000ULL);
+}
 
-        tempS = alphablock->row[0];
-        alphablock->row[0] = alphablock->row[3];
-        alphablock->row[3] = tempS;
-        tempS = alphablock->row[1];
-        alphablock->row[1] = alphablock->row[2];
-        alphablock->row[2] = tempS;
+static inline uint64_t load_block_word(const uint8_t* ptr)
+{
+    uint64_t block;
+    memcpy(&block, ptr, sizeof(uint64_t));
+    return block;
+}
 
-        curblock++;
+static inline void store_block_word(uint8_t* ptr, uint64_t block)
+{
+    memcpy(ptr, &block, sizeof(uint64_t));
+}
+
+#if NV_IMAGE_SSE2
+static inline __m128i flip_color_sse2(__m128i blocks)
+{
+    // swap the two 16bit halves of the row word, then the bytes within them
+    const __m128i rowMask = _mm_set_epi32(-1, 0, -1, 0);
+    __m128i t = _mm_shufflehi_epi16(_mm_shufflelo_epi16(blocks, _MM_SHUFFLE(2, 3, 1, 0)), _MM_SHUFFLE(2, 3, 1, 0));
+    __m128i s = _mm_or_si128(_mm_slli_epi16(t, 8), _mm_srli_epi16(t, 8));
+    return _mm_or_si128(_mm_and_si128(rowMask, s), _mm_andnot_si128(rowMask, blocks));
+}
+
+static inline __m128i flip_dxt3_alpha_sse2(__m128i blocks)
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(blocks, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+static inline __m128i flip_dxt5_alpha_sse2(__m128i blocks)
+{
+    const __m128i endpoints = _mm_set1_epi64x(0x000000000000ffffLL);
+    const __m128i row0 = _mm_set1_epi64x(0xfff0000000000000LL);
+    const __m128i row1 = _mm_set1_epi64x(0x000fff0000000000LL);
+    const __m128i row2 = _mm_set1_epi64x(0x000000fff0000000LL);
+    const __m128i row3 = _mm_set1_epi64x(0x000000000fff0000LL);
+
+    __m128i r = _mm_and_si128(blocks, endpoints);
+    r = _mm_or_si128(r, _mm_and_si128(_mm_slli_epi64(blocks, 36), row0));
+    r = _mm_or_si128(r, _mm_and_si128(_mm_slli_epi64(blocks, 12), row1));
+    r = _mm_or_si128(r, _mm_and_si128(_mm_srli_epi64(blocks, 12), row2));
+    r = _mm_or_si128(r, _mm_and_si128(_mm_srli_epi64(blocks, 36), row3));
+    return r;
+}
 
-        tempB = curblock->row[0];
-        curblock->row[0] = curblock->row[3];
-        curblock->row[3] = tempB;
-        tempB = curblock->row[1];
-        curblock->row[1] = curblock->row[2];
-        curblock->row[2] = tempB;
+// takes the low 64bit word from lo and the high one from hi
+static inline __m128i merge_words_sse2(__m128i lo, __m128i hi)
+{
+    return _mm_castpd_si128(_mm_move_sd(_mm_castsi128_pd(hi), _mm_castsi128_pd(lo)));
+}
+#endif
 
-        curblock++;
+//
+// flip a DXT1 color block
+////////////////////////////////////////////////////////////
+void NvImage::flip_blocks_dxtc1(uint8_t *ptr, uint32_t numBlocks)
+{
+    uint32_t i = 0;
+#if NV_IMAGE_SSE2
+    for (; i + 2 <= numBlocks; i += 2, ptr += 16) {
+        __m128i blocks = _mm_loadu_si128((const __m128i*)ptr);
+        _mm_storeu_si128((__m128i*)ptr, flip_color_sse2(blocks));
     }
+#endif
+    for (; i < numBlocks; i++, ptr += 8)
+        store_block_word(ptr, flip_color_word(load_block_word(ptr)));
 }
 
 //
-// flip a DXT5 alpha block
+// flip a DXT3 color block
 ////////////////////////////////////////////////////////////
-void flip_dxt5_alpha(DXT5AlphaBlock *block)
+void NvImage::flip_blocks_dxtc3(uint8_t *ptr, uint32_t numBlocks)
 {
-    uint8_t gBits[4][4];
-    
-    const uint32_t mask = 0x00000007;          // bits = 00 00 01 11
-    uint32_t bits = 0;
-    memcpy(&bits, &block->row[0], sizeof(uint8_t) * 3);
-
-    gBits[0][0] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[0][1] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[0][2] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[0][3] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[1][0] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[1][1] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[1][2] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[1][3] = (uint8_t)(bits & mask);
-
-    bits = 0;
-    memcpy(&bits, &block->row[3], sizeof(uint8_t) * 3);
-
-    gBits[2][0] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[2][1] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[2][2] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[2][3] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[3][0] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[3][1] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[3][2] = (uint8_t)(bits & mask);
-    bits >>= 3;
-    gBits[3][3] = (uint8_t)(bits & mask);
-
-    // clear existing alpha bits
-    memset(block->row, 0, sizeof(uint8_t) * 6);
-
-    uint32_t *pBits = ((uint32_t*) &(block->row[0]));
-
-    *pBits = *pBits | (gBits[3][0] << 0);
-    *pBits = *pBits | (gBits[3][1] << 3);
-    *pBits = *pBits | (gBits[3][2] << 6);
-    *pBits = *pBits | (gBits[3][3] << 9);
-
-    *pBits = *pBits | (gBits[2][0] << 12);
-    *pBits = *pBits | (gBits[2][1] << 15);
-    *pBits = *pBits | (gBits[2][2] << 18);
-    *pBits = *pBits | (gBits[2][3] << 21);
-
-    pBits = ((uint32_t*) &(block->row[3]));
-
-    *pBits = *pBits | (gBits[1][0] << 0);
-    *pBits = *pBits | (gBits[1][1] << 3);
-    *pBits = *pBits | (gBits[1][2] << 6);
-    *pBits = *pBits | (gBits[1][3] << 9);
-
-    *pBits = *pBits | (gBits[0][0] << 12);
-    *pBits = *pBits | (gBits[0][1] << 15);
-    *pBits = *pBits | (gBits[0][2] << 18);
-    *pBits = *pBits | (gBits[0][3] << 21);
+    for (uint32_t i = 0; i < numBlocks; i++, ptr += 16)
+    {
+#if NV_IMAGE_SSE2
+        __m128i block = _mm_loadu_si128((const __m128i*)ptr);
+        _mm_storeu_si128((__m128i*)ptr, merge_words_sse2(flip_dxt3_alpha_sse2(block), flip_color_sse2(block)));
+#else
+        store_block_word(ptr, flip_dxt3_alpha_word(load_block_word(ptr)));
+        store_block_word(ptr + 8, flip_color_word(load_block_word(ptr + 8)));
+#endif
+    }
 }
 
 //
@@ -1576,26 +1566,15 @@ void flip_dxt5_alpha(DXT5AlphaBlock *block)
 ////////////////////////////////////////////////////////////
 void NvImage::flip_blocks_dxtc5(uint8_t *ptr, uint32_t numBlocks)
 {
-    DXTColBlock *curblock = (DXTColBlock*)ptr;
-    DXT5AlphaBlock *alphablock;
-    uint8_t temp;
-    
-    for (uint32_t i = 0; i < numBlocks; i++)
+    for (uint32_t i = 0; i < numBlocks; i++, ptr += 16)
     {
-        alphablock = (DXT5AlphaBlock*)curblock;
-        
-        flip_dxt5_alpha(alphablock);
-
-        curblock++;
-
-        temp = curblock->row[0];
-        curblock->row[0] = curblock->row[3];
-        curblock->row[3] = temp;
-        temp = curblock->row[1];
-        curblock->row[1] = curblock->row[2];
-        curblock->row[2] = temp;
-
-        curblock++;
+#if NV_IMAGE_SSE2
+        __m128i block = _mm_loadu_si128((const __m128i*)ptr);
+        _mm_storeu_si128((__m128i*)ptr, merge_words_sse2(flip_dxt5_alpha_sse2(block), flip_color_sse2(block)));
+#else
+        store_block_word(ptr, flip_dxt5_alpha_word(load_block_word(ptr)));
+        store_block_word(ptr + 8, flip_color_word(load_block_word(ptr + 8)));
+#endif
     }
 }
 
@@ -1604,14 +1583,15 @@ void NvImage::flip_blocks_dxtc5(uint8_t *ptr, uint32_t numBlocks)
 ////////////////////////////////////////////////////////////
 void NvImage::flip_blocks_bc4(uint8_t *ptr, uint32_t numBlocks)
 {
-    DXT5AlphaBlock *alphablock = (DXT5AlphaBlock*)ptr;
-    
-    for (uint32_t i = 0; i < numBlocks; i++)
-    {
-        flip_dxt5_alpha(alphablock);
-
-        alphablock++;
+    uint32_t i = 0;
+#if NV_IMAGE_SSE2
+    for (; i + 2 <= numBlocks; i += 2, ptr += 16) {
+        __m128i blocks = _mm_loadu_si128((const __m128i*)ptr);
+        _mm_storeu_si128((__m128i*)ptr, flip_dxt5_alpha_sse2(blocks));
     }
+#endif
+    for (; i < numBlocks; i++, ptr += 8)
+        store_block_word(ptr, flip_dxt5_alpha_word(load_block_word(ptr)));
 }
 
 //
@@ -1619,16 +1599,6 @@ void NvImage::flip_blocks_bc4(uint8_t *ptr, uint32_t numBlocks)
 ////////////////////////////////////////////////////////////
 void NvImage::flip_blocks_bc5(uint8_t *ptr, uint32_t numBlocks)
 {
-    DXT5AlphaBlock *alphablock = (DXT5AlphaBlock*)ptr;
-    
-    for (uint32_t i = 0; i < numBlocks; i++)
-    {
-        flip_dxt5_alpha(alphablock);
-
-        alphablock++;
-        flip_dxt5_alpha(alphablock);
-
-        alphablock++;
-    }
+    // a BC5 block is simply two BC4 blocks
+    flip_blocks_bc4(ptr, numBlocks * 2);
 }
-
@@ -39,6 +39,8 @@
 #include "NvModel/NvModelSubMesh.h"
 #include "NvModel/NvSkeleton.h"
 #include "NvModelExtFile.h"
+#include "NvModelSimplifier.h"
+#include <algorithm>
 
 #ifdef LINUX
 #include <stdio.h>
@@ -50,13 +52,13 @@ namespace Nv
 
 	NvModelExt* NvModelExt::CreateFromObj(const char* filename, float scale,
 		bool generateNormals, bool generateTangents,
-		float vertMergeThreshold, float normMergeThreshold, uint32_t initialVertCount) {
+		float vertMergeThreshold, float normMergeThreshold, uint32_t initialVertCount, WeldMethod weldMethod) {
 		return NvModelExtObj::Create(filename, scale, generateNormals, generateTangents,
-			vertMergeThreshold, normMergeThreshold, initialVertCount);
+			vertMergeThreshold, normMergeThreshold, initialVertCount, weldMethod);
 	}
 
-	NvModelExt* NvModelExt::CreateFromPreprocessed(const char* filename) {
-		return NvModelExtBin::Create(filename);
+	NvModelExt* NvModelExt::CreateFromPreprocessed(const char* filename, bool mapData) {
+		return NvModelExtBin::Create(filename, mapData);
 	}
 
 	NvModelExt::NvModelExt() :
@@ -71,6 +73,49 @@ namespace Nv
 	{
 	}
 
+    uint32_t NvModelExt::GenerateLods(uint32_t lodCount, float reduction, float maxError)
+    {
+        uint32_t generatedCount = 1;
+        std::vector<uint32_t> lodIndices;
+
+        const uint32_t meshCount = GetMeshCount();
+        for (uint32_t meshIndex = 0; meshIndex < meshCount; ++meshIndex)
+        {
+            SubMesh* pMesh = GetSubMesh(meshIndex);
+            if (NULL == pMesh)
+            {
+                continue;
+            }
+
+            pMesh->m_lodIndices.clear();
+            pMesh->m_lodIndexCounts.clear();
+
+            // Each level is simplified from the previous one, so their collapses are nested
+            const uint32_t* pSrcIndices = pMesh->m_indices;
+            uint32_t srcIndexCount = pMesh->m_indexCount;
+            for (uint32_t lod = 1; lod < lodCount; ++lod)
+            {
+                const uint32_t targetIndexCount = (uint32_t)(srcIndexCount * reduction) / 3 * 3;
+                SimplifyMesh(lodIndices, pSrcIndices, srcIndexCount, pMesh->m_vertices, pMesh->m_vertexCount,
+                    pMesh->m_vertSize, targetIndexCount, maxError);
+                if (lodIndices.empty() || lodIndices.size() >= srcIndexCount)
+                {
+                    break;
+                }
+
+                const size_t lodOffset = pMesh->m_lodIndices.size();
+                pMesh->m_lodIndices.insert(pMesh->m_lodIndices.end(), lodIndices.begin(), lodIndices.end());
+                pMesh->m_lodIndexCounts.push_back((uint32_t)lodIndices.size());
+                pSrcIndices = &pMesh->m_lodIndices[lodOffset];
+                srcIndexCount = (uint32_t)lodIndices.size();
+            }
+
+            generatedCount = std::max(generatedCount, pMesh->getLodCount());
+        }
+
+        return generatedCount;
+    }
+
     int32_t AppendTextureDescs(std::vector<NvModelTextureDesc>& destDescs, const TextureDescArray& srcDescs, int32_t currentOffset, int32_t& outOffset)
     {
         if (srcDescs.empty())
@@ -101,11 +146,17 @@ namespace Nv
     }
 
 	bool NvModelExt::WritePreprocessedModel(const char* filename) {
-#ifdef _WIN32
 		FILE* fp = NULL;
-	
+#ifdef _WIN32
 		errno_t err = fopen_s(&fp, filename, "wb");
-		if (err || !fp)
+		if (err)
+		{
+			fp = NULL;
+		}
+#else
+		fp = fopen(filename, "wb");
+#endif
+		if (!fp)
 		{
 			LOGE("Unable to write file: %s\n", filename);
 			return false;
@@ -127,9 +178,6 @@ namespace Nv
         fclose(fp);
 
 		return true;
-#else
-		return false;
-#endif
 	}
 
     int32_t NvModelExt::WriteFileHeader(FILE* fp) const {
@@ -39,24 +39,74 @@
 namespace Nv
 {
 	NvModelExtBin::NvModelExtBin()
+		: m_materials(NULL)
+		, m_materialCount(0)
+		, m_textureCount(0)
+		, m_subMeshes(NULL)
+		, m_meshCount(0)
+		, m_pMappedData(NULL)
+		, m_mappedDataLength(0)
+		, m_pMappedLoader(NULL)
 	{
 	}
 
 	NvModelExtBin::~NvModelExtBin()
 	{
+		for (uint32_t i = 0; i < m_meshCount; ++i)
+		{
+			SubMesh* pMesh = m_subMeshes + i;
+			if (!IsMappedArray(pMesh->m_vertices))
+			{
+				delete[] pMesh->m_vertices;
+			}
+			if (!IsMappedArray(pMesh->m_indices))
+			{
+				delete[] pMesh->m_indices;
+			}
+		}
+		delete[] m_subMeshes;
+		delete[] m_materials;
+
+		if (NULL != m_pMappedData)
+		{
+			m_pMappedLoader->UnmapData(m_pMappedData, m_mappedDataLength);
+		}
 	}
 
-	NvModelExtBin* NvModelExtBin::Create(const char* pFileName) {
-		NvModelExtBin* model = new NvModelExtBin;
+	NvModelExtBin* NvModelExtBin::Create(const char* pFileName, bool mapData) {
 		if (NULL == ms_pLoader)
 		{
 			return NULL;
 		}
 
+		NvModelExtBin* model = new NvModelExtBin;
+
+		if (mapData)
+		{
+			// Map the file and let the sub-meshes reference it directly, the
+			// mapping is released by the loader that created it once the model dies
+			size_t length = 0;
+			char* pData = ms_pLoader->MapDataFromFile(pFileName, length);
+			if (NULL != pData)
+			{
+				model->m_pMappedData = pData;
+				model->m_mappedDataLength = length;
+				model->m_pMappedLoader = ms_pLoader;
+				if (!model->LoadFromPreprocessed((uint8_t*)pData))
+				{
+					delete model;
+					return NULL;
+				}
+				return model;
+			}
+			// Fall back to reading the file if the loader can't map it
+		}
+
 		// Use the provided loader callback to load the file into memory
 		char *pData = ms_pLoader->LoadDataFromFile(pFileName);
 		if (NULL == pData)
 		{
+			delete model;
 			return NULL;
 		}
 
@@ -68,6 +118,27 @@ namespace Nv
 		return model;
 	}
 
+    template <typename T>
+    T* NvModelExtBin::AcquireArray(uint8_t* pSrc, uint32_t count)
+    {
+        // The writer keeps every element 4-byte aligned, so mapped arrays can be
+        // used in place; copy anything that doesn't meet the alignment anyway
+        if ((NULL != m_pMappedData) && ((reinterpret_cast<uintptr_t>(pSrc) % sizeof(T)) == 0))
+        {
+            return reinterpret_cast<T*>(pSrc);
+        }
+
+        T* pDest = new T[count];
+        memcpy(pDest, pSrc, count * sizeof(T));
+        return pDest;
+    }
+
+    bool NvModelExtBin::IsMappedArray(const void* pArray) const
+    {
+        const char* p = static_cast<const char*>(pArray);
+        return (NULL != m_pMappedData) && (p >= m_pMappedData) && (p < m_pMappedData + m_mappedDataLength);
+    }
+
     // Helper function for reading in texture descriptions
     void ReadTextureDescs(NvModelTextureDesc* pSrcDescs, TextureDescArray& destArray, int32_t offset, int32_t count)
     {
@@ -156,12 +227,10 @@ namespace Nv
             pMesh->m_boneWeightOffset = -1;
             pMesh->m_bonesPerVertex = 0;
 
-			pMesh->m_vertices = new float[pMesh->m_vertSize * pMesh->m_vertexCount];
-			memcpy(pMesh->m_vertices, data + mhdr._vertArrayBase,
-				pMesh->m_vertSize * pMesh->m_vertexCount * sizeof(float));
-			pMesh->m_indices = new uint32_t[pMesh->m_indexCount];
-			memcpy(pMesh->m_indices, data + mhdr._indexArrayBase,
-				pMesh->m_indexCount * sizeof(uint32_t));
+			pMesh->m_vertices = AcquireArray<float>(data + mhdr._vertArrayBase,
+				pMesh->m_vertSize * pMesh->m_vertexCount);
+			pMesh->m_indices = AcquireArray<uint32_t>(data + mhdr._indexArrayBase,
+				pMesh->m_indexCount);
 			pMesh->m_materialId = mhdr._matIndex;
 		}
 
@@ -288,12 +357,10 @@ namespace Nv
             pMesh->m_boneWeightOffset = -1;
             pMesh->m_bonesPerVertex = 0;
 
-            pMesh->m_vertices = new float[pMesh->m_vertSize * pMesh->m_vertexCount];
-            memcpy(pMesh->m_vertices, data + mhdr._vertArrayBase,
-                pMesh->m_vertSize * pMesh->m_vertexCount * sizeof(float));
-            pMesh->m_indices = new uint32_t[pMesh->m_indexCount];
-            memcpy(pMesh->m_indices, data + mhdr._indexArrayBase,
-                pMesh->m_indexCount * sizeof(uint32_t));
+            pMesh->m_vertices = AcquireArray<float>(data + mhdr._vertArrayBase,
+                pMesh->m_vertSize * pMesh->m_vertexCount);
+            pMesh->m_indices = AcquireArray<uint32_t>(data + mhdr._indexArrayBase,
+                pMesh->m_indexCount);
             pMesh->m_materialId = mhdr._matIndex;
         }
 
@@ -551,13 +618,12 @@ namespace Nv
                 memcpy(&(pDestMesh->m_meshToBoneTransforms[0]), pBoneTransforms, boneTransformsSize);
             }
 
-            uint32_t vertBufferSize = pDestMesh->m_vertSize * pDestMesh->m_vertexCount * sizeof(float);
-            pDestMesh->m_vertices = new float[pDestMesh->m_vertSize * pDestMesh->m_vertexCount];
-            memcpy(pDestMesh->m_vertices, pMeshes + pSrcMesh->_vertArrayBase, vertBufferSize);
+            pDestMesh->m_vertices = AcquireArray<float>(pMeshes + pSrcMesh->_vertArrayBase,
+                pDestMesh->m_vertSize * pDestMesh->m_vertexCount);
             
             uint32_t indexBufferSize = pDestMesh->m_indexCount * sizeof(uint32_t);
-            pDestMesh->m_indices = new uint32_t[pDestMesh->m_indexCount];
-            memcpy(pDestMesh->m_indices, pMeshes + pSrcMesh->_indexArrayBase, indexBufferSize);
+            pDestMesh->m_indices = AcquireArray<uint32_t>(pMeshes + pSrcMesh->_indexArrayBase,
+                pDestMesh->m_indexCount);
 
             pMeshes += pSrcMesh->_indexArrayBase + indexBufferSize;
         }
@@ -603,13 +669,12 @@ namespace Nv
                 memcpy(&(pDestMesh->m_meshToBoneTransforms[0]), pBoneTransforms, boneTransformsSize);
             }
 
-            uint32_t vertBufferSize = pDestMesh->m_vertSize * pDestMesh->m_vertexCount * sizeof(float);
-            pDestMesh->m_vertices = new float[pDestMesh->m_vertSize * pDestMesh->m_vertexCount];
-            memcpy(pDestMesh->m_vertices, pMeshes + pSrcMesh->_vertArrayBase, vertBufferSize);
+            pDestMesh->m_vertices = AcquireArray<float>(pMeshes + pSrcMesh->_vertArrayBase,
+                pDestMesh->m_vertSize * pDestMesh->m_vertexCount);
 
             uint32_t indexBufferSize = pDestMesh->m_indexCount * sizeof(uint32_t);
-            pDestMesh->m_indices = new uint32_t[pDestMesh->m_indexCount];
-            memcpy(pDestMesh->m_indices, pMeshes + pSrcMesh->_indexArrayBase, indexBufferSize);
+            pDestMesh->m_indices = AcquireArray<uint32_t>(pMeshes + pSrcMesh->_indexArrayBase,
+                pDestMesh->m_indexCount);
 
             pMeshes += pSrcMesh->_indexArrayBase + indexBufferSize;
         }
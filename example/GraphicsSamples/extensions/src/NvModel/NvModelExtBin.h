@@ -48,7 +48,12 @@ namespace Nv
 	public:
 		virtual ~NvModelExtBin();
 
-		static NvModelExtBin* Create(const char* pFileName);
+		/// Creates a model from a preprocessed NVE file
+		/// \param[in] pFileName path/name of the NVE file data
+		/// \param[in] mapData if true, the file is mapped through the file loader and the
+		///            vertex and index arrays of the sub-meshes point into the mapping
+		/// \return a pointer to the new model or null if the file could not be read
+		static NvModelExtBin* Create(const char* pFileName, bool mapData = false);
 
 		/// Returns the number of meshes contained in the model
 		/// \return Number of meshes contained in the model
@@ -106,6 +111,11 @@ namespace Nv
         uint8_t* ReadMeshes_v3(uint8_t* pMeshes);
         uint8_t* ReadMeshes(uint8_t* pMeshes);
 
+        // Returns an array of count elements read from pSrc, either referencing the
+        // mapped file in place or as a new copy if the model isn't mapped
+        template <typename T>
+        T* AcquireArray(uint8_t* pSrc, uint32_t count);
+        bool IsMappedArray(const void* pArray) const;
 
 		Material* m_materials;
 		uint32_t m_materialCount;
@@ -116,6 +126,11 @@ namespace Nv
 		
 		SubMeshBin* m_subMeshes;
 		uint32_t m_meshCount;
+
+        // Mapping of the source file, kept alive for as long as the sub-meshes reference it
+        char* m_pMappedData;
+        size_t m_mappedDataLength;
+        NvModelFileLoader* m_pMappedLoader;
 	};
 }
 #endif // _NVMODELEXT_H_
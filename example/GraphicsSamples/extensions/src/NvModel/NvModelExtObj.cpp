@@ -38,6 +38,10 @@
 #include "NvModelMeshFace.h"
 #include "NvModelSubMeshObj.h"
 
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
 namespace Nv
 {
 // Debug helper to ignore all material definitions in the model
@@ -83,9 +87,10 @@ namespace Nv
 
 	NvModelExtObj* NvModelExtObj::Create(const char* filename, float scale, 
 		bool generateNormals, bool generateTangents,
-		float vertMergeThreshold, float normMergeThreshold, uint32_t initialVertCount)
+		float vertMergeThreshold, float normMergeThreshold, uint32_t initialVertCount, WeldMethod weldMethod)
 	{
 		NvModelExtObj* pModel = new NvModelExtObj(vertMergeThreshold, normMergeThreshold);
+		pModel->SetWeldMethod(weldMethod);
 		pModel->LoadObjFromFile(filename);
 		pModel->RescaleToOrigin(scale);
 		if (generateNormals)
@@ -108,7 +113,8 @@ namespace Nv
         m_numTexCoordComponents(2),
         m_normals(normMergeThreshold, initialVertCount),
         m_texCoords(0.00001f, initialVertCount),
-        m_tangents(0.00001f, initialVertCount)
+        m_tangents(0.00001f, initialVertCount),
+        m_processingThreadCount(0)
     {
         m_rawMaterials.reserve(32);
         m_subMeshes.reserve(32);
@@ -154,6 +160,17 @@ namespace Nv
         InitializeDefaultMaterial();
     }
 
+	void NvModelExtObj::SetWeldMethod(WeldMethod weldMethod)
+    {
+        ResetModel();
+
+        const bool bUseHashGrid = (WeldMethod_HashGrid == weldMethod);
+        m_positions.SetUseHashGrid(bUseHashGrid);
+        m_normals.SetUseHashGrid(bUseHashGrid);
+        m_texCoords.SetUseHashGrid(bUseHashGrid);
+        m_tangents.SetUseHashGrid(bUseHashGrid);
+    }
+
 	SubMesh* NvModelExtObj::GetSubMesh(uint32_t subMeshID)
 	{
 		return GetSubMeshObj(subMeshID);
@@ -187,6 +204,24 @@ namespace Nv
         return pSubmesh;
     }
 
+	uint32_t NvModelExtObj::GetMaterialId(const std::string& materialName)
+    {
+        // See if the material already exists
+        MaterialMap::iterator fIt = m_materialMap.find(materialName);
+        if (fIt != m_materialMap.end())
+        {
+            return fIt->second;
+        }
+
+        // We need to add the material
+        uint32_t materialId = uint32_t(m_rawMaterials.size());
+        m_materialMap[materialName] = materialId;
+
+        Material newMaterial;
+        m_rawMaterials.push_back(newMaterial);
+        return materialId;
+    }
+
 	bool NvModelExtObj::LoadObjFromFile(const char* pFileName)
     {
         if (NULL == ms_pLoader)
@@ -194,6 +229,16 @@ namespace Nv
             return false;
         }
 
+        // Prefer mapping the file, the chunk parser doesn't need a null terminated buffer
+        size_t length = 0;
+        char* pMapping = ms_pLoader->MapDataFromFile(pFileName, length);
+        if (NULL != pMapping)
+        {
+            bool result = LoadObjFromMemory(pMapping, length, 0);
+            ms_pLoader->UnmapData(pMapping, length);
+            return result;
+        }
+
         // Use the provided loader callback to load the file into memory
         char *pData = ms_pLoader->LoadDataFromFile(pFileName);
         if (NULL == pData)
@@ -201,7 +246,7 @@ namespace Nv
             return false;
         }
 
-        bool result = LoadObjFromMemory(pData);
+        bool result = LoadObjFromMemory(pData, strlen(pData), 0);
 
         // Free the OBJ buffer
         ms_pLoader->ReleaseData(pData);
@@ -758,23 +803,8 @@ namespace Nv
                     return false;
                 }
 
-                // See if the material already exists
-                MaterialMap::iterator fIt = m_materialMap.find(materialName);
-                if (fIt == m_materialMap.end())
-                {
-                    // We need to add the material
-                    currentMaterial = int32_t(m_rawMaterials.size());
-                    m_materialMap[materialName] = currentMaterial;
-
-                    Material newMaterial;
-                    m_rawMaterials.push_back(newMaterial);
-                }
-                else
-                {
-                    currentMaterial = fIt->second;
-                }
-
                 // Switch to the submesh that uses the active material
+                currentMaterial = int32_t(GetMaterialId(materialName));
                 currentSubMesh = GetSubMeshForMaterial(currentMaterial);
                 tok.consumeToEOL();
                 break;
@@ -795,6 +825,634 @@ namespace Nv
         return true;
     }
 
+    namespace
+    {
+        // Buffers smaller than this per thread are not worth splitting further
+        const size_t kMinObjChunkBytes = 256 * 1024;
+
+        // Positions or faces per thread below which generating their normals or tangents
+        // doesn't make up for starting the thread
+        const uint32_t kMinParallelRange = 8192;
+
+        inline bool IsObjWhitespace(const char c)
+        {
+            return (' ' == c || '\t' == c);
+        }
+
+        inline bool IsObjEOL(const char c)
+        {
+            return ('\n' == c || '\r' == c);
+        }
+
+        inline bool IsObjQuote(const char c)
+        {
+            return ('"' == c || '\'' == c);
+        }
+
+        // Skips whitespace and finds the end of the next word of the line, which is
+        // terminated by whitespace or an EOL.  Returns false at the end of the line.
+        inline bool NextObjWord(const char*& p, const char* pEnd, const char*& pWordEnd)
+        {
+            while (p != pEnd && IsObjWhitespace(*p))
+                ++p;
+            if (p == pEnd || IsObjEOL(*p))
+                return false;
+
+            pWordEnd = p;
+            while (pWordEnd != pEnd && !IsObjWhitespace(*pWordEnd) && !IsObjEOL(*pWordEnd))
+                ++pWordEnd;
+            return true;
+        }
+
+        // Returns the first '/' delimiter in the range, or its end if there is none
+        inline const char* FindObjDelim(const char* p, const char* pEnd)
+        {
+            while (p != pEnd && '/' != *p)
+                ++p;
+            return p;
+        }
+
+        // Converts a plain decimal number without the C locale.  Numbers with at most 19 significant
+        // digits, a mantissa up to 2^53 and a power of ten up to 22 are exactly representable as
+        // doubles, so a single multiply or divide rounds them like strtod() does.
+        // Returns false for any other form, which must be converted by strtod().
+        bool ParseObjDecimal(const char* p, const char* pEnd, float& out)
+        {
+            static const double kPowersOf10[] =
+            {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+
+            bool bNegative = false;
+            if (p != pEnd && ('-' == *p || '+' == *p))
+                bNegative = ('-' == *p++);
+
+            uint64_t mantissa = 0;
+            int32_t significantDigits = 0;
+            int32_t exponent = 0;
+            bool bHasDigits = false;
+            bool bFraction = false;
+            for (; p != pEnd; ++p)
+            {
+                if ('.' == *p && !bFraction)
+                {
+                    bFraction = true;
+                    continue;
+                }
+                if (*p < '0' || *p > '9')
+                    break;
+
+                bHasDigits = true;
+                if (0 != mantissa || '0' != *p)
+                {
+                    if (++significantDigits > 19)
+                        return false;
+                    mantissa = mantissa * 10 + uint64_t(*p - '0');
+                }
+                if (bFraction)
+                    --exponent;
+            }
+            if (!bHasDigits)
+                return false;
+
+            if (p != pEnd && ('e' == *p || 'E' == *p))
+            {
+                ++p;
+                bool bNegativeExponent = false;
+                if (p != pEnd && ('-' == *p || '+' == *p))
+                    bNegativeExponent = ('-' == *p++);
+
+                const char* pDigits = p;
+                int32_t value = 0;
+                for (; p != pEnd && *p >= '0' && *p <= '9'; ++p)
+                {
+                    if (value > 1000)
+                        return false;
+                    value = value * 10 + int32_t(*p - '0');
+                }
+                if (p == pDigits)
+                    return false;
+                exponent += bNegativeExponent ? -value : value;
+            }
+            if (p != pEnd)
+                return false;
+
+            if (0 == mantissa)
+            {
+                out = bNegative ? -0.0f : 0.0f;
+                return true;
+            }
+            if (mantissa > (uint64_t(1) << 53) || exponent < -22 || exponent > 22)
+                return false;
+
+            double value = double(mantissa);
+            value = (exponent < 0) ? (value / kPowersOf10[-exponent]) : (value * kPowersOf10[exponent]);
+            out = float(bNegative ? -value : value);
+            return true;
+        }
+
+        // Converts a float token to the same value as the tokenizer
+        inline float ParseObjFloat(const char* p, const char* pEnd)
+        {
+            float value;
+            if (ParseObjDecimal(p, pEnd, value))
+                return value;
+            return (float)strtod(std::string(p, pEnd).c_str(), NULL);
+        }
+
+        // Converts an integer token to the same value as the tokenizer, which uses base 0,
+        // so only decimal numbers without a leading zero are converted directly
+        int32_t ParseObjInt(const char* p, const char* pEnd)
+        {
+            const char* pDigits = p;
+            bool bNegative = false;
+            if (pDigits != pEnd && ('-' == *pDigits || '+' == *pDigits))
+                bNegative = ('-' == *pDigits++);
+
+            const ptrdiff_t digitCount = pEnd - pDigits;
+            if (digitCount > 0 && digitCount < 10 && ('0' != *pDigits || 1 == digitCount))
+            {
+                int32_t value = 0;
+                for (; pDigits != pEnd && *pDigits >= '0' && *pDigits <= '9'; ++pDigits)
+                    value = value * 10 + int32_t(*pDigits - '0');
+                if (pDigits == pEnd)
+                    return bNegative ? -value : value;
+            }
+            return (int32_t)strtol(std::string(p, pEnd).c_str(), NULL, 0);
+        }
+
+        // Calls func(begin, end) on contiguous ranges of [0, count), one per thread, and waits for
+        // them.  The threads are started for each call, which is only made twice per model, and only
+        // if each gets at least kMinParallelRange items, otherwise func runs on the calling thread.
+        template <typename Func>
+        void ParallelForRanges(uint32_t count, uint32_t threadCount, const Func& func)
+        {
+            if (0 == threadCount)
+            {
+                threadCount = std::max(1u, std::thread::hardware_concurrency());
+            }
+            threadCount = std::min(threadCount, count / kMinParallelRange);
+            if (threadCount <= 1)
+            {
+                func(0, count);
+                return;
+            }
+
+            std::vector<std::thread> threads;
+            threads.reserve(threadCount - 1);
+            for (uint32_t i = 1; i < threadCount; ++i)
+            {
+                const uint32_t begin = uint32_t(uint64_t(count) * i / threadCount);
+                const uint32_t end = uint32_t(uint64_t(count) * (i + 1) / threadCount);
+                threads.push_back(std::thread([&func, begin, end]() { func(begin, end); }));
+            }
+            func(0, uint32_t(uint64_t(count) / threadCount));
+
+            for (size_t i = 0; i < threads.size(); ++i)
+            {
+                threads[i].join();
+            }
+        }
+    }
+
+    struct NvModelExtObj::ObjChunk
+    {
+        enum StatementType
+        {
+            Statement_Positions,
+            Statement_Normals,
+            Statement_TexCoords,
+            Statement_Face,
+            Statement_SmoothingGroup,
+            Statement_MaterialLib,
+            Statement_UseMaterial
+        };
+
+        // A face or material statement, or a run of consecutive vertex components
+        struct Statement
+        {
+            uint8_t m_type;
+            uint8_t m_format;   // OBJFaceFormat of a face
+            uint32_t m_value;   // Component or face vertex count, smoothing group or name index
+        };
+
+        ObjChunk() : m_bParsed(false) {}
+
+        void AddStatement(StatementType type, uint32_t value, OBJFaceFormat format = Face_Invalid)
+        {
+            Statement statement = { uint8_t(type), uint8_t(format), value };
+            m_statements.push_back(statement);
+        }
+
+        void AddComponent(StatementType type)
+        {
+            if (!m_statements.empty() && m_statements.back().m_type == type)
+                ++m_statements.back().m_value;
+            else
+                AddStatement(type, 1);
+        }
+
+        std::vector<Statement> m_statements;
+        std::vector<nv::vec3f> m_positions;
+        std::vector<nv::vec3f> m_normals;
+        std::vector<nv::vec3f> m_texCoords;
+        std::vector<int32_t> m_indices;     // OBJ indices of the components of each face vertex
+        std::vector<std::string> m_names;   // Material and material library names
+        bool m_bParsed;
+    };
+
+    bool NvModelExtObj::ParseObjChunk(const char* p, const char* pEnd, ObjChunk& chunk)
+    {
+        chunk.m_statements.reserve((pEnd - p) / 64);
+
+        // A line is only parsed if it would be read the same by the tokenizer, so quoted
+        // tokens or delimiters anywhere else than between face indices fail the chunk.
+        const char* pWordEnd = NULL;
+        while (p != pEnd)
+        {
+            if (NextObjWord(p, pEnd, pWordEnd) && '/' != *p)
+            {
+                const char* pArgs = pWordEnd;
+                const char* pArgEnd = NULL;
+                if (IsObjQuote(*p))
+                {
+                    return false;
+                }
+
+                switch (*p)
+                {
+                case 'v':
+                {
+                    // The type is the character after the 'v' of the first token, which ends at a delimiter
+                    const char* pKeyEnd = FindObjDelim(p, pWordEnd);
+                    const char type = (pKeyEnd - p > 1) ? p[1] : '\0';
+                    if ('\0' != type && 'n' != type && 't' != type)
+                    {
+                        // Parameter space vertices not supported...
+                        break;
+                    }
+                    if (pKeyEnd != pWordEnd)
+                    {
+                        return false;
+                    }
+
+                    // Read up to as many components as the tokenizer loader, the rest of the line is ignored
+                    float values[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                    const uint32_t maxCount = ('\0' == type) ? 4 : 3;
+                    uint32_t compCount = 0;
+                    while (compCount < maxCount && NextObjWord(pArgs, pEnd, pArgEnd))
+                    {
+                        if (IsObjQuote(*pArgs) || FindObjDelim(pArgs, pArgEnd) != pArgEnd)
+                        {
+                            return false;
+                        }
+                        values[compCount++] = ParseObjFloat(pArgs, pArgEnd);
+                        pArgs = pArgEnd;
+                    }
+
+                    if ('\0' == type)
+                    {
+                        if (compCount < 3)
+                        {
+                            return false;
+                        }
+                        chunk.m_positions.push_back(nv::vec3f(values[0], values[1], values[2]));
+                        chunk.AddComponent(ObjChunk::Statement_Positions);
+                    }
+                    else if ('n' == type)
+                    {
+                        if (compCount != 3)
+                        {
+                            return false;
+                        }
+                        chunk.m_normals.push_back(nv::vec3f(values[0], values[1], values[2]));
+                        chunk.AddComponent(ObjChunk::Statement_Normals);
+                    }
+                    else
+                    {
+                        if (compCount < 2)
+                        {
+                            return false;
+                        }
+                        chunk.m_texCoords.push_back(nv::vec3f(values[0], values[1], values[2]));
+                        chunk.AddComponent(ObjChunk::Statement_TexCoords);
+                    }
+                    break;
+                }
+                case 'f':
+                {
+                    if (FindObjDelim(p, pWordEnd) != pWordEnd)
+                    {
+                        return false;
+                    }
+
+                    // Every vertex must use the format of the first one, the tokenizer loader
+                    // ends the face or fails at a vertex that doesn't
+                    OBJFaceFormat format = Face_Invalid;
+                    uint32_t vertexCount = 0;
+                    while (NextObjWord(pArgs, pEnd, pArgEnd))
+                    {
+                        // Split the #, #/#, #/#/# or #//# vertex into its indices
+                        const char* indices[3][2] = { { pArgs, pArgEnd } };
+                        uint32_t indexCount = 1;
+                        OBJFaceFormat vertexFormat = Face_PosOnly;
+                        const char* pDelim = FindObjDelim(pArgs, pArgEnd);
+                        if (pDelim != pArgEnd)
+                        {
+                            indices[0][1] = pDelim;
+                            const char* pSecondDelim = FindObjDelim(pDelim + 1, pArgEnd);
+                            if (pSecondDelim == pArgEnd)
+                            {
+                                vertexFormat = Face_PosTex;
+                                indices[indexCount][0] = pDelim + 1;
+                                indices[indexCount++][1] = pArgEnd;
+                            }
+                            else
+                            {
+                                vertexFormat = (pSecondDelim == pDelim + 1) ? Face_PosNormal : Face_PosTexNormal;
+                                if (Face_PosTexNormal == vertexFormat)
+                                {
+                                    indices[indexCount][0] = pDelim + 1;
+                                    indices[indexCount++][1] = pSecondDelim;
+                                }
+                                indices[indexCount][0] = pSecondDelim + 1;
+                                indices[indexCount++][1] = pArgEnd;
+                            }
+                        }
+
+                        if (Face_Invalid == format)
+                        {
+                            format = vertexFormat;
+                        }
+                        if (format != vertexFormat)
+                        {
+                            return false;
+                        }
+
+                        for (uint32_t i = 0; i < indexCount; ++i)
+                        {
+                            const char* pIndex = indices[i][0];
+                            const char* pIndexEnd = indices[i][1];
+                            if (pIndex == pIndexEnd || IsObjQuote(*pIndex) || FindObjDelim(pIndex, pIndexEnd) != pIndexEnd)
+                            {
+                                return false;
+                            }
+                            chunk.m_indices.push_back(ParseObjInt(pIndex, pIndexEnd));
+                        }
+                        ++vertexCount;
+                        pArgs = pArgEnd;
+                    }
+
+                    if (vertexCount < 2)
+                    {
+                        return false;
+                    }
+                    chunk.AddStatement(ObjChunk::Statement_Face, vertexCount, format);
+                    break;
+                }
+                case 's':
+                case 'm':
+                case 'u':
+                {
+                    // smoothing group, mtllib or usemtl, followed by a single token
+                    if (FindObjDelim(p, pWordEnd) != pWordEnd || !NextObjWord(pArgs, pEnd, pArgEnd))
+                    {
+                        return false;
+                    }
+                    pArgEnd = FindObjDelim(pArgs, pArgEnd);
+                    if (pArgs == pArgEnd || IsObjQuote(*pArgs))
+                    {
+                        return false;
+                    }
+
+                    if ('s' == *p)
+                    {
+                        chunk.AddStatement(ObjChunk::Statement_SmoothingGroup, uint32_t(ParseObjInt(pArgs, pArgEnd)));
+                    }
+                    else
+                    {
+                        chunk.AddStatement(('m' == *p) ? ObjChunk::Statement_MaterialLib : ObjChunk::Statement_UseMaterial,
+                            uint32_t(chunk.m_names.size()));
+                        chunk.m_names.push_back(std::string(pArgs, pArgEnd));
+                    }
+                    break;
+                }
+                default:
+                    // comments, groups and objects are ignored
+                    break;
+                }
+            }
+
+            // consume to the next line
+            while (p != pEnd && !IsObjEOL(*p))
+                ++p;
+            while (p != pEnd && IsObjEOL(*p))
+                ++p;
+        }
+
+        return true;
+    }
+
+	bool NvModelExtObj::LoadObjFromMemory(const char* pLoadData, size_t length, uint32_t threadCount)
+    {
+        // The tokenizer stops at the first null character
+        const char* pNull = (const char*)memchr(pLoadData, 0, length);
+        if (NULL != pNull)
+        {
+            length = size_t(pNull - pLoadData);
+        }
+        const char* pLoadEnd = pLoadData + length;
+
+#if DEBUG_SMOOTHING_AS_MATS
+        // Smoothing groups are only turned into materials by the tokenizer
+        return LoadObjFromMemory(std::string(pLoadData, length).c_str());
+#endif
+
+        if (0 == threadCount)
+        {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threadCount = uint32_t(std::min<size_t>(threadCount, length / kMinObjChunkBytes + 1));
+
+        // Split the buffer after line ends, so that each chunk holds complete lines
+        std::vector<const char*> bounds(threadCount + 1, pLoadEnd);
+        bounds[0] = pLoadData;
+        for (uint32_t i = 1; i < threadCount; ++i)
+        {
+            const char* pSplit = std::max(bounds[i - 1], pLoadData + length / threadCount * i);
+            const char* pEOL = (const char*)memchr(pSplit, '\n', size_t(pLoadEnd - pSplit));
+            bounds[i] = (NULL != pEOL) ? (pEOL + 1) : pLoadEnd;
+        }
+
+        // Parse the chunks on worker threads, this one parsing the first
+        std::vector<ObjChunk> chunks(threadCount);
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount - 1);
+        for (uint32_t i = 1; i < threadCount; ++i)
+        {
+            threads.push_back(std::thread([&chunks, &bounds, i]() {
+                chunks[i].m_bParsed = ParseObjChunk(bounds[i], bounds[i + 1], chunks[i]);
+            }));
+        }
+        chunks[0].m_bParsed = ParseObjChunk(bounds[0], bounds[1], chunks[0]);
+
+        bool bParsed = chunks[0].m_bParsed;
+        for (uint32_t i = 1; i < threadCount; ++i)
+        {
+            threads[i - 1].join();
+            bParsed &= chunks[i].m_bParsed;
+        }
+
+        if (!bParsed)
+        {
+            // Use a null terminated copy, the buffer may be a mapped file
+            chunks.clear();
+            return LoadObjFromMemory(std::string(pLoadData, length).c_str());
+        }
+
+        // Build the meshes in file order, exactly like the tokenizer loader does
+        int32_t currentMaterial = 0;
+        int32_t currentSmoothingGroup = 0;
+        SubMeshObj* currentSubMesh = GetSubMeshForMaterial(0);
+
+        bool bHas3CompTex = false;
+        bool bBoundingBoxInitialized = false;
+        int32_t nextPosIndex = 0;
+        int32_t nextNormalIndex = 0;
+        int32_t nextTexCoordIndex = 0;
+
+        for (std::vector<ObjChunk>::const_iterator chunkIt = chunks.begin(); chunkIt != chunks.end(); ++chunkIt)
+        {
+            const ObjChunk& chunk = *chunkIt;
+            const nv::vec3f* pPosition = chunk.m_positions.data();
+            const nv::vec3f* pNormal = chunk.m_normals.data();
+            const nv::vec3f* pTexCoord = chunk.m_texCoords.data();
+            const int32_t* pIndex = chunk.m_indices.data();
+
+            for (std::vector<ObjChunk::Statement>::const_iterator it = chunk.m_statements.begin();
+                it != chunk.m_statements.end(); ++it)
+            {
+                const ObjChunk::Statement& statement = *it;
+                switch (statement.m_type)
+                {
+                case ObjChunk::Statement_Positions:
+                {
+                    for (uint32_t i = 0; i < statement.m_value; ++i, ++pPosition)
+                    {
+                        nv::vec4f pos(pPosition->x, pPosition->y, pPosition->z, 1.0f);
+                        if (bBoundingBoxInitialized)
+                        {
+                            // Grow our bounding box, if necessary
+                            m_boundingBoxMin = nv::min(m_boundingBoxMin, (nv::vec3f)pos);
+                            m_boundingBoxMax = nv::max(m_boundingBoxMax, (nv::vec3f)pos);
+                        }
+                        else
+                        {
+                            // Make sure that our bounding box starts out with a valid, contained point
+                            m_boundingBoxMin = (nv::vec3f)pos;
+                            m_boundingBoxMax = (nv::vec3f)pos;
+                            bBoundingBoxInitialized = true;
+                        }
+
+                        int32_t index = m_positions.Append(pos);
+                        NV_ASSERT(index != -1);
+                        ++nextPosIndex;
+                    }
+                    break;
+                }
+                case ObjChunk::Statement_Normals:
+                {
+                    for (uint32_t i = 0; i < statement.m_value; ++i, ++pNormal)
+                    {
+                        int32_t index = m_normals.Append(*pNormal);
+                        NV_ASSERT(index != -1);
+                        ++nextNormalIndex;
+                    }
+                    break;
+                }
+                case ObjChunk::Statement_TexCoords:
+                {
+                    for (uint32_t i = 0; i < statement.m_value; ++i, ++pTexCoord)
+                    {
+                        // A third coordinate that is all 0s doesn't count as a component
+                        bHas3CompTex |= !((pTexCoord->z > -0.0001f) && (pTexCoord->z < 0.0001f));
+                        int32_t index = m_texCoords.Append(*pTexCoord);
+                        NV_ASSERT(index != -1);
+                        ++nextTexCoordIndex;
+                    }
+                    break;
+                }
+                case ObjChunk::Statement_Face:
+                {
+                    MeshFace face;
+                    MeshVertex vert;
+
+                    face.m_material = uint32_t(currentMaterial);
+                    face.m_smoothingGroup = currentSmoothingGroup;
+                    face.m_pSubMesh = currentSubMesh;
+
+                    // Create a triangle fan of the vertices, generating the face normal
+                    // once if the face doesn't define normals
+                    const OBJFaceFormat format = OBJFaceFormat(statement.m_format);
+                    const bool bHasTexCoord = (Face_PosTex == format) || (Face_PosTexNormal == format);
+                    const bool bHasNormal = (Face_PosTexNormal == format) || (Face_PosNormal == format);
+                    bool bGeneratedFaceNormal = bHasNormal;
+                    for (uint32_t i = 0; i < statement.m_value; ++i)
+                    {
+                        vert.m_pos = m_positions.Remap(RemapObjIndex(*pIndex++, nextPosIndex));
+                        if (bHasTexCoord)
+                        {
+                            vert.m_texcoord = m_texCoords.Remap(RemapObjIndex(*pIndex++, nextTexCoordIndex));
+                        }
+                        if (bHasNormal)
+                        {
+                            vert.m_normal = m_normals.Remap(RemapObjIndex(*pIndex++, nextNormalIndex));
+                        }
+
+                        if (i < 2)
+                        {
+                            face.m_verts[i] = currentSubMesh->FindOrAddVertex(vert);
+                            continue;
+                        }
+                        face.m_verts[2] = currentSubMesh->FindOrAddVertex(vert);
+
+                        if (!bGeneratedFaceNormal)
+                        {
+                            face.CalculateFaceNormal(m_positions.GetVectors());
+                            bGeneratedFaceNormal = true;
+                        }
+
+                        currentSubMesh->m_rawFaces.push_back(face);
+                        face.m_verts[1] = face.m_verts[2];
+                    }
+                    break;
+                }
+                case ObjChunk::Statement_SmoothingGroup:
+                    currentSmoothingGroup = int32_t(statement.m_value);
+                    break;
+                case ObjChunk::Statement_MaterialLib:
+                    // Load the material library so that subsequent faces can use the materials it defines
+                    LoadMaterialLibraryFromFile(chunk.m_names[statement.m_value]);
+                    break;
+                case ObjChunk::Statement_UseMaterial:
+                    // Switch to the submesh that uses the active material
+                    currentMaterial = int32_t(GetMaterialId(chunk.m_names[statement.m_value]));
+                    currentSubMesh = GetSubMeshForMaterial(currentMaterial);
+                    break;
+                }
+            }
+        }
+
+        // The w component of positions is never kept by the tokenizer loader either
+        m_numPositionComponents = 3;
+        m_numTexCoordComponents = bHas3CompTex ? 3 : 2;
+
+        OptimizeModel();
+
+        return true;
+    }
+
 	void NvModelExtObj::OptimizeModel()
     {
         RemoveEmptySubmeshes();
@@ -1377,15 +2035,12 @@ namespace Nv
         // Every position will generate at least one normal, but possibly more,
         // depending on smoothing groups and other discontinuities.
         // Start by building up a mapping from each position to every 
-        // Face/Vertex that references it, divided by smoothing group.
+        // Face/Vertex that references it, with a counting sort that keeps
+        // them in face order.
         uint32_t numPositions = m_positions.GetVectorCount();
         m_normals.Reserve(numPositions);  // Avoid re-allocations the best we can
 
-        VertexFaces vertexReferences;
-        vertexReferences.resize(numPositions);
-
-        // Iterate over all submeshes and process their faces, adding references to each
-        // vertex that the face refers to
+        std::vector<uint32_t> referenceStarts(numPositions + 1, 0);
         std::vector<SubMeshObj*>::const_iterator smEnd = m_subMeshes.end();
 		for (std::vector<SubMeshObj*>::iterator smIt = m_subMeshes.begin(); smIt != smEnd; ++smIt)
         {
@@ -1395,115 +2050,145 @@ namespace Nv
             std::vector<MeshFace>::const_iterator faceEnd = faces.end();
             for (std::vector<MeshFace>::iterator faceIt = faces.begin(); faceIt != faceEnd; ++faceIt)
             {
-                MeshFace* pFace = &(*faceIt);
                 for (uint32_t vIndex = 0; vIndex < 3; ++vIndex)
                 {
-                    // Get the index of the vertex
-                    uint32_t posIndex = pSubMesh->m_srcVertices[pFace->m_verts[vIndex]].m_pos;
+                    uint32_t posIndex = pSubMesh->m_srcVertices[faceIt->m_verts[vIndex]].m_pos;
                     NV_ASSERT(posIndex < numPositions);
+                    ++referenceStarts[posIndex + 1];
+                }
+            }
+        }
+        for (uint32_t i = 0; i < numPositions; ++i)
+        {
+            referenceStarts[i + 1] += referenceStarts[i];
+        }
 
-                    // Find the face group for the smoothing group that the face belongs to, creating
-                    // a new one if one doesn't already exist.
-                    FaceGroups& faceGroups = vertexReferences[posIndex];
-                    ReferringFaceGroup* pGroup = NULL;
-
-                    FaceGroups::const_iterator faceGroupEnd = faceGroups.end();
-                    for (FaceGroups::iterator faceGroupIt = faceGroups.begin(); faceGroupIt != faceGroupEnd; ++faceGroupIt)
-                    {
-                        if (faceGroupIt->m_smoothingGroup == pFace->m_smoothingGroup)
-                        {
-                            // found one
-                            pGroup = &(*faceGroupIt);
-                            break;
-                        }
-                    }
-                    if (pGroup == NULL)
-                    {
-                        faceGroups.resize(faceGroups.size() + 1);
-                        pGroup = &(faceGroups.back());
-                        pGroup->m_smoothingGroup = pFace->m_smoothingGroup;
-                    }
+        std::vector<FaceVert> references(referenceStarts.back());
+        std::vector<uint32_t> referenceEnds(referenceStarts.begin(), referenceStarts.end() - 1);
+		for (std::vector<SubMeshObj*>::iterator smIt = m_subMeshes.begin(); smIt != smEnd; ++smIt)
+        {
+			SubMeshObj* pSubMesh = *smIt;
+            std::vector<MeshFace>& faces = pSubMesh->m_rawFaces;
 
-                    pGroup->m_referringFaces.push_back(ReferringFaceGroup::FaceVert(pFace, vIndex));
+            std::vector<MeshFace>::const_iterator faceEnd = faces.end();
+            for (std::vector<MeshFace>::iterator faceIt = faces.begin(); faceIt != faceEnd; ++faceIt)
+            {
+                MeshFace* pFace = &(*faceIt);
+                for (uint32_t vIndex = 0; vIndex < 3; ++vIndex)
+                {
+                    uint32_t posIndex = pSubMesh->m_srcVertices[pFace->m_verts[vIndex]].m_pos;
+                    references[referenceEnds[posIndex]++] = FaceVert(pFace, vIndex);
                 }
             }
         }
 
-        // Mapping of positions to MeshVertex is complete.  Now iterate over all of these mappings
-        // and generate normals, associating them with the appropriate MeshVertices.
+        // Divide the references of each position by smoothing group, in the order the groups first
+        // appear, and average the normal of each group.  Positions are independent, so this is done
+        // in parallel, with the same summation order as one position at a time.
         const NvModelVectorCompactor<nv::vec4f>::Positions::VecArray& positions = m_positions.GetVectors();
+        std::vector<ReferringFaceGroup> groups(references.size());
 
-        VertexFaces::const_iterator vfEnd = vertexReferences.end();
-        for (VertexFaces::iterator vfIt = vertexReferences.begin(); vfIt != vfEnd; ++vfIt)
+        ParallelForRanges(numPositions, m_processingThreadCount, [&](uint32_t begin, uint32_t end)
         {
-            FaceGroups& faceGroups = (*vfIt);
-            FaceGroups::const_iterator fgEnd = faceGroups.end();
-            for (FaceGroups::iterator fgIt = faceGroups.begin(); fgIt != fgEnd; ++fgIt)
+            std::vector<FaceVert> positionReferences;
+            std::vector<uint32_t> smoothingGroups;
+            for (uint32_t posIndex = begin; posIndex < end; ++posIndex)
             {
-                // For each smoothing group of faces, we need to generate an averaged normal, except for
-                // smoothing group 0, which is the "smoothing off" group
-                ReferringFaceGroup& group = (*fgIt);
-                if (group.m_smoothingGroup > 0)
-                {
-                    nv::vec3f normal(0.0f, 0.0f, 0.0f);
+                const uint32_t referenceStart = referenceStarts[posIndex];
+                const uint32_t referenceEnd = referenceStarts[posIndex + 1];
+                positionReferences.assign(references.begin() + referenceStart, references.begin() + referenceEnd);
 
-                    ReferringFaceGroup::FaceVerts& faces = group.m_referringFaces;
-                    ReferringFaceGroup::FaceVerts::const_iterator fvEnd = faces.end();
-                    if (faces.size() == 1)
+                smoothingGroups.resize(0);
+                for (uint32_t i = 0; i < positionReferences.size(); ++i)
+                {
+                    const uint32_t smoothingGroup = positionReferences[i].first->m_smoothingGroup;
+                    if (std::find(smoothingGroups.begin(), smoothingGroups.end(), smoothingGroup) == smoothingGroups.end())
                     {
-                        // Only one face in this group, so just re-use its face normal
-                        normal = faces.front().first->m_faceNormal;
+                        smoothingGroups.push_back(smoothingGroup);
                     }
-                    else
+                }
+
+                uint32_t groupStart = referenceStart;
+                for (uint32_t g = 0; g < smoothingGroups.size(); ++g)
+                {
+                    uint32_t groupEnd = groupStart;
+                    for (uint32_t i = 0; i < positionReferences.size(); ++i)
                     {
-                        // Sum up the face normals of each face, where each is weighted by an appropriate factor
-                        for (ReferringFaceGroup::FaceVerts::iterator fvIt = faces.begin(); fvIt != fvEnd; ++fvIt)
+                        if (positionReferences[i].first->m_smoothingGroup == smoothingGroups[g])
                         {
-                            MeshFace* pFace = fvIt->first;
-                            NV_ASSERT(NULL != pFace);
-                            normal += (pFace->GetFaceWeight(positions, fvIt->second) * pFace->m_faceNormal);
+                            references[groupEnd++] = positionReferences[i];
                         }
                     }
 
-                    // Unitize the normal and add it to the shared list
-                    float normalLen = length(normal);
-                    if (normalLen > 0.0000001)
-                    {
-                        normal *= 1.0f / normalLen;
-                    }
-                    else
-                    {
-                        // It's a zero-vector, so give it a default value in the positive y so that it's usable, if not correct
-                        normal.y = 1.0f;
-                    }
-                    uint32_t normalIndex = m_normals.Append(normal);
+                    ReferringFaceGroup& group = groups[groupStart];
+                    group.m_end = groupEnd;
+                    group.m_smoothingGroup = smoothingGroups[g];
 
-                    // Now point all of those face vertices to their new normal
-                    for (ReferringFaceGroup::FaceVerts::iterator fvIt = faces.begin(); fvIt != fvEnd; ++fvIt)
+                    // For each smoothing group of faces, we need to generate an averaged normal, except for
+                    // smoothing group 0, which is the "smoothing off" group
+                    if (group.m_smoothingGroup > 0)
                     {
-                        MeshFace* pFace = fvIt->first;
-                        NV_ASSERT(NULL != pFace);
-                        SubMeshObj* pSubMesh = pFace->m_pSubMesh;
-                        NV_ASSERT(NULL != pSubMesh);
-                        int32_t newVertIndex = pSubMesh->SetNormal(pFace->m_verts[fvIt->second], normalIndex);
-                        pFace->m_verts[fvIt->second] = newVertIndex;
+                        nv::vec3f normal(0.0f, 0.0f, 0.0f);
+                        if (groupEnd - groupStart == 1)
+                        {
+                            // Only one face in this group, so just re-use its face normal
+                            normal = references[groupStart].first->m_faceNormal;
+                        }
+                        else
+                        {
+                            // Sum up the face normals of each face, where each is weighted by an appropriate factor
+                            for (uint32_t i = groupStart; i < groupEnd; ++i)
+                            {
+                                const MeshFace* pFace = references[i].first;
+                                normal += (pFace->GetFaceWeight(positions, references[i].second) * pFace->m_faceNormal);
+                            }
+                        }
+
+                        // Unitize the normal
+                        float normalLen = length(normal);
+                        if (normalLen > 0.0000001)
+                        {
+                            normal *= 1.0f / normalLen;
+                        }
+                        else
+                        {
+                            // It's a zero-vector, so give it a default value in the positive y so that it's usable, if not correct
+                            normal.y = 1.0f;
+                        }
+                        group.m_normal = normal;
                     }
+                    groupStart = groupEnd;
                 }
-                else
+            }
+        });
+
+        // Add the normals to the shared list and point the face vertices to them, in order
+        for (uint32_t posIndex = 0; posIndex < numPositions; ++posIndex)
+        {
+            for (uint32_t groupStart = referenceStarts[posIndex]; groupStart < referenceStarts[posIndex + 1];)
+            {
+                const ReferringFaceGroup& group = groups[groupStart];
+                uint32_t normalIndex = 0;
+                if (group.m_smoothingGroup > 0)
+                {
+                    normalIndex = m_normals.Append(group.m_normal);
+                }
+
+                for (uint32_t i = groupStart; i < group.m_end; ++i)
                 {
-                    // For each face, add their face normal to the set of normals and point the vertex to it
-                    ReferringFaceGroup::FaceVerts::const_iterator fvEnd = group.m_referringFaces.end();
-                    for (ReferringFaceGroup::FaceVerts::iterator fvIt = group.m_referringFaces.begin(); fvIt != fvEnd; ++fvIt)
+                    MeshFace* pFace = references[i].first;
+                    NV_ASSERT(NULL != pFace);
+                    SubMeshObj* pSubMesh = pFace->m_pSubMesh;
+                    NV_ASSERT(NULL != pSubMesh);
+                    if (0 == group.m_smoothingGroup)
                     {
-                        MeshFace* pFace = fvIt->first;
-                        NV_ASSERT(NULL != pFace);
-                        SubMeshObj* pSubMesh = pFace->m_pSubMesh;
-                        NV_ASSERT(NULL != pSubMesh);
-                        uint32_t normalIndex = m_normals.Append(pFace->m_faceNormal);
-                        int32_t newVertIndex = pSubMesh->SetNormal(pFace->m_verts[fvIt->second], normalIndex);
-                        pFace->m_verts[fvIt->second] = newVertIndex;
+                        // Without smoothing, each face vertex uses its face normal
+                        normalIndex = m_normals.Append(pFace->m_faceNormal);
                     }
+                    int32_t newVertIndex = pSubMesh->SetNormal(pFace->m_verts[references[i].second], normalIndex);
+                    pFace->m_verts[references[i].second] = newVertIndex;
                 }
+                groupStart = group.m_end;
             }
         }
     }
@@ -1533,8 +2218,8 @@ namespace Nv
             }
         }
 
-        // Iterate over all the vertices in all the faces in all the submeshes and calculate 
-        // tangent vectors for each of them.
+        // Gather all the faces in all the submeshes that can have tangents
+        std::vector<MeshFace*> tangentFaces;
 		std::vector<SubMeshObj*>::const_iterator smEnd = m_subMeshes.end();
 		for (std::vector<SubMeshObj*>::iterator smIt = m_subMeshes.begin(); smIt != smEnd; ++smIt)
         {
@@ -1550,65 +2235,89 @@ namespace Nv
             std::vector<MeshFace>::const_iterator faceEnd = faces.end();
             for (std::vector<MeshFace>::iterator faceIt = faces.begin(); faceIt != faceEnd; ++faceIt)
             {
-                MeshFace* pFace = &(*faceIt);
-				SubMeshObj* pSubMesh = pFace->m_pSubMesh;
-				const SubMeshObj::MeshVertexArray& verts = pSubMesh->m_srcVertices;
+                tangentFaces.push_back(&(*faceIt));
+            }
+        }
 
-                // We'll need all three positions and all three UV sets to calculate
-                // each tangent, so go ahead and load them all once.
-                nv::vec4f positions[3];
-                m_positions.GetObject(verts[pFace->m_verts[0]].m_pos, positions[0]);
-                m_positions.GetObject(verts[pFace->m_verts[1]].m_pos, positions[1]);
-                m_positions.GetObject(verts[pFace->m_verts[2]].m_pos, positions[2]);
+        // The tangents of each face only depend on its own vertices, so calculate them in parallel
+        const uint32_t faceCount = uint32_t(tangentFaces.size());
+        std::vector<nv::vec3f> tangents(3 * faceCount);
+        ParallelForRanges(faceCount, m_processingThreadCount, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                CalculateFaceTangents(*tangentFaces[i], &tangents[3 * i]);
+            }
+        });
 
-                nv::vec3f uvs[3];
-                m_texCoords.GetObject(verts[pFace->m_verts[0]].m_texcoord, uvs[0]);
-                m_texCoords.GetObject(verts[pFace->m_verts[1]].m_texcoord, uvs[1]);
+        // Add the tangents to the shared list and point the face vertices to them, in order
+        for (uint32_t i = 0; i < faceCount; ++i)
+        {
+            MeshFace* pFace = tangentFaces[i];
+            SubMeshObj* pSubMesh = pFace->m_pSubMesh;
+            for (uint32_t vIndex = 0; vIndex < 3; ++vIndex)
+            {
+                uint32_t tangentIndex = m_tangents.Append(tangents[3 * i + vIndex]);
+                int32_t newVertIndex = pSubMesh->SetTangent(pFace->m_verts[vIndex], tangentIndex);
+                pFace->m_verts[vIndex] = newVertIndex;
+            }
+        }
+    }
 
-                for (uint32_t vIndex = 0; vIndex < 3; ++vIndex)
-                {
-                    // Given the current index, determine the index
-                    // of the adjacent vertices in the definition of
-                    // the face.
-                    uint32_t nextIndex = (vIndex + 1) % 3;
-                    uint32_t lastIndex = (vIndex + 2) % 3;
+	void NvModelExtObj::CalculateFaceTangents(const MeshFace& face, nv::vec3f tangents[3])
+    {
+		const SubMeshObj::MeshVertexArray& verts = face.m_pSubMesh->m_srcVertices;
 
-                    nv::vec3f tangent;
+        // We'll need all three positions and all three UV sets to calculate
+        // each tangent, so go ahead and load them all once.
+        nv::vec4f positions[3];
+        m_positions.GetObject(verts[face.m_verts[0]].m_pos, positions[0]);
+        m_positions.GetObject(verts[face.m_verts[1]].m_pos, positions[1]);
+        m_positions.GetObject(verts[face.m_verts[2]].m_pos, positions[2]);
 
-                    //compute the edge and tc differentials
-                    nv::vec3f dp0 = (nv::vec3f)(positions[nextIndex] - positions[vIndex]);
-                    nv::vec3f dp1 = (nv::vec3f)(positions[lastIndex] - positions[vIndex]);
-                    nv::vec2f dst0 = (nv::vec2f)(uvs[nextIndex] - uvs[vIndex]);
-                    nv::vec2f dst1 = (nv::vec2f)(uvs[lastIndex] - uvs[vIndex]);
+        nv::vec3f uvs[3];
+        m_texCoords.GetObject(verts[face.m_verts[0]].m_texcoord, uvs[0]);
+        m_texCoords.GetObject(verts[face.m_verts[1]].m_texcoord, uvs[1]);
 
-                    // Make sure there's no divide by 0
-                    float factor = 1.0f;
-                    float denom = dst0[0] * dst1[1] - dst1[0] * dst0[1];
-                    if (fabsf(denom) > 0.00001f)
-                    {
-                        factor /= denom;
-                    }
+        for (uint32_t vIndex = 0; vIndex < 3; ++vIndex)
+        {
+            // Given the current index, determine the index
+            // of the adjacent vertices in the definition of
+            // the face.
+            uint32_t nextIndex = (vIndex + 1) % 3;
+            uint32_t lastIndex = (vIndex + 2) % 3;
+
+            nv::vec3f& tangent = tangents[vIndex];
+
+            //compute the edge and tc differentials
+            nv::vec3f dp0 = (nv::vec3f)(positions[nextIndex] - positions[vIndex]);
+            nv::vec3f dp1 = (nv::vec3f)(positions[lastIndex] - positions[vIndex]);
+            nv::vec2f dst0 = (nv::vec2f)(uvs[nextIndex] - uvs[vIndex]);
+            nv::vec2f dst1 = (nv::vec2f)(uvs[lastIndex] - uvs[vIndex]);
+
+            // Make sure there's no divide by 0
+            float factor = 1.0f;
+            float denom = dst0[0] * dst1[1] - dst1[0] * dst0[1];
+            if (fabsf(denom) > 0.00001f)
+            {
+                factor /= denom;
+            }
 
-                    //compute sTangent
-                    tangent.x = dp0.x * dst1.y - dp1.x * dst0.y;
-                    tangent.y = dp0.y * dst1.y - dp1.y * dst0.y;
-                    tangent.z = dp0.z * dst1.y - dp1.z * dst0.y;
-                    tangent *= factor;
-                    float tangentLen = length(tangent);
-                    if (tangentLen > 0.000001)
-                    {
-                        tangent = normalize(tangent);
-                    }
-                    else
-                    {
-                        // It's a zero-vector, so give it a default value in the positive x so that it's usable, if not correct
-                        tangent.x = 1.0f;
+            //compute sTangent
+            tangent.x = dp0.x * dst1.y - dp1.x * dst0.y;
+            tangent.y = dp0.y * dst1.y - dp1.y * dst0.y;
+            tangent.z = dp0.z * dst1.y - dp1.z * dst0.y;
+            tangent *= factor;
+            float tangentLen = length(tangent);
+            if (tangentLen > 0.000001)
+            {
+                tangent = normalize(tangent);
+            }
+            else
+            {
+                // It's a zero-vector, so give it a default value in the positive x so that it's usable, if not correct
+                tangent.x = 1.0f;
 
-                    }
-                    uint32_t tangentIndex = m_tangents.Append(tangent);
-                    int32_t newVertIndex = pSubMesh->SetTangent(pFace->m_verts[vIndex], tangentIndex);
-                    pFace->m_verts[vIndex] = newVertIndex;
-                }
             }
         }
     }
@@ -59,10 +59,12 @@ namespace Nv
         /// \param[in] vertMergeThreshold Vertices within this distance of each other will be merged together
         /// \param[in] normMergeThreshold Normals whose dot product is within this value of 1.0 will be merged together
         /// \param[in] initialVertCount Initial size of all containers to minimize re-allocations while loading the mesh
+        /// \param[in] weldMethod Method used to find the vertices and normals to merge
         /// \return A pointer to a new, empty model with the given settings
 		static NvModelExtObj* Create(const char* filename, float scale, 
 			bool generateNormals, bool generateTangents,
-			float vertMergeThreshold = 0.01f, float normMergeThreshold = 0.001f, uint32_t initialVertCount = 3000);
+			float vertMergeThreshold = 0.01f, float normMergeThreshold = 0.001f, uint32_t initialVertCount = 3000,
+			WeldMethod weldMethod = WeldMethod_SortedAxis);
 		virtual ~NvModelExtObj();
 
         /// Loads the model data from the OBJ file with the given file name
@@ -72,12 +74,35 @@ namespace Nv
         ///         processing the data.
         bool LoadObjFromFile(const char* fileName);
 
+        /// Selects the method used to merge the vertex components of the next load,
+        /// which also clears out any data already loaded
+        /// \param[in] weldMethod Method used to find the vertex components to merge
+        void SetWeldMethod(WeldMethod weldMethod);
+
+        /// Sets the number of threads used to generate the normals and tangents.  Small
+        /// models are always processed on the calling thread.  The result doesn't depend
+        /// on the thread count.
+        /// \param[in] threadCount Number of threads, 0 for one per hardware thread
+        void SetProcessingThreadCount(uint32_t threadCount) { m_processingThreadCount = threadCount; }
+
         /// Loads the model data from the OBJ file in the given memory buffer
         /// \param[in] pLoadData Pointer to the buffer containing the OBJ definition to load
         /// \return True if the OBJ was parsed successfully and the model now contains
         ///         the processed data.  False if there was a problem processing the data.
         bool LoadObjFromMemory(const char* pLoadData);
 
+        /// Loads the model data from the OBJ file in the given memory buffer, parsing it in
+        /// line aligned chunks on worker threads and then building the meshes in file order.
+        /// The result is identical to the single threaded LoadObjFromMemory(), which is used
+        /// instead if the buffer contains constructs that the chunk parser doesn't handle.
+        /// \param[in] pLoadData Pointer to the buffer containing the OBJ definition to load,
+        ///                      it doesn't need to be null terminated (i.e. a mapped file)
+        /// \param[in] length Size of the buffer in bytes
+        /// \param[in] threadCount Number of threads used to parse, 0 for one per hardware thread
+        /// \return True if the OBJ was parsed successfully and the model now contains
+        ///         the processed data.  False if there was a problem processing the data.
+        bool LoadObjFromMemory(const char* pLoadData, size_t length, uint32_t threadCount);
+
         virtual uint32_t GetMeshCount() const { return uint32_t(m_subMeshes.size()); }
 		
 		/// Returns the mesh contained in the model with the given ID
@@ -188,6 +213,13 @@ namespace Nv
         ///         False if an error occurred.
         bool ReadTextureLine(NvTokenizer& tok, TextureDesc& desc);
 
+        // Statements parsed from a range of lines of an OBJ file, see LoadObjFromMemory()
+        struct ObjChunk;
+
+        /// Parses the complete lines in the given range into a chunk, without modifying the model.
+        /// \return False if a line can't be parsed exactly like the tokenizer would.
+        static bool ParseObjChunk(const char* pBegin, const char* pEnd, ObjChunk& chunk);
+
         // Number of floats contained in the positions defined by the OBJ file
         uint32_t m_numPositionComponents;
 
@@ -233,6 +265,9 @@ namespace Nv
         // Array of all sub meshs that comprise the model
         std::vector<SubMeshObj*> m_subMeshes;
 
+        // Number of threads used to generate the normals and tangents, 0 for one per hardware thread
+        uint32_t m_processingThreadCount;
+
         // Method to remap an index in an obj file to the corresponding index in the given vector.
         //
         // Indices in obj files are 1-based.  Since we're using 0-based vectors
@@ -261,25 +296,32 @@ namespace Nv
         ///         associated mesh.
         SubMeshObj* GetSubMeshForMaterial(uint32_t materialID);
 
+        /// Returns the ID of the material with the given name, adding an empty
+        /// material if it hasn't been defined by a material library.
+        /// \param[in] materialName Name used by the OBJ file to refer to the material
+        /// \return The ID, or index, of the material in the raw materials array
+        uint32_t GetMaterialId(const std::string& materialName);
+
         ///////////////////////////////
         // Normal generation helpers //
         ///////////////////////////////
 
-        // Set of faces within a single smoothing group that refer to a vertex
+        // A vertex of a face, as the face and the index of the vertex within it
+        typedef std::pair<MeshFace*, uint32_t> FaceVert;
+
+        // The face vertices of a position that belong to one smoothing group.  The face vertices
+        // of each position are sorted by group, the group is stored at the index of its first one.
         struct ReferringFaceGroup
         {
-            typedef std::pair<MeshFace*, uint32_t> FaceVert;
-            typedef std::vector<FaceVert> FaceVerts;
-
+            uint32_t m_end;             // Index after the last face vertex of the group
             uint32_t m_smoothingGroup;
-            FaceVerts m_referringFaces;
+            nv::vec3f m_normal;         // Averaged normal of the faces, unused for smoothing group 0
         };
 
-        // Set of all faces that refer to a single vertex, divided by smoothing group
-        typedef std::vector<ReferringFaceGroup> FaceGroups;
-
-        // One 'FaceGroups' per position in the shared array
-        typedef std::vector<FaceGroups> VertexFaces;
+        /// Calculates the tangents at the vertices of a face from its positions and texture coordinates
+        /// \param[in] face The face to calculate the tangents of
+        /// \param[out] tangents Normalized tangent of each vertex of the face
+        void CalculateFaceTangents(const MeshFace& face, nv::vec3f tangents[3]);
     };
 }
 
@@ -0,0 +1,416 @@
+//----------------------------------------------------------------------------------
+// File:        NvModel/NvModelSimplifier.cpp
+// SDK Version: v3.00 
+// Email:       gameworks@nvidia.com
+// Site:        http://developer.nvidia.com/
+//
+// Copyright (c) 2014-2015, NVIDIA CORPORATION. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//----------------------------------------------------------------------------------
+#include "NvModelSimplifier.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <unordered_map>
+
+namespace Nv
+{
+    namespace
+    {
+        // Sum of the squared distances to a set of weighted planes, stored as the upper
+        // half of the symmetric 4x4 matrix
+        struct Quadric
+        {
+            double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+            double weight;
+
+            void AddPlane(double a, double b, double c, double d, double w)
+            {
+                a2 += w * a * a; ab += w * a * b; ac += w * a * c; ad += w * a * d;
+                b2 += w * b * b; bc += w * b * c; bd += w * b * d;
+                c2 += w * c * c; cd += w * c * d;
+                d2 += w * d * d;
+                weight += w;
+            }
+
+            void Add(const Quadric& q)
+            {
+                a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+                b2 += q.b2; bc += q.bc; bd += q.bd;
+                c2 += q.c2; cd += q.cd;
+                d2 += q.d2;
+                weight += q.weight;
+            }
+
+            // Weighted mean of the squared distances from the point to the planes
+            double Error(const float* p) const
+            {
+                const double x = p[0], y = p[1], z = p[2];
+                const double error = a2 * x * x + b2 * y * y + c2 * z * z + d2 +
+                    2.0 * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z);
+                return weight > 0.0 ? fabs(error) / weight : 0.0;
+            }
+        };
+
+        // Weight of the planes keeping the open edges in place, relative to the triangle planes
+        const double kBorderWeight = 10.0;
+
+        struct Collapse
+        {
+            uint32_t from;
+            uint32_t to;
+            double error;
+
+            bool operator<(const Collapse& other) const { return error < other.error; }
+        };
+
+        struct PositionKey
+        {
+            uint32_t x, y, z;
+
+            bool operator==(const PositionKey& other) const { return x == other.x && y == other.y && z == other.z; }
+        };
+
+        struct PositionHash
+        {
+            size_t operator()(const PositionKey& key) const
+            {
+                return (key.x * 73856093u) ^ (key.y * 19349663u) ^ (key.z * 83492791u);
+            }
+        };
+
+        // Number of triangles using each directed edge, between position ids
+        class EdgeSet
+        {
+        public:
+            void Build(const std::vector<uint32_t>& triangles, const std::vector<uint32_t>& positionIds)
+            {
+                m_counts.clear();
+                m_counts.reserve(triangles.size());
+                for (size_t i = 0; i < triangles.size(); ++i)
+                {
+                    ++m_counts[Key(positionIds[triangles[i]], positionIds[triangles[i - i % 3 + (i + 1) % 3]])];
+                }
+            }
+
+            uint32_t Count(uint32_t a, uint32_t b) const
+            {
+                std::unordered_map<uint64_t, uint32_t>::const_iterator it = m_counts.find(Key(a, b));
+                return it != m_counts.end() ? it->second : 0;
+            }
+
+            // An open edge, used by a single triangle
+            bool IsBorder(uint32_t a, uint32_t b) const { return Count(a, b) == 1 && Count(b, a) == 0; }
+
+        private:
+            static uint64_t Key(uint32_t a, uint32_t b) { return ((uint64_t)a << 32) | b; }
+
+            std::unordered_map<uint64_t, uint32_t> m_counts;
+        };
+
+        void Normal(float* n, const float* p0, const float* p1, const float* p2)
+        {
+            const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+            n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+            n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+        }
+    }
+
+    float SimplifyMesh(std::vector<uint32_t>& outIndices, const uint32_t* indices, uint32_t indexCount,
+        const float* vertices, uint32_t vertexCount, uint32_t vertexStride,
+        uint32_t targetIndexCount, float maxError)
+    {
+        std::vector<uint32_t> triangles(indices, indices + indexCount - indexCount % 3);
+        if (triangles.empty() || vertexCount == 0 || triangles.size() <= targetIndexCount)
+        {
+            outIndices.swap(triangles);
+            return 0.0f;
+        }
+
+        // Work on positions scaled to the unit cube, so the errors are relative to the mesh size
+        float minExt[3] = { vertices[0], vertices[1], vertices[2] };
+        float maxExt[3] = { vertices[0], vertices[1], vertices[2] };
+        for (uint32_t v = 1; v < vertexCount; ++v)
+        {
+            const float* p = vertices + v * vertexStride;
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                minExt[axis] = std::min(minExt[axis], p[axis]);
+                maxExt[axis] = std::max(maxExt[axis], p[axis]);
+            }
+        }
+        const float extent = std::max(maxExt[0] - minExt[0], std::max(maxExt[1] - minExt[1], maxExt[2] - minExt[2]));
+        const float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+        std::vector<float> positions(vertexCount * 3);
+        for (uint32_t v = 0; v < vertexCount; ++v)
+        {
+            const float* p = vertices + v * vertexStride;
+            for (uint32_t axis = 0; axis < 3; ++axis)
+                positions[v * 3 + axis] = (p[axis] - minExt[axis]) * scale;
+        }
+
+        // Vertices that only differ by their attributes are seams, they share a position id
+        // and are locked along with the vertices of non-manifold edges
+        std::vector<uint32_t> positionIds(vertexCount);
+        std::vector<uint8_t> locked(vertexCount, 0);
+        {
+            std::unordered_map<PositionKey, uint32_t, PositionHash> firstVertices;
+            firstVertices.reserve(vertexCount);
+            for (uint32_t v = 0; v < vertexCount; ++v)
+            {
+                PositionKey key;
+                memcpy(&key, vertices + v * vertexStride, sizeof(key));
+                auto inserted = firstVertices.insert(std::make_pair(key, v));
+                positionIds[v] = inserted.first->second;
+                if (!inserted.second)
+                    locked[v] = locked[inserted.first->second] = 1;
+            }
+        }
+
+        EdgeSet edges;
+        edges.Build(triangles, positionIds);
+
+        // Quadrics of the planes of the triangles around each vertex, weighted by their area.
+        // Open edges add a plane perpendicular to their triangle, which keeps the border in place.
+        std::vector<Quadric> quadrics(vertexCount);
+        memset(quadrics.data(), 0, sizeof(Quadric) * vertexCount);
+        for (size_t i = 0; i < triangles.size(); i += 3)
+        {
+            float n[3];
+            Normal(n, &positions[triangles[i] * 3], &positions[triangles[i + 1] * 3], &positions[triangles[i + 2] * 3]);
+            const double length = sqrt((double)n[0] * n[0] + (double)n[1] * n[1] + (double)n[2] * n[2]);
+            if (length <= 0.0)
+                continue;
+
+            const double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+            const float* p = &positions[triangles[i] * 3];
+            const double d = -(a * p[0] + b * p[1] + c * p[2]);
+            for (uint32_t corner = 0; corner < 3; ++corner)
+                quadrics[triangles[i + corner]].AddPlane(a, b, c, d, length * 0.5);
+
+            for (uint32_t corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t v0 = triangles[i + corner];
+                const uint32_t v1 = triangles[i + (corner + 1) % 3];
+                if (edges.Count(positionIds[v0], positionIds[v1]) != 1 || edges.Count(positionIds[v1], positionIds[v0]) > 1)
+                {
+                    locked[v0] = locked[v1] = 1;
+                }
+                if (!edges.IsBorder(positionIds[v0], positionIds[v1]))
+                    continue;
+
+                const float* p0 = &positions[v0 * 3];
+                const float* p1 = &positions[v1 * 3];
+                const double e[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+                double pn[3] = { e[1] * c - e[2] * b, e[2] * a - e[0] * c, e[0] * b - e[1] * a };
+                const double edgeLength = sqrt(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+                if (edgeLength <= 0.0)
+                    continue;
+
+                pn[0] /= edgeLength; pn[1] /= edgeLength; pn[2] /= edgeLength;
+                const double pd = -(pn[0] * p0[0] + pn[1] * p0[1] + pn[2] * p0[2]);
+                const double weight = kBorderWeight * edgeLength * edgeLength;
+                quadrics[v0].AddPlane(pn[0], pn[1], pn[2], pd, weight);
+                quadrics[v1].AddPlane(pn[0], pn[1], pn[2], pd, weight);
+            }
+        }
+
+        const double maxErrorSquared = (double)maxError * maxError;
+        double reachedError = 0.0;
+
+        std::vector<uint32_t> offsets(vertexCount + 1);
+        std::vector<uint32_t> adjacency;
+        std::vector<uint32_t> remap(vertexCount);
+        std::vector<uint8_t> touched(vertexCount);
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> fromNeighbors, toNeighbors;
+        std::vector<uint8_t> borderEdgeCounts(vertexCount);
+
+        while (triangles.size() > targetIndexCount)
+        {
+            // Triangles around each position
+            std::fill(offsets.begin(), offsets.end(), 0);
+            for (uint32_t index : triangles)
+                ++offsets[positionIds[index] + 1];
+            for (uint32_t v = 0; v < vertexCount; ++v)
+                offsets[v + 1] += offsets[v];
+            adjacency.resize(triangles.size());
+            for (size_t i = 0; i < triangles.size(); ++i)
+                adjacency[offsets[positionIds[triangles[i]]]++] = (uint32_t)(i / 3);
+            for (uint32_t v = vertexCount; v > 0; --v)
+                offsets[v] = offsets[v - 1];
+            offsets[0] = 0;
+
+            // Vertices on a single border may only slide along it, the other border vertices stay
+            edges.Build(triangles, positionIds);
+            std::fill(borderEdgeCounts.begin(), borderEdgeCounts.end(), 0);
+            for (size_t i = 0; i < triangles.size(); ++i)
+            {
+                const uint32_t a = positionIds[triangles[i]];
+                const uint32_t b = positionIds[triangles[i - i % 3 + (i + 1) % 3]];
+                if (edges.IsBorder(a, b))
+                {
+                    ++borderEdgeCounts[a];
+                    ++borderEdgeCounts[b];
+                }
+            }
+
+            collapses.clear();
+            for (size_t i = 0; i < triangles.size(); ++i)
+            {
+                const uint32_t a = triangles[i];
+                const uint32_t b = triangles[i - i % 3 + (i + 1) % 3];
+                const bool border = edges.IsBorder(positionIds[a], positionIds[b]);
+                for (uint32_t direction = 0; direction < (border ? 2u : 1u); ++direction)
+                {
+                    const uint32_t from = direction ? b : a;
+                    const uint32_t to = direction ? a : b;
+                    const uint8_t borderEdgeCount = borderEdgeCounts[positionIds[from]];
+                    if (locked[from] || (borderEdgeCount != 0 && (borderEdgeCount != 2 || !border)))
+                        continue;
+
+                    Quadric q = quadrics[from];
+                    q.Add(quadrics[to]);
+                    const Collapse collapse = { from, to, q.Error(&positions[to * 3]) };
+                    collapses.push_back(collapse);
+                }
+            }
+            std::sort(collapses.begin(), collapses.end());
+
+            // Collapse the cheapest edges, each one removes one or two triangles.  The one-ring of
+            // a collapsed vertex is left alone for the rest of the pass, as its costs are stale.
+            const size_t removeCount = (triangles.size() - targetIndexCount + 2) / 3;
+            size_t removed = 0;
+            for (uint32_t v = 0; v < vertexCount; ++v)
+                remap[v] = v;
+            std::fill(touched.begin(), touched.end(), 0);
+
+            for (const Collapse& collapse : collapses)
+            {
+                if (collapse.error > maxErrorSquared || removed >= removeCount)
+                    break;
+
+                const uint32_t fromId = positionIds[collapse.from];
+                const uint32_t toId = positionIds[collapse.to];
+                if (touched[fromId] || touched[toId])
+                    continue;
+
+                // The link condition, the only neighbors of both ends must be the opposite
+                // corners of the triangles sharing the edge, or the collapse pinches the surface
+                fromNeighbors.clear();
+                toNeighbors.clear();
+                uint32_t sharedTriangles = 0;
+                for (uint32_t i = offsets[fromId]; i < offsets[fromId + 1]; ++i)
+                {
+                    const uint32_t* tri = &triangles[adjacency[i] * 3];
+                    bool shared = false;
+                    for (uint32_t corner = 0; corner < 3; ++corner)
+                    {
+                        fromNeighbors.push_back(positionIds[tri[corner]]);
+                        shared |= positionIds[tri[corner]] == toId;
+                    }
+                    sharedTriangles += shared ? 1 : 0;
+                }
+                for (uint32_t i = offsets[toId]; i < offsets[toId + 1]; ++i)
+                {
+                    const uint32_t* tri = &triangles[adjacency[i] * 3];
+                    for (uint32_t corner = 0; corner < 3; ++corner)
+                        toNeighbors.push_back(positionIds[tri[corner]]);
+                }
+                std::sort(fromNeighbors.begin(), fromNeighbors.end());
+                fromNeighbors.erase(std::unique(fromNeighbors.begin(), fromNeighbors.end()), fromNeighbors.end());
+                std::sort(toNeighbors.begin(), toNeighbors.end());
+                toNeighbors.erase(std::unique(toNeighbors.begin(), toNeighbors.end()), toNeighbors.end());
+
+                uint32_t commonNeighbors = 0;
+                for (uint32_t id : fromNeighbors)
+                {
+                    if (id != fromId && id != toId && std::binary_search(toNeighbors.begin(), toNeighbors.end(), id))
+                        ++commonNeighbors;
+                }
+                if (sharedTriangles == 0 || commonNeighbors != sharedTriangles)
+                    continue;
+
+                // Moving the vertex must not flip any of the triangles that remain
+                bool flipped = false;
+                for (uint32_t i = offsets[fromId]; i < offsets[fromId + 1] && !flipped; ++i)
+                {
+                    const uint32_t* tri = &triangles[adjacency[i] * 3];
+                    const float* p[3];
+                    const float* moved[3];
+                    bool degenerate = false;
+                    for (uint32_t corner = 0; corner < 3; ++corner)
+                    {
+                        degenerate |= positionIds[tri[corner]] == toId;
+                        p[corner] = &positions[tri[corner] * 3];
+                        moved[corner] = positionIds[tri[corner]] == fromId ? &positions[collapse.to * 3] : p[corner];
+                    }
+                    if (degenerate)
+                        continue;
+
+                    float before[3], after[3];
+                    Normal(before, p[0], p[1], p[2]);
+                    Normal(after, moved[0], moved[1], moved[2]);
+                    flipped = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0f;
+                }
+                if (flipped)
+                    continue;
+
+                remap[collapse.from] = collapse.to;
+                quadrics[collapse.to].Add(quadrics[collapse.from]);
+                for (uint32_t id : fromNeighbors)
+                    touched[id] = 1;
+                removed += sharedTriangles;
+                reachedError = std::max(reachedError, collapse.error);
+            }
+
+            if (removed == 0)
+                break;
+
+            size_t write = 0;
+            for (size_t i = 0; i < triangles.size(); i += 3)
+            {
+                const uint32_t a = remap[triangles[i]];
+                const uint32_t b = remap[triangles[i + 1]];
+                const uint32_t c = remap[triangles[i + 2]];
+                if (a == b || b == c || a == c)
+                    continue;
+
+                triangles[write++] = a;
+                triangles[write++] = b;
+                triangles[write++] = c;
+            }
+            triangles.resize(write);
+        }
+
+        outIndices.swap(triangles);
+        return (float)sqrt(reachedError);
+    }
+}
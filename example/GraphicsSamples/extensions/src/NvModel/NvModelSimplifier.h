@@ -0,0 +1,66 @@
+//----------------------------------------------------------------------------------
+// File:        NvModel/NvModelSimplifier.h
+// SDK Version: v3.00 
+// Email:       gameworks@nvidia.com
+// Site:        http://developer.nvidia.com/
+//
+// Copyright (c) 2014-2015, NVIDIA CORPORATION. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//----------------------------------------------------------------------------------
+#ifndef _NVMODELSIMPLIFIER_H_
+#define _NVMODELSIMPLIFIER_H_
+#pragma once
+
+#include <NvSimpleTypes.h>
+#include <vector>
+
+namespace Nv
+{
+    // Simplifies a triangle list by collapsing its edges in order of their quadric error.
+    // Each collapse moves a vertex onto one of its neighbors, so the simplified triangles
+    // still index the source vertices and can share their vertex buffer.  The vertices on
+    // attribute seams (vertices sharing a position) and on non-manifold edges are never
+    // moved, which keeps the texture mapping intact.  A vertex with exactly two open border
+    // edges may only slide along its border, onto one of its border neighbors; the other
+    // border vertices are never moved, and the border planes of the quadrics keep the
+    // silhouette in place.
+    // \param[out] outIndices Receives the simplified triangle list
+    // \param[in] indices Source triangle list
+    // \param[in] indexCount Number of indices in the source triangle list
+    // \param[in] vertices Source vertices, with the position as the first three floats
+    // \param[in] vertexCount Number of source vertices
+    // \param[in] vertexStride Size of a source vertex, in number of floats
+    // \param[in] targetIndexCount Number of indices to simplify down to, if possible
+    // \param[in] maxError Largest distance a collapse may move the surface, relative to
+    //                     the largest extent of the mesh
+    // \return The largest error of the collapses done, relative to the mesh extent
+    float SimplifyMesh(std::vector<uint32_t>& outIndices, const uint32_t* indices, uint32_t indexCount,
+        const float* vertices, uint32_t vertexCount, uint32_t vertexStride,
+        uint32_t targetIndexCount, float maxError);
+}
+
+#endif
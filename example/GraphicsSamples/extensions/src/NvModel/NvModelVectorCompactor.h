@@ -39,9 +39,178 @@
 #include <NV/NvLogs.h>
 #include <vector>
 #include <map>
+#include <cmath>
 
 namespace Nv
 {
+    // VectorHashGrid is an open addressing spatial hash of the vectors in a compactor.
+    // The vectors are bucketed by their first three components in cubic cells twice
+    // the size of the search radius, so the vectors within the radius of any point,
+    // in each component, are in at most two cells along each axis.  Each cell holds
+    // the head of a list of its vectors, linked by their index in the compacted set.
+    template <class T>
+    class VectorHashGrid
+    {
+    public:
+        VectorHashGrid() :
+            m_radius(0.0f),
+            m_invCellSize(0.0f),
+            m_usedCells(0)
+        {
+        }
+
+        // Clear out the grid and set the search radius, which sizes its cells
+        // \param[in] radius Largest component difference of the vectors to find,
+        //                   no vectors are found if it isn't positive
+        void Clear(float radius)
+        {
+            m_radius = radius;
+            m_invCellSize = (radius > 0.0f) ? (0.5f / radius) : 0.0f;
+            m_cells.resize(0);
+            m_next.resize(0);
+            m_usedCells = 0;
+        }
+
+        // Reserve an initial size for the grid's table and vector links
+        // \param[in] size Number of vectors to reserve space for
+        void Reserve(uint32_t size)
+        {
+            m_next.reserve(size);
+            if (m_cells.size() < 2 * size)
+            {
+                Rehash(2 * size);
+            }
+        }
+
+        float GetRadius() const { return m_radius; }
+
+        // Adds the vector with the given index in the compacted set to its cell.
+        // Vectors must be added in index order.
+        void Insert(const T& v, int32_t index)
+        {
+            NV_ASSERT(index == (int32_t)m_next.size());
+
+            // Keep the table at most half full
+            if (2 * (m_usedCells + 1) > m_cells.size())
+            {
+                Rehash(2 * (m_usedCells + 1));
+            }
+
+            int32_t key[3];
+            GetCellKey(v, 0.0f, key);
+            Cell& cell = FindCell(key);
+            if (-1 == cell.m_head)
+            {
+                cell.m_key[0] = key[0];
+                cell.m_key[1] = key[1];
+                cell.m_key[2] = key[2];
+                ++m_usedCells;
+            }
+            m_next.push_back(cell.m_head);
+            cell.m_head = index;
+        }
+
+        // Calls the given function with the index of each vector in the cells overlapping
+        // the box of the search radius around the given vector
+        template <typename Func>
+        void ForEachNeighbor(const T& v, Func& func)
+        {
+            if (0 == m_usedCells || !(m_radius > 0.0f))
+            {
+                return;
+            }
+
+            int32_t lo[3], hi[3];
+            GetCellKey(v, -m_radius, lo);
+            GetCellKey(v, m_radius, hi);
+            for (int32_t x = lo[0]; x <= hi[0]; ++x)
+            {
+                for (int32_t y = lo[1]; y <= hi[1]; ++y)
+                {
+                    for (int32_t z = lo[2]; z <= hi[2]; ++z)
+                    {
+                        const int32_t neighbor[3] = { x, y, z };
+                        for (int32_t index = FindCell(neighbor).m_head; -1 != index; index = m_next[index])
+                        {
+                            func(index);
+                        }
+                    }
+                }
+            }
+        }
+
+    protected:
+        struct Cell
+        {
+            int32_t m_key[3];   // Coordinates of the cell
+            int32_t m_head;     // Index of the last vector added to the cell, -1 if the slot is free
+        };
+
+        // Returns the coordinates of the cell containing the vector offset by the given amount
+        // in each component.  They are clamped so that far away vectors share the outer cells.
+        void GetCellKey(const T& v, float offset, int32_t key[3]) const
+        {
+            const float kLimit = 1073741824.0f;
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                float c = floorf((v[i] + offset) * m_invCellSize);
+                if (!(c > -kLimit))
+                    c = -kLimit;
+                if (!(c < kLimit))
+                    c = kLimit;
+                key[i] = int32_t(c);
+            }
+        }
+
+        // Returns the slot holding the given cell, or the free slot where it would be added
+        Cell& FindCell(const int32_t key[3])
+        {
+            const uint32_t mask = uint32_t(m_cells.size()) - 1;
+            uint32_t slot = (uint32_t(key[0]) * 73856093u) ^ (uint32_t(key[1]) * 19349663u) ^ (uint32_t(key[2]) * 83492791u);
+            slot = (slot ^ (slot >> 16)) & mask;
+            for (;;)
+            {
+                Cell& cell = m_cells[slot];
+                if (-1 == cell.m_head ||
+                    (cell.m_key[0] == key[0] && cell.m_key[1] == key[1] && cell.m_key[2] == key[2]))
+                {
+                    return cell;
+                }
+                slot = (slot + 1) & mask;
+            }
+        }
+
+        // Grows the table to a power of two of at least the given size, keeping the vector lists
+        void Rehash(size_t minSize)
+        {
+            size_t size = 64;
+            while (size < minSize)
+            {
+                size *= 2;
+            }
+
+            std::vector<Cell> oldCells(size);
+            oldCells.swap(m_cells);
+            for (size_t i = 0; i < m_cells.size(); ++i)
+            {
+                m_cells[i].m_head = -1;
+            }
+            for (size_t i = 0; i < oldCells.size(); ++i)
+            {
+                if (-1 != oldCells[i].m_head)
+                {
+                    FindCell(oldCells[i].m_key) = oldCells[i];
+                }
+            }
+        }
+
+        float m_radius;
+        float m_invCellSize;
+        uint32_t m_usedCells;
+        std::vector<Cell> m_cells;      // Open addressing table of cells, its size is a power of two
+        std::vector<int32_t> m_next;    // Index of the next vector in the same cell, -1 for the last one
+    };
+
     // VectorCompactor is a class to contain a set of vectors, which it optimizes by 
     // removing vectors that are duplicates of each other, within a given tolerance.
     // It also maintains a mapping of the original vector's index, which is determined
@@ -57,17 +226,34 @@ namespace Nv
         VectorCompactor(float epsilon, uint32_t reserveSize, Cmp comp = Cmp()) :
             m_mappedIndices(0, -1),
             m_epsilon(epsilon),
-            m_comp(comp)
+            m_comp(comp),
+            m_bUseHashGrid(false)
         {
             Reserve(reserveSize);
         }
 
+        // Selects how vectors are matched for welding.  By default the candidates are found
+        // in a map sorted by their first component, which degrades when many vectors share it,
+        // i.e. axis aligned meshes.  The hash grid only checks the vectors in neighboring
+        // cells, within a radius given by the comparator for the epsilon.
+        // Must be called while the container is empty.
+        // \param[in] bUseHashGrid True to find the candidates with a hash grid
+        void SetUseHashGrid(bool bUseHashGrid)
+        {
+            NV_ASSERT(m_vecs.empty());
+            m_bUseHashGrid = bUseHashGrid;
+            m_grid.Clear(m_comp.SearchRadius(m_epsilon));
+        }
+
+        bool GetUseHashGrid() const { return m_bUseHashGrid; }
+
         // Clear out the data from the container so that it may be reused
         void Clear()
         {
             m_vecs.resize(0);
             m_mappedIndices.resize(0);
             m_vecMap.clear();
+            m_grid.Clear(m_comp.SearchRadius(m_epsilon));
         }
 
         // Reserve an initial size for the container and its underlying structures.
@@ -78,6 +264,10 @@ namespace Nv
         {
             m_vecs.reserve(size);
             m_mappedIndices.reserve(size);
+            if (m_bUseHashGrid)
+            {
+                m_grid.Reserve(size);
+            }
         }
 
         // Adds a vector to the container.  The vector's original index will be 
@@ -176,6 +366,11 @@ namespace Nv
         // \return The index of the vector in the compacted set
         int32_t FindOrAddObject(const T& v)
         {
+            if (m_bUseHashGrid)
+            {
+                return FindOrAddObjectHashed(v);
+            }
+
             // If we have nothing yet, then we simply add this vector to the set
             if (m_vecs.empty())
             {
@@ -241,6 +436,35 @@ namespace Nv
             return closestPosition->second;
         }
 
+        // Hash grid version of FindOrAddObject(), which only compares the vectors in the
+        // neighboring cells of the given one.  Ties are resolved to the lowest index so
+        // that the result doesn't depend on the order of the cells.
+        int32_t FindOrAddObjectHashed(const T& v)
+        {
+            int32_t closest = -1;
+            float bestDist2 = 0.0f;
+            auto checkCandidate = [&](int32_t index)
+            {
+                float dist2 = m_comp.Diff(v, m_vecs[index]);
+                if (-1 == closest || dist2 < bestDist2 || (dist2 == bestDist2 && index < closest))
+                {
+                    bestDist2 = dist2;
+                    closest = index;
+                }
+            };
+            m_grid.ForEachNeighbor(v, checkCandidate);
+
+            if (-1 != closest && m_comp.ShouldMerge(bestDist2, m_epsilon))
+            {
+                return closest;
+            }
+
+            int32_t index = int32_t(m_vecs.size());
+            m_vecs.push_back(v);
+            m_grid.Insert(v, index);
+            return index;
+        }
+
         // Adds the given vector to the compacted set, using the given hint
         // to find the right spot
         int32_t Add(const T& v, const typename VecMap::iterator& hint)
@@ -267,6 +491,9 @@ namespace Nv
                                                 // containing the index in the compacted set that 
                                                 // holds the vector (or the one that it was merged
                                                 // with), in order of their addition to the set
+
+        bool m_bUseHashGrid;        // Whether the candidates for merging are found with the grid
+        VectorHashGrid<T> m_grid;   // Spatial hash of the compacted set, if used
     };
 
     // Comparator objects to be used to allow the compactor to hold different types of vectors
@@ -285,6 +512,12 @@ namespace Nv
         {
             return diff < (epsilon * epsilon);
         }
+
+        // Positions closer than epsilon are closer than epsilon in each component
+        float SearchRadius(float epsilon)
+        {
+            return epsilon;
+        }
     };
 
     // Normal Comparator
@@ -302,6 +535,14 @@ namespace Nv
         {
             return (diff < epsilon);
         }
+
+        // Unit vectors with 1 - dot below epsilon are closer than sqrt(2 * epsilon), so
+        // normals that aren't normalized may be missed by the hash grid.  The sorted map
+        // also requires the x components within epsilon, so it merges fewer normals.
+        float SearchRadius(float epsilon)
+        {
+            return sqrtf(2.0f * epsilon);
+        }
     };
 
     // Helper struct to simplify declarations of compactors for different vector usages
@@ -32,9 +32,62 @@
 //
 //----------------------------------------------------------------------------------
 #include "NvModel/NvSkeleton.h"
+#include <algorithm>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKELETON_SSE 1
+#include <emmintrin.h>
+#endif
 
 namespace Nv
 {
+    namespace
+    {
+        // Instances evaluated through all of the nodes at a time, so that the
+        // parent transforms are still in the cache when their children need them
+        const uint32_t kPoseBlockSize = 64;
+
+        // result = parent * local, with the same summation order as nv::matrix4f's operator*
+        inline void MultiplyTransform(const nv::matrix4f& parent, const nv::matrix4f& local, nv::matrix4f& result)
+        {
+#if SKELETON_SSE
+            const float* pParent = parent._array;
+            const float* pLocal = local._array;
+            const __m128 col0 = _mm_loadu_ps(pParent);
+            const __m128 col1 = _mm_loadu_ps(pParent + 4);
+            const __m128 col2 = _mm_loadu_ps(pParent + 8);
+            const __m128 col3 = _mm_loadu_ps(pParent + 12);
+            for (uint32_t col = 0; col < 4; ++col, pLocal += 4)
+            {
+                __m128 sum = _mm_mul_ps(col0, _mm_set1_ps(pLocal[0]));
+                sum = _mm_add_ps(sum, _mm_mul_ps(col1, _mm_set1_ps(pLocal[1])));
+                sum = _mm_add_ps(sum, _mm_mul_ps(col2, _mm_set1_ps(pLocal[2])));
+                sum = _mm_add_ps(sum, _mm_mul_ps(col3, _mm_set1_ps(pLocal[3])));
+                _mm_storeu_ps(result._array + 4 * col, sum);
+            }
+#else
+            result = parent * local;
+#endif
+        }
+
+        // Copies a transform to memory that is only written to, such as a mapped buffer
+        inline void StreamTransform(const nv::matrix4f& src, nv::matrix4f& dest, bool bAligned)
+        {
+#if SKELETON_SSE
+            if (bAligned)
+            {
+                _mm_stream_ps(dest._array, _mm_loadu_ps(src._array));
+                _mm_stream_ps(dest._array + 4, _mm_loadu_ps(src._array + 4));
+                _mm_stream_ps(dest._array + 8, _mm_loadu_ps(src._array + 8));
+                _mm_stream_ps(dest._array + 12, _mm_loadu_ps(src._array + 12));
+                return;
+            }
+#endif
+            memcpy(dest._array, src._array, sizeof(nv::matrix4f));
+        }
+    }
+
     NvSkeleton::NvSkeleton(const NvSkeletonNode* pNodes, uint32_t numNodes)
     {
         m_nodes.resize(numNodes);
@@ -112,4 +165,58 @@ namespace Nv
 
         return &(m_nodeTransforms[index]);
     }
-}
\ No newline at end of file
+
+    void NvSkeleton::EvaluatePoses(const nv::matrix4f* pLocalTransforms, uint32_t instanceCount,
+        nv::matrix4f* pTransforms, nv::matrix4f* pSkinningTransforms) const
+    {
+        const uint32_t numNodes = m_nodes.size();
+        const bool bAlignedSkinning = (reinterpret_cast<uintptr_t>(pSkinningTransforms) & 15) == 0;
+
+        for (uint32_t blockStart = 0; blockStart < instanceCount; blockStart += kPoseBlockSize)
+        {
+            const uint32_t blockEnd = std::min(blockStart + kPoseBlockSize, instanceCount);
+
+            // Parents always precede their children, so a single pass over the nodes
+            // propagates the transforms down the hierarchy
+            for (uint32_t nodeIndex = 0; nodeIndex < numNodes; ++nodeIndex)
+            {
+                const int32_t parentIndex = m_nodes[nodeIndex].m_parentNode;
+                const nv::matrix4f* pLocal = pLocalTransforms + nodeIndex * instanceCount;
+                nv::matrix4f* pDest = pTransforms + nodeIndex * instanceCount;
+                if (-1 == parentIndex)
+                {
+                    memcpy(pDest + blockStart, pLocal + blockStart, (blockEnd - blockStart) * sizeof(nv::matrix4f));
+                    continue;
+                }
+
+                const nv::matrix4f* pParent = pTransforms + parentIndex * instanceCount;
+                for (uint32_t instance = blockStart; instance < blockEnd; ++instance)
+                {
+                    MultiplyTransform(pParent[instance], pLocal[instance], pDest[instance]);
+                }
+            }
+
+            if (NULL == pSkinningTransforms)
+            {
+                continue;
+            }
+
+            // Write the block out by instance, so the destination is filled sequentially
+            nv::matrix4f* pSkinning = pSkinningTransforms + blockStart * numNodes;
+            for (uint32_t instance = blockStart; instance < blockEnd; ++instance)
+            {
+                for (uint32_t nodeIndex = 0; nodeIndex < numNodes; ++nodeIndex, ++pSkinning)
+                {
+                    StreamTransform(pTransforms[nodeIndex * instanceCount + instance], *pSkinning, bAlignedSkinning);
+                }
+            }
+        }
+
+#if SKELETON_SSE
+        if ((NULL != pSkinningTransforms) && bAlignedSkinning)
+        {
+            _mm_sfence();
+        }
+#endif
+    }
+}
@@ -59,6 +59,7 @@
 #include <memory.h>
 #include <string.h>
 #include <string>
+#include <algorithm>
 
 //========================================================================
 // datatypes & defines
@@ -106,6 +107,7 @@ static float dispRotation = 0;
 static uint8_t lastTextMode = 111;
 
 static float s_pixelToClipMatrix[4][4];
+static uint32_t s_glyphGeneration = 0;
 static float s_pixelScaleFactorX = 2.0f / 640.0f;
 static float s_pixelScaleFactorY = 2.0f / 480.0f;
 
@@ -471,6 +473,8 @@ NvBFText::NvBFText()
 , m_charColor(NV_PC_PREDEF_WHITE)
 
 , m_cached(false)
+, m_uploaded(false)
+, m_generation(0)
 , m_visible(true)
 , m_fontNum(0)
 , m_fontSize(10)
@@ -909,12 +913,26 @@ void NvBFText::TrackOutputLines(float lineWidth)
 }
 
 //========================================================================
-// this function rebuilds the VBO/rendercache based on a simplistic
+// regenerates the glyphs if needed, then uploads them to the VBO.
+//========================================================================
+void NvBFText::RebuildCache(bool internalCall)
+{
+    if (!m_cached)
+        GenerateGlyphs();
+    if (!m_cached || m_uploaded)
+        return;
+
+    m_render->UpdateText(m_stringCharsOut, m_data, internalCall);
+    m_uploaded = 1;
+}
+
+//========================================================================
+// this function rebuilds the glyph vertices based on a simplistic
 // ENGLISH char-walk of the string.
 // !!!!TBD handle the actual unicode chars we might get properly
 // !!!!TBD handle complex script layouts and break rules of non-roman lang
 //========================================================================
-void NvBFText::RebuildCache(bool internalCall)
+void NvBFText::GenerateGlyphs()
 {
     NvBftStyle::Enum bfs = NvBftStyle::NORMAL;
 
@@ -1161,11 +1179,12 @@ void NvBFText::RebuildCache(bool internalCall)
     AdjustGlyphsForAlignment();
     
     //DEBUG_LOG(">> output glyph count = %d, stringMax = %d.", m_stringCharsOut, m_stringMax);
-    m_render->UpdateText(m_stringCharsOut, m_data, internalCall);
 
     m_pixelsWide = maxWidth; // cache the total width in output pixels, for justification and such.
     m_pixelsHigh = vsize * m_numLines;
     m_cached = 1; // flag that we cached this.
+    m_uploaded = 0; // the vertices need uploading before drawing this bftext on its own.
+    m_generation = ++s_glyphGeneration; // unique across bftexts, so a batch can't confuse them.
     m_posCached = 0; // flag that position needs recache.  FIXME could optimize...
 }
 
@@ -1271,39 +1290,11 @@ void NvBFText::UpdateTextPosition()
 
 
 //========================================================================
+// we apply any global screen orientation/rotation so long as
+// caller hasn't specified their own transform matrix.
 //========================================================================
-void NvBFText::Render()
+static const float *PixelToClipMatrix(float textLeft, float textTop)
 {
-    void *p = 0;
-    int32_t count = m_drawnChars;
-
-    if (!m_visible || !m_fontNum || !m_font) // nothing we should output...
-        return;
-
-    if (count<0)
-        count = m_stringChars; // !!!TBD maybe negative means something else.
-    else
-        if (count>m_stringChars)
-            count = m_stringChars;
-    if (count == 0)
-        return; // done...
-    if (m_shadowDir)
-        count *= 2; // so we draw char+shadow equally...
-
-    // since buffer state is now set, can rebuild cache now without extra calls.
-    if (!m_cached) // need to recache BEFORE we do anything using textwidth, etc.
-        RebuildCache(1);
-    if (count > m_stringCharsOut) // recheck count against CharsOut after rebuilding cache
-        count = m_stringCharsOut;
-    if (!m_posCached) // AFTER we may have rebuilt the cache, we check if we recalc pos.
-        UpdateTextPosition();
-
-    // set the model matrix offset for rendering this text based on position & alignment
-    // first, do any pre-render position updates
-
-    // we apply any global screen orientation/rotation so long as
-    // caller hasn't specified their own transform matrix.
-
     const float* matrix = m_matrixOverride;
     if (!matrix) {
         const float wNorm = s_pixelScaleFactorX;
@@ -1315,8 +1306,8 @@ void NvBFText::Render()
             s_pixelToClipMatrix[0][1] = 0;
             s_pixelToClipMatrix[1][1] = -hNorm;
 
-            s_pixelToClipMatrix[3][0] = (wNorm * m_textLeft) - 1;
-            s_pixelToClipMatrix[3][1] = 1 - (hNorm * m_textTop);
+            s_pixelToClipMatrix[3][0] = (wNorm * textLeft) - 1;
+            s_pixelToClipMatrix[3][1] = 1 - (hNorm * textTop);
         }
         else
         {
@@ -1333,16 +1324,238 @@ void NvBFText::Render()
             s_pixelToClipMatrix[0][1] = wNorm * sinfv;
             s_pixelToClipMatrix[1][1] = hNorm * -cosfv;
 
-            s_pixelToClipMatrix[3][0] = (s_pixelToClipMatrix[0][0] * m_textLeft)
+            s_pixelToClipMatrix[3][0] = (s_pixelToClipMatrix[0][0] * textLeft)
                 - cosfv - sinfv
-                + (s_pixelToClipMatrix[1][0] * m_textTop);
-            s_pixelToClipMatrix[3][1] = (s_pixelToClipMatrix[0][1] * m_textLeft)
+                + (s_pixelToClipMatrix[1][0] * textTop);
+            s_pixelToClipMatrix[3][1] = (s_pixelToClipMatrix[0][1] * textLeft)
                 - sinfv + cosfv
-                + (s_pixelToClipMatrix[1][1] * m_textTop);
+                + (s_pixelToClipMatrix[1][1] * textTop);
         }
 
         matrix = &(s_pixelToClipMatrix[0][0]);
     }
+    return matrix;
+}
+
+
+//========================================================================
+// regenerates the glyphs if needed, and returns how many to draw.
+//========================================================================
+int32_t NvBFText::PrepareGlyphs()
+{
+    int32_t count = m_drawnChars;
+
+    if (!m_visible || !m_fontNum || !m_font) // nothing we should output...
+        return 0;
+
+    if (count<0)
+        count = m_stringChars; // !!!TBD maybe negative means something else.
+    else
+        if (count>m_stringChars)
+            count = m_stringChars;
+    if (count == 0)
+        return 0; // done...
+    if (m_shadowDir)
+        count *= 2; // so we draw char+shadow equally...
+
+    if (!m_cached) // need to recache BEFORE we do anything using textwidth, etc.
+        GenerateGlyphs();
+    if (count > m_stringCharsOut) // recheck count against CharsOut after rebuilding cache
+        count = m_stringCharsOut;
+    if (!m_posCached) // AFTER we may have rebuilt the cache, we check if we recalc pos.
+        UpdateTextPosition();
+
+    return count;
+}
+
+
+//========================================================================
+//========================================================================
+void NvBFText::Render()
+{
+    const int32_t count = PrepareGlyphs();
+    if (count == 0)
+        return;
+
+    // since buffer state is now set, can upload the cache now without extra calls.
+    RebuildCache(1);
+
+    // set the model matrix offset for rendering this text based on position & alignment
+    const float* matrix = PixelToClipMatrix(m_textLeft, m_textTop);
 
     m_render->Render(matrix, m_outlineColor, m_font, m_outline, count);
 }
+
+
+//========================================================================
+//========================================================================
+struct NvBFTextBatch::Run
+{
+    NvBitFont *font;
+    bool outline;
+    NvPackedColor outlineColor;
+    int32_t first;
+    int32_t count;
+};
+
+struct NvBFTextBatch::Slot
+{
+    const NvBFText *text;
+    uint32_t generation;
+    float left;
+    float top;
+    int32_t first;
+    int32_t count;
+};
+
+// the index buffer is 16 bit, and each run indexes from its first vertex
+static const int32_t s_maxRunGlyphs = 65536 / VERT_PER_QUAD;
+
+//========================================================================
+NvBFTextBatch::NvBFTextBatch()
+: m_texts(NULL)
+, m_textCount(0)
+, m_textMax(0)
+, m_slots(NULL)
+, m_slotCount(0)
+, m_slotMax(0)
+, m_verts(NULL)
+, m_glyphCount(0)
+, m_glyphMax(0)
+, m_runs(NULL)
+, m_runCount(0)
+, m_runMax(0)
+, m_built(false)
+, m_uploaded(false)
+, m_render(NvBitFontRenderFactory::TextRenderCreate())
+{
+}
+
+//========================================================================
+NvBFTextBatch::~NvBFTextBatch()
+{
+    delete m_render;
+    free(m_texts);
+    free(m_slots);
+    free(m_verts);
+    free(m_runs);
+}
+
+//========================================================================
+void NvBFTextBatch::Add(NvBFText *text)
+{
+    if (m_textCount == m_textMax)
+    {
+        m_textMax = m_textMax ? m_textMax*2 : 16;
+        m_texts = (NvBFText**)realloc(m_texts, m_textMax*sizeof(NvBFText*));
+    }
+    m_texts[m_textCount++] = text;
+    m_built = false;
+}
+
+//========================================================================
+int32_t NvBFTextBatch::Build()
+{
+    if (m_built)
+        return m_glyphCount;
+
+    // group the bftexts by how they are drawn, keeping their order otherwise
+    std::stable_sort(m_texts, m_texts + m_textCount, [](const NvBFText *a, const NvBFText *b) {
+        if (a->m_fontNum != b->m_fontNum)
+            return a->m_fontNum < b->m_fontNum;
+        return a->m_outline < b->m_outline;
+    });
+
+    if (m_textCount > m_slotMax)
+    {
+        m_slotMax = std::max(m_textCount, m_slotMax*2);
+        m_slots = (Slot*)realloc(m_slots, m_slotMax*sizeof(Slot));
+    }
+
+    m_glyphCount = 0;
+    m_runCount = 0;
+    int32_t slotCount = 0;
+    for (int32_t i=0; i<m_textCount; i++)
+    {
+        NvBFText *text = m_texts[i];
+        const int32_t count = text->PrepareGlyphs();
+        if (count == 0)
+            continue;
+
+        if (m_glyphCount + count > m_glyphMax)
+        {
+            m_glyphMax = std::max(m_glyphCount + count, m_glyphMax*2);
+            m_verts = (BFVert*)realloc(m_verts, m_glyphMax*sizeof(BFVert)*VERT_PER_QUAD);
+        }
+
+        // the quads are still in place if the same unchanged bftext was copied at the same offset last time
+        Slot &slot = m_slots[slotCount];
+        if (slotCount >= m_slotCount || slot.text != text || slot.generation != text->m_generation
+        ||  slot.left != text->m_textLeft || slot.top != text->m_textTop
+        ||  slot.first != m_glyphCount || slot.count != count)
+        {
+            CopyGlyphQuads(m_verts + m_glyphCount*VERT_PER_QUAD, text->m_data, count, text->m_textLeft, text->m_textTop);
+            slot.text = text;
+            slot.generation = text->m_generation;
+            slot.left = text->m_textLeft;
+            slot.top = text->m_textTop;
+            slot.first = m_glyphCount;
+            slot.count = count;
+            m_uploaded = false;
+        }
+        slotCount++;
+
+        Run *run = m_runCount ? &m_runs[m_runCount-1] : NULL;
+        if (!run || run->font != text->m_font || run->outline != text->m_outline
+        ||  (text->m_outline && !NV_PC_EQUAL(run->outlineColor, text->m_outlineColor))
+        ||  run->count + count > s_maxRunGlyphs)
+        {
+            if (m_runCount == m_runMax)
+            {
+                m_runMax = m_runMax ? m_runMax*2 : 4;
+                m_runs = (Run*)realloc(m_runs, m_runMax*sizeof(Run));
+            }
+            run = &m_runs[m_runCount++];
+            run->font = text->m_font;
+            run->outline = text->m_outline;
+            run->outlineColor = text->m_outlineColor;
+            run->first = m_glyphCount;
+            run->count = 0;
+        }
+        run->count += count;
+        m_glyphCount += count;
+    }
+
+    if (slotCount != m_slotCount)
+        m_uploaded = false;
+    m_slotCount = slotCount;
+
+    m_built = true;
+    return m_glyphCount;
+}
+
+//========================================================================
+void NvBFTextBatch::Render()
+{
+    Build();
+
+    if (m_glyphCount)
+    {
+        m_render->RenderPrep();
+        if (!m_uploaded)
+            m_render->UpdateText(m_glyphCount, m_verts, true);
+        m_uploaded = true;
+
+        // positions are in the vertices already
+        const float* matrix = PixelToClipMatrix(0, 0);
+        for (int32_t i=0; i<m_runCount; i++)
+        {
+            const Run &run = m_runs[i];
+            m_render->RenderRange(matrix, run.outlineColor, run.font, run.outline, run.first, run.count);
+        }
+        m_render->RenderDone();
+    }
+
+    m_textCount = 0;
+    m_built = false;
+}
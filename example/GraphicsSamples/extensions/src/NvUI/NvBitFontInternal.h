@@ -60,6 +60,11 @@
 #include <string.h>
 #include <string>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BITFONT_SSE 1
+#include <emmintrin.h>
+#endif
+
 struct BFVert
 {
     float pos[2]; // TBD where we add Z support. !!!!TBD
@@ -74,6 +79,61 @@ struct BFVert
 #define IND_PER_QUAD      6
 #define VERT_PER_QUAD     4
 
+//========================================================================
+// Copies glyph quads, moving them by the given offset, one vertex at a
+// time like each text does when it's rendered on its own.
+//========================================================================
+inline void CopyGlyphQuadsScalar(BFVert *dest, const BFVert *src, int32_t count, float x, float y)
+{
+    for (int32_t i=0; i<count*VERT_PER_QUAD; i++)
+    {
+        dest[i] = src[i];
+        dest[i].pos[0] += x;
+        dest[i].pos[1] += y;
+    }
+}
+
+//========================================================================
+// Copies glyph quads, moving them by the given offset.  A quad is four
+// 20 byte vertices, so with SSE it is moved as five vectors, where only the
+// position lanes are offset and the packed color lanes are kept as is.
+//========================================================================
+inline void CopyGlyphQuads(BFVert *dest, const BFVert *src, int32_t count, float x, float y)
+{
+#if BITFONT_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 offsets[5] = {
+        _mm_setr_ps(x, y, 0, 0),
+        _mm_setr_ps(0, x, y, 0),
+        _mm_setr_ps(0, 0, x, y),
+        _mm_setr_ps(0, 0, 0, x),
+        _mm_setr_ps(y, 0, 0, 0)
+    };
+    // the color of vertex i is lane i of vector i+1
+    const __m128 colorMasks[5] = {
+        zero,
+        _mm_castsi128_ps(_mm_setr_epi32(-1, 0, 0, 0)),
+        _mm_castsi128_ps(_mm_setr_epi32(0, -1, 0, 0)),
+        _mm_castsi128_ps(_mm_setr_epi32(0, 0, -1, 0)),
+        _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1))
+    };
+
+    const float *s = &src->pos[0];
+    float *d = &dest->pos[0];
+    for (int32_t i=0; i<count; i++, s+=20, d+=20)
+    {
+        for (int32_t k=0; k<5; k++)
+        {
+            const __m128 v = _mm_loadu_ps(s + 4*k);
+            const __m128 moved = _mm_add_ps(v, offsets[k]);
+            _mm_storeu_ps(d + 4*k, _mm_or_ps(_mm_and_ps(colorMasks[k], v), _mm_andnot_ps(colorMasks[k], moved)));
+        }
+    }
+#else
+    CopyGlyphQuadsScalar(dest, src, count, x, y);
+#endif
+}
+
 class NvImage;
 
 class NvBitFontRender {
@@ -116,6 +176,8 @@ public:
     virtual ~NvBFTextRender() { /* */ }
     virtual void RenderPrep() = 0;
     virtual void Render(const float* matrix, const NvPackedColor& color, NvBitFont* font, bool outline, int count) = 0;
+    // draws count quads starting at quad first, which must be less than 16384 quads apart
+    virtual void RenderRange(const float* matrix, const NvPackedColor& color, NvBitFont* font, bool outline, int first, int count) = 0;
     virtual void UpdateText(int count, const BFVert* data, bool midrender) = 0;
     virtual void RenderDone() = 0;
 };
@@ -96,7 +96,8 @@ void NvUIText::StaticCleanup()
 //======================================================================
 //======================================================================
 NvUIText::NvUIText(const char* str, NvUIFontFamily::Enum font, float size, NvUITextAlign::Enum halign)
-: m_size(size)
+: m_batch(NULL)
+, m_size(size)
 {
     m_bftext = new NvBFText();
     
@@ -211,6 +212,13 @@ void NvUIText::Draw(const NvUIDrawState &drawState)
             m_bftext->SetColor(col);
         }
 
+        if (m_batch)
+        {
+            m_bftext->SetCursorPos(m_rect.left, m_rect.top);
+            m_batch->Add(m_bftext);
+            return;
+        }
+
         m_bftext->RenderPrep();
         
         m_bftext->SetCursorPos(m_rect.left, m_rect.top);
@@ -3,6 +3,8 @@
 #include "NV/NvLogs.h"
 #include "NvGLUtils/NvGLSLProgram.h"
 
+#include <string>
+
 #include "CommandBuffer.h"
 #include "CommandKeys.h"
 
@@ -16,9 +18,19 @@ namespace Nv
             std::string name;
             GLuint location = 0;
             GLuint ubo = 0;
+            /// The texture used by the draws of the material, bound by the draw commands.
+            GLuint texture = 0;
             NvGLSLProgram* shader = nullptr;
         };
 
+        /// State changes since the last resetStats.
+        struct Stats
+        {
+            uint32_t shaderChanges = 0;
+            uint32_t uboChanges = 0;
+            uint32_t textureChanges = 0;
+        };
+
         ///@note Returns true if there are more passes to bind.
         CB_FORCE_INLINE bool operator()(cb::MaterialId material) const
         {
@@ -32,11 +44,23 @@ namespace Nv
                 //bind only if different shaders
                 mat.shader->enable();
                 activeShader = mat.shader;
+                ++stats.shaderChanges;
             }
             if (material.id != activeMaterial)
             {
-                // bind material ubo
-                glBindBufferBase(GL_UNIFORM_BUFFER, mat.location, mat.ubo);
+                if (activeMaterial < 0 || mat.ubo != activeUbo || mat.location != activeLocation)
+                {
+                    // bind material ubo
+                    glBindBufferBase(GL_UNIFORM_BUFFER, mat.location, mat.ubo);
+                    activeUbo = mat.ubo;
+                    activeLocation = mat.location;
+                    ++stats.uboChanges;
+                }
+                if (activeMaterial < 0 || mat.texture != activeTexture)
+                {
+                    activeTexture = mat.texture;
+                    ++stats.textureChanges;
+                }
                 activeMaterial = material.id;
             }
 
@@ -55,12 +79,37 @@ namespace Nv
             activeShader = nullptr;
         }
 
+        void resetStats()
+        {
+            stats = Stats();
+        }
+
+        /// Takes the redundancy state of a binder that bound after this one, i.e. the binder of a chunk of
+        /// CommandBuffer::submitParallel, and adds its state changes.
+        void fold(const MaterialBinder& next)
+        {
+            stats.shaderChanges += next.stats.shaderChanges;
+            stats.uboChanges += next.stats.uboChanges;
+            stats.textureChanges += next.stats.textureChanges;
+            activeMaterial = next.activeMaterial;
+            activeShader = next.activeShader;
+            activeUbo = next.activeUbo;
+            activeLocation = next.activeLocation;
+            activeTexture = next.activeTexture;
+        }
+
         std::vector<Material> materials;
+        mutable Stats stats;
         mutable int activeMaterial = -1;
         mutable NvGLSLProgram* activeShader = nullptr;
+        mutable GLuint activeUbo = 0;
+        mutable GLuint activeLocation = 0;
+        mutable GLuint activeTexture = 0;
     };
 }
 
-typedef cb::CommandBuffer<cb::DrawKey, cb::DefaultKeyDecoder, Nv::MaterialBinder> GeometryCommandBuffer;
+// the geometry arena is several MBs, pre-fault it on huge pages to avoid page faults while recording the first frames
+typedef cb::CommandBuffer<cb::DrawKey, cb::DefaultKeyDecoder, Nv::MaterialBinder,
+                          cb::VirtualMemorySource<cb::kMemoryHugePages | cb::kMemoryPrefault>> GeometryCommandBuffer;
 typedef cb::CommandBuffer<uint32_t,cb::DummyKeyDecoder<uint32_t>> DeferredCommandBuffer;
 typedef cb::CommandBuffer<uint16_t,cb::DummyKeyDecoder<uint16_t>> PostProcessCommandBuffer;
@@ -4,6 +4,7 @@
 #include "NV/NvLogs.h"
 #include "NvGLUtils/NvGLSLProgram.h"
 #include "NvGLUtils/NvShapesGL.h"
+#include "NvUI/NvBitFont.h"
 #include "NvSharedVBOGL.h"
 
 namespace cmds
@@ -137,6 +138,12 @@ namespace cmds
         cmd.vbo->EndUpdate();
     }
 
+    void drawTextBatchCommand(const void* data, cb::RenderContext* rc)
+    {
+        auto& cmd = *reinterpret_cast<const DrawTextBatchCommand*>(data);
+        cmd.batch->Render();
+    }
+
     void clearRenderTarget(const void* data, cb::RenderContext* rc)
     {
         auto& cmd = *reinterpret_cast<const ClearRenderTarget*>(data);
@@ -160,5 +167,6 @@ namespace cmds
     const cb::RenderContext::function_t DrawSkyboxCommand::kDispatchFunction = &drawSkyboxCommand;
     const cb::RenderContext::function_t DrawGroundCommand::kDispatchFunction = &drawGroundCommand;
     const cb::RenderContext::function_t VboUpdate::kDispatchFunction = &vboUpdate;
+    const cb::RenderContext::function_t DrawTextBatchCommand::kDispatchFunction = &drawTextBatchCommand;
     const cb::RenderContext::function_t ClearRenderTarget::kDispatchFunction = &clearRenderTarget;
 }
@@ -5,9 +5,11 @@
 
 #include "CommandPacket.h"
 #include "RenderContext.h"
+#include "StagingRing.h"
 
 class ThreadedRenderingGL;
 class NvGLSLProgram;
+class NvBFTextBatch;
 namespace Nv
 {
     class NvSharedVBOGLPool;
@@ -71,6 +73,14 @@ namespace cmds
         size_t size;
     };
 
+    //  Draws the texts queued into a text batch, one draw call per font
+    struct DrawTextBatchCommand
+    {
+        static const cb::RenderContext::function_t kDispatchFunction;
+
+        NvBFTextBatch* batch;
+    };
+
     struct ClearRenderTarget
     {
         static const cb::RenderContext::function_t kDispatchFunction;
@@ -0,0 +1,277 @@
+#include "FrustumCuller.h"
+
+#include <math.h>
+
+#if defined(__AVX__)
+#define CULL_AVX 1
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULL_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace Nv
+{
+    FrustumPlanes FrustumPlanes::fromMatrix(const nv::matrix4f& m)
+    {
+        // Gribb/Hartmann: clip planes are the last row +/- one of the other rows
+        FrustumPlanes planes;
+        for (int p = 0; p < kPlaneCount; ++p)
+        {
+            const int row = p >> 1;
+            const float sign = (p & 1) ? -1.f : 1.f;
+            const float a = m(3, 0) + sign * m(row, 0);
+            const float b = m(3, 1) + sign * m(row, 1);
+            const float c = m(3, 2) + sign * m(row, 2);
+            const float w = m(3, 3) + sign * m(row, 3);
+            const float invLength = 1.f / sqrtf(a * a + b * b + c * c);
+            planes.nx[p] = a * invLength;
+            planes.ny[p] = b * invLength;
+            planes.nz[p] = c * invLength;
+            planes.d[p] = w * invLength;
+        }
+        return planes;
+    }
+
+    void SphereBoundsSoA::resize(size_t count)
+    {
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        radius.resize(count);
+    }
+
+    void BoxBoundsSoA::resize(size_t count)
+    {
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        extentX.resize(count);
+        extentY.resize(count);
+        extentZ.resize(count);
+    }
+
+    namespace
+    {
+        // Appends the lanes set in mask without branching, the index is always
+        // written but only kept if the lane is visible.
+        inline uint32_t appendVisible(uint32_t* visibleIndices, uint32_t count, uint32_t base, int mask, int width)
+        {
+            for (int k = 0; k < width; ++k)
+            {
+                visibleIndices[count] = base + k;
+                count += (mask >> k) & 1;
+            }
+            return count;
+        }
+
+        // Scalar lanes, used for the remainder and on targets without SSE2.
+        struct SphereLane
+        {
+            float r;
+            SphereLane(const SphereBoundsSoA& b, uint32_t i) : r(b.radius[i]) {}
+            float radius(const FrustumPlanes&, int) const { return r; }
+        };
+
+        struct BoxLane
+        {
+            float ex, ey, ez;
+            BoxLane(const BoxBoundsSoA& b, uint32_t i) : ex(b.extentX[i]), ey(b.extentY[i]), ez(b.extentZ[i]) {}
+            float radius(const FrustumPlanes& f, int p) const
+            {
+                return fabsf(f.nx[p]) * ex + fabsf(f.ny[p]) * ey + fabsf(f.nz[p]) * ez;
+            }
+        };
+
+        template <typename Lane, typename Bounds>
+        uint32_t cullScalar(const FrustumPlanes& f, const Bounds& b, uint32_t i, uint32_t end,
+                            uint32_t* visibleIndices, uint32_t count)
+        {
+            for (; i < end; ++i)
+            {
+                const Lane lane(b, i);
+                bool visible = true;
+                for (int p = 0; p < FrustumPlanes::kPlaneCount; ++p)
+                {
+                    const float dist = f.nx[p] * b.x[i] + f.ny[p] * b.y[i] + f.nz[p] * b.z[i] + f.d[p];
+                    visible &= dist + lane.radius(f, p) >= 0.f;
+                }
+                visibleIndices[count] = i;
+                count += visible ? 1 : 0;
+            }
+            return count;
+        }
+
+#if CULL_SSE
+        struct Planes4
+        {
+            __m128 nx[FrustumPlanes::kPlaneCount], ny[FrustumPlanes::kPlaneCount];
+            __m128 nz[FrustumPlanes::kPlaneCount], d[FrustumPlanes::kPlaneCount];
+            __m128 ax[FrustumPlanes::kPlaneCount], ay[FrustumPlanes::kPlaneCount];
+            __m128 az[FrustumPlanes::kPlaneCount];
+
+            explicit Planes4(const FrustumPlanes& f)
+            {
+                for (int p = 0; p < FrustumPlanes::kPlaneCount; ++p)
+                {
+                    nx[p] = _mm_set1_ps(f.nx[p]);
+                    ny[p] = _mm_set1_ps(f.ny[p]);
+                    nz[p] = _mm_set1_ps(f.nz[p]);
+                    d[p] = _mm_set1_ps(f.d[p]);
+                    ax[p] = _mm_set1_ps(fabsf(f.nx[p]));
+                    ay[p] = _mm_set1_ps(fabsf(f.ny[p]));
+                    az[p] = _mm_set1_ps(fabsf(f.nz[p]));
+                }
+            }
+        };
+
+        struct SphereLane4
+        {
+            __m128 r;
+            SphereLane4(const SphereBoundsSoA& b, uint32_t i) : r(_mm_loadu_ps(&b.radius[i])) {}
+            __m128 radius(const Planes4&, int) const { return r; }
+        };
+
+        struct BoxLane4
+        {
+            __m128 ex, ey, ez;
+            BoxLane4(const BoxBoundsSoA& b, uint32_t i)
+                : ex(_mm_loadu_ps(&b.extentX[i]))
+                , ey(_mm_loadu_ps(&b.extentY[i]))
+                , ez(_mm_loadu_ps(&b.extentZ[i]))
+            {
+            }
+            __m128 radius(const Planes4& f, int p) const
+            {
+                return _mm_add_ps(_mm_add_ps(_mm_mul_ps(f.ax[p], ex), _mm_mul_ps(f.ay[p], ey)), _mm_mul_ps(f.az[p], ez));
+            }
+        };
+
+        template <typename Lane, typename Bounds>
+        uint32_t cullSSE(const FrustumPlanes& frustum, const Bounds& b, uint32_t& i, uint32_t end,
+                         uint32_t* visibleIndices, uint32_t count)
+        {
+            const Planes4 f(frustum);
+            const __m128 zero = _mm_setzero_ps();
+            for (; i + 4 <= end; i += 4)
+            {
+                const __m128 x = _mm_loadu_ps(&b.x[i]);
+                const __m128 y = _mm_loadu_ps(&b.y[i]);
+                const __m128 z = _mm_loadu_ps(&b.z[i]);
+                const Lane lane(b, i);
+
+                __m128 outside = zero;
+                for (int p = 0; p < FrustumPlanes::kPlaneCount; ++p)
+                {
+                    __m128 dist = _mm_add_ps(_mm_mul_ps(f.nx[p], x), _mm_mul_ps(f.ny[p], y));
+                    dist = _mm_add_ps(dist, _mm_add_ps(_mm_mul_ps(f.nz[p], z), f.d[p]));
+                    outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, lane.radius(f, p)), zero));
+                }
+                count = appendVisible(visibleIndices, count, i, ~_mm_movemask_ps(outside) & 0xF, 4);
+            }
+            return count;
+        }
+#endif
+
+#if CULL_AVX
+        struct Planes8
+        {
+            __m256 nx[FrustumPlanes::kPlaneCount], ny[FrustumPlanes::kPlaneCount];
+            __m256 nz[FrustumPlanes::kPlaneCount], d[FrustumPlanes::kPlaneCount];
+            __m256 ax[FrustumPlanes::kPlaneCount], ay[FrustumPlanes::kPlaneCount];
+            __m256 az[FrustumPlanes::kPlaneCount];
+
+            explicit Planes8(const FrustumPlanes& f)
+            {
+                for (int p = 0; p < FrustumPlanes::kPlaneCount; ++p)
+                {
+                    nx[p] = _mm256_set1_ps(f.nx[p]);
+                    ny[p] = _mm256_set1_ps(f.ny[p]);
+                    nz[p] = _mm256_set1_ps(f.nz[p]);
+                    d[p] = _mm256_set1_ps(f.d[p]);
+                    ax[p] = _mm256_set1_ps(fabsf(f.nx[p]));
+                    ay[p] = _mm256_set1_ps(fabsf(f.ny[p]));
+                    az[p] = _mm256_set1_ps(fabsf(f.nz[p]));
+                }
+            }
+        };
+
+        struct SphereLane8
+        {
+            __m256 r;
+            SphereLane8(const SphereBoundsSoA& b, uint32_t i) : r(_mm256_loadu_ps(&b.radius[i])) {}
+            __m256 radius(const Planes8&, int) const { return r; }
+        };
+
+        struct BoxLane8
+        {
+            __m256 ex, ey, ez;
+            BoxLane8(const BoxBoundsSoA& b, uint32_t i)
+                : ex(_mm256_loadu_ps(&b.extentX[i]))
+                , ey(_mm256_loadu_ps(&b.extentY[i]))
+                , ez(_mm256_loadu_ps(&b.extentZ[i]))
+            {
+            }
+            __m256 radius(const Planes8& f, int p) const
+            {
+                return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(f.ax[p], ex), _mm256_mul_ps(f.ay[p], ey)),
+                                     _mm256_mul_ps(f.az[p], ez));
+            }
+        };
+
+        template <typename Lane, typename Bounds>
+        uint32_t cullAVX(const FrustumPlanes& frustum, const Bounds& b, uint32_t& i, uint32_t end,
+                         uint32_t* visibleIndices, uint32_t count)
+        {
+            const Planes8 f(frustum);
+            const __m256 zero = _mm256_setzero_ps();
+            for (; i + 8 <= end; i += 8)
+            {
+                const __m256 x = _mm256_loadu_ps(&b.x[i]);
+                const __m256 y = _mm256_loadu_ps(&b.y[i]);
+                const __m256 z = _mm256_loadu_ps(&b.z[i]);
+                const Lane lane(b, i);
+
+                __m256 outside = zero;
+                for (int p = 0; p < FrustumPlanes::kPlaneCount; ++p)
+                {
+                    __m256 dist = _mm256_add_ps(_mm256_mul_ps(f.nx[p], x), _mm256_mul_ps(f.ny[p], y));
+                    dist = _mm256_add_ps(dist, _mm256_add_ps(_mm256_mul_ps(f.nz[p], z), f.d[p]));
+                    outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(dist, lane.radius(f, p)), zero, _CMP_LT_OQ));
+                }
+                count = appendVisible(visibleIndices, count, i, ~_mm256_movemask_ps(outside) & 0xFF, 8);
+            }
+            return count;
+        }
+#endif
+    }
+
+    uint32_t cullSpheres(const FrustumPlanes& frustum, const SphereBoundsSoA& bounds,
+                         uint32_t begin, uint32_t end, uint32_t* visibleIndices)
+    {
+        uint32_t count = 0;
+        uint32_t i = begin;
+#if CULL_AVX
+        count = cullAVX<SphereLane8>(frustum, bounds, i, end, visibleIndices, count);
+#endif
+#if CULL_SSE
+        count = cullSSE<SphereLane4>(frustum, bounds, i, end, visibleIndices, count);
+#endif
+        return cullScalar<SphereLane>(frustum, bounds, i, end, visibleIndices, count);
+    }
+
+    uint32_t cullBoxes(const FrustumPlanes& frustum, const BoxBoundsSoA& bounds,
+                       uint32_t begin, uint32_t end, uint32_t* visibleIndices)
+    {
+        uint32_t count = 0;
+        uint32_t i = begin;
+#if CULL_AVX
+        count = cullAVX<BoxLane8>(frustum, bounds, i, end, visibleIndices, count);
+#endif
+#if CULL_SSE
+        count = cullSSE<BoxLane4>(frustum, bounds, i, end, visibleIndices, count);
+#endif
+        return cullScalar<BoxLane>(frustum, bounds, i, end, visibleIndices, count);
+    }
+}
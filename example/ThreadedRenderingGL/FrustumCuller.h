@@ -0,0 +1,73 @@
+#pragma once
+
+#include "NV/NvMath.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace Nv
+{
+    ///@brief Frustum planes in SoA layout, so each component can be splatted
+    /// into a SIMD register and tested against several bounds at once.
+    ///@note A point p is inside plane i if nx*p.x + ny*p.y + nz*p.z + d >= 0.
+    struct FrustumPlanes
+    {
+        enum { kPlaneCount = 6 };
+
+        float nx[kPlaneCount];
+        float ny[kPlaneCount];
+        float nz[kPlaneCount];
+        float d[kPlaneCount];
+
+        /// Extracts the normalized clip planes of a (GL convention) projection * view matrix.
+        static FrustumPlanes fromMatrix(const nv::matrix4f& projView);
+    };
+
+    ///@brief Bounding spheres in SoA layout.
+    struct SphereBoundsSoA
+    {
+        std::vector<float> x, y, z;
+        std::vector<float> radius;
+
+        void resize(size_t count);
+        size_t size() const { return x.size(); }
+
+        void set(size_t index, const nv::vec3f& center, float r)
+        {
+            x[index] = center.x;
+            y[index] = center.y;
+            z[index] = center.z;
+            radius[index] = r;
+        }
+    };
+
+    ///@brief Axis aligned bounding boxes, as center and half extents, in SoA layout.
+    struct BoxBoundsSoA
+    {
+        std::vector<float> x, y, z;
+        std::vector<float> extentX, extentY, extentZ;
+
+        void resize(size_t count);
+        size_t size() const { return x.size(); }
+
+        void set(size_t index, const nv::vec3f& center, const nv::vec3f& halfExtents)
+        {
+            x[index] = center.x;
+            y[index] = center.y;
+            z[index] = center.z;
+            extentX[index] = halfExtents.x;
+            extentY[index] = halfExtents.y;
+            extentZ[index] = halfExtents.z;
+        }
+    };
+
+    ///@brief Culls the bounds [begin, end) against the frustum, 8 (AVX) or 4 (SSE2) at a time.
+    /// Writes the indices of the visible bounds, in ascending order, to visibleIndices
+    /// and returns their count.
+    ///@note visibleIndices must have room for end - begin indices.
+    ///@note Disjoint ranges can be culled concurrently, e.g. one per worker thread.
+    uint32_t cullSpheres(const FrustumPlanes& frustum, const SphereBoundsSoA& bounds,
+                         uint32_t begin, uint32_t end, uint32_t* visibleIndices);
+    uint32_t cullBoxes(const FrustumPlanes& frustum, const BoxBoundsSoA& bounds,
+                       uint32_t begin, uint32_t end, uint32_t* visibleIndices);
+}
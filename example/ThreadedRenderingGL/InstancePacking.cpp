@@ -0,0 +1,288 @@
+#include "InstancePacking.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PACK_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Both paths multiply and add separately, a contracted multiply-add would only round once and
+// make the scalar remainder of a batch differ from the SSE lanes.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+namespace Nv
+{
+    namespace
+    {
+        const float kSnormMax = 32767.f;
+        const float kTwoPi = 6.28318530718f;
+        const float kInvTwoPi = 1.f / kTwoPi;
+
+        // half float limits, as the bits of the float they are rounded from
+        const uint32_t kHalfExponentBias = (127 - 15) << 23;
+        const uint32_t kHalfMinNormal = 0x38800000;  // 2^-14
+        const uint32_t kHalfOverflow = 0x477ff000;   // 65520, rounds up to infinity
+        const uint32_t kFloatInfinity = 0x7f800000;
+
+        inline int16_t toSnorm(float value)
+        {
+            return (int16_t)lrintf(std::min(std::max(value * kSnormMax, -kSnormMax), kSnormMax));
+        }
+
+        inline float fromSnorm(int16_t value)
+        {
+            return std::max(value / kSnormMax, -1.f);
+        }
+
+        // Octahedral projection of a unit vector, the lower hemisphere is folded over the diagonals.
+        inline void octEncode(float x, float y, float z, float& u, float& v)
+        {
+            const float invSum = 1.f / std::max(fabsf(x) + fabsf(y) + fabsf(z), 1e-20f);
+            u = x * invSum;
+            v = y * invSum;
+            if (z < 0.f)
+            {
+                const float foldedU = copysignf(1.f - fabsf(v), u);
+                const float foldedV = copysignf(1.f - fabsf(u), v);
+                u = foldedU;
+                v = foldedV;
+            }
+        }
+
+        inline nv::vec3f octDecode(float u, float v)
+        {
+            nv::vec3f n(u, v, 1.f - fabsf(u) - fabsf(v));
+            const float t = std::max(-n.z, 0.f);
+            n.x += n.x >= 0.f ? -t : t;
+            n.y += n.y >= 0.f ? -t : t;
+            return nv::normalize(n);
+        }
+
+        // Only its sine is used, whole periods are taken off to keep the half float precise.
+        inline float wrapAnimTime(float time)
+        {
+            return time - (float)(int)(time * kInvTwoPi) * kTwoPi;
+        }
+
+        void packScalar(const PackedInstanceRange& range, const float* instances, uint32_t stride,
+                        const uint32_t* order, uint32_t first, uint32_t count, PackedInstance* packed)
+        {
+            const nv::vec3f invScale(1.f / range.scale.x, 1.f / range.scale.y, 1.f / range.scale.z);
+            for (uint32_t i = first; i < count; ++i)
+            {
+                const float*    src = instances + (order ? order[i] : i) * stride;
+                PackedInstance& dst = packed[i];
+                dst.position[0] = toSnorm((src[0] - range.origin.x) * invScale.x);
+                dst.position[1] = toSnorm((src[1] - range.origin.y) * invScale.y);
+                dst.position[2] = toSnorm((src[2] - range.origin.z) * invScale.z);
+
+                float u, v;
+                octEncode(src[3], src[4], src[5], u, v);
+                dst.heading[0] = toSnorm(u);
+                dst.heading[1] = toSnorm(v);
+
+                dst.animTime = floatToHalf(wrapAnimTime(src[6]));
+            }
+        }
+
+#if PACK_SSE
+        inline __m128i toSnorm4(__m128 value)
+        {
+            const __m128 limit = _mm_set1_ps(kSnormMax);
+            value = _mm_mul_ps(value, limit);
+            value = _mm_min_ps(_mm_max_ps(value, _mm_sub_ps(_mm_setzero_ps(), limit)), limit);
+            // rounds to nearest even, like lrintf
+            return _mm_cvtps_epi32(value);
+        }
+
+        inline __m128 select4(__m128 mask, __m128 a, __m128 b)
+        {
+            return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+        }
+
+        inline __m128i select4(__m128i mask, __m128i a, __m128i b)
+        {
+            return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+        }
+
+        // Same as floatToHalf, the results are in the low 16 bits of each lane.
+        __m128i floatToHalf4(__m128 value)
+        {
+            const __m128i bits = _mm_castps_si128(value);
+            const __m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+            const __m128i absBits = _mm_and_si128(bits, _mm_set1_epi32(0x7fffffff));
+
+            // normal, the mantissa is rounded to nearest even
+            __m128i normal = _mm_sub_epi32(absBits, _mm_set1_epi32(kHalfExponentBias));
+            normal = _mm_add_epi32(normal, _mm_set1_epi32(0xfff));
+            normal = _mm_add_epi32(normal, _mm_and_si128(_mm_srli_epi32(absBits, 13), _mm_set1_epi32(1)));
+            normal = _mm_srli_epi32(normal, 13);
+
+            // denormal
+            const __m128i denormal = _mm_cvtps_epi32(_mm_mul_ps(_mm_castsi128_ps(absBits), _mm_set1_ps(16777216.f)));
+
+            // infinity and nan
+            const __m128i isNan = _mm_cmpgt_epi32(absBits, _mm_set1_epi32(kFloatInfinity));
+            const __m128i special = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(isNan, _mm_set1_epi32(0x200)));
+
+            __m128i result = select4(_mm_cmplt_epi32(absBits, _mm_set1_epi32(kHalfMinNormal)), denormal, normal);
+            result = select4(_mm_cmpgt_epi32(absBits, _mm_set1_epi32(kHalfOverflow - 1)), special, result);
+            return _mm_or_si128(result, sign);
+        }
+
+        // Packs 4 instances at a time, transposed so each register holds one component of the 4.
+        // Returns the count packed, the remainder is left to packScalar.
+        uint32_t packSSE(const PackedInstanceRange& range, const float* instances, uint32_t stride,
+                         const uint32_t* order, uint32_t count, PackedInstance* packed)
+        {
+            const __m128 originX = _mm_set1_ps(range.origin.x);
+            const __m128 originY = _mm_set1_ps(range.origin.y);
+            const __m128 originZ = _mm_set1_ps(range.origin.z);
+            const __m128 invScaleX = _mm_set1_ps(1.f / range.scale.x);
+            const __m128 invScaleY = _mm_set1_ps(1.f / range.scale.y);
+            const __m128 invScaleZ = _mm_set1_ps(1.f / range.scale.z);
+            const __m128 signMask = _mm_set1_ps(-0.f);
+            const __m128 one = _mm_set1_ps(1.f);
+            const __m128 minSum = _mm_set1_ps(1e-20f);
+
+            int32_t position[3][4];
+            int32_t heading[2][4];
+            int32_t animTime[4];
+
+            uint32_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                const float* src[4];
+                for (uint32_t k = 0; k < 4; ++k)
+                    src[k] = instances + (order ? order[i + k] : i + k) * stride;
+
+                // position.xyz, heading.x then heading.xyz, anim time
+                __m128 px = _mm_loadu_ps(src[0]);
+                __m128 py = _mm_loadu_ps(src[1]);
+                __m128 pz = _mm_loadu_ps(src[2]);
+                __m128 unused = _mm_loadu_ps(src[3]);
+                _MM_TRANSPOSE4_PS(px, py, pz, unused);
+                __m128 hx = _mm_loadu_ps(src[0] + 3);
+                __m128 hy = _mm_loadu_ps(src[1] + 3);
+                __m128 hz = _mm_loadu_ps(src[2] + 3);
+                __m128 time = _mm_loadu_ps(src[3] + 3);
+                _MM_TRANSPOSE4_PS(hx, hy, hz, time);
+
+                _mm_storeu_si128((__m128i*)position[0], toSnorm4(_mm_mul_ps(_mm_sub_ps(px, originX), invScaleX)));
+                _mm_storeu_si128((__m128i*)position[1], toSnorm4(_mm_mul_ps(_mm_sub_ps(py, originY), invScaleY)));
+                _mm_storeu_si128((__m128i*)position[2], toSnorm4(_mm_mul_ps(_mm_sub_ps(pz, originZ), invScaleZ)));
+
+                const __m128 absX = _mm_andnot_ps(signMask, hx);
+                const __m128 absY = _mm_andnot_ps(signMask, hy);
+                const __m128 absZ = _mm_andnot_ps(signMask, hz);
+                const __m128 sum = _mm_max_ps(_mm_add_ps(_mm_add_ps(absX, absY), absZ), minSum);
+                const __m128 invSum = _mm_div_ps(one, sum);
+                __m128       u = _mm_mul_ps(hx, invSum);
+                __m128       v = _mm_mul_ps(hy, invSum);
+                const __m128 foldedU = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, v)), _mm_and_ps(signMask, u));
+                const __m128 foldedV = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, u)), _mm_and_ps(signMask, v));
+                const __m128 lower = _mm_cmplt_ps(hz, _mm_setzero_ps());
+                u = select4(lower, foldedU, u);
+                v = select4(lower, foldedV, v);
+                _mm_storeu_si128((__m128i*)heading[0], toSnorm4(u));
+                _mm_storeu_si128((__m128i*)heading[1], toSnorm4(v));
+
+                const __m128 periods = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(time, _mm_set1_ps(kInvTwoPi))));
+                time = _mm_sub_ps(time, _mm_mul_ps(periods, _mm_set1_ps(kTwoPi)));
+                _mm_storeu_si128((__m128i*)animTime, floatToHalf4(time));
+
+                for (uint32_t k = 0; k < 4; ++k)
+                {
+                    PackedInstance& dst = packed[i + k];
+                    dst.position[0] = (int16_t)position[0][k];
+                    dst.position[1] = (int16_t)position[1][k];
+                    dst.position[2] = (int16_t)position[2][k];
+                    dst.animTime = (uint16_t)animTime[k];
+                    dst.heading[0] = (int16_t)heading[0][k];
+                    dst.heading[1] = (int16_t)heading[1][k];
+                }
+            }
+            return i;
+        }
+#endif
+    }
+
+    PackedInstanceRange PackedInstanceRange::fromBounds(const nv::vec3f& boundsMin, const nv::vec3f& boundsMax)
+    {
+        PackedInstanceRange range;
+        range.origin = (boundsMin + boundsMax) * 0.5f;
+        range.scale = nv::max((boundsMax - boundsMin) * 0.5f, nv::vec3f(1e-6f, 1e-6f, 1e-6f));
+        return range;
+    }
+
+    uint16_t floatToHalf(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        const uint32_t sign = (bits >> 16) & 0x8000;
+        const uint32_t absBits = bits & 0x7fffffff;
+
+        if (absBits >= kHalfOverflow)
+            return (uint16_t)(sign | 0x7c00 | (absBits > kFloatInfinity ? 0x200 : 0));
+        if (absBits < kHalfMinNormal)
+            return (uint16_t)(sign | lrintf(fabsf(value) * 16777216.f));
+
+        // rebias the exponent and round the mantissa to nearest even
+        const uint32_t rounded = absBits - kHalfExponentBias + 0xfff + ((absBits >> 13) & 1);
+        return (uint16_t)(sign | (rounded >> 13));
+    }
+
+    float halfToFloat(uint16_t value)
+    {
+        const uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+        const uint32_t exponent = (value >> 10) & 0x1f;
+        const uint32_t mantissa = value & 0x3ff;
+
+        if (exponent == 0)
+        {
+            const float denormal = mantissa * (1.f / 16777216.f);
+            return sign ? -denormal : denormal;
+        }
+
+        uint32_t bits = sign | (mantissa << 13);
+        bits |= exponent == 0x1f ? kFloatInfinity : (exponent << 23) + kHalfExponentBias;
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    void packInstances(const PackedInstanceRange& range, const float* instances, uint32_t stride,
+                       const uint32_t* order, uint32_t count, PackedInstance* packed)
+    {
+        uint32_t first = 0;
+#if PACK_SSE
+        first = packSSE(range, instances, stride, order, count, packed);
+#endif
+        packScalar(range, instances, stride, order, first, count, packed);
+    }
+
+    void packInstancesScalar(const PackedInstanceRange& range, const float* instances, uint32_t stride,
+                             const uint32_t* order, uint32_t count, PackedInstance* packed)
+    {
+        packScalar(range, instances, stride, order, 0, count, packed);
+    }
+
+    void unpackInstance(const PackedInstanceRange& range, const PackedInstance& packed,
+                        nv::vec3f& position, nv::vec3f& heading, float& animTime)
+    {
+        position.x = range.origin.x + fromSnorm(packed.position[0]) * range.scale.x;
+        position.y = range.origin.y + fromSnorm(packed.position[1]) * range.scale.y;
+        position.z = range.origin.z + fromSnorm(packed.position[2]) * range.scale.z;
+        heading = octDecode(fromSnorm(packed.heading[0]), fromSnorm(packed.heading[1]));
+        animTime = halfToFloat(packed.animTime);
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "NV/NvMath.h"
+
+#include <stdint.h>
+
+namespace Nv
+{
+    ///@brief Instance data packed in 12 bytes, decoded by staticfish_VS.
+    struct PackedInstance
+    {
+        int16_t  position[3];  // snorm, relative to the PackedInstanceRange
+        uint16_t animTime;     // half float, wrapped to (-2pi, 2pi) as it only drives a sine
+        int16_t  heading[2];   // snorm, octahedral encoding of the unit heading
+    };
+
+    ///@brief Range of the packed positions, they are decoded as origin + position * scale.
+    struct PackedInstanceRange
+    {
+        nv::vec3f origin;
+        nv::vec3f scale;
+
+        /// The range covering the bounds of the positions to pack.
+        static PackedInstanceRange fromBounds(const nv::vec3f& boundsMin, const nv::vec3f& boundsMax);
+    };
+
+    uint16_t floatToHalf(float value);
+    float halfToFloat(uint16_t value);
+
+    ///@brief Packs instances that start with a float position, heading and animation time,
+    /// 4 (SSE2) at a time.
+    ///@param instances The first float of the first instance.
+    ///@param stride Distance, in floats, between the instances.
+    ///@param order Indices of the instances to pack, in the packed order. Null packs them in order.
+    void packInstances(const PackedInstanceRange& range, const float* instances, uint32_t stride,
+                       const uint32_t* order, uint32_t count, PackedInstance* packed);
+    /// Same as packInstances, one instance at a time. Both produce the same bytes.
+    void packInstancesScalar(const PackedInstanceRange& range, const float* instances, uint32_t stride,
+                             const uint32_t* order, uint32_t count, PackedInstance* packed);
+
+    /// Decodes a packed instance like the vertex shader does.
+    void unpackInstance(const PackedInstanceRange& range, const PackedInstance& packed,
+                        nv::vec3f& position, nv::vec3f& heading, float& animTime);
+}
@@ -0,0 +1,108 @@
+#include "MaterialRegistry.h"
+
+#include <algorithm>
+#include <set>
+#include <tuple>
+
+namespace Nv
+{
+    MaterialRegistry::MaterialRegistry(MaterialBinder& binder)
+        : m_binder(binder)
+    {
+        // first material is a dummy, it's never renumbered
+        if (m_binder.materials.empty())
+            m_binder.materials.resize(1);
+        m_ids.push_back(0);
+        m_remap.push_back(0);
+    }
+
+    uint32_t MaterialRegistry::add(const MaterialBinder::Material& material)
+    {
+        const uint32_t materialId = (uint32_t)m_binder.materials.size();
+        m_binder.materials.push_back(material);
+        m_ids.push_back(materialId);
+        m_remap.push_back(materialId);
+        return (uint32_t)m_ids.size() - 1;
+    }
+
+    MaterialBinder::Material& MaterialRegistry::material(uint32_t handle)
+    {
+        return m_binder.materials[m_ids[handle]];
+    }
+
+    uint32_t MaterialRegistry::id(uint32_t handle) const
+    {
+        return m_ids[handle];
+    }
+
+    size_t MaterialRegistry::count() const
+    {
+        return m_ids.size() - 1;
+    }
+
+    bool MaterialRegistry::update()
+    {
+        const std::vector<MaterialBinder::Material>& materials = m_binder.materials;
+
+        // the state with less distinct values is grouped first, i.e. a texture shared by several
+        // materials that each have their own uniform buffer
+        std::set<GLuint> ubos, textures;
+        for (size_t i = 1; i < materials.size(); ++i)
+        {
+            ubos.insert(materials[i].ubo);
+            textures.insert(materials[i].texture);
+        }
+        const bool textureFirst = textures.size() < ubos.size();
+
+        std::vector<uint32_t> order(materials.size() - 1);
+        for (uint32_t i = 0; i < order.size(); ++i)
+            order[i] = i + 1;
+        std::stable_sort(order.begin(), order.end(), [&materials, textureFirst](uint32_t lhs, uint32_t rhs) {
+            const MaterialBinder::Material& a = materials[lhs];
+            const MaterialBinder::Material& b = materials[rhs];
+            const GLuint first[2] = { textureFirst ? a.texture : a.ubo, textureFirst ? b.texture : b.ubo };
+            const GLuint second[2] = { textureFirst ? a.ubo : a.texture, textureFirst ? b.ubo : b.texture };
+            return std::make_tuple(a.shader, first[0], second[0]) < std::make_tuple(b.shader, first[1], second[1]);
+        });
+
+        bool changed = false;
+        std::vector<MaterialBinder::Material> sorted(materials.size());
+        sorted[0] = materials[0];
+        m_remap[0] = 0;
+        for (uint32_t i = 0; i < order.size(); ++i)
+        {
+            const uint32_t newId = i + 1;
+            m_remap[order[i]] = newId;
+            sorted[newId] = materials[order[i]];
+            changed |= order[i] != newId;
+        }
+        if (!changed)
+            return false;
+
+        m_binder.materials.swap(sorted);
+        for (uint32_t& materialId : m_ids)
+            materialId = m_remap[materialId];
+        m_binder.reset();
+        return true;
+    }
+
+    const std::vector<uint32_t>& MaterialRegistry::remap() const
+    {
+        return m_remap;
+    }
+
+    MaterialRegistry::Transitions MaterialRegistry::transitions() const
+    {
+        Transitions transitions = { 0, 0, 0 };
+        const MaterialBinder::Material* previous = nullptr;
+        for (size_t i = 1; i < m_binder.materials.size(); ++i)
+        {
+            const MaterialBinder::Material& material = m_binder.materials[i];
+            transitions.shaderChanges += !previous || previous->shader != material.shader;
+            transitions.uboChanges += !previous || previous->ubo != material.ubo;
+            transitions.textureChanges += !previous || previous->texture != material.texture;
+            previous = &material;
+        }
+        return transitions;
+    }
+}
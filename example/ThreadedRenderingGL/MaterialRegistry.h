@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Buffers.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace Nv
+{
+    ///@brief Assigns the material ids of a MaterialBinder so that the commands sorted by material id
+    /// bind the materials grouped by shader, then by their uniform buffer and texture.
+    ///@note Materials are registered with a stable handle, their ids are reassigned by update()
+    /// and the keys of the commands must be rebuilt with the new ids.
+    class MaterialRegistry
+    {
+    public:
+        struct Transitions
+        {
+            uint32_t shaderChanges;
+            uint32_t uboChanges;
+            uint32_t textureChanges;
+        };
+
+        explicit MaterialRegistry(MaterialBinder& binder);
+
+        /// Registers a material and returns its handle, the material is bound with id(handle).
+        uint32_t add(const MaterialBinder::Material& material);
+
+        MaterialBinder::Material& material(uint32_t handle);
+        uint32_t id(uint32_t handle) const;
+        size_t count() const;
+
+        /// Renumbers the materials in state order, returns true if any id changed.
+        bool update();
+        /// Maps the material ids before the last update to the current ones.
+        const std::vector<uint32_t>& remap() const;
+
+        /// Returns the state changes when binding all the materials in id order.
+        Transitions transitions() const;
+
+    private:
+        MaterialBinder&       m_binder;
+        std::vector<uint32_t> m_ids;    // id of each handle
+        std::vector<uint32_t> m_remap;  // previous id to current id
+    };
+}
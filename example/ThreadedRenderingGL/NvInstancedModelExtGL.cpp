@@ -60,6 +60,7 @@ namespace Nv
             cmd.texcoordHandle = texcoordHandle;
             cmd.tangentHandle = tangentHandle;
             cmd.pSourceModel = m_pSourceModel;
+            cmd.lod = m_lod;
             CB_DEBUG_COMMAND_TAG(cmd);
             return 1;
         }
@@ -73,8 +74,12 @@ namespace Nv
             cmd.tangentHandle = tangentHandle;
             cmd.pSourceModel = m_pSourceModel;
             cmd.instanceCount = m_instanceCount;
+            cmd.offset = m_pInstancingVertexBinder->GetStride() * m_firstInstance;
+            cmd.lod = m_lod;
             cmd.pInstanceDataStream = m_pInstanceDataStream;
             cmd.pInstancingVertexBinder = m_pInstancingVertexBinder;
+            cmd.constantCount = m_instanceConstantCount;
+            memcpy(cmd.constants, m_instanceConstants, sizeof(cmd.constants));
             CB_DEBUG_COMMAND_TAG(cmd);
             return 1;
         }
@@ -86,8 +91,11 @@ namespace Nv
 
     NvInstancedModelExtGL::NvInstancedModelExtGL(uint32_t instanceCount,
         NvModelExtGL* pSourceModel) :
-        m_instanceCount(instanceCount),
         m_pSourceModel(nullptr),
+        m_firstInstance(0),
+        m_instanceCount(instanceCount),
+        m_lod(0),
+        m_instanceConstantCount(0),
         m_drawKey(0)
     {
         SetSourceModel(pSourceModel);
@@ -96,7 +104,7 @@ namespace Nv
     uint32_t NvInstancedModelExtGL::RenderBatched(GeometryCommandBuffer& geometryCommands, GLint positionHandle, GLint normalHandle, GLint texcoordHandle, GLint tangentHandle)
     {
         bool bFirstBatch = true;
-        uint32_t batchOffset = 0;
+        uint32_t batchOffset = m_pInstancingVertexBinder->GetStride() * m_firstInstance;
         uint32_t batchInstanceCount = m_batchSize;
         uint32_t numDraws = 0;
 
@@ -106,6 +114,8 @@ namespace Nv
         cmd.pInstanceDataStream = m_pInstanceDataStream;
         cmd.pInstancingVertexBinder = m_pInstancingVertexBinder;
         cmd.activate = true;
+        cmd.constantCount = m_instanceConstantCount;
+        memcpy(cmd.constants, m_instanceConstants, sizeof(cmd.constants));
         CB_DEBUG_COMMAND_SET_MSG(cmd, "Activate binder");
 
         // Invoke the number of draws required to render all of our instances, while limiting
@@ -130,6 +140,7 @@ namespace Nv
             renderCmd.pSourceModel = m_pSourceModel;
             renderCmd.instanceCount = batchInstanceCount;
             renderCmd.offset = batchOffset;
+            renderCmd.lod = m_lod;
             renderCmd.pInstanceDataStream = m_pInstanceDataStream;
             renderCmd.pInstancingVertexBinder = m_pInstancingVertexBinder;
             CB_DEBUG_COMMAND_TAG(renderCmd);
@@ -150,15 +161,20 @@ namespace Nv
     void NvInstancedModelExtGL::RenderInstancedUpdate::execute() const
     {
         pInstancingVertexBinder->UpdatePointers(pInstanceDataStream, offset);
-        pSourceModel->DrawElements(instanceCount, positionHandle, normalHandle, texcoordHandle, tangentHandle);
+        pSourceModel->DrawElements(instanceCount, positionHandle, normalHandle, texcoordHandle, tangentHandle, lod);
     }
 
     void NvInstancedModelExtGL::RenderInstanced::execute() const
     {
         // Activate the instancing data by binding the instance data stream and setting
         // up all of the offsets into each of the attributes
-        pInstancingVertexBinder->Activate(pInstanceDataStream);
-        pSourceModel->DrawElements(instanceCount, positionHandle, normalHandle, texcoordHandle, tangentHandle);
+        pInstancingVertexBinder->Activate(pInstanceDataStream, constants, constantCount);
+        if (offset != 0)
+        {
+            // Start from the first instance of the range
+            pInstancingVertexBinder->UpdatePointers(pInstanceDataStream, offset);
+        }
+        pSourceModel->DrawElements(instanceCount, positionHandle, normalHandle, texcoordHandle, tangentHandle, lod);
         pInstancingVertexBinder->Deactivate();
     }
 
@@ -167,7 +183,7 @@ namespace Nv
         if (activate) {
             // Activate the instancing data by binding the instance data stream and setting
             // up all of the offsets into each of the attributes
-            pInstancingVertexBinder->Activate(pInstanceDataStream);
+            pInstancingVertexBinder->Activate(pInstanceDataStream, constants, constantCount);
         }
         else {
             pInstancingVertexBinder->Deactivate();
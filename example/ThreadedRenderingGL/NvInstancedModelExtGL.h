@@ -36,7 +36,9 @@
 
 #include "NvGLUtils/NvModelExtGL.h"
 #include "NvSharedVBOGL.h"
+#include <algorithm>
 #include <map>
+#include <string.h>
 
 #include "Buffers.h"
 
@@ -99,6 +101,31 @@ namespace Nv
         /// \param count Number of instances to render when Render() is called
         void SetInstanceCount(uint32_t count) { m_instanceCount = count; }
 
+        /// Sets the range of instances to render when rendering this model.
+        /// \param first Index of the first instance in the instance data streams
+        /// \param count Number of instances to render when Render() is called
+        void SetInstanceRange(uint32_t first, uint32_t count)
+        {
+            m_firstInstance = first;
+            m_instanceCount = count;
+        }
+
+        /// Sets the level of detail of the source model to render
+        /// \param lod Level of detail, 0 being the full detail meshes
+        void SetLod(uint32_t lod) { m_lod = lod; }
+
+        enum { MAX_INSTANCE_CONSTANTS = 2 };
+
+        /// Sets the values of the instancing vertex binder's constant attributes
+        /// for the following renders, e.g. to decode the instance data
+        /// \param pConstants Values of the constant attributes, 4 floats per attribute
+        /// \param count Number of vec4 values, at most MAX_INSTANCE_CONSTANTS
+        void SetInstanceConstants(const float* pConstants, uint32_t count)
+        {
+            m_instanceConstantCount = std::min<uint32_t>(count, MAX_INSTANCE_CONSTANTS);
+            memcpy(m_instanceConstants, pConstants, sizeof(float) * 4 * m_instanceConstantCount);
+        }
+
         /// Enables/Disables instanced rendering
         /// \param pInstancingVertexBinder Pointer to the Vertex Binder that will
         ///                                handle setting up the vertex state for
@@ -137,10 +164,11 @@ namespace Nv
 
             NvModelExtGL* pSourceModel;
             GLint positionHandle, normalHandle, texcoordHandle, tangentHandle;
+            uint32_t lod;
 
             void execute() const
             {
-                pSourceModel->DrawElements(1, positionHandle, normalHandle, texcoordHandle, tangentHandle);
+                pSourceModel->DrawElements(1, positionHandle, normalHandle, texcoordHandle, tangentHandle, lod);
             }
         };
 
@@ -153,6 +181,10 @@ namespace Nv
             NvModelExtGL* pSourceModel;
             GLint positionHandle, normalHandle, texcoordHandle, tangentHandle;
             uint32_t instanceCount;
+            uint32_t offset;
+            uint32_t lod;
+            uint32_t constantCount;
+            float constants[MAX_INSTANCE_CONSTANTS * 4];
 
             void execute() const;
         };
@@ -167,6 +199,7 @@ namespace Nv
             GLint positionHandle, normalHandle, texcoordHandle, tangentHandle;
             uint32_t instanceCount;
             uint32_t offset;
+            uint32_t lod;
 
             void execute() const;
         };
@@ -178,6 +211,8 @@ namespace Nv
             VertexFormatBinder* pInstancingVertexBinder;
             NvSharedVBOGL*  pInstanceDataStream;
             bool activate;
+            uint32_t constantCount;
+            float constants[MAX_INSTANCE_CONSTANTS * 4];
 
             void execute() const;
         };
@@ -198,12 +233,22 @@ namespace Nv
         // Pointer to the model to be instanced
         NvModelExtGL* m_pSourceModel;
 
+        // Index of the first instance to render in the instance data buffer
+        uint32_t m_firstInstance;
+
         // Number of instances in the instance data buffer
         uint32_t m_instanceCount;
 
+        // Level of detail of the source model to render
+        uint32_t m_lod;
+
         // Number of instances to render per draw call
         uint32_t m_batchSize;
 
+        // Values of the instancing vertex binder's constant attributes
+        uint32_t m_instanceConstantCount;
+        float m_instanceConstants[MAX_INSTANCE_CONSTANTS * 4];
+
         cb::DrawKey m_drawKey;
 
         template<class CommandClass>
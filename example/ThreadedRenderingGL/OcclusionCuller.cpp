@@ -0,0 +1,443 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <math.h>
+
+#if defined(__AVX__)
+#define OCCLUSION_AVX 1
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE 1
+#include <emmintrin.h>
+#endif
+
+// The lanes of the scalar, SSE and AVX paths must round their edge functions and depths the same way,
+// a multiply and add fused by the compiler would round them once, in some of the paths only.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+namespace Nv
+{
+    namespace
+    {
+        enum
+        {
+            kMaxClipVertices = 3 + 5,  // a triangle gains at most a vertex per clip plane
+#if OCCLUSION_AVX
+            kMaxLaneCount = 8
+#elif OCCLUSION_SSE
+            kMaxLaneCount = 4
+#else
+            kMaxLaneCount = 1
+#endif
+        };
+
+        // Distance of a clip space vertex to the near, left, right, bottom and top planes,
+        // inside is positive. The far plane is left out, whatever is behind it is culled by the frustum.
+        inline float clipDistance(const float* v, int plane)
+        {
+            switch (plane)
+            {
+            case 0: return v[2] + v[3];
+            case 1: return v[0] + v[3];
+            case 2: return v[3] - v[0];
+            case 3: return v[1] + v[3];
+            default: return v[3] - v[1];
+            }
+        }
+
+        // Clips the polygon against one plane (Sutherland-Hodgman), returns the new vertex count.
+        uint32_t clipPolygon(const float (*in)[4], uint32_t count, float (*out)[4], int plane)
+        {
+            uint32_t outCount = 0;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const float* v0 = in[i];
+                const float* v1 = in[(i + 1) % count];
+                const float  d0 = clipDistance(v0, plane);
+                const float  d1 = clipDistance(v1, plane);
+                if (d0 >= 0.f)
+                {
+                    std::copy(v0, v0 + 4, out[outCount++]);
+                }
+                if ((d0 >= 0.f) != (d1 >= 0.f))
+                {
+                    const float t = d0 / (d0 - d1);
+                    for (int k = 0; k < 4; ++k)
+                        out[outCount][k] = v0[k] + (v1[k] - v0[k]) * t;
+                    ++outCount;
+                }
+            }
+            return outCount;
+        }
+
+        // The pixels whose centers are in [minValue, maxValue], clamped to [0, size).
+        inline void pixelRange(float minValue, float maxValue, uint32_t size, int& first, int& last)
+        {
+            first = std::max((int)ceilf(minValue - 0.5f), 0);
+            last = std::min((int)floorf(maxValue - 0.5f), (int)size - 1);
+        }
+
+        // Keeps the nearest occluder of the pixels [x, x + kLanes) of a row, covered if all of the
+        // edge functions are positive. The scalar, SSE and AVX paths evaluate the same expressions
+        // so the buffer doesn't depend on the instruction set.
+        template <int kLanes>
+        void rasterizeLanes(float* depth, int x, const float* edgeA, const float* rowEdge, float depthA,
+                            float rowDepth);
+
+        template <>
+        inline void rasterizeLanes<1>(float* depth, int x, const float* edgeA, const float* rowEdge,
+                                      float depthA, float rowDepth)
+        {
+            const float px = (float)x + 0.5f;
+            const bool covered = edgeA[0] * px + rowEdge[0] >= 0.f && edgeA[1] * px + rowEdge[1] >= 0.f &&
+                                 edgeA[2] * px + rowEdge[2] >= 0.f;
+            if (covered)
+                depth[x] = std::max(depth[x], depthA * px + rowDepth);
+        }
+
+#if OCCLUSION_SSE
+        template <>
+        inline void rasterizeLanes<4>(float* depth, int x, const float* edgeA, const float* rowEdge,
+                                      float depthA, float rowDepth)
+        {
+            const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+            const __m128 zero = _mm_setzero_ps();
+            __m128 covered = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[0]), px), _mm_set1_ps(rowEdge[0])), zero);
+            covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[1]), px), _mm_set1_ps(rowEdge[1])), zero));
+            covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[2]), px), _mm_set1_ps(rowEdge[2])), zero));
+            const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depthA), px), _mm_set1_ps(rowDepth));
+            _mm_storeu_ps(depth + x, _mm_max_ps(_mm_loadu_ps(depth + x), _mm_and_ps(covered, z)));
+        }
+#endif
+
+#if OCCLUSION_AVX
+        template <>
+        inline void rasterizeLanes<8>(float* depth, int x, const float* edgeA, const float* rowEdge,
+                                      float depthA, float rowDepth)
+        {
+            const __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+            const __m256 zero = _mm256_setzero_ps();
+            __m256 covered = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edgeA[0]), px), _mm256_set1_ps(rowEdge[0])), zero, _CMP_GE_OQ);
+            covered = _mm256_and_ps(covered, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edgeA[1]), px), _mm256_set1_ps(rowEdge[1])), zero, _CMP_GE_OQ));
+            covered = _mm256_and_ps(covered, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edgeA[2]), px), _mm256_set1_ps(rowEdge[2])), zero, _CMP_GE_OQ));
+            const __m256 z = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(depthA), px), _mm256_set1_ps(rowDepth));
+            _mm256_storeu_ps(depth + x, _mm256_max_ps(_mm256_loadu_ps(depth + x), _mm256_and_ps(covered, z)));
+        }
+#endif
+    }
+
+    OcclusionBuffer::OcclusionBuffer(uint32_t width /*= 256*/, uint32_t height /*= 128*/)
+        : m_laneCount(kMaxLaneCount)
+    {
+        resize(width, height);
+        begin(nv::matrix4f());
+    }
+
+    void OcclusionBuffer::resize(uint32_t width, uint32_t height)
+    {
+        m_tilesX = std::max((width + kTileWidth - 1) / kTileWidth, 1u);
+        m_tilesY = std::max((height + kTileHeight - 1) / kTileHeight, 1u);
+        m_width = m_tilesX * kTileWidth;
+        m_height = m_tilesY * kTileHeight;
+        m_blocksX = m_width / kBlockSize;
+
+        m_tileBins.resize(tileCount());
+        m_depth.assign(m_width * m_height, 0.f);
+        m_blockDepth.assign(m_blocksX * (m_height / kBlockSize), 0.f);
+        for (std::vector<uint32_t>& bin : m_tileBins)
+            bin.clear();
+        m_triangles.clear();
+    }
+
+    void OcclusionBuffer::begin(const nv::matrix4f& projView)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            for (int column = 0; column < 4; ++column)
+                m_projView[row][column] = projView(row, column);
+        }
+
+        m_triangles.clear();
+        for (std::vector<uint32_t>& bin : m_tileBins)
+            bin.clear();
+    }
+
+    void OcclusionBuffer::addTriangle(const nv::vec3f& a, const nv::vec3f& b, const nv::vec3f& c)
+    {
+        const nv::vec3f* positions[] = { &a, &b, &c };
+        float clip[3][4];
+        for (int i = 0; i < 3; ++i)
+        {
+            const nv::vec3f& p = *positions[i];
+            for (int row = 0; row < 4; ++row)
+                clip[i][row] = m_projView[row][0] * p.x + m_projView[row][1] * p.y + m_projView[row][2] * p.z + m_projView[row][3];
+        }
+        addPolygon(clip, 3);
+    }
+
+    void OcclusionBuffer::addQuad(const nv::vec3f& a, const nv::vec3f& b, const nv::vec3f& c, const nv::vec3f& d)
+    {
+        addTriangle(a, b, c);
+        addTriangle(a, c, d);
+    }
+
+    void OcclusionBuffer::addPolygon(const float (*clip)[4], uint32_t vertexCount)
+    {
+        // clip in homogeneous space, so the vertices behind the camera never get projected
+        float    polygons[2][kMaxClipVertices][4];
+        uint32_t count = vertexCount;
+        std::copy(clip[0], clip[0] + 4 * vertexCount, polygons[0][0]);
+        for (int plane = 0; plane < 5 && count >= 3; ++plane)
+            count = clipPolygon(polygons[plane & 1], count, polygons[(plane + 1) & 1], plane);
+        if (count < 3)
+            return;
+
+        // 5 planes, the result ended up in the second polygon
+        float screen[kMaxClipVertices][3];
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const float* v = polygons[1][i];
+            const float  invW = 1.f / v[3];
+            screen[i][0] = (v[0] * invW * 0.5f + 0.5f) * m_width;
+            screen[i][1] = (v[1] * invW * 0.5f + 0.5f) * m_height;
+            screen[i][2] = invW;
+        }
+        for (uint32_t i = 2; i < count; ++i)
+            addScreenTriangle(screen[0], screen[i - 1], screen[i]);
+    }
+
+    void OcclusionBuffer::addScreenTriangle(const float* a, const float* b, const float* c)
+    {
+        float area = (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+        if (fabsf(area) < 1e-6f)
+            return;
+        // double sided, wind the edges counter-clockwise
+        if (area < 0.f)
+        {
+            std::swap(b, c);
+            area = -area;
+        }
+
+        Triangle tri;
+        const float* vertices[] = { a, b, c };
+        float minX = a[0], maxX = a[0], minY = a[1], maxY = a[1];
+        for (int i = 0; i < 3; ++i)
+        {
+            const float* v0 = vertices[i];
+            const float* v1 = vertices[(i + 1) % 3];
+            tri.edgeA[i] = v0[1] - v1[1];
+            tri.edgeB[i] = v1[0] - v0[0];
+            tri.edgeC[i] = -(tri.edgeA[i] * v0[0] + tri.edgeB[i] * v0[1]);
+
+            minX = std::min(minX, v0[0]);
+            maxX = std::max(maxX, v0[0]);
+            minY = std::min(minY, v0[1]);
+            maxY = std::max(maxY, v0[1]);
+        }
+        tri.depthA = ((b[2] - a[2]) * (c[1] - a[1]) - (c[2] - a[2]) * (b[1] - a[1])) / area;
+        tri.depthB = ((c[2] - a[2]) * (b[0] - a[0]) - (b[2] - a[2]) * (c[0] - a[0])) / area;
+        tri.depthC = a[2] - tri.depthA * a[0] - tri.depthB * a[1];
+
+        pixelRange(minX, maxX, m_width, tri.minX, tri.maxX);
+        pixelRange(minY, maxY, m_height, tri.minY, tri.maxY);
+        if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+            return;
+
+        const uint32_t index = (uint32_t)m_triangles.size();
+        m_triangles.push_back(tri);
+        for (int ty = tri.minY / kTileHeight; ty <= tri.maxY / kTileHeight; ++ty)
+        {
+            for (int tx = tri.minX / kTileWidth; tx <= tri.maxX / kTileWidth; ++tx)
+                m_tileBins[ty * m_tilesX + tx].push_back(index);
+        }
+    }
+
+    template <int kLanes>
+    void OcclusionBuffer::rasterizeTriangle(const Triangle& tri, int tileX, int tileY)
+    {
+        // the tiles are a multiple of the lane count wide, the lanes never straddle two tiles
+        const int minX = std::max(tri.minX, tileX) & ~(kLanes - 1);
+        const int maxX = std::min(tri.maxX, tileX + kTileWidth - 1);
+        const int minY = std::max(tri.minY, tileY);
+        const int maxY = std::min(tri.maxY, tileY + kTileHeight - 1);
+        for (int y = minY; y <= maxY; ++y)
+        {
+            const float py = (float)y + 0.5f;
+            const float rowEdge[3] = { tri.edgeB[0] * py + tri.edgeC[0], tri.edgeB[1] * py + tri.edgeC[1],
+                                       tri.edgeB[2] * py + tri.edgeC[2] };
+            const float rowDepth = tri.depthB * py + tri.depthC;
+            float*      depth = &m_depth[y * m_width];
+            for (int x = minX; x <= maxX; x += kLanes)
+                rasterizeLanes<kLanes>(depth, x, tri.edgeA, rowEdge, tri.depthA, rowDepth);
+        }
+    }
+
+    void OcclusionBuffer::rasterizeTile(uint32_t tile)
+    {
+        const int tileX = (int)(tile % m_tilesX) * kTileWidth;
+        const int tileY = (int)(tile / m_tilesX) * kTileHeight;
+
+        for (int y = tileY; y < tileY + kTileHeight; ++y)
+            std::fill_n(&m_depth[y * m_width + tileX], (int)kTileWidth, 0.f);
+
+        for (uint32_t index : m_tileBins[tile])
+        {
+            const Triangle& tri = m_triangles[index];
+            switch (m_laneCount)
+            {
+#if OCCLUSION_AVX
+            case 8:
+                rasterizeTriangle<8>(tri, tileX, tileY);
+                break;
+#endif
+#if OCCLUSION_SSE
+            case 4:
+                rasterizeTriangle<4>(tri, tileX, tileY);
+                break;
+#endif
+            default:
+                rasterizeTriangle<1>(tri, tileX, tileY);
+                break;
+            }
+        }
+
+        // keep the farthest pixel of each block of the tile
+        for (int blockY = tileY; blockY < tileY + kTileHeight; blockY += kBlockSize)
+        {
+            for (int blockX = tileX; blockX < tileX + kTileWidth; blockX += kBlockSize)
+            {
+                float farthest = m_depth[blockY * m_width + blockX];
+                for (int y = blockY; y < blockY + kBlockSize; ++y)
+                {
+                    const float* row = &m_depth[y * m_width + blockX];
+                    farthest = std::min(farthest, *std::min_element(row, row + kBlockSize));
+                }
+                m_blockDepth[(blockY / kBlockSize) * m_blocksX + blockX / kBlockSize] = farthest;
+            }
+        }
+    }
+
+    void OcclusionBuffer::rasterize()
+    {
+        for (uint32_t tile = 0; tile < tileCount(); ++tile)
+            rasterizeTile(tile);
+    }
+
+    bool OcclusionBuffer::setLaneCount(uint32_t laneCount)
+    {
+        switch (laneCount)
+        {
+        case 1:
+#if OCCLUSION_SSE
+        case 4:
+#endif
+#if OCCLUSION_AVX
+        case 8:
+#endif
+            m_laneCount = laneCount;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool OcclusionBuffer::isOccluded(const nv::vec3f& center, const nv::vec3f& halfExtents) const
+    {
+        const float(&m)[4][4] = m_projView;
+
+        // nearest clip w of the box, the bounds that reach behind the camera are kept
+        const float minW = m[3][0] * center.x + m[3][1] * center.y + m[3][2] * center.z + m[3][3] -
+                           (fabsf(m[3][0]) * halfExtents.x + fabsf(m[3][1]) * halfExtents.y +
+                            fabsf(m[3][2]) * halfExtents.z);
+        if (minW <= 1e-6f)
+            return false;
+
+        // screen rectangle of the projected corners
+        float clipCenter[4], axes[3][4];
+        for (int row = 0; row < 4; ++row)
+        {
+            clipCenter[row] = m[row][0] * center.x + m[row][1] * center.y + m[row][2] * center.z + m[row][3];
+            axes[0][row] = m[row][0] * halfExtents.x;
+            axes[1][row] = m[row][1] * halfExtents.y;
+            axes[2][row] = m[row][2] * halfExtents.z;
+        }
+        float minX = 1.f, maxX = -1.f, minY = 1.f, maxY = -1.f;
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            float v[4];
+            for (int row = 0; row < 4; ++row)
+            {
+                v[row] = clipCenter[row];
+                for (int axis = 0; axis < 3; ++axis)
+                    v[row] += (corner >> axis) & 1 ? axes[axis][row] : -axes[axis][row];
+            }
+            const float invW = 1.f / v[3];
+            minX = std::min(minX, v[0] * invW);
+            maxX = std::max(maxX, v[0] * invW);
+            minY = std::min(minY, v[1] * invW);
+            maxY = std::max(maxY, v[1] * invW);
+        }
+        minX = (minX * 0.5f + 0.5f) * m_width;
+        maxX = (maxX * 0.5f + 0.5f) * m_width;
+        minY = (minY * 0.5f + 0.5f) * m_height;
+        maxY = (maxY * 0.5f + 0.5f) * m_height;
+        // the frustum culling decides about the bounds out of the view
+        if (maxX < 0.f || maxY < 0.f || minX >= (float)m_width || minY >= (float)m_height)
+            return false;
+
+        const int blockMinX = std::max((int)floorf(minX), 0) / kBlockSize;
+        const int blockMaxX = std::min((int)floorf(maxX), (int)m_width - 1) / kBlockSize;
+        const int blockMinY = std::max((int)floorf(minY), 0) / kBlockSize;
+        const int blockMaxY = std::min((int)floorf(maxY), (int)m_height - 1) / kBlockSize;
+
+        // hidden if the nearest point of the box is behind the farthest occluder of all the blocks it overlaps
+        const float nearest = 1.f / minW;
+        for (int y = blockMinY; y <= blockMaxY; ++y)
+        {
+            const float* blocks = &m_blockDepth[y * m_blocksX];
+            for (int x = blockMinX; x <= blockMaxX; ++x)
+            {
+                if (!(blocks[x] > nearest))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    uint32_t OcclusionBuffer::cullBoxes(const BoxBoundsSoA& bounds, const uint32_t* indices, uint32_t count,
+                                        uint32_t* visibleIndices) const
+    {
+        uint32_t visibleCount = 0;
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            const uint32_t i = indices[k];
+            const nv::vec3f center(bounds.x[i], bounds.y[i], bounds.z[i]);
+            const nv::vec3f halfExtents(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+            visibleIndices[visibleCount] = i;
+            visibleCount += isOccluded(center, halfExtents) ? 0 : 1;
+        }
+        return visibleCount;
+    }
+
+    uint32_t OcclusionBuffer::cullSpheres(const SphereBoundsSoA& bounds, const uint32_t* indices, uint32_t count,
+                                          uint32_t* visibleIndices) const
+    {
+        uint32_t visibleCount = 0;
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            const uint32_t i = indices[k];
+            const nv::vec3f center(bounds.x[i], bounds.y[i], bounds.z[i]);
+            const float     r = bounds.radius[i];
+            visibleIndices[visibleCount] = i;
+            visibleCount += isOccluded(center, nv::vec3f(r, r, r)) ? 0 : 1;
+        }
+        return visibleCount;
+    }
+}
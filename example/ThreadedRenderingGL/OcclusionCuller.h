@@ -0,0 +1,91 @@
+#pragma once
+
+#include "FrustumCuller.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace Nv
+{
+    ///@brief Low resolution depth buffer that a few occluders are rasterized into on the CPU, so the
+    /// bounds hidden behind them can be culled before any of their commands are recorded.
+    ///@note Each pixel keeps the nearest occluder as 1/w of its clip position, which interpolates linearly
+    /// in screen space, and 0 where there is no occluder. Each 8x8 block keeps the farthest of its pixels
+    /// and the bounds are only tested against the blocks they overlap.
+    ///@note The occluders are sampled at the pixel centers, bounds peeking out from behind an occluder edge
+    /// by less than a pixel of the buffer may be culled.
+    class OcclusionBuffer
+    {
+    public:
+        enum
+        {
+            kTileWidth = 64,
+            kTileHeight = 32,
+            kBlockSize = 8
+        };
+
+        ///@param width, height Rounded up to a multiple of the tile size.
+        OcclusionBuffer(uint32_t width = 256, uint32_t height = 128);
+
+        void resize(uint32_t width, uint32_t height);
+        uint32_t width() const { return m_width; }
+        uint32_t height() const { return m_height; }
+        uint32_t tileCount() const { return m_tilesX * m_tilesY; }
+
+        /// Removes the occluders, the next ones are rasterized with the (GL convention) projection * view matrix.
+        void begin(const nv::matrix4f& projView);
+        /// Clips the occluder to the view, in world space, and bins it into the tiles it overlaps.
+        /// Occluders are double sided.
+        void addTriangle(const nv::vec3f& a, const nv::vec3f& b, const nv::vec3f& c);
+        void addQuad(const nv::vec3f& a, const nv::vec3f& b, const nv::vec3f& c, const nv::vec3f& d);
+
+        /// Clears the tile and rasterizes the occluders binned into it, 8 (AVX) or 4 (SSE2) pixels at a time.
+        ///@note Distinct tiles can be rasterized concurrently, e.g. spread over the worker threads.
+        void rasterizeTile(uint32_t tile);
+        void rasterize();
+
+        /// Number of pixels rasterized at a time, the widest the build supports by default. All of the
+        /// lane counts produce the same buffer, returns false if the build doesn't support the count.
+        bool setLaneCount(uint32_t laneCount);
+        uint32_t laneCount() const { return m_laneCount; }
+
+        /// Tests the bounds listed in indices against the occluders and writes the indices of the ones that
+        /// may be visible, in the same order, to visibleIndices. Returns their count.
+        ///@note visibleIndices can be indices, culling a list of visible indices in place.
+        ///@note All the tiles must have been rasterized, then the bounds can be tested concurrently.
+        uint32_t cullBoxes(const BoxBoundsSoA& bounds, const uint32_t* indices, uint32_t count,
+                           uint32_t* visibleIndices) const;
+        uint32_t cullSpheres(const SphereBoundsSoA& bounds, const uint32_t* indices, uint32_t count,
+                             uint32_t* visibleIndices) const;
+
+        /// The nearest occluder 1/w of each pixel, in rows from the bottom of the view.
+        const float* depth() const { return m_depth.data(); }
+        uint32_t occluderCount() const { return (uint32_t)m_triangles.size(); }
+
+    private:
+        // Screen space triangle, the edge and 1/w plane equations are evaluated at the pixel centers.
+        struct Triangle
+        {
+            float edgeA[3], edgeB[3], edgeC[3];
+            float depthA, depthB, depthC;
+            int minX, minY, maxX, maxY;
+        };
+
+        void addPolygon(const float (*clip)[4], uint32_t vertexCount);
+        void addScreenTriangle(const float* a, const float* b, const float* c);
+        template <int kLanes>
+        void rasterizeTriangle(const Triangle& tri, int tileX, int tileY);
+        bool isOccluded(const nv::vec3f& center, const nv::vec3f& halfExtents) const;
+
+        uint32_t m_width, m_height;
+        uint32_t m_tilesX, m_tilesY;
+        uint32_t m_blocksX;
+        uint32_t m_laneCount;
+        float    m_projView[4][4];
+
+        std::vector<Triangle>              m_triangles;
+        std::vector<std::vector<uint32_t>> m_tileBins;
+        std::vector<float>                 m_depth;
+        std::vector<float>                 m_blockDepth;
+    };
+}
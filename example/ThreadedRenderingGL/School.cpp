@@ -38,6 +38,11 @@
 #include "Commands.h"
 #include "NvInstancedModelExtGL.h"
 
+#include <algorithm>
+
+// Bit of the draw key depth holding the level of detail, the depth of the school is below it
+#define LOD_DEPTH_SHIFT 20
+
 Nv::VertexFormatBinder* School::ms_pInstancingVertexBinder = nullptr;
 
 Nv::VertexFormatBinder* School::GetInstancingVertexBinder()
@@ -51,11 +56,25 @@ Nv::VertexFormatBinder* School::GetInstancingVertexBinder()
 		//layout(location = 9) in float a_fInstanceAnimTime;
 		//layout(location = 10) in int a_iSchoolId;
 
+		//layout(location = 11) in vec4 a_vInstanceOrigin;
+		//layout(location = 12) in vec4 a_vInstanceScale;
+
+#if FISH_PACKED_INSTANCES
+		// Normalized position within the school's range, half float animation
+		// time and octahedral heading, the school id is not used by the shaders
+		pNewBinder->AddInstanceAttrib(7, 3, GL_SHORT, GL_FLOAT, GL_TRUE, 1, 0);
+		pNewBinder->AddInstanceAttrib(9, 1, GL_HALF_FLOAT, GL_FLOAT, GL_FALSE, 1, 6);
+		pNewBinder->AddInstanceAttrib(8, 2, GL_SHORT, GL_FLOAT, GL_TRUE, 1, 8);
+#else
 		pNewBinder->AddInstanceAttrib(7, 3, GL_FLOAT, GL_FLOAT, GL_FALSE, 1, 0);
 		pNewBinder->AddInstanceAttrib(8, 3, GL_FLOAT, GL_FLOAT, GL_FALSE, 1, 12);
 		pNewBinder->AddInstanceAttrib(9, 1, GL_FLOAT, GL_FLOAT, GL_FALSE, 1, 24);
 		pNewBinder->AddInstanceAttrib(10, 1, GL_UNSIGNED_INT, GL_INT, GL_FALSE, 1, 28);
-		pNewBinder->SetStride(sizeof(FishInstanceData));
+#endif
+		// Decoding constants of each draw, set by School::Render
+		pNewBinder->AddConstantAttrib(11);
+		pNewBinder->AddConstantAttrib(12);
+		pNewBinder->SetStride(sizeof(InstanceData));
 
 		ms_pInstancingVertexBinder = pNewBinder;
 	}
@@ -74,7 +93,11 @@ School::School()
 	, m_schoolGoal(0.0f, 0.0f, 0.0f)
 	, m_lastCentroid(0.0f, 0.0f, 0.0f)
 	, m_lastRadius(0.0f)
-{}
+	, m_lastBoundsMin(0.0f, 0.0f, 0.0f)
+	, m_lastBoundsMax(0.0f, 0.0f, 0.0f)
+{
+	memset(m_lodCounts, 0, sizeof(m_lodCounts));
+}
 
 School::School(const SchoolFlockingParams& params)
 	: m_pInstancedModel(nullptr)
@@ -89,7 +112,11 @@ School::School(const SchoolFlockingParams& params)
 	, m_schoolGoal(0.0f, 0.0f, 0.0f)
 	, m_lastCentroid(0.0f, 0.0f, 0.0f)
 	, m_lastRadius(0.0f)
-{}
+	, m_lastBoundsMin(0.0f, 0.0f, 0.0f)
+	, m_lastBoundsMax(0.0f, 0.0f, 0.0f)
+{
+	memset(m_lodCounts, 0, sizeof(m_lodCounts));
+}
 
 School::~School()
 {
@@ -152,6 +179,9 @@ bool School::Initialize(uint32_t index,
 		// Initialize the fish book-keeping structures
 	m_fishAnimStates.resize(m_instancesCapacity);
 	m_fishInstanceStates.resize(m_instancesCapacity);
+#if FISH_PACKED_INSTANCES
+	m_packedInstances.resize(m_instancesCapacity);
+#endif
 
 	nv::vec3f centroid(0.0f, 0.0f, 0.0f);
 
@@ -183,10 +213,24 @@ bool School::Initialize(uint32_t index,
 	{
 		m_lastCentroid = centroid;
 	}
+	ComputeBounds();
+	PackInstanceData();
 
 	return true;
 }
 
+void School::ComputeBounds()
+{
+	m_lastBoundsMin = m_lastCentroid;
+	m_lastBoundsMax = m_lastCentroid;
+	for (uint32_t fishIndex = 0; fishIndex < m_instancesActive; ++fishIndex)
+	{
+		const nv::vec3f& position = m_fishInstanceStates[fishIndex].m_position;
+		m_lastBoundsMin = nv::min(m_lastBoundsMin, position);
+		m_lastBoundsMax = nv::max(m_lastBoundsMax, position);
+	}
+}
+
 void School::SetVBOPolicy(Nv::VBOPolicy vboPolicy, Nv::NvSharedVBOGLPool* pVBOPool, uint32_t numFrames)
 {
 	// If we already had a VBO, we need to release it before setting a policy
@@ -244,7 +288,7 @@ void School::SetVBOPolicy(Nv::VBOPolicy vboPolicy, Nv::NvSharedVBOGLPool* pVBOPo
 	}
 	m_currentVBOPolicy = vboPolicy;
 
-	if (!m_pInstanceData->Initialize(sizeof(FishInstanceData) * m_instancesCapacity, numFrames, persistentMapping))
+	if (!m_pInstanceData->Initialize(GetInstanceDataStride() * m_instancesCapacity, numFrames, persistentMapping))
 	{
 		delete m_pInstanceData;
 		m_pInstanceData = nullptr;
@@ -274,11 +318,19 @@ void School::ResetToLocation(const nv::vec3f& loc)
 	}
 	m_lastCentroid = loc;
 	m_schoolGoal = loc;
+	ComputeBounds();
+	PackInstanceData();
 }
 
 void School::SetInstanceCount(uint32_t instances)
 {
 	m_instancesActive = instances;
+	// Until the next animation all the fish use the full detail
+	m_lodOrder.clear();
+	memset(m_lodCounts, 0, sizeof(m_lodCounts));
+	m_lodCounts[0] = instances;
+	ComputeBounds();
+	PackInstanceData();
 	if (nullptr != m_pInstancedModel)
 	{
 		m_pInstancedModel->SetInstanceCount(instances);
@@ -334,10 +386,13 @@ bool School::SetModel(Nv::NvModelExtGL* pModel,
 uint32_t neighborOffset = 0;
 uint32_t neighborSkip = 1;
 
-void School::Animate(float frameTime, SchoolStateManager* pStateManager, bool avoid)
+void School::Animate(float frameTime, SchoolStateManager* pStateManager, bool avoid, const SchoolLodParams& lodParams)
 {
 	// We need to calculate a new centroid
 	nv::vec3f newCentroid = nv::vec3f(0.0f, 0.0f, 0.0f);
+	// ...and bounds, for culling
+	nv::vec3f newBoundsMin = m_lastCentroid;
+	nv::vec3f newBoundsMax = m_lastCentroid;
 	// ...and approximate radius
 	float newRadius2 = 0.0f;
 
@@ -365,15 +420,17 @@ void School::Animate(float frameTime, SchoolStateManager* pStateManager, bool av
 	float neighborDistance2 =
 		m_flockParams.m_neighborDistance * m_flockParams.m_neighborDistance;
 
-	uint32_t numSchools = pStateManager->GetNumReadStates();
-	SchoolState* pSchools = pStateManager->GetReadStates();
+	// Pinned until the end of the animation, the other schools' states of last frame
+	const SchoolStateManager::ReadStates readStates = pStateManager->PinReadStates();
+	uint32_t numSchools = readStates.count();
+	const SchoolState* pSchools = readStates.data();
 
 	// We will avoid, at most, 8 other schools
 	const uint32_t cMaxSchoolsToAvoid = 8;
 	uint32_t schoolsToAvoid[cMaxSchoolsToAvoid];
 	uint32_t numSchoolsToAvoid = 0;
 
-	SchoolState* pSchool = pSchools;
+	const SchoolState* pSchool = pSchools;
 	if (avoid)
 	{
 		// Find schools that are at least as aggressive as our school, and overlap our school
@@ -634,9 +691,13 @@ void School::Animate(float frameTime, SchoolStateManager* pStateManager, bool av
 		// Add our new position to the calculation of the school centroid for
 		// this frame
 		newCentroid += fishInstData.m_position;
+		newBoundsMin = nv::min(newBoundsMin, fishInstData.m_position);
+		newBoundsMax = nv::max(newBoundsMax, fishInstData.m_position);
 	}
 	// Update our centroid based on the school's fish positions
 	m_lastCentroid = newCentroid / m_instancesActive;
+	m_lastBoundsMin = newBoundsMin;
+	m_lastBoundsMax = newBoundsMax;
 
 	// Give a bit of a buffer (20%) to the average radius to account for most 
 	// of the school, but still ignore the outliers
@@ -653,6 +714,9 @@ void School::Animate(float frameTime, SchoolStateManager* pStateManager, bool av
 		pOurState->m_radius = m_lastRadius;
 	}
 
+	SelectLods(lodParams);
+	PackInstanceData();
+
 	// If we are using a pooled VBO, then it is already mapped, so we can go ahead and copy into it in this thread
 	if ((m_currentVBOPolicy == Nv::VBO_POOLED) || (m_currentVBOPolicy == Nv::VBO_POOLED_PERSISTENT))
 	{
@@ -660,16 +724,31 @@ void School::Animate(float frameTime, SchoolStateManager* pStateManager, bool av
 	}
 }
 
-void School::Update(GeometryCommandBuffer& geometryCommands)
+void School::Update(GeometryCommandBuffer& geometryCommands, cb::StagingRing& stagingRing)
 {
 	cb::DrawKey key = cb::DrawKey::makeCustom(cb::ViewLayerType::eHighest, 10);
 
-	size_t size = sizeof(FishInstanceData) * m_instancesActive;
+	const uint32_t size = GetInstanceDataSize();
 	auto& cmd = *geometryCommands.addCommand<cmds::VboUpdate>(key);
 	cmd.vbo = m_pInstanceData;
 	cmd.size = size;
-	// no need to copy data as it will be read only on the main thread, since the animation threads are waiting for work
-	cmd.data = &m_fishInstanceStates[0];
+	// copy to the frame's staging memory so the school can be animated again while the commands are submitted
+	InstanceData* stagingData = stagingRing.alloc<InstanceData>(m_instancesActive);
+	if (nullptr != stagingData)
+	{
+		CopyInstanceData(stagingData);
+		cmd.data = stagingData;
+	}
+	else
+	{
+		// out of staging memory, the live data is read at submit while the animation threads are waiting for the
+		// next frame, i.e. it's still the data of this frame
+#if FISH_PACKED_INSTANCES
+		cmd.data = &m_packedInstances[0];
+#else
+		cmd.data = &m_fishInstanceStates[0];
+#endif
+	}
 	CB_DEBUG_COMMAND_TAG_MSG(cmd, "Update fish data");
 }
 
@@ -680,17 +759,101 @@ void School::UpdateInstanceDataBuffer()
 		return;
 	}
 
-	FishInstanceData* pCurrInstance =
-		(FishInstanceData*)m_pInstanceData->GetData();
+	InstanceData* pCurrInstance =
+		(InstanceData*)m_pInstanceData->GetData();
 	if (nullptr == pCurrInstance)
 	{
 		m_pInstanceData->EndUpdate();
 		return;
 	}
-	memcpy(pCurrInstance, &m_fishInstanceStates[0], sizeof(FishInstanceData) * m_instancesActive);
+	CopyInstanceData(pCurrInstance);
 	m_pInstanceData->EndUpdate();
 }
 
+void School::SelectLods(const SchoolLodParams& lodParams)
+{
+	memset(m_lodCounts, 0, sizeof(m_lodCounts));
+
+	uint32_t lodCount = 1;
+	if ((nullptr != m_pInstancedModel) && (nullptr != m_pInstancedModel->GetModel()))
+	{
+		lodCount = std::min<uint32_t>(m_pInstancedModel->GetModel()->GetLodCount(), SchoolLodParams::MAX_LOD_COUNT);
+	}
+	if ((lodCount <= 1) || (lodParams.m_pixelScale <= 0.0f))
+	{
+		m_lodOrder.clear();
+		m_lodCounts[0] = m_instancesActive;
+		return;
+	}
+
+	// A fish is smaller than a level's size when fishSize / w < size, fish at
+	// or behind the eye plane keep the full detail
+	const float fishSize = 2.0f * nv::length(m_fishHalfExtents) * lodParams.m_pixelScale;
+	const nv::vec4f& depthRow = lodParams.m_depthRow;
+	m_fishLods.resize(m_instancesActive);
+	for (uint32_t fishIndex = 0; fishIndex < m_instancesActive; ++fishIndex)
+	{
+		const nv::vec3f& position = m_fishInstanceStates[fishIndex].m_position;
+		const float w = depthRow.x * position.x + depthRow.y * position.y + depthRow.z * position.z + depthRow.w;
+
+		uint32_t lod = 0;
+		while ((lod + 1 < lodCount) && (fishSize < lodParams.m_lodSizes[lod] * w))
+		{
+			++lod;
+		}
+		m_fishLods[fishIndex] = (uint8_t)lod;
+		++m_lodCounts[lod];
+	}
+
+	// Counting sort of the fish by level
+	uint32_t lodOffsets[SchoolLodParams::MAX_LOD_COUNT];
+	lodOffsets[0] = 0;
+	for (uint32_t lod = 1; lod < SchoolLodParams::MAX_LOD_COUNT; ++lod)
+	{
+		lodOffsets[lod] = lodOffsets[lod - 1] + m_lodCounts[lod - 1];
+	}
+	m_lodOrder.resize(m_instancesActive);
+	for (uint32_t fishIndex = 0; fishIndex < m_instancesActive; ++fishIndex)
+	{
+		m_lodOrder[lodOffsets[m_fishLods[fishIndex]]++] = fishIndex;
+	}
+}
+
+void School::PackInstanceData()
+{
+#if FISH_PACKED_INSTANCES
+	if (0 == m_instancesActive)
+	{
+		return;
+	}
+
+	m_packedRange = Nv::PackedInstanceRange::fromBounds(m_lastBoundsMin, m_lastBoundsMax);
+	NV_ASSERT(m_lodOrder.empty() || (m_lodOrder.size() == m_instancesActive));
+	Nv::packInstances(m_packedRange, &m_fishInstanceStates[0].m_position.x, sizeof(FishInstanceData) / sizeof(float),
+		m_lodOrder.empty() ? nullptr : &m_lodOrder[0], m_instancesActive, &m_packedInstances[0]);
+#endif
+}
+
+void School::CopyInstanceData(InstanceData* pDst) const
+{
+#if FISH_PACKED_INSTANCES
+	// already packed in level of detail order
+	memcpy(pDst, &m_packedInstances[0], sizeof(InstanceData) * m_instancesActive);
+#else
+	if (m_lodOrder.empty())
+	{
+		memcpy(pDst, &m_fishInstanceStates[0], sizeof(FishInstanceData) * m_instancesActive);
+		return;
+	}
+
+	NV_ASSERT(m_lodOrder.size() == m_instancesActive);
+	for (uint32_t i = 0; i < m_instancesActive; ++i)
+	{
+		pDst[i] = m_fishInstanceStates[m_lodOrder[i]];
+	}
+#endif
+}
+
 uint32_t School::Render(const nv::matrix4f& projView, uint32_t batchSize, GeometryCommandBuffer& geometryCommands)
 {
 	uint32_t drawCallCount = 0;
@@ -703,10 +866,36 @@ uint32_t School::Render(const nv::matrix4f& projView, uint32_t batchSize, Geomet
 	nv::vec4f position = projView * nv::vec4f(m_lastCentroid.x, 1.f);
 	float invDepth = (1.f - position.z / position.w);
 	invDepth *= 10000.f;
-	m_pInstancedModel->DrawKey().setDepth(invDepth);
+	const uint32_t depth = std::min((uint32_t)std::max(invDepth, 0.f), (1u << LOD_DEPTH_SHIFT) - 1);
 
+	// One draw per level of detail, over its range of instances.  The level is in the
+	// top bits of the depth, so that the draws of a level sort together, nearest first.
 	m_pInstancedModel->SetBatchSize(batchSize);
-	drawCallCount += m_pInstancedModel->Render(geometryCommands, 0, 1, 2);
+	// The vertex shader decodes the instance positions as origin + position * scale,
+	// and the heading as octahedral when the origin's w is set
+#if FISH_PACKED_INSTANCES
+	const float instanceConstants[8] = {
+		m_packedRange.origin.x, m_packedRange.origin.y, m_packedRange.origin.z, 1.0f,
+		m_packedRange.scale.x, m_packedRange.scale.y, m_packedRange.scale.z, 0.0f };
+#else
+	const float instanceConstants[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f };
+#endif
+	m_pInstancedModel->SetInstanceConstants(instanceConstants, 2);
+	uint32_t firstInstance = 0;
+	for (uint32_t lod = 0; lod < SchoolLodParams::MAX_LOD_COUNT; ++lod)
+	{
+		const uint32_t instanceCount = m_lodCounts[lod];
+		if (0 == instanceCount)
+		{
+			continue;
+		}
+
+		m_pInstancedModel->DrawKey().setDepth(((SchoolLodParams::MAX_LOD_COUNT - 1 - lod) << LOD_DEPTH_SHIFT) | depth);
+		m_pInstancedModel->SetInstanceRange(firstInstance, instanceCount);
+		m_pInstancedModel->SetLod(lod);
+		drawCallCount += m_pInstancedModel->Render(geometryCommands, 0, 1, 2);
+		firstInstance += instanceCount;
+	}
 
 	return drawCallCount;
 }
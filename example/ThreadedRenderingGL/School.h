@@ -44,6 +44,14 @@
 #include "NvSharedVBOGL_Pooled.h"
 
 #include "Buffers.h"
+#include "InstancePacking.h"
+#include "StagingRing.h"
+
+#ifndef FISH_PACKED_INSTANCES
+/// Uploads the instance data of each fish packed in 12 bytes instead of 32,
+/// see Nv::PackedInstance
+#define FISH_PACKED_INSTANCES 1
+#endif
 
 namespace Nv
 {
@@ -138,6 +146,34 @@ public:
 	float m_schoolAvoidanceScale; /// Avoid other schools
 };
 
+/// Class to hold settings for selecting the level of detail each fish
+/// of a school is rendered with, from its projected size
+class SchoolLodParams
+{
+public:
+	enum { MAX_LOD_COUNT = 3 };
+
+	SchoolLodParams()
+		: m_depthRow(0.0f, 0.0f, 0.0f, 0.0f)
+		, m_pixelScale(0.0f)
+	{
+		m_lodSizes[0] = 48.0f;
+		m_lodSizes[1] = 16.0f;
+	}
+
+	/// Row of the projection-view matrix giving the clip space w of a
+	/// world space position
+	nv::vec4f m_depthRow;
+
+	/// Size, in pixels, of a unit long object at a clip space w of one.
+	/// Zero disables the selection, rendering every fish at full detail.
+	float m_pixelScale;
+
+	/// Projected size of a fish, in pixels, below which each lower level
+	/// of detail is used
+	float m_lodSizes[MAX_LOD_COUNT - 1];
+};
+
 /// School class holds data required to render a school of fish that share
 /// a model, with per-instance data controlling the position and orientation
 /// of each fish.  Implements flocking behavior for the school of fish.
@@ -276,13 +312,16 @@ public:
 	///                      information for all schools in the simulation
 	/// \param avoid Flag indicating whether the fish in this school should 
 	///				 attempt to avoid other schools
-	void Animate(float frameTime, SchoolStateManager* pStateManager, bool avoid);
+	/// \param lodParams Settings used to select the level of detail of each fish
+	void Animate(float frameTime, SchoolStateManager* pStateManager, bool avoid, const SchoolLodParams& lodParams);
 
 	/// Updates the instance data buffer with the current state of the flocking 
 	/// simulation.
-	void Update(GeometryCommandBuffer& geometryCommands);
+	/// \param stagingRing Per frame memory the instance data is copied to
+	void Update(GeometryCommandBuffer& geometryCommands, cb::StagingRing& stagingRing);
 
-	/// Render the school using GL commands and structures
+	/// Render the school using GL commands and structures, the fish of each
+	/// level of detail are rendered as a separate range of instances
 	/// \param batchSize Number of instances rendered per draw call
 	/// \return Returns the number of draw calls invoked during the Render call
 	uint32_t Render(const nv::matrix4f& projView, uint32_t batchSize, GeometryCommandBuffer& geometryCommands);
@@ -318,9 +357,24 @@ public:
 	///         surrounding the school's fish, centered at the centroid.
 	float GetRadius() const { return m_lastRadius; }
 
+	/// Retrieve the bounds of all of the school's fish in the last update
+	/// \param[out] center center, in world space, of the axis aligned bounds
+	/// \param[out] halfExtents half extents of the bounds, padded by the size
+	///             of a fish so that they contain the whole meshes
+	void GetBounds(nv::vec3f& center, nv::vec3f& halfExtents) const
+	{
+		const float fishRadius = nv::length(m_fishHalfExtents);
+		center = (m_lastBoundsMin + m_lastBoundsMax) * 0.5f;
+		halfExtents = (m_lastBoundsMax - m_lastBoundsMin) * 0.5f + nv::vec3f(fishRadius, fishRadius, fishRadius);
+	}
+
 	/// Retrieves the size of the instance data for a single fish
 	/// \return The size, in bytes, of the instance data for a single instance of a fish
-	static uint32_t GetInstanceDataStride() { return sizeof(FishInstanceData); }
+	static uint32_t GetInstanceDataStride() { return sizeof(InstanceData); }
+
+	/// Retrieves the size of the instance data uploaded for the school
+	/// \return The size, in bytes, of the instance data of all the active fish
+	uint32_t GetInstanceDataSize() const { return GetInstanceDataStride() * m_instancesActive; }
 
 	/// Calculates a new goal for the school, abandoning any previously set goal location.
 	void FindNewGoal();
@@ -334,6 +388,16 @@ private:
 	/// each fish in the school in preparation for rendering.
 	void UpdateInstanceDataBuffer();
 
+	/// Recomputes the bounds from the current fish positions
+	void ComputeBounds();
+
+	/// Selects the level of detail of each fish and orders the fish by it
+	void SelectLods(const SchoolLodParams& lodParams);
+
+	/// Packs the instance data of the fish, in level of detail order, once
+	/// their state and bounds are final for the frame
+	void PackInstanceData();
+
 	static Nv::VertexFormatBinder* ms_pInstancingVertexBinder;
 
 	/// Index of the school to identify it in the SchoolStateManager
@@ -372,6 +436,29 @@ private:
 	/// instance data buffer
 	FishInstanceDataSet m_fishInstanceStates;
 
+	/// Indices of the fish ordered by level of detail, the instance data is
+	/// copied in this order so that each level is a contiguous range of
+	/// instances.  Empty when all the fish use the full detail.
+	std::vector<uint32_t> m_lodOrder;
+	std::vector<uint8_t> m_fishLods;
+
+	/// Number of fish rendered with each level of detail
+	uint32_t m_lodCounts[SchoolLodParams::MAX_LOD_COUNT];
+
+#if FISH_PACKED_INSTANCES
+	typedef Nv::PackedInstance InstanceData;
+
+	/// Instance data of the fish packed in level of detail order, the
+	/// positions are relative to the range of the school's bounds
+	std::vector<Nv::PackedInstance> m_packedInstances;
+	Nv::PackedInstanceRange m_packedRange;
+#else
+	typedef FishInstanceData InstanceData;
+#endif
+
+	/// Copies the instance data of the fish, in level of detail order
+	void CopyInstanceData(InstanceData* pDst) const;
+
 	/// Uniform buffer object providing school-specific parameters to the
 	/// shader
 	SchoolUBO   m_schoolUBO_Data;       // Actual values for the UBO
@@ -399,6 +486,10 @@ private:
 	/// Radius of the school in the last update
 	float m_lastRadius;
 
+	/// Bounds of the school's fish positions in the last update
+	nv::vec3f m_lastBoundsMin;
+	nv::vec3f m_lastBoundsMax;
+
 	SchoolFlockingParams m_flockParams;
 
 	/// Current animation state of each fish in the school
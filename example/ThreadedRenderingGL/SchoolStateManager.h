@@ -34,6 +34,7 @@
 #ifndef SCHOOLSTATEMANAGER_H_
 #define SCHOOLSTATEMANAGER_H_
 #include "NV/NvMath.h"
+#include "SnapshotStore.h"
 
 /// Structure to hold last computed state for a particular School
 struct SchoolState
@@ -47,53 +48,43 @@ struct SchoolState
 };
 
 /// Class to manage a set of states for each school that can be written to
-/// and read from in a lock-free, thread-safe manner.  The "Read" and "Write"
-/// buffers are alternated each frame, so that all threads are either reading
-/// or writing to them, but never both.
+/// and read from in a lock-free, thread-safe manner.  The states written
+/// during a frame are published at the start of the next one, readers pin
+/// the last published states so they stay consistent even while the
+/// following frames are written.
 class SchoolStateManager
 {
 public:
+    typedef cb::SnapshotStore<SchoolState>::Snapshot ReadStates;
+
     /// Constructor. Determines how many schools will be managed
     /// \param maxSchools Maximum number of school states contained in the buffer
     SchoolStateManager(uint32_t maxSchools)
-        : m_capacity(maxSchools)
-        , m_numReadStates(0)
+        : m_states(maxSchools, 3)
         , m_numWriteStates(0)
+        , m_writeBuffer(nullptr)
     {
-        m_readBuffer = new SchoolState[maxSchools];
-        m_writeBuffer = new SchoolState[maxSchools];
     }
 
-    ~SchoolStateManager()
-    {
-        delete[] m_readBuffer;
-        delete[] m_writeBuffer;
-    }
-
-    /// Swap the write buffer to the read buffer in preparation for updating
-    /// the next frame
+    /// Publish the states written last frame and start writing the next
+    /// ones.  Waits if readers still pin the version that is rewritten.
     /// \param numSchools Number of active schools this frame
     void BeginFrame(uint32_t numSchools)
     {
-        // Swap the read and write buffers
-        SchoolState* pTemp = m_writeBuffer;
-        m_writeBuffer = m_readBuffer;
-        m_readBuffer = pTemp;
-
-        // The number of readable states is the number of states
-        // that were written last frame
-        m_numReadStates = m_numWriteStates;
+        if (nullptr != m_writeBuffer)
+        {
+            m_states.publish();
+        }
 
         // The number of writable states is the number passed in
         m_numWriteStates = numSchools;
+        m_writeBuffer = m_states.beginWrite(numSchools);
     }
 
-    /// Return the number of states written to last frame, thus readable this frame
-    /// \return The number of states in the readable buffer
-    uint32_t GetNumReadStates() const { return m_numReadStates; }
-
-    /// Retrieve a pointer to the readable buffer of SchoolStates for this frame
-    SchoolState* GetReadStates() { return m_readBuffer; }
+    /// Pin the states written last frame, they are not modified until the
+    /// returned snapshot is released
+    /// \return The readable states, empty before the first frame was published
+    ReadStates PinReadStates() const { return m_states.acquire(); }
 
     /// Return the number of states writable to for this frame
     /// \return The number of states in the writable buffer
@@ -103,19 +94,9 @@ public:
     SchoolState* GetWriteStates() { return m_writeBuffer; }
 
 protected:
-    /// Default constructor.  Unavailable as the maximum 
-    /// number of states must be declared at creation time.
-    SchoolStateManager() {}
-
-    /// Maximum number of SchoolStates that can be held in the
-    /// readable/writable buffers
-    uint32_t m_capacity;
-
-    /// Current number of SchoolStates in m_readBuffer
-    uint32_t m_numReadStates;
-
-    /// Pointer to the currently readable set of SchoolStates
-    SchoolState* m_readBuffer;
+    /// Versions of the SchoolStates, one written while the previous ones
+    /// are read
+    cb::SnapshotStore<SchoolState> m_states;
 
     /// Current number of SchoolStates in m_writeBuffer
     uint32_t m_numWriteStates;
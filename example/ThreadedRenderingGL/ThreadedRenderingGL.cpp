@@ -35,6 +35,7 @@
 
 #include "Commands.h"
 #include "cmds/GLCommands.h"
+#include "RadixSort.h"
 
 #include "NvAppBase/NvFramerateCounter.h"
 #include "NvAppBase/NvInputHandler_CameraFly.h"
@@ -53,6 +54,7 @@
 #include <stdint.h>
 
 #include <ctime>
+#include <thread>
 
 int commandLogFunction(const char* fmt, ...)
 {
@@ -67,57 +69,6 @@ int commandLogFunction(const char* fmt, ...)
     return 0;
 }
 
-template<typename T>
-void countingSort(T* arr, int N, uint64_t p)
-{
-    static T output[10000];
-    assert(N < 10000);
-
-    int count[10] = { 0 }; //keeping count if digits <=9
-
-    for (int i = 0; i < N; i++)
-        count[((uint64_t)arr[i] / p) % 10]++;
-
-    //Applying counting sort so now the array contains actual position of the digits
-    for (int i = 1; i < 10; i++) {
-        count[i] += count[i - 1];
-    }
-
-    //staring from N-1 helps to keep digits in order
-    for (int i = N - 1; i >= 0; i--) {
-        uint64_t val = (uint64_t)arr[i] / p;
-        output[count[val % 10] - 1] = arr[i];
-        count[val % 10]--;
-    }
-
-    for (int i = 0; i < N; i++)
-        arr[i] = output[i];
-}
-
-template<typename T>
-void radixsort(T* begin, T* end)
-{
-    size_t N = std::distance(begin, end);
-    uint64_t max = 0;
-
-    for (size_t i = 0; i < N; i++)
-    {
-        uint64_t val = (uint64_t)begin[i];
-        max = std::max(max, val);
-    }
-
-    uint64_t p = 1;
-    uint64_t pass = 1;
-
-    while (max / p > 0) {
-        countingSort(begin, N, p);
-        pass++;
-        p *= 10;
-    }
-
-    std::reverse(begin, end); // could flip keys
-}
-
 #define ARRAY_SIZE(a) ( sizeof(a) / sizeof( (a)[0] ))
 #define NV_UNUSED( variable ) ( void )( variable )
 
@@ -135,6 +86,13 @@ void radixsort(T* begin, T* end)
 #define MAX_SCHOOL_COUNT 1000
 #endif
 
+// Levels of detail of the fish models, each keeping about half of the triangles
+// of the previous one, as long as the surface moves less than the max error
+// (relative to the fish size)
+#define FISH_LOD_COUNT 3
+#define FISH_LOD_REDUCTION 0.5f
+#define FISH_LOD_MAX_ERROR 0.1f
+
 #if STRESS_TEST
 #define SCHOOL_COUNT MAX_SCHOOL_COUNT
 #else 
@@ -175,19 +133,57 @@ void* helperJobFunctionThunk(void *arg)
     return 0;
 }
 
+// Global function passed to the loader threads at startup, each of which
+// loads an interleaved slice of the fish models and scene textures
+#ifdef _WIN32
+DWORD WINAPI loadAssetsJobFunctionThunk(VOID *arg)
+#else
+void* loadAssetsJobFunctionThunk(void *arg)
+#endif
+{
+    ThreadedRenderingGL::ThreadData* data = (ThreadedRenderingGL::ThreadData*)arg;
+    data->m_app->loadAssetsJobFunction(data->m_index);
+
+    return 0;
+}
+
 bool ThreadedRenderingGL::waitForWork(ThreadData& me, int threadIndex)
 {
+    TRACE_SCOPE(TRACE_THREAD_BASE_WAIT + me.m_index);
+
     // We use the m_frameStartCV condition variable to wake threads up 
     // and notify them that there is work available to be done.  The 
     // condition variable is protected by the m_frameStartLock mutex.
     m_frameStartLock->lockMutex();
     {
         // Sleep the thread until there is work to be done
-        if (m_frameID == me.m_frameID) {
+        if (m_frameID == me.m_frameID && m_taskID == me.m_taskID) {
             m_frameStartCV->waitConditionVariable(
                 m_frameStartLock);
         }
 
+        // Tasks are only given between frames, and all active animation
+        // threads take part in them, see runOnAnimationThreads
+        const bool newTasks = m_taskID != me.m_taskID && m_frameID == me.m_frameID;
+        me.m_taskID = m_taskID;
+        if (newTasks && m_running)
+        {
+            const bool active = threadIndex >= 0 && threadIndex < (int)m_activeAnimationThreads;
+            m_frameStartLock->unlockMutex();
+            if (active)
+            {
+                runTasks();
+
+                m_doneCountLock->lockMutex();
+                {
+                    m_taskThreadsDone++;
+                    m_doneCountCV->signalConditionVariable();
+                }
+                m_doneCountLock->unlockMutex();
+            }
+            return true;
+        }
+
         me.m_frameID = m_frameID;
 
         // See if we were told to stop running while we
@@ -232,12 +228,58 @@ void ThreadedRenderingGL::signalWorkComplete(uint32_t workCountDone)
     m_doneCountLock->unlockMutex();
 }
 
+void ThreadedRenderingGL::runOnAnimationThreads(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+{
+    // Nothing to share without the threads
+    if (nullptr == m_frameStartLock || taskCount < 2)
+    {
+        for (uint32_t i = 0; i < taskCount; i++)
+            task(i);
+        return;
+    }
+
+    // The threads are waiting for the next frame, wake them up for the tasks
+    uint32_t threadCount;
+    m_frameStartLock->lockMutex();
+    {
+        m_task = &task;
+        m_taskCount = taskCount;
+        m_nextTask = 0;
+        // the threads of the previous tasks are all done with it
+        m_taskThreadsDone = 0;
+        m_taskID++;
+        threadCount = m_activeAnimationThreads;
+        m_frameStartCV->broadcastConditionVariable();
+    }
+    m_frameStartLock->unlockMutex();
+
+    runTasks();
+
+    // The tasks the threads took are done once all of them found no more tasks
+    m_doneCountLock->lockMutex();
+    {
+        while (m_taskThreadsDone != threadCount)
+        {
+            m_doneCountCV->waitConditionVariable(m_doneCountLock);
+        }
+    }
+    m_doneCountLock->unlockMutex();
+}
+
+void ThreadedRenderingGL::runTasks()
+{
+    for (uint32_t i = m_nextTask++; i < m_taskCount; i = m_nextTask++)
+        (*m_task)(i);
+}
+
 void ThreadedRenderingGL::animateJobFunction(uint32_t threadIndex)
 {
     NvThreadManager* threadManager = getThreadManagerInstance();
     NV_ASSERT(nullptr != threadManager);
     ThreadData& me = m_threads[threadIndex];
     me.m_frameID = 0;
+    me.m_taskID = 0;
+    m_trace.setThreadName("Animation");
 
     // Our m_running member gives us a mechanism to signal all worker threads
     // to quit when we need to shut them all down
@@ -274,6 +316,14 @@ void ThreadedRenderingGL::animateJobFunction(uint32_t threadIndex)
 
             const nv::matrix4f projView = m_projUBO_Data.m_projectionMatrix * m_projUBO_Data.m_viewMatrix;
 
+            // The fish levels of detail are selected from their projected size in the render targets
+            SchoolLodParams lodParams;
+            lodParams.m_depthRow = projView.get_row(3);
+            if (m_fishLods)
+            {
+                lodParams.m_pixelScale = m_projUBO_Data.m_projectionMatrix._array[5] * m_imageHeight * 0.5f;
+            }
+
             schoolsDone = me.m_schoolCount;
             if (!m_animPaused || m_forceUpdateMode != ForceUpdateMode::eNone)
             {
@@ -285,9 +335,42 @@ void ThreadedRenderingGL::animateJobFunction(uint32_t threadIndex)
                     CPU_TIMER_SCOPE(CPU_TIMER_THREAD_BASE_ANIMATE + threadIndex);
                     if (m_forceUpdateMode != ForceUpdateMode::eForceDispatch)
                     {
-                        m_schools[i]->Animate(getClampedFrameTime(), &m_schoolStateMgr, m_avoidance);
-                        // Dispatch vbo update commands
-                        m_schools[i]->Update(m_geometryCommands);
+                        m_schools[i]->Animate(getClampedFrameTime(), &m_schoolStateMgr, m_avoidance, lodParams);
+                        // the pooled policies copy the instance data to the vbo while animating
+                        if ((m_currentVBOPolicy == Nv::VBO_POOLED) || (m_currentVBOPolicy == Nv::VBO_POOLED_PERSISTENT))
+                            m_schoolsUploadSize[i] += m_schools[i]->GetInstanceDataSize();
+                    }
+
+                    nv::vec3f center, halfExtents;
+                    m_schools[i]->GetBounds(center, halfExtents);
+                    m_schoolsBounds.set(i, center, halfExtents);
+                    m_schoolsDrawCount[i] = 0;
+                }
+
+                // Cull our range of schools and only generate keys and render
+                // commands for the visible ones
+                const Nv::FrustumPlanes frustum = Nv::FrustumPlanes::fromMatrix(projView);
+                uint32_t* visibleSchools = m_visibleSchools.data() + me.m_baseSchoolIndex;
+                uint32_t visibleCount =
+                    Nv::cullBoxes(frustum, m_schoolsBounds, me.m_baseSchoolIndex, schoolMax, visibleSchools);
+                if (m_useOcclusionCulling)
+                {
+                    CPU_TIMER_SCOPE(CPU_TIMER_THREAD_BASE_OCCLUSION + threadIndex);
+                    rasterizeOcclusionTiles();
+                    const uint32_t unoccludedCount =
+                        m_occlusionBuffer.cullBoxes(m_schoolsBounds, visibleSchools, visibleCount, visibleSchools);
+                    m_occlusionTestedCount += visibleCount;
+                    m_occlusionCulledCount += visibleCount - unoccludedCount;
+                    visibleCount = unoccludedCount;
+                }
+                for (uint32_t v = 0; v < visibleCount; ++v)
+                {
+                    const uint32_t i = visibleSchools[v];
+                    // Dispatch vbo update commands, culled schools are uploaded once visible again
+                    if (m_forceUpdateMode != ForceUpdateMode::eForceDispatch)
+                    {
+                        m_schools[i]->Update(m_geometryCommands, m_stagingRing);
+                        m_schoolsUploadSize[i] += m_schools[i]->GetInstanceDataSize();
                     }
                     // Dispatch render commands
                     m_schoolsDrawCount[i] = m_schools[i]->Render(projView, m_uiBatchSize, m_geometryCommands);
@@ -315,9 +398,9 @@ void ThreadedRenderingGL::animateJobFunction(uint32_t threadIndex)
                 if (!m_animPaused || m_bForceSchoolUpdate)
                 {
                     CPU_TIMER_SCOPE(CPU_TIMER_THREAD_BASE_ANIMATE + threadIndex);
-                    job.school->Animate(getClampedFrameTime(), &m_schoolStateMgr, m_avoidance);
+                    job.school->Animate(getClampedFrameTime(), &m_schoolStateMgr, m_avoidance, SchoolLodParams());
                     // Dispatch vbo update commands
-                    job.school->Update(m_geometryCommands);
+                    job.school->Update(m_geometryCommands, m_stagingRing);
                     // Dispatch render commands
                     m_schoolsDrawCount[i] = job.school->Render(m_uiBatchSize, m_geometryCommands);
                 }
@@ -344,6 +427,8 @@ void ThreadedRenderingGL::helperJobFunction()
     const uint32_t threadIndex = m_activeAnimationThreads;
     ThreadData& me = m_threads[threadIndex];
     me.m_frameID = 0;
+    me.m_taskID = 0;
+    m_trace.setThreadName("Helper");
 
     while (m_running)
     {
@@ -372,33 +457,7 @@ void ThreadedRenderingGL::helperJobFunction()
             CB_DEBUG_COMMAND_TAG_MSG(cmd, "Wait on fences");
         }
 
-#if !SIMPLE_DEMO
-        // Update the camera position if we are following a school
-        if (m_uiCameraFollow)
-        {
-            if (m_uiSchoolInfoId < m_activeSchools)
-            {
-                // Get the centroid of the school we're following
-                School* pSchool = m_schools[m_uiSchoolInfoId];
-                nv::vec3f camPos = pSchool->GetCentroid() - (m_pInputHandler->getLookVector() * pSchool->GetRadius() * 4);
-                if (camPos.y < 0.01f)
-                {
-                    camPos.y = 0.01f;
-                }
-                m_pInputHandler->setPosition(camPos);
-            }
-            else
-            {
-                m_uiCameraFollow = false;
-                m_bUIDirty = true;
-                updateUI();
-            }
-        }
-#endif
         updateSchoolTankSizes();
-    
-        m_projUBO_Data.m_viewMatrix = m_pInputHandler->getViewMatrix();
-        m_projUBO_Data.m_inverseViewMatrix = m_pInputHandler->getCameraMatrix();
 
         // NOTE. could create enums with priorities for better management
         {
@@ -407,11 +466,12 @@ void ThreadedRenderingGL::helperJobFunction()
             // Get the current view matrix (according to user input through mouse,
             // gamepad, etc.)
             cmd->projUBO_Id = m_projUBO_Id;
-            cmd->projUBO_Data = m_projUBO_Data;
+            cmd->projUBO_Block = m_geometryCommands.addConstantBlock(m_projUBO_Data);
             cmd->lightingUBO_Id = m_lightingUBO_Id;
-            cmd->lightingUBO_Data = m_lightingUBO_Data;
-            cmd->lightingUBO_Data.m_causticOffset = m_currentTime * m_causticSpeed;
-            cmd->lightingUBO_Data.m_causticTiling = m_causticTiling;
+            LightingUBO lightingUBO_Data = m_lightingUBO_Data;
+            lightingUBO_Data.m_causticOffset = m_currentTime * m_causticSpeed;
+            lightingUBO_Data.m_causticTiling = m_causticTiling;
+            cmd->lightingUBO_Block = m_geometryCommands.addConstantBlock(lightingUBO_Data);
             cmd->materialBinder = &m_geometryCommands.materialBinder();
             CB_DEBUG_COMMAND_TAG(cmd);
         }
@@ -471,6 +531,11 @@ void ThreadedRenderingGL::helperJobFunction()
         }
 
         // deferred commands
+        GBufferTextures gbufferTextures;
+        for (int i = 0; i < GBUFFER_COUNT; ++i)
+            gbufferTextures.tex[i] = m_texGBuffer[i];
+        // recorded once, all the lighting commands reference it
+        const uint32_t gbufferBlock = m_deferredCommands.addConstantBlock(gbufferTextures);
         {
             auto& cmd = *m_deferredCommands.addCommand<BeginDeferredCommand>(0);
             cmd.mainFboId = getMainFBO();
@@ -479,13 +544,13 @@ void ThreadedRenderingGL::helperJobFunction()
             auto& drawCmd = *m_deferredCommands.appendCommand<DrawDirectionalLightCommand>(&cmd);
             drawCmd.brdf = m_brdf;
             drawCmd.shader = m_shader_DirectionalLight;
+            drawCmd.uniforms = m_directionalLightUniforms;
             drawCmd.fullscreenMVP = nv::matrix4f(); // identity
             drawCmd.lightingUBO_Id = m_lightingUBO_Id;
             drawCmd.lightingUBO_Location = m_lightingUBO_Location;
             drawCmd.projUBO_Id = m_projUBO_Id;
             drawCmd.projUBO_Location = m_projUBO_Location;
-            for (int i = 0; i < GBUFFER_COUNT; ++i)
-                drawCmd.texGBuffer[i] = m_texGBuffer[i];
+            drawCmd.gbufferBlock = gbufferBlock;
             CB_DEBUG_COMMAND_TAG(drawCmd);
 
             auto& pointPassCmd = *m_deferredCommands.appendCommand<BeginPointLightPassCommand>(&drawCmd);
@@ -493,13 +558,19 @@ void ThreadedRenderingGL::helperJobFunction()
         }
 
         // deferred point lights 
-        if (!m_schoolsCentroid.empty() && !m_lightsSchoolIndex.empty())
+        const cb::SnapshotStore<nv::vec3f>::Snapshot schoolsCentroid = m_schoolsCentroid.acquire();
+        if (schoolsCentroid.valid() && !m_lightsSchoolIndex.empty())
         {
             const nv::matrix4f projMatrix = m_projUBO_Data.m_projectionMatrix;
             const nv::matrix4f viewMatrix = m_projUBO_Data.m_viewMatrix;
-            for (size_t i = 0; i < m_lightsSchoolIndex.size(); ++i)
+            const uint32_t lightCount = (uint32_t)m_lightsSchoolIndex.size();
+            for (uint32_t i = 0; i < lightCount; ++i)
             {
-                nv::vec4f position(m_schoolsCentroid[m_lightsSchoolIndex[i]]);
+                // the school count may have changed since the centroids were published
+                const uint32_t schoolIndex = m_lightsSchoolIndex[i];
+                nv::vec4f position = m_lightsUBO_Data[i].m_lightPosition;
+                if (schoolIndex < schoolsCentroid.count())
+                    position = nv::vec4f(schoolsCentroid[schoolIndex]);
                 position.w = 1.f;
                 m_lightsUBO_Data[i].m_lightPosition = position;
 
@@ -515,23 +586,54 @@ void ThreadedRenderingGL::helperJobFunction()
                 float sqrtAttenuation = std::sqrt(linearAttenuationSqr - 4 * quadraticAttenuation * (constantAttenuation - threshold * intensityMax));
                 float lightRadius = (-linearAttenuation + sqrtAttenuation) / (2 * quadraticAttenuation);
 
+                m_lightsBounds.set(i, nv::vec3f(position), lightRadius);
+            }
+
+            // Don't submit lights out of view
+            uint32_t visibleCount = Nv::cullSpheres(Nv::FrustumPlanes::fromMatrix(projMatrix * viewMatrix),
+                                                    m_lightsBounds, 0, lightCount, m_visibleLights.data());
+            if (m_useOcclusionCulling)
+            {
+                CPU_TIMER_SCOPE(CPU_TIMER_THREAD_BASE_OCCLUSION + threadIndex);
+                rasterizeOcclusionTiles();
+                const uint32_t unoccludedCount = m_occlusionBuffer.cullSpheres(
+                    m_lightsBounds, m_visibleLights.data(), visibleCount, m_visibleLights.data());
+                m_occlusionTestedCount += visibleCount;
+                m_occlusionCulledCount += visibleCount - unoccludedCount;
+                visibleCount = unoccludedCount;
+            }
+            for (uint32_t v = 0; v < visibleCount; ++v)
+            {
+                const uint32_t i = m_visibleLights[v];
+                const nv::vec4f& position = m_lightsUBO_Data[i].m_lightPosition;
+                const float lightRadius = m_lightsBounds.radius[i];
+
                 nv::matrix4f transform;
                 transform.set_scale(lightRadius);
                 transform.set_translate(nv::vec3f(position));
 
-                //NOTE. Could do frustum culling and not submit lights out of view.
+                // written straight into the mapped buffer, the command only binds its range
+                const cb::UniformBlock lightingBlock = m_uniformRing.write(m_lightsUBO_Data[i]);
+                NV_ASSERT(nullptr != lightingBlock.data);
+                if (nullptr == lightingBlock.data)
+                {
+                    // the region is sized for all the lights, never bind an empty range
+                    LOGE("ThreadedRenderingGL: uniform ring region full, point light %u skipped\n", i);
+                    continue;
+                }
 
                 auto& drawCmd = *m_deferredCommands.addCommand<DrawPointLightCommand>(1);
                 drawCmd.brdf = m_brdf;
                 drawCmd.shader = m_shader_PointLight;
+                drawCmd.uniforms = m_pointLightUniforms;
                 drawCmd.MVP = projMatrix * viewMatrix * transform;
-                drawCmd.lightingUBO_Id = m_lightsUBO_Id[i];
-                drawCmd.lightingUBO_Data = m_lightsUBO_Data[i];
+                drawCmd.lightingUBO_Buffer = m_uniformRingBuffer;
+                drawCmd.lightingUBO_Offset = lightingBlock.offset;
+                drawCmd.lightingUBO_Size = lightingBlock.size;
                 drawCmd.lightingUBO_Location = m_lightingUBO_Location;
                 drawCmd.projUBO_Id = m_projUBO_Id;
                 drawCmd.projUBO_Location = m_projUBO_Location;
-                for (int i = 0; i < GBUFFER_COUNT; ++i)
-                    drawCmd.texGBuffer[i] = m_texGBuffer[i];
+                drawCmd.gbufferBlock = gbufferBlock;
                 CB_DEBUG_COMMAND_TAG(drawCmd);
 
                 if(i > 4 || !m_useVolumetricLights)
@@ -544,6 +646,8 @@ void ThreadedRenderingGL::helperJobFunction()
                 // gbuffer command
                 auto& geomCmd = *m_geometryCommands.addCommand<DrawSphereCommand>(cb::DrawKey::makeDefault(0, cb::ViewLayerType::e3D));
                 geomCmd.shader = m_shader_Emission;
+                geomCmd.modelViewMatrix = m_emissionModelViewMatrix;
+                geomCmd.colorUniform = m_emissionColor;
                 geomCmd.MVP = projMatrix * viewMatrix * transform;
                 geomCmd.color = m_lightsUBO_Data[i].m_lightDiffuse;
                 geomCmd.color.w = i;
@@ -570,6 +674,98 @@ void ThreadedRenderingGL::helperJobFunction()
     }
 }
 
+void ThreadedRenderingGL::updateCamera()
+{
+#if !SIMPLE_DEMO
+    // Update the camera position if we are following a school
+    if (m_uiCameraFollow)
+    {
+        if (m_uiSchoolInfoId < m_activeSchools)
+        {
+            // Get the centroid of the school we're following
+            School* pSchool = m_schools[m_uiSchoolInfoId];
+            nv::vec3f camPos = pSchool->GetCentroid() - (m_pInputHandler->getLookVector() * pSchool->GetRadius() * 4);
+            if (camPos.y < 0.01f)
+            {
+                camPos.y = 0.01f;
+            }
+            m_pInputHandler->setPosition(camPos);
+        }
+        else
+        {
+            m_uiCameraFollow = false;
+            m_bUIDirty = true;
+            updateUI();
+        }
+    }
+#endif
+
+    m_projUBO_Data.m_viewMatrix = m_pInputHandler->getViewMatrix();
+    m_projUBO_Data.m_inverseViewMatrix = m_pInputHandler->getCameraMatrix();
+}
+
+void ThreadedRenderingGL::beginOcclusion()
+{
+    CPU_TIMER_SCOPE(CPU_TIMER_MAIN_OCCLUSION);
+
+    m_occlusionBuffer.begin(m_projUBO_Data.m_projectionMatrix * m_projUBO_Data.m_viewMatrix);
+    // The ground is the only opaque occluder of the scene, it hides whatever is above it
+    // when the camera goes below the sand. Same quad as groundplane_VS, centered under the camera.
+    const float groundSize = 100.0f;
+    const nv::vec3f camPos(m_projUBO_Data.m_inverseViewMatrix.get_column(3));
+    const nv::vec3f center(camPos.x, 0.0f, camPos.z);
+    m_occlusionBuffer.addQuad(center + nv::vec3f(-groundSize, 0.0f, -groundSize),
+                              center + nv::vec3f(groundSize, 0.0f, -groundSize),
+                              center + nv::vec3f(groundSize, 0.0f, groundSize),
+                              center + nv::vec3f(-groundSize, 0.0f, groundSize));
+
+    m_occlusionNextTile = 0;
+    m_occlusionTilesDone = 0;
+    m_occlusionTestedCount = 0;
+    m_occlusionCulledCount = 0;
+}
+
+void ThreadedRenderingGL::rasterizeOcclusionTiles()
+{
+    // The tiles are independent, whichever thread takes one the buffer is the same
+    const uint32_t tileCount = m_occlusionBuffer.tileCount();
+    for (uint32_t tile = m_occlusionNextTile++; tile < tileCount; tile = m_occlusionNextTile++)
+    {
+        m_occlusionBuffer.rasterizeTile(tile);
+        m_occlusionTilesDone.fetch_add(1, std::memory_order_release);
+    }
+    while (m_occlusionTilesDone.load(std::memory_order_acquire) < tileCount)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void ThreadedRenderingGL::loadAssetsJobFunction(uint32_t threadIndex)
+{
+    for (uint32_t i = threadIndex; i < MODEL_COUNT + TEXTURE_COUNT; i += MAX_ANIMATION_THREAD_COUNT)
+    {
+        if (i < MODEL_COUNT)
+        {
+            // Map the model files so the meshes reference them in place instead
+            // of copying every vertex and index array out of a read buffer
+            m_sourceModels[i] =
+                Nv::NvModelExt::CreateFromPreprocessed(ms_modelInfo[i].m_filename, true);
+            // Simplify the lower levels of detail of the distant fish here, off the render thread
+            if (nullptr != m_sourceModels[i])
+            {
+                m_sourceModels[i]->GenerateLods(FISH_LOD_COUNT, FISH_LOD_REDUCTION, FISH_LOD_MAX_ERROR);
+            }
+        }
+        else
+        {
+            // Decode (flip and expand) the textures here, leaving only
+            // the upload for initGL on the rendering thread
+            const uint32_t textureIndex = i - MODEL_COUNT;
+            m_textureImages[textureIndex] = NvImage::CreateFromDDSFile(ms_textureFilenames[textureIndex]);
+        }
+    }
+}
+
 class ThreadedRenderingModelLoader : public Nv::NvModelFileLoader
 {
 public:
@@ -585,8 +781,25 @@ public:
     {
         NvAssetLoaderFree(pData);
     }
+
+    virtual char* MapDataFromFile(const char* fileName, size_t& length)
+    {
+        int64_t mappedLength = 0;
+        char* pData = NvAssetLoaderMap(fileName, mappedLength);
+        length = (size_t)mappedLength;
+        return pData;
+    }
+
+    virtual void UnmapData(char* pData, size_t length)
+    {
+        NvAssetLoaderUnmap(pData, (int64_t)length);
+    }
 };
 
+// Mapped models release their data through the loader when destroyed,
+// so it has to outlive all of them
+static ThreadedRenderingModelLoader s_modelLoader;
+
 //-----------------------------------------------------------------------------
 // PUBLIC METHODS, CTOR AND DTOR
 nv::vec3f ThreadedRenderingGL::ms_tankMin(-30.0f, 5.0f, -30.0f);
@@ -598,6 +811,10 @@ ThreadedRenderingGL::ThreadedRenderingGL() :
     m_frameStartLock(nullptr),
     m_frameStartCV(nullptr),
     m_needsUpdateQueueLock(nullptr),
+    m_task(nullptr),
+    m_taskCount(0),
+    m_taskID(0),
+    m_taskThreadsDone(0),
     m_doneCount(0),
     m_doneCountLock(nullptr),
     m_doneCountCV(nullptr),
@@ -614,12 +831,15 @@ ThreadedRenderingGL::ThreadedRenderingGL() :
     m_projUBO_Location(0),
     m_lightingUBO_Id(0),
     m_lightingUBO_Location(0),
+    m_uniformRingBuffer(0),
+    m_uniformRingMapped(false),
     m_startingCameraPitchYaw(0.0f, 0.0f),
     m_maxSchools(MAX_SCHOOL_COUNT),
     m_schoolStateMgr(m_maxSchools),
     m_ESVBOPolicy(Nv::VBO_SUBRANGE),
     m_currentVBOPolicy(Nv::VBO_INVALID),
     m_pVBOPool(nullptr),
+    m_schoolsCentroid(m_maxSchools),
     m_activeSchools(0),
     m_skyboxSandTex(0),
     m_skyboxGradientTex(0),
@@ -633,6 +853,7 @@ ThreadedRenderingGL::ThreadedRenderingGL() :
     m_animPaused(false),
     m_avoidance(true),
     m_useVolumetricLights(true),
+    m_useOcclusionCulling(true),
     m_currentTime(0.0f),
     m_forceUpdateMode(ForceUpdateMode::eNone),
     m_bUIDirty(true),
@@ -662,11 +883,15 @@ ThreadedRenderingGL::ThreadedRenderingGL() :
     m_simpleStatsBox(nullptr),
     m_fullTimingStats(nullptr),
     m_fullStatsBox(nullptr),
+    m_textBatch(nullptr),
     m_bDisplayLogos(true),
     m_logoNVIDIA(nullptr),
     m_logoGLES(nullptr),
     m_logoGL(nullptr),
     m_drawCallCount(0),
+    m_instanceUploadSize(0),
+    m_occlusionTested(0),
+    m_occlusionCulled(0),
     m_statsCountdown(STATS_FRAMES),
     m_statsMode(STATS_SIMPLE),
     m_pStatsModeVar(nullptr),
@@ -674,10 +899,20 @@ ThreadedRenderingGL::ThreadedRenderingGL() :
     m_meanCPUMainCmd(0.0f),
     m_meanCPUMainWait(0.0f),
     m_meanCPUMainCopyVBO(0.0f),
+    m_meanCPUMainOcclusion(0.0f),
     m_meanGPUFrameMS(0.0f),
-    m_frameID(0)
+    m_frameID(0),
+    m_frameComposer([this](uint32_t taskCount, const std::function<void(uint32_t)>& task) {
+        runOnAnimationThreads(taskCount, task);
+    }),
+    m_materialRegistry(m_geometryCommands.materialBinder()),
+    m_renumberMaterials(false)
 {
     m_imageWidth = m_imageHeight = 0;
+    m_fishLods = true;
+    m_occlusionNextTile = m_occlusionTilesDone = 0;
+    m_nextTask = 0;
+    m_occlusionTestedCount = m_occlusionCulledCount = 0;
     for(int i = 0; i < GBUFFER_COUNT; ++i)
         m_texGBuffer[i] = 0;
     m_texGBufferFboId = m_texDepthStencilBuffer = 0;
@@ -685,6 +920,17 @@ ThreadedRenderingGL::ThreadedRenderingGL() :
 
     cb::DrawKey::sanityChecks();
     m_geometryCommands.resize(10000, 3 * 1024);
+    // room for the instance data of every school, plus the alignment padding
+    m_stagingRing.resize(MAX_SCHOOL_COUNT * (MAX_INSTANCE_COUNT * School::GetInstanceDataStride() + 16), 2);
+
+    const uint32_t geometryPass = m_frameComposer.add(m_geometryCommands,
+        cb::radixSort<GeometryCommandBuffer::command_t>, "Geometry");
+    const uint32_t deferredPass = m_frameComposer.add(m_deferredCommands,
+        std::sort<DeferredCommandBuffer::command_t*>, "Deferred");
+    const uint32_t postProcessPass = m_frameComposer.add(m_postProcessCommands,
+        std::sort<PostProcessCommandBuffer::command_t*>, "Post process");
+    m_frameComposer.addDependency(deferredPass, geometryPass);
+    m_frameComposer.addDependency(postProcessPass, deferredPass);
 #if STRESS_TEST
     // Full complexity for the stress test
     neighborSkip = 5;
@@ -713,6 +959,12 @@ ThreadedRenderingGL::ThreadedRenderingGL() :
     for (uint32_t i = 0; i < MODEL_COUNT; i++)
     {
         m_models[i] = nullptr;
+        m_sourceModels[i] = nullptr;
+    }
+
+    for (uint32_t i = 0; i < TEXTURE_COUNT; i++)
+    {
+        m_textureImages[i] = nullptr;
     }
 
     for (uint32_t i = 0; i < MAX_THREAD_COUNT; i++)
@@ -722,6 +974,20 @@ ThreadedRenderingGL::ThreadedRenderingGL() :
         m_threads[i].m_index = i;
     }
 
+    m_trace.setName(CPU_TIMER_MAIN_CMD_BUILD, "Main command build");
+    m_trace.setName(CPU_TIMER_MAIN_WAIT, "Main wait");
+    m_trace.setName(CPU_TIMER_MAIN_COPYVBO, "Main copy VBO");
+    m_trace.setName(CPU_TIMER_MAIN_OCCLUSION, "Main occlusion binning");
+    for (uint32_t i = 0; i < MAX_THREAD_COUNT; i++)
+    {
+        m_trace.setName(CPU_TIMER_THREAD_BASE_CMD_BUILD + i, "Command build");
+        m_trace.setName(CPU_TIMER_THREAD_BASE_ANIMATE + i, "Animate");
+        m_trace.setName(CPU_TIMER_THREAD_BASE_UPDATE + i, "Update");
+        m_trace.setName(CPU_TIMER_THREAD_BASE_TOTAL + i, "Total");
+        m_trace.setName(CPU_TIMER_THREAD_BASE_OCCLUSION + i, "Occlusion");
+        m_trace.setName(TRACE_THREAD_BASE_WAIT + i, "Wait for work");
+    }
+
     initializeSchoolDescriptions(50);
 
     // We have the option of not synchronizing access to our instancing buffers.  This will
@@ -753,6 +1019,19 @@ ThreadedRenderingGL::~ThreadedRenderingGL()
     }
     cleanThreads();
     cleanRendering();
+    delete m_textBatch;
+
+    if (!m_traceFile.empty())
+    {
+        if (m_trace.dumpChromeTrace(m_traceFile.c_str(), TRACE_EXPORT_FRAMES))
+        {
+            LOGI("ThreadedRenderingGL: trace of the last %d frames written to %s\n", TRACE_EXPORT_FRAMES, m_traceFile.c_str());
+        }
+        else
+        {
+            LOGI("ThreadedRenderingGL: failed to write the trace to %s\n", m_traceFile.c_str());
+        }
+    }
 }
 
 // Inherited methods
@@ -784,12 +1063,22 @@ void ThreadedRenderingGL::initRendering(void)
         for (std::vector<std::string>::const_iterator iter = cmd.begin(); iter != cmd.end(); ++iter)
         {
             //          if (*iter == "-idle")
+            if (*iter == "-trace" && (iter + 1) != cmd.end())
+            {
+                m_traceFile = *(++iter);
+            }
+            else if (*iter == "-nolod")
+            {
+                m_fishLods = false;
+            }
         }
     }
 
     // Disable v-sync
     getAppContext()->setSwapInterval(0);
 
+    m_trace.setThreadName("Main");
+
     for (int32_t i = 0; i < CPU_TIMER_COUNT; ++i)
     {
         m_CPUTimers[i].init();
@@ -800,8 +1089,7 @@ void ThreadedRenderingGL::initRendering(void)
     mFramerate->setReportFrames(20);
 
     NvAssetLoaderAddSearchPath("es3aep-kepler/ThreadedRenderingGL");
-    ThreadedRenderingModelLoader loader;
-    Nv::NvModelExt::SetFileLoader(&loader);
+    Nv::NvModelExt::SetFileLoader(&s_modelLoader);
 
     // Load all shaders
     m_shader_GroundPlane = NvGLSLProgram::createFromFiles("src_shaders/groundplane_VS.glsl", "src_shaders/groundplane_FS.glsl");
@@ -839,10 +1127,59 @@ void ThreadedRenderingGL::initRendering(void)
         return;
     }
 
+    m_directionalLightUniforms.resolve(m_shader_DirectionalLight);
+    m_pointLightUniforms.resolve(m_shader_PointLight);
+    m_emissionModelViewMatrix = m_shader_Emission->getUniform("uModelViewMatrix");
+    m_emissionColor = m_shader_Emission->getUniform("uColor");
+
+    // Load the models and textures in parallel, borrowing the worker thread
+    // stacks as the workers themselves are only started afterwards
+    {
+        NvThreadManager* threadManager = getThreadManagerInstance();
+        NV_ASSERT(nullptr != threadManager);
+
+        NvCPUTimer loadTimer;
+        loadTimer.init();
+        loadTimer.start();
+
+        for (uint32_t i = 0; i < MAX_ANIMATION_THREAD_COUNT; i++)
+        {
+            ThreadData& thread = m_threads[i];
+            thread.m_thread =
+                threadManager->createThread(loadAssetsJobFunctionThunk, &thread,
+                    &(m_threadStacks[i]),
+                    THREAD_STACK_SIZE,
+                    NvThread::DefaultThreadPriority);
+            NV_ASSERT(thread.m_thread != NULL);
+            thread.m_thread->startThread();
+        }
+        for (uint32_t i = 0; i < MAX_ANIMATION_THREAD_COUNT; i++)
+        {
+            ThreadData& thread = m_threads[i];
+            thread.m_thread->waitThread();
+            threadManager->destroyThread(thread.m_thread);
+            thread.m_thread = NULL;
+        }
+
+        loadTimer.stop();
+
+        uint32_t textureBytes = 0;
+        for (uint32_t i = 0; i < TEXTURE_COUNT; ++i)
+        {
+            if (nullptr != m_textureImages[i])
+            {
+                textureBytes += m_textureImages[i]->getDataBlockSize();
+            }
+        }
+        const float loadTime = loadTimer.getScaledCycles();
+        LOGI("Loaded %d models and %d textures in %.2f ms, %.1f MB/s of texture data",
+            MODEL_COUNT, TEXTURE_COUNT, loadTime * 1000.0f,
+            (loadTime > 0.0f) ? textureBytes / (1024.0f * 1024.0f) / loadTime : 0.0f);
+    }
+
     for (uint32_t i = 0; i < MODEL_COUNT; ++i)
     {
-        Nv::NvModelExt* pModel =
-            Nv::NvModelExt::CreateFromPreprocessed(ms_modelInfo[i].m_filename);
+        Nv::NvModelExt* pModel = m_sourceModels[i];
         if (nullptr != pModel)
         {
 
@@ -869,6 +1206,7 @@ void ThreadedRenderingGL::initRendering(void)
     m_geometryCommands.setLogFunction(&commandLogFunction);
     m_deferredCommands.setLogFunction(&commandLogFunction);
     m_postProcessCommands.setLogFunction(&commandLogFunction);
+    m_overlayCommands.setLogFunction(&commandLogFunction);
 #endif
 
     const auto key = cb::DrawKey::makeCustom(cb::ViewLayerType::eHighest, 0);
@@ -891,7 +1229,6 @@ void ThreadedRenderingGL::initGL()
     glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingUBO), &m_lightingUBO_Data, GL_STREAM_DRAW);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-    glGenBuffers(MAX_LIGHTS_COUNT, &m_lightsUBO_Id[0]);
     for (size_t i = 0; i < MAX_LIGHTS_COUNT; ++i)
     {
         float gColor = ((rand() % 192) / 256.f) + 0.25;
@@ -903,17 +1240,64 @@ void ThreadedRenderingGL::initGL()
         m_lightsUBO_Data[i].m_lightDiffuse = nv::vec4f(rColor, gColor, bColor, 1.0f) * 2.5f;
         m_lightsUBO_Data[i].m_linearAttenuation = 0.1f +(rand() % 10) / 10.f;
         m_lightsUBO_Data[i].m_quadraticAttenuation = 0.1f +(rand() % 20) / 20.f;
+    }
 
-        glBindBuffer(GL_UNIFORM_BUFFER, m_lightsUBO_Id[i]);
-        glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingUBO), &m_lightsUBO_Data[i], GL_STREAM_DRAW);
+    // The point lights uniforms are written at record time into a persistently mapped ring, it has a
+    // region more than the frames in flight and waits on the fence of a region's frame before reusing it.
+    // Without buffer storage(i.e. ES 3.0) the ring is in client memory and the blocks of each frame are
+    // uploaded to an orphaned buffer before submit.
+    {
+        GLint offsetAlignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+        const uint32_t blockSize = (sizeof(LightingUBO) + offsetAlignment - 1) & ~(offsetAlignment - 1);
+        const uint32_t regionCount = m_numDrawAheadFrames + 1;
+        const uint32_t frameBytes = MAX_LIGHTS_COUNT * blockSize;
+
+        typedef void (KHRONOS_APIENTRY *PFNBufferStorage)(GLenum target, GLsizeiptr size, const void* data,
+                                                          GLbitfield flags);
+        PFNBufferStorage bufferStorage = nullptr;
+        if ((NvGLAPIVersionGL4_4() <= getGLContext()->getConfiguration().apiVer) ||
+            getGLContext()->isExtensionSupported("GL_ARB_buffer_storage"))
+        {
+            bufferStorage = (PFNBufferStorage)getGLContext()->getGLProcAddress("glBufferStorage");
+        }
+        else if (getGLContext()->isExtensionSupported("GL_EXT_buffer_storage"))
+        {
+            bufferStorage = (PFNBufferStorage)getGLContext()->getGLProcAddress("glBufferStorageEXT");
+        }
+
+        uint8_t* data = nullptr;
+        glGenBuffers(1, &m_uniformRingBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_uniformRingBuffer);
+        if (nullptr != bufferStorage)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage(GL_UNIFORM_BUFFER, frameBytes * regionCount, 0, flags);
+            data = static_cast<uint8_t*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, frameBytes * regionCount, flags));
+            NV_ASSERT(nullptr != data);
+        }
+        if (nullptr == data)
+        {
+            LOGI("ThreadedRenderingGL: no buffer storage, the point light uniforms are uploaded each frame\n");
+            glBufferData(GL_UNIFORM_BUFFER, frameBytes * regionCount, nullptr, GL_STREAM_DRAW);
+        }
         glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        m_uniformRingMapped = nullptr != data;
+
+        // the fences are only inserted for the mapped buffer, the uploaded blocks are copied by glBufferSubData
+        m_uniformFences.assign(regionCount, nullptr);
+        m_uniformRing.reset(data, frameBytes, regionCount, [this](uint32_t frame) { waitUniformFence(frame); },
+                            offsetAlignment);
     }
 
-    // Load the skybox
-    m_skyboxSandTex = NvImageGL::UploadTextureFromDDSFile("textures/sand.dds");
-    m_skyboxGradientTex = NvImageGL::UploadTextureFromDDSFile("textures/Gradient.dds");
-    m_caustic1Tex = NvImageGL::UploadTextureFromDDSFile("textures/caustic1.dds");
-    m_caustic2Tex = NvImageGL::UploadTextureFromDDSFile("textures/caustic2.dds");
+    // Upload the skybox and caustic textures decoded at load time
+    GLuint* textureIds[TEXTURE_COUNT] = { &m_skyboxSandTex, &m_skyboxGradientTex, &m_caustic1Tex, &m_caustic2Tex };
+    for (uint32_t i = 0; i < TEXTURE_COUNT; ++i)
+    {
+        *textureIds[i] = NvImageGL::UploadTexture(m_textureImages[i]);
+        delete m_textureImages[i];
+        m_textureImages[i] = nullptr;
+    }
 
     // Assign some values which apply to the entire scene and update once per frame.
     m_lightingUBO_Data.m_lightPosition = nv::vec4f(1.0f, 1.0f, 1.0f, 0.0f);
@@ -960,9 +1344,10 @@ uint32_t ThreadedRenderingGL::setNumSchools(uint32_t numSchools)
         uint32_t schoolIndex = m_schools.size();
         m_schools.resize(numSchools);
         m_schoolsDrawCount.resize(numSchools);
-        m_schoolsCentroid.resize(numSchools);
-
-        m_geometryCommands.materialBinder().materials.resize(numSchools + 1);
+        m_schoolsUploadSize.resize(numSchools);
+        m_schoolsMaterial.resize(numSchools);
+        m_schoolsBounds.resize(numSchools);
+        m_visibleSchools.resize(numSchools);
 
         int32_t newSchools = numSchools - schoolIndex;
 
@@ -1000,9 +1385,7 @@ uint32_t ThreadedRenderingGL::setNumSchools(uint32_t numSchools)
                     return 0;
                 }
 
-                int materialId = schoolIndex + 1; // first material is reserved
-                pSchool->SetMaterial(cb::TranslucencyType::eOpaque, materialId);
-                auto& mat = m_geometryCommands.materialBinder().materials[materialId];
+                Nv::MaterialBinder::Material mat;
                 mat.name = "Fish school:";
                 mat.name += std::to_string(schoolIndex);
                 mat.shader = m_shader_Fish;
@@ -1010,9 +1393,27 @@ uint32_t ThreadedRenderingGL::setNumSchools(uint32_t numSchools)
                 auto ubo = pSchool->GetUniformBuffer();
                 mat.ubo = ubo.first;
                 mat.location = ubo.second;
+                Nv::NvModelExtGL* pModel = m_models[desc.m_modelId];
+                mat.texture = pModel->GetTextureCount() ? pModel->GetTexture(0) : 0;
+                m_schoolsMaterial[schoolIndex] = m_materialRegistry.add(mat);
                 m_schools[schoolIndex] = pSchool;
             }
         }
+
+        // the commands recorded when paused are replayed with the current ids,
+        // the renumber is deferred until they are cleared
+        if (m_animPaused)
+        {
+            for (uint32_t i = 0; i < m_schools.size(); ++i)
+            {
+                m_schools[i]->SetMaterial(cb::TranslucencyType::eOpaque, m_materialRegistry.id(m_schoolsMaterial[i]));
+            }
+            m_renumberMaterials = true;
+        }
+        else
+        {
+            renumberMaterials();
+        }
     }
     m_activeSchools = numSchools;
 
@@ -1027,6 +1428,23 @@ uint32_t ThreadedRenderingGL::setNumSchools(uint32_t numSchools)
     return m_activeSchools;
 }
 
+void ThreadedRenderingGL::renumberMaterials()
+{
+    // renumber the materials so the sorted schools share their state, then rebuild their keys
+    m_materialRegistry.update();
+    for (uint32_t i = 0; i < m_schools.size(); ++i)
+    {
+        m_schools[i]->SetMaterial(cb::TranslucencyType::eOpaque, m_materialRegistry.id(m_schoolsMaterial[i]));
+    }
+    m_renumberMaterials = false;
+#if FISH_DEBUG
+    const Nv::MaterialRegistry::Transitions transitions = m_materialRegistry.transitions();
+    LOGI("Materials: %u, shader changes %u, ubo changes %u, texture changes %u\n",
+        (uint32_t)m_materialRegistry.count(), transitions.shaderChanges, transitions.uboChanges,
+        transitions.textureChanges);
+#endif
+}
+
 void ThreadedRenderingGL::initializeSchoolDescriptions(uint32_t numSchools)
 {
     uint32_t schoolIndex = m_schoolDescs.size();
@@ -1137,6 +1555,8 @@ uint32_t ThreadedRenderingGL::setNumLights(uint32_t numLights)
 
     int prevSize = m_lightsSchoolIndex.size();
     m_lightsSchoolIndex.resize(numLights);
+    m_lightsBounds.resize(numLights);
+    m_visibleLights.resize(numLights);
     for (size_t i = prevSize; i < m_lightsSchoolIndex.size(); ++i)
     {
         m_lightsSchoolIndex[i] = rand() % m_activeSchools;
@@ -1214,6 +1634,8 @@ void ThreadedRenderingGL::initUI(void)
         mTweakBar->addMenu("BRDF", (uint32_t&)m_brdf, &(BRDF_OPTIONS[0]), BRDF_COUNT, UIACTION_UIBRDF);
         var = mTweakBar->addValue("Use Volumetric Lights", m_useVolumetricLights);
         addTweakKeyBind(var, NvKey::K_V);
+        var = mTweakBar->addValue("Occlusion Culling", m_useOcclusionCulling);
+        addTweakKeyBind(var, NvKey::K_O);
 
         mTweakBar->addPadding();
         mTweakBar->addLabel("Animation Settings", true);
@@ -1295,11 +1717,13 @@ void ThreadedRenderingGL::initUI(void)
         mFPSText->GetScreenRect(fpsRect); // base off of fps element.
         // pre-size the rectangle with fake text
         NvUIRect textRect;
+        m_textBatch = new NvBFTextBatch();
 
         m_fullTimingStats = new NvUIText("______________________________----------\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n",
             NvUIFontFamily::SANS, (mFPSText->GetFontSize() * 2) / 3, NvUITextAlign::LEFT);
         m_fullTimingStats->SetColor(NV_PACKED_COLOR(255, 255, 255, 255));
         m_fullTimingStats->SetShadow();
+        m_fullTimingStats->SetBatch(m_textBatch);
         m_fullTimingStats->GetScreenRect(textRect);
         m_fullStatsBox = new NvUIContainer(textRect.width, textRect.height, new NvUIGraphicFrame("popup_frame.dds", 24, 24));
         m_fullStatsBox->Add(m_fullTimingStats, 8.0f, 8.0f);
@@ -1310,6 +1734,7 @@ void ThreadedRenderingGL::initUI(void)
             NvUIFontFamily::SANS, mFPSText->GetFontSize(), NvUITextAlign::LEFT);
         m_simpleTimingStats->SetColor(NV_PACKED_COLOR(218, 218, 0, 255));
         m_simpleTimingStats->SetShadow();
+        m_simpleTimingStats->SetBatch(m_textBatch);
         m_simpleTimingStats->GetScreenRect(textRect);
         m_simpleStatsBox = new NvUIContainer(textRect.width, textRect.height, new NvUIGraphicFrame("popup_frame.dds", 24, 24));
         m_simpleStatsBox->Add(m_simpleTimingStats, 8.0f, 8.0f);
@@ -1924,6 +2349,7 @@ void ThreadedRenderingGL::draw(void)
     neighborOffset = (neighborOffset + 1) % (6 - neighborSkip);
 
     s_threadMask = 0;
+    m_trace.nextFrame();
 
     m_currentTime += getClampedFrameTime();
 
@@ -2001,6 +2427,16 @@ void ThreadedRenderingGL::draw(void)
             }
         }
 
+        // The camera is latched before the threads start, they all cull with it
+        if (!m_animPaused || m_forceUpdateMode == ForceUpdateMode::eForceDispatch)
+        {
+            updateCamera();
+        }
+        if (m_useOcclusionCulling)
+        {
+            beginOcclusion();
+        }
+
         m_doneCount = 0;
         // Work is ready to begin.  Signal the threads that we're
         // ready for them to start updating schools
@@ -2024,31 +2460,67 @@ void ThreadedRenderingGL::draw(void)
         m_doneCountLock->unlockMutex();
     }
 
+    m_occlusionTested = m_useOcclusionCulling ? m_occlusionTestedCount.load() : 0;
+    m_occlusionCulled = m_useOcclusionCulling ? m_occlusionCulledCount.load() : 0;
     m_drawCallCount = 0;
+    m_instanceUploadSize = 0;
+    nv::vec3f* schoolsCentroid = m_schoolsCentroid.beginWrite(m_activeSchools);
     for (uint32_t schoolIndex = 0; schoolIndex < m_activeSchools; ++schoolIndex)
     {
-        m_schoolsCentroid[schoolIndex] = m_schools[schoolIndex]->GetCentroid();
+        schoolsCentroid[schoolIndex] = m_schools[schoolIndex]->GetCentroid();
         m_drawCallCount += m_schoolsDrawCount[schoolIndex];
+        m_instanceUploadSize += m_schoolsUploadSize[schoolIndex];
+        m_schoolsUploadSize[schoolIndex] = 0;
     }
+    m_schoolsCentroid.publish();
     m_commandCount = m_geometryCommands.count(true) + m_deferredCommands.count(true)  + m_postProcessCommands.count(true) ;
     m_commandAllocations = m_geometryCommands.allocations() / 1024.f + m_deferredCommands.allocations() / 1024.f;
 
     // Rendering
     {
-        m_geometryCommands.sort(radixsort<GeometryCommandBuffer::command_t>);
-        m_deferredCommands.sort();
-        m_postProcessCommands.sort();
+        // the sorts are independent so they run concurrently on the animation threads
+        m_frameComposer.sort();
 
         CPU_TIMER_SCOPE(CPU_TIMER_MAIN_CMD_BUILD);
         GPU_TIMER_SCOPE();
 
         const bool clearCommands = !m_animPaused; // using recorded commands when paused
 
-        // nothing to pass as GL doesn't have any contexts
-        m_geometryCommands.submit(nullptr, clearCommands);
-        m_deferredCommands.submit(nullptr, clearCommands);
-        m_postProcessCommands.submit(nullptr, clearCommands);
+        // GL doesn't have any contexts, only used to resolve the constant blocks of the commands
+        cb::RenderContext renderContext(nullptr);
+        uploadUniformRing();
+        m_frameComposer.submit(&renderContext, clearCommands);
+        m_materialStats = m_geometryCommands.materialBinder().stats;
+        m_uniformStats = NvGLSLProgram::getUniformStats();
+        NvGLSLProgram::resetUniformStats();
+        m_drawStats = Nv::NvMeshExtGL::GetDrawStats();
+        Nv::NvMeshExtGL::ResetDrawStats();
+        // the instance data of this frame was uploaded, recorded commands still reference it when paused
+        if (clearCommands)
+        {
+            m_stagingRing.nextFrame();
+
+            // the uniform region of this frame is reused once the GPU has signaled its fence
+            if (m_uniformRingMapped)
+            {
+                GLsync& uniformFence = m_uniformFences[m_uniformRing.region()];
+                NV_ASSERT(nullptr == uniformFence);
+                uniformFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+            m_uniformRing.beginFrame();
+
+            // no recorded commands reference the previous ids anymore
+            if (m_renumberMaterials)
+                renumberMaterials();
+        }
     }
+#if FISH_DEBUG
+    for (uint32_t i = 0; i < m_frameComposer.count(); ++i)
+    {
+        const cb::FrameComposer::Timing& timing = m_frameComposer.timing(i);
+        LOGI("%s commands: sort %.3f ms, submit %.3f ms", m_frameComposer.name(i), timing.sortTime, timing.submitTime);
+    }
+#endif
     m_forceUpdateMode = ForceUpdateMode::eNone;
 #if FISH_DEBUG
     LOGI("END OF FRAME");
@@ -2056,11 +2528,71 @@ void ThreadedRenderingGL::draw(void)
 #endif
     }
 
+void ThreadedRenderingGL::drawUI(void)
+{
+    if (nullptr == m_textBatch)
+        return;
+
+    // the stats texts were queued while drawing the UI window, draw them with one call per font
+    auto& cmd = *m_overlayCommands.addCommand<cmds::DrawTextBatchCommand>(0);
+    cmd.batch = m_textBatch;
+    CB_DEBUG_COMMAND_SET_MSG(cmd, "Draw text batch");
+
+    m_overlayCommands.sort();
+    cb::RenderContext renderContext(nullptr);
+    m_overlayCommands.submit(&renderContext);
+}
+
 //-----------------------------------------------------------------------------
 // PRIVATE METHODS
 
 void ThreadedRenderingGL::cleanRendering(void)
 {
+    for (GLsync& fence : m_uniformFences)
+    {
+        if (nullptr != fence)
+        {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (0 != m_uniformRingBuffer)
+    {
+        // deleting the buffer also unmaps it
+        glDeleteBuffers(1, &m_uniformRingBuffer);
+        m_uniformRingBuffer = 0;
+    }
+}
+
+void ThreadedRenderingGL::waitUniformFence(uint32_t frame)
+{
+    // no fence when the region was uploaded instead of mapped, or when its frame was never submitted
+    GLsync& fence = m_uniformFences[frame % m_uniformFences.size()];
+    if (nullptr == fence)
+        return;
+
+    // unlike the instance data it can't give up on a timeout, the region is rewritten next
+    GLenum waitStatus = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    while (GL_TIMEOUT_EXPIRED == waitStatus)
+        waitStatus = glClientWaitSync(fence, 0, 1000000);
+    if (GL_WAIT_FAILED == waitStatus)
+        LOGE("ThreadedRenderingGL: failed waiting for the uniform ring fence of frame %u\n", frame);
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void ThreadedRenderingGL::uploadUniformRing(void)
+{
+    if (m_uniformRingMapped || 0 == m_uniformRing.frameUsed())
+        return;
+
+    // orphans the buffer, the draws of the previous frames keep reading their storage
+    const uint32_t offset = m_uniformRing.region() * m_uniformRing.frameBytes();
+    glBindBuffer(GL_UNIFORM_BUFFER, m_uniformRingBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, m_uniformRing.bufferBytes(), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, m_uniformRing.frameUsed(), m_uniformRing.data() + offset);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void ThreadedRenderingGL::initThreads(void)
@@ -2208,6 +2740,14 @@ ThreadedRenderingGL::ModelDesc ThreadedRenderingGL::ms_modelInfo[MODEL_COUNT] =
     { "Yellow Fish 11", "models/Yellow_Fish_11.nve", sc_yaw180, sc_zeroVec, sc_zeroVec, 0.32f }
 };
 
+const char* ThreadedRenderingGL::ms_textureFilenames[TEXTURE_COUNT] =
+{
+    "textures/sand.dds",
+    "textures/Gradient.dds",
+    "textures/caustic1.dds",
+    "textures/caustic2.dds"
+};
+
 SchoolFlockingParams ThreadedRenderingGL::ms_fishTypeDefs[FISHTYPE_COUNT] =
 {
     //     |       |Goal|      Spawn Zone       |Neighbor|Spawn|          |<***************** Strengths ****************>|             
@@ -2292,6 +2832,8 @@ void ThreadedRenderingGL::updateStats()
             frameConv;
         m_meanCPUMainCopyVBO = m_CPUTimers[CPU_TIMER_MAIN_COPYVBO].getScaledCycles() *
             frameConv;
+        m_meanCPUMainOcclusion = m_CPUTimers[CPU_TIMER_MAIN_OCCLUSION].getScaledCycles() *
+            frameConv;
 
         for (uint32_t i = 0; i < activeThreadCount(); i++) {
             ThreadTimings& t = m_threadTimings[i];
@@ -2303,6 +2845,8 @@ void ThreadedRenderingGL::updateStats()
                 frameConv;
             t.tot = m_CPUTimers[CPU_TIMER_THREAD_BASE_TOTAL + i].getScaledCycles() *
                 frameConv;
+            t.occlusion = m_CPUTimers[CPU_TIMER_THREAD_BASE_OCCLUSION + i].getScaledCycles() *
+                frameConv;
         }
 
         m_meanGPUFrameMS = m_GPUTimer.getScaledCycles() / STATS_FRAMES;
@@ -2351,10 +2895,14 @@ void ThreadedRenderingGL::buildSimpleStatsString(char* buffer, int32_t size)
         "Draw Commands: %d - %.1f\n"
         NvBF_COLORSTR_WHITE
         NVBF_STYLESTR_NORMAL
+        "State Changes: %d/%d/%d\n"
+        NvBF_COLORSTR_WHITE
+        NVBF_STYLESTR_NORMAL
         "CPU Thd0: %5.1fms\n",
         fishCountStr,
         drawCallRateStr,
         m_commandCount, m_commandAllocations,
+        m_materialStats.shaderChanges, m_materialStats.uboChanges, m_materialStats.textureChanges,
         m_meanCPUMainCmd + m_meanCPUMainCopyVBO);
 
     for (uint32_t i = 0; i < activeThreadCount(); ++i) {
@@ -2375,21 +2923,40 @@ void ThreadedRenderingGL::buildFullStatsString(char* buffer, int32_t size)
     char drawCallRateStr[32];
     uint32_t drawCallRate = (uint32_t)(m_drawCallCount * m_meanFPS);
     sprintComma(drawCallRate, drawCallRateStr);
+    // counted from the indices the meshes submitted, at the levels of detail they were drawn at
+    char triangleCountStr[32];
+    sprintComma((uint32_t)(m_drawStats.indices / 3), triangleCountStr);
+
+    // the cost of the occlusion culling is the binning plus the rasterization and tests of every thread
+    float occlusionMS = m_meanCPUMainOcclusion;
+    for (uint32_t i = 0; i < activeThreadCount(); ++i) {
+        occlusionMS += m_threadTimings[i].occlusion;
+    }
+    const float occlusionCulledPercent = m_occlusionTested ? 100.0f * m_occlusionCulled / m_occlusionTested : 0.0f;
 
     int32_t offset = sprintf(buffer,
         NvBF_COLORSTR_WHITE
         "Fish/frame: %s\n"
         "Fish/sec: %s\n"
         "Draw Calls/sec: %s\n"
+        "Triangles/frame: %s%s\n"
         "CPU Thd0 CmdBuf: %5.1fms\n"
         "CPU Thd0 Wait: %5.1fms\n"
         "CPU Thd0 CopyVBO: %5.1fms\n"
         "GPU: %5.1fms\n"
+        "Uniforms: %d set, %d redundant, %d lookups, %d by GL\n"
+        "Occlusion: %d/%d culled (%.0f%%), %5.2fms\n"
+        "Instance upload: %.1f KB/frame, %d B/fish\n"
         "ThdID, CmdBuf,   Anim,  Update,  TOTAL\n",
         fishCountStr,
         fishRateStr,
-        drawCallRateStr, m_meanCPUMainCmd, m_meanCPUMainWait, m_meanCPUMainCopyVBO,
-        m_meanGPUFrameMS);
+        drawCallRateStr,
+        triangleCountStr, m_fishLods ? "" : " (no LOD)",
+        m_meanCPUMainCmd, m_meanCPUMainWait, m_meanCPUMainCopyVBO,
+        m_meanGPUFrameMS,
+        m_uniformStats.uploads, m_uniformStats.skipped, m_uniformStats.lookups, m_uniformStats.glLookups,
+        m_occlusionCulled, m_occlusionTested, occlusionCulledPercent, occlusionMS,
+        m_instanceUploadSize / 1024.0f, School::GetInstanceDataStride());
 
     for (uint32_t i = 0; i < activeThreadCount(); ++i) {
         offset += sprintf(buffer + offset,
@@ -2457,6 +3024,14 @@ void ThreadedRenderingGL::InitRenderTargets()
 
 //-----------------------------------------------------------------------------
 
+void ThreadedRenderingGL::LightingUniforms::resolve(NvGLSLProgram* shader)
+{
+    modelViewMatrix = shader->getUniform("uModelViewMatrix");
+    lightingModel = shader->getUniform("uLightingModel");
+    normalDepth = shader->getUniform("uNormalDepth");
+    diffuseRoughness = shader->getUniform("uDiffuseRoughness");
+}
+
 void ThreadedRenderingGL::DrawDirectionalLightCommand::execute(const void* data, cb::RenderContext* rc)
 {
     auto& cmd = *reinterpret_cast<const DrawDirectionalLightCommand*>(data);
@@ -2465,11 +3040,12 @@ void ThreadedRenderingGL::DrawDirectionalLightCommand::execute(const void* data,
 
     glBindBufferBase(GL_UNIFORM_BUFFER, cmd.projUBO_Location, cmd.projUBO_Id);
     glBindBufferBase(GL_UNIFORM_BUFFER, cmd.lightingUBO_Location, cmd.lightingUBO_Id);
-    cmd.shader->setUniformMatrix4fv("uModelViewMatrix", cmd.fullscreenMVP._array);
+    cmd.shader->setUniformMatrix4fv(cmd.uniforms.modelViewMatrix, cmd.fullscreenMVP._array);
 
-    cmd.shader->setUniform1i("uLightingModel", cmd.brdf);
-    cmd.shader->bindTextureRect("uNormalDepth", 0, cmd.texGBuffer[0]);
-    cmd.shader->bindTextureRect("uDiffuseRoughness", 1, cmd.texGBuffer[1]);
+    const GBufferTextures& gbuffer = rc->constantBlock<GBufferTextures>(cmd.gbufferBlock);
+    cmd.shader->setUniform1i(cmd.uniforms.lightingModel, cmd.brdf);
+    cmd.shader->bindTextureRect(cmd.uniforms.normalDepth, 0, gbuffer.tex[0]);
+    cmd.shader->bindTextureRect(cmd.uniforms.diffuseRoughness, 1, gbuffer.tex[1]);
 
     NvDrawQuadGL(0);
 
@@ -2484,17 +3060,15 @@ void ThreadedRenderingGL::DrawPointLightCommand::execute(const void* data, cb::R
 
     glClear(GL_STENCIL_BUFFER_BIT); // stencil enabled, render point light faces once
 
-    glBindBuffer(GL_UNIFORM_BUFFER, cmd.lightingUBO_Id);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingUBO), &cmd.lightingUBO_Data, GL_STREAM_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
     glBindBufferBase(GL_UNIFORM_BUFFER, cmd.projUBO_Location, cmd.projUBO_Id);
-    glBindBufferBase(GL_UNIFORM_BUFFER, cmd.lightingUBO_Location, cmd.lightingUBO_Id);
-    cmd.shader->setUniformMatrix4fv("uModelViewMatrix", cmd.MVP._array);
+    glBindBufferRange(GL_UNIFORM_BUFFER, cmd.lightingUBO_Location, cmd.lightingUBO_Buffer,
+                      cmd.lightingUBO_Offset, cmd.lightingUBO_Size);
+    cmd.shader->setUniformMatrix4fv(cmd.uniforms.modelViewMatrix, cmd.MVP._array);
 
-    cmd.shader->setUniform1i("uLightingModel", cmd.brdf);
-    cmd.shader->bindTextureRect("uNormalDepth", 0, cmd.texGBuffer[0]);
-    cmd.shader->bindTextureRect("uDiffuseRoughness", 1, cmd.texGBuffer[1]);
+    const GBufferTextures& gbuffer = rc->constantBlock<GBufferTextures>(cmd.gbufferBlock);
+    cmd.shader->setUniform1i(cmd.uniforms.lightingModel, cmd.brdf);
+    cmd.shader->bindTextureRect(cmd.uniforms.normalDepth, 0, gbuffer.tex[0]);
+    cmd.shader->bindTextureRect(cmd.uniforms.diffuseRoughness, 1, gbuffer.tex[1]);
 
     static GLUquadricObj *quadric = nullptr;
     if (!quadric)
@@ -2514,8 +3088,8 @@ void ThreadedRenderingGL::DrawSphereCommand::execute(const void* data, cb::Rende
 
     cmd.shader->enable();
 
-    cmd.shader->setUniformMatrix4fv("uModelViewMatrix", cmd.MVP._array);
-    cmd.shader->setUniform4fv("uColor", cmd.color._array);
+    cmd.shader->setUniformMatrix4fv(cmd.modelViewMatrix, cmd.MVP._array);
+    cmd.shader->setUniform4fv(cmd.colorUniform, cmd.color._array);
 
     static GLUquadricObj *quadric = nullptr;
     if (!quadric)
@@ -40,19 +40,44 @@
 #include "NV/NvMath.h"
 #include "NvAppBase/NvCPUTimer.h"
 #include "NvUI/NvBitFont.h"
+#include "NvImage/NvImage.h"
 
 #include "NvGLUtils/NvTimers.h"
 #include "NvGamepad/NvGamepad.h"
 
 #include "School.h"
 #include "SchoolStateManager.h"
+#include <atomic>
 #include <cstdlib>
 #include <deque>
+#include <functional>
 #include <vector>
 
 #include "Buffers.h"
+#include "FrameComposer.h"
+#include "SnapshotStore.h"
+#include "StagingRing.h"
+#include "UniformRing.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "MaterialRegistry.h"
+#include "TraceRecorder.h"
+
+/// Times a scope and records it in the trace, a single object so CPU_TIMER_SCOPE is a single declaration
+struct CPUTimerTraceScope
+{
+    CPUTimerTraceScope(NvCPUTimer* timer, Nv::TraceRecorder& recorder, uint32_t id)
+        : m_timerScope(timer)
+        , m_traceScope(recorder, id)
+    {
+    }
+
+    NvCPUTimerScope m_timerScope;
+    Nv::TraceScope  m_traceScope;
+};
 
-#define CPU_TIMER_SCOPE(TIMER_ID) NvCPUTimerScope cpuTimer(&m_CPUTimers[TIMER_ID])
+#define TRACE_SCOPE(TRACE_ID) Nv::TraceScope traceScope(m_trace, TRACE_ID)
+#define CPU_TIMER_SCOPE(TIMER_ID) CPUTimerTraceScope cpuTimer(&m_CPUTimers[TIMER_ID], m_trace, TIMER_ID)
 #define GPU_TIMER_SCOPE() NvGPUTimerScope gpuTimer(&m_GPUTimer)
 
 class NvInputHandler_CameraFly;
@@ -71,6 +96,7 @@ public:
     virtual void initUI(void);
     virtual void reshape(int32_t width, int32_t height);
     virtual void draw(void);
+    virtual void drawUI(void);
 
     enum {
         MAX_ANIMATION_THREAD_COUNT = 8,
@@ -86,6 +112,7 @@ public:
         CPU_TIMER_MAIN_CMD_BUILD = 0,
         CPU_TIMER_MAIN_WAIT,
         CPU_TIMER_MAIN_COPYVBO,
+        CPU_TIMER_MAIN_OCCLUSION,
         CPU_TIMER_THREAD_BASE_CMD_BUILD,
         CPU_TIMER_THREAD_MAX_CMD_BUILD = CPU_TIMER_THREAD_BASE_CMD_BUILD + MAX_THREAD_COUNT,
         CPU_TIMER_THREAD_BASE_ANIMATE,
@@ -94,9 +121,20 @@ public:
         CPU_TIMER_THREAD_MAX_UPDATE = CPU_TIMER_THREAD_BASE_UPDATE + MAX_THREAD_COUNT,
         CPU_TIMER_THREAD_BASE_TOTAL,
         CPU_TIMER_THREAD_MAX_TOTAL = CPU_TIMER_THREAD_BASE_TOTAL + MAX_THREAD_COUNT,
+        CPU_TIMER_THREAD_BASE_OCCLUSION,
+        CPU_TIMER_THREAD_MAX_OCCLUSION = CPU_TIMER_THREAD_BASE_OCCLUSION + MAX_THREAD_COUNT,
         CPU_TIMER_COUNT
     };
 
+    /// IDs of the scopes that are only traced, the timer scopes are
+    /// traced with their timer ID
+    enum
+    {
+        TRACE_THREAD_BASE_WAIT = CPU_TIMER_COUNT,
+        TRACE_THREAD_MAX_WAIT = TRACE_THREAD_BASE_WAIT + MAX_THREAD_COUNT,
+        TRACE_COUNT
+    };
+
     /// Values to identify the current "rendering mode" being used
     enum
     {
@@ -137,6 +175,9 @@ public:
     /// in the scene.
     struct ProjUBO
     {
+        // hint that we dont care about ctr/dtr, recorded as constant blocks
+        typedef void pod_hint_tag;
+
         // Pipeline matrices
         nv::matrix4f m_projectionMatrix;
         nv::matrix4f m_inverseProjMatrix;
@@ -149,6 +190,9 @@ public:
     /// in the scene.
     struct LightingUBO
     {
+        // hint that we dont care about ctr/dtr, recorded as constant blocks
+        typedef void pod_hint_tag;
+
         nv::vec4f m_lightPosition;
         nv::vec4f m_lightAmbient;
         nv::vec4f m_lightDiffuse;
@@ -175,11 +219,18 @@ public:
         uint32_t m_baseSchoolIndex;
         uint32_t m_schoolCount;
         uint32_t m_frameID;
+        uint32_t m_taskID;
     };
 
     bool waitForWork(ThreadData& me, int threadIndex);
     void signalWorkComplete(uint32_t workCountDone);
 
+    /// Runs task(0) .. task(taskCount - 1) on the calling thread and the active animation
+    /// threads, once they finished their frame, and returns when all tasks are done
+    void runOnAnimationThreads(uint32_t taskCount, const std::function<void(uint32_t)>& task);
+    /// Runs tasks of the current runOnAnimationThreads call until none is left
+    void runTasks();
+
     /// Worker function called by each animation thread to update 
     /// the flocking animation in the school(s) that it handles
     /// \param threadIndex Index of the thread calling the method
@@ -187,10 +238,27 @@ public:
     ///
     void helperJobFunction();
 
+    /// Latches the camera of the frame, following the selected school if requested
+    void updateCamera();
+    /// Bins the occluders of the frame, the threads rasterize them in rasterizeOcclusionTiles
+    void beginOcclusion();
+    /// Rasterizes the occlusion tiles that no other thread took yet, then waits
+    /// until all of them are rasterized, so the bounds can be tested
+    void rasterizeOcclusionTiles();
+
+    /// Worker function called by each loader thread at startup to load the
+    /// fish models and textures with indices threadIndex + N * MAX_ANIMATION_THREAD_COUNT
+    /// \param threadIndex Index of the thread calling the method
+    void loadAssetsJobFunction(uint32_t threadIndex);
+
 private:
     // Additional rendering setup methods
     /// Shutdown and free all rendering resources
     void cleanRendering(void);
+    /// Blocks until the GPU has completed the frame, the uniform ring reuses its region afterwards
+    void waitUniformFence(uint32_t frame);
+    /// Without persistent mapping, uploads the uniform blocks of the current frame to the orphaned buffer
+    void uploadUniformRing(void);
 
     /// Resizes the School Descriptions array to the given size,
     /// initializing any new descriptions from the static array 
@@ -250,6 +318,8 @@ private:
 
     // Methods to affect the current settings of the app
     uint32_t setNumSchools(uint32_t numSchools);
+    /// Renumbers the materials by state and rebuilds the keys of the schools with the new ids
+    void renumberMaterials();
     void updateSchoolTankSizes();
     uint32_t setAnimationThreadNum(uint32_t numThreads);
     uint32_t setNumLights(uint32_t numLights);
@@ -309,6 +379,15 @@ private:
     // (Only used if USE_STATIC_THREAD_WORK is not defined)
     NvMutex* m_needsUpdateQueueLock;
 
+    // Tasks spread over the animation threads by runOnAnimationThreads, a new task ID wakes
+    // the threads like a new frame does. Each active thread increments m_taskThreadsDone
+    // once it found no more tasks.
+    const std::function<void(uint32_t)>* m_task;
+    uint32_t m_taskCount;
+    std::atomic<uint32_t> m_nextTask;
+    uint32_t m_taskID;
+    uint32_t m_taskThreadsDone;
+
     // Counter of the number of schools that have completed their update so that
     // a frame can continue its rendering once all schools are updated.
     uint32_t m_doneCount;
@@ -350,6 +429,21 @@ private:
     NvGLSLProgram* m_shader_Emission;
     NvGLSLProgram* m_shader_Volumetric;
 
+    /// Uniforms of the lighting shaders, resolved once so the commands don't look them up by name
+    struct LightingUniforms
+    {
+        NvGLSLProgram::Uniform modelViewMatrix;
+        NvGLSLProgram::Uniform lightingModel;
+        NvGLSLProgram::Uniform normalDepth;
+        NvGLSLProgram::Uniform diffuseRoughness;
+
+        void resolve(NvGLSLProgram* shader);
+    };
+    LightingUniforms m_directionalLightUniforms;
+    LightingUniforms m_pointLightUniforms;
+    NvGLSLProgram::Uniform m_emissionModelViewMatrix;
+    NvGLSLProgram::Uniform m_emissionColor;
+
     BRDF m_brdf;
 
     // Member fields that hold the scene geometry
@@ -397,7 +491,21 @@ private:
 
     LightingUBO         m_lightsUBO_Data[MAX_LIGHTS_COUNT];
     std::vector<int>    m_lightsSchoolIndex;
-    GLuint              m_lightsUBO_Id[MAX_LIGHTS_COUNT];
+    GLuint              m_uniformRingBuffer;  // holds the blocks of m_uniformRing
+    bool                m_uniformRingMapped;  // persistently mapped, else the ring's regions are uploaded
+    std::vector<GLsync> m_uniformFences;      // signaled after the submit of the frame of each ring region
+
+    // Point light volumes, culled before recording their commands
+    Nv::SphereBoundsSoA   m_lightsBounds;
+    std::vector<uint32_t> m_visibleLights;
+
+    // Occluders rasterized on the CPU, the schools and lights that passed the frustum culling
+    // are tested against them. The tiles are spread over the threads that test bounds.
+    Nv::OcclusionBuffer   m_occlusionBuffer;
+    std::atomic<uint32_t> m_occlusionNextTile;
+    std::atomic<uint32_t> m_occlusionTilesDone;
+    std::atomic<uint32_t> m_occlusionTestedCount;
+    std::atomic<uint32_t> m_occlusionCulledCount;
 
     // define the volume that the fish will remain within
     static nv::vec3f ms_tankMin;
@@ -441,6 +549,7 @@ private:
     };
     static ModelDesc ms_modelInfo[];
     Nv::NvModelExtGL* m_models[MODEL_COUNT];
+    Nv::NvModelExt* m_sourceModels[MODEL_COUNT]; // CPU side models, only valid during initialization
 
     // Structure used to define all of the characteristics of a school
     struct SchoolDesc
@@ -490,10 +599,29 @@ private:
     typedef std::vector<School*> SchoolSet;
     SchoolSet m_schools;
     std::vector<uint32_t> m_schoolsDrawCount;
-    std::vector<nv::vec3f> m_schoolsCentroid;
+    std::vector<uint32_t> m_schoolsUploadSize;  // bytes of instance data uploaded in the frame
+    std::vector<uint32_t> m_schoolsMaterial;
+    // Centroids of the schools published after each frame, the lights pin
+    // a version so it can't change while they are placed
+    cb::SnapshotStore<nv::vec3f> m_schoolsCentroid;
+    // School bounds and visible school indices, each animation thread
+    // culls and compacts its own range of schools
+    Nv::BoxBoundsSoA m_schoolsBounds;
+    std::vector<uint32_t> m_visibleSchools;
     uint32_t m_activeSchools;
 
     // Scene wide and background shared textures
+    enum
+    {
+        TEXTURE_SKYBOX_SAND = 0,
+        TEXTURE_SKYBOX_GRADIENT,
+        TEXTURE_CAUSTIC_1,
+        TEXTURE_CAUSTIC_2,
+        TEXTURE_COUNT
+    };
+    static const char* ms_textureFilenames[TEXTURE_COUNT];
+    NvImage* m_textureImages[TEXTURE_COUNT]; // Decoded at load time, only valid until uploaded in initGL
+
     GLuint m_skyboxSandTex;
     GLuint m_skyboxGradientTex;
 
@@ -520,6 +648,7 @@ private:
     // attempt to avoid each other
     bool m_avoidance;
     bool m_useVolumetricLights;
+    bool m_useOcclusionCulling;
 
     // Current application time in seconds
     float m_currentTime;
@@ -598,6 +727,9 @@ private:
     NvUIText* m_fullTimingStats;
     NvUIContainer* m_fullStatsBox;
 
+    // The stats texts are queued into it while drawing the UI, then drawn together
+    NvBFTextBatch* m_textBatch;
+
     // Textures to use when displaying NVIDIA and API logos as well
     // as a flag to indicate whether or not they should be displayed.
     bool m_bDisplayLogos;
@@ -607,11 +739,18 @@ private:
 
     // Stats variables
     uint32_t m_drawCallCount;
+    uint32_t m_instanceUploadSize;  // bytes of instance data uploaded by all the schools in the last frame
     uint32_t m_commandCount;
+    uint32_t m_occlusionTested;  // bounds tested against the occluders in the last frame
+    uint32_t m_occlusionCulled;
     float m_commandAllocations;
 
     enum { STATS_FRAMES = 5 };
+    enum { TRACE_EXPORT_FRAMES = 120 };
     NvCPUTimer m_CPUTimers[CPU_TIMER_COUNT];
+    Nv::TraceRecorder m_trace;
+    std::string m_traceFile;    // the last frames are exported to it at exit, set with -trace <file>
+    bool m_fishLods;            // cleared with -nolod to draw every fish at full detail
     NvGPUTimer m_GPUTimer;
     int32_t m_statsCountdown;
 
@@ -624,6 +763,11 @@ private:
 
     enum { GBUFFER_COUNT = 3 };
     GLuint m_texGBuffer[GBUFFER_COUNT];
+    /// The gbuffer textures read by the lighting commands, shared as a constant block.
+    struct GBufferTextures
+    {
+        GLuint tex[GBUFFER_COUNT];
+    };
     GLuint m_texDepthStencilBuffer;
     GLuint m_texGBufferFboId;
 
@@ -632,6 +776,7 @@ private:
     float m_meanCPUMainCmd;
     float m_meanCPUMainWait;
     float m_meanCPUMainCopyVBO;
+    float m_meanCPUMainOcclusion;
     float m_meanGPUFrameMS;
 
     struct ThreadTimings {
@@ -639,6 +784,7 @@ private:
         float update;
         float cmd;
         float tot;
+        float occlusion;
     };
 
     ThreadTimings m_threadTimings[MAX_THREAD_COUNT];
@@ -682,20 +828,21 @@ private:
 
         Nv::MaterialBinder* materialBinder;
         GLuint projUBO_Id;
-        ProjUBO projUBO_Data;
+        uint32_t projUBO_Block;  // constant block handle of the ProjUBO data
         GLuint lightingUBO_Id;
-        LightingUBO lightingUBO_Data;
+        uint32_t lightingUBO_Block;  // constant block handle of the LightingUBO data
 
         static void execute(const void* data, cb::RenderContext* rc)
         {
             auto& cmd = *reinterpret_cast<const BeginFrameCommand*>(data);
             cmd.materialBinder->reset();
+            cmd.materialBinder->resetStats();
 
             glBindBuffer(GL_UNIFORM_BUFFER, cmd.projUBO_Id);
-            glBufferData(GL_UNIFORM_BUFFER, sizeof(ProjUBO), &cmd.projUBO_Data, GL_STREAM_DRAW);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(ProjUBO), &rc->constantBlock<ProjUBO>(cmd.projUBO_Block), GL_STREAM_DRAW);
 
             glBindBuffer(GL_UNIFORM_BUFFER, cmd.lightingUBO_Id);
-            glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingUBO), &cmd.lightingUBO_Data, GL_STREAM_DRAW);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingUBO), &rc->constantBlock<LightingUBO>(cmd.lightingUBO_Block), GL_STREAM_DRAW);
             glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
             glEnable(GL_DEPTH_TEST);
@@ -800,7 +947,8 @@ private:
         GLuint lightingUBO_Location;
         GLuint lightingUBO_Id;
         NvGLSLProgram* shader;
-        GLuint texGBuffer[GBUFFER_COUNT];
+        LightingUniforms uniforms;
+        uint32_t gbufferBlock;  // constant block handle of the GBufferTextures
         uint32_t brdf;
 
         nv::matrix4f fullscreenMVP;
@@ -817,10 +965,12 @@ private:
         GLuint projUBO_Location;
         GLuint projUBO_Id;
         GLuint lightingUBO_Location;
-        GLuint lightingUBO_Id;
-        LightingUBO lightingUBO_Data;
+        GLuint lightingUBO_Buffer;  // range of the LightingUBO data in the uniform ring
+        uint32_t lightingUBO_Offset;
+        uint32_t lightingUBO_Size;
         NvGLSLProgram* shader;
-        GLuint texGBuffer[GBUFFER_COUNT];
+        LightingUniforms uniforms;
+        uint32_t gbufferBlock;  // constant block handle of the GBufferTextures
         uint32_t brdf;
 
         nv::matrix4f MVP;
@@ -835,6 +985,8 @@ private:
         typedef void pod_hint_tag;
 
         NvGLSLProgram* shader;
+        NvGLSLProgram::Uniform modelViewMatrix;
+        NvGLSLProgram::Uniform colorUniform;
         nv::vec4f color;
         nv::matrix4f MVP;
 
@@ -858,6 +1010,21 @@ private:
     GeometryCommandBuffer m_geometryCommands;
     DeferredCommandBuffer m_deferredCommands;
     PostProcessCommandBuffer m_postProcessCommands;
+    // Drawn over the UI, after the frame passes
+    PostProcessCommandBuffer m_overlayCommands;
+    // Sorts the three buffers concurrently and submits them in order
+    cb::FrameComposer m_frameComposer;
+    // Instance data copied by the animation threads, uploaded at submit
+    cb::StagingRing m_stagingRing;
+    // Uniform data of the point lights written at record time, one region per frame in flight
+    cb::UniformRing m_uniformRing;
+    // Orders the material ids of the geometry commands by state
+    Nv::MaterialRegistry m_materialRegistry;
+    // Set while the commands recorded with the current ids are kept, i.e. when paused
+    bool m_renumberMaterials;
+    Nv::MaterialBinder::Stats m_materialStats;
+    NvGLSLProgram::UniformStats m_uniformStats;
+    Nv::NvMeshExtGL::DrawStats m_drawStats;
 
 };
 #endif // ThreadedRenderingGL_H_
@@ -0,0 +1,177 @@
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+namespace Nv
+{
+    namespace
+    {
+        std::atomic<uint32_t> s_recorderCount(0);
+
+        uint64_t steadyMicroseconds()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        uint32_t roundUpPowerOfTwo(uint32_t value)
+        {
+            uint32_t result = 1;
+            while (result < value)
+                result <<= 1;
+            return result;
+        }
+
+        void appendEscaped(std::string& json, const std::string& text)
+        {
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                    json += '\\';
+                if ((unsigned char)c >= 0x20)
+                    json += c;
+            }
+        }
+    }
+
+    TraceRecorder::TraceRecorder(uint32_t eventsPerThread /*= 1 << 15*/)
+        : m_id(++s_recorderCount)
+        , m_eventMask(roundUpPowerOfTwo(std::max(eventsPerThread, 2u)) - 1)
+        , m_frame(0)
+        , m_enabled(true)
+        , m_startTimestamp(timestamp())
+        , m_startMicroseconds(steadyMicroseconds())
+    {
+    }
+
+    void TraceRecorder::setName(uint32_t id, const char* name)
+    {
+        std::lock_guard<std::mutex> lock(m_ringsLock);
+        if (id >= m_names.size())
+            m_names.resize(id + 1);
+        m_names[id] = name;
+    }
+
+    void TraceRecorder::setThreadName(const char* name)
+    {
+        ThreadCache& cache = threadCache();
+        ThreadRing*  ring = cache.recorderId == m_id ? cache.ring : registerThread();
+
+        std::lock_guard<std::mutex> lock(m_ringsLock);
+        ring->name = name;
+    }
+
+    TraceRecorder::ThreadRing* TraceRecorder::registerThread()
+    {
+        std::lock_guard<std::mutex> lock(m_ringsLock);
+
+        // the thread may have been recording to another recorder in between
+        const std::thread::id threadId = std::this_thread::get_id();
+        ThreadRing*           ring = nullptr;
+        for (const std::unique_ptr<ThreadRing>& threadRing : m_rings)
+        {
+            if (threadRing->threadId == threadId)
+                ring = threadRing.get();
+        }
+
+        if (!ring)
+        {
+            ring = new ThreadRing();
+            ring->head.store(0, std::memory_order_relaxed);
+            ring->index = (uint32_t)m_rings.size();
+            ring->threadId = threadId;
+            ring->events.resize(m_eventMask + 1);
+            m_rings.push_back(std::unique_ptr<ThreadRing>(ring));
+        }
+
+        ThreadCache& cache = threadCache();
+        cache.recorderId = m_id;
+        cache.ring = ring;
+        return ring;
+    }
+
+    std::string TraceRecorder::chromeTrace(uint32_t frameCount) const
+    {
+        const uint32_t lastFrame = frame();
+        const uint32_t firstFrame = lastFrame >= frameCount ? lastFrame - frameCount + 1 : 0;
+
+        // convert the timestamps to microseconds since the recorder was created
+        const uint64_t elapsedTicks = timestamp() - m_startTimestamp;
+        const uint64_t elapsedMicroseconds = steadyMicroseconds() - m_startMicroseconds;
+        const double   microsecondsPerTick =
+            elapsedTicks ? (double)elapsedMicroseconds / (double)elapsedTicks : 0.0;
+
+        std::lock_guard<std::mutex> lock(m_ringsLock);
+
+        std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        char        buffer[256];
+        bool        first = true;
+
+        std::vector<Event> events;
+        for (const std::unique_ptr<ThreadRing>& ring : m_rings)
+        {
+            if (!ring->name.empty())
+            {
+                json += first ? "" : ",";
+                json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":";
+                json += std::to_string(ring->index);
+                json += ",\"args\":{\"name\":\"";
+                appendEscaped(json, ring->name);
+                json += "\"}}";
+                first = false;
+            }
+
+            // copy the ring, then drop the scopes that the thread might have overwritten meanwhile
+            const uint32_t capacity = m_eventMask + 1;
+            const uint32_t head = ring->head.load(std::memory_order_acquire);
+            const uint32_t count = std::min(head, capacity);
+            events.resize(count);
+            for (uint32_t i = 0; i < count; ++i)
+                events[i] = ring->events[(head - count + i) & m_eventMask];
+            // orders the copy before the reload, so any scope it read that was rewritten is counted as overwritten
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // (the slot of the next scope might be half written as well)
+            const uint32_t newHead = ring->head.load(std::memory_order_acquire);
+            const uint32_t span = newHead + 1 - (head - count);
+            const uint32_t overwritten = span > capacity ? std::min(span - capacity, count) : 0;
+
+            // in the order they ended, so the children come before their parents
+            for (uint32_t i = overwritten; i < count; ++i)
+            {
+                const Event& event = events[i];
+                if (event.frame < firstFrame)
+                    continue;
+
+                json += first ? "" : ",";
+                json += "{\"name\":\"";
+                if (event.id < m_names.size() && !m_names[event.id].empty())
+                    appendEscaped(json, m_names[event.id]);
+                else
+                    json += std::to_string(event.id);
+                snprintf(buffer, sizeof(buffer),
+                         "\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                         ring->index, (event.begin - m_startTimestamp) * microsecondsPerTick,
+                         (event.end - event.begin) * microsecondsPerTick, event.frame);
+                json += buffer;
+                first = false;
+            }
+        }
+
+        json += "]}";
+        return json;
+    }
+
+    bool TraceRecorder::dumpChromeTrace(const char* path, uint32_t frameCount) const
+    {
+        const std::string json = chromeTrace(frameCount);
+
+        FILE* file = fopen(path, "wb");
+        if (!file)
+            return false;
+        const bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+        return fclose(file) == 0 && written;
+    }
+}
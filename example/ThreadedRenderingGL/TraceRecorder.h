@@ -0,0 +1,178 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#define TRACE_RDTSC 1
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#define TRACE_RDTSC 1
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace Nv
+{
+    ///@brief Records scopes in a fixed size ring per thread, the last frames can be exported as Chrome
+    /// trace JSON(chrome://tracing or ui.perfetto.dev).
+    ///@note Recording is lock-free and wait-free, each thread only writes to its own ring. A thread
+    /// takes a lock once, on its first scope, to register its ring. A scope is written once, when it ends,
+    /// with both of its timestamps, so its cost is mostly reading the clock twice.
+    class TraceRecorder
+    {
+    public:
+        ///@param eventsPerThread The ring size of each thread, in scopes, rounded up to a power of two.
+        explicit TraceRecorder(uint32_t eventsPerThread = 1 << 15);
+
+        /// Returns the timestamp a scope begins at, to be passed to end(), 0 if the recorder is disabled.
+        uint64_t begin() const;
+        /// Records the scope with the given id that began at the given timestamp, unless it is 0.
+        void end(uint32_t id, uint64_t beginTimestamp);
+
+        /// Starts a new frame, the scopes ending from then on are tagged with it.
+        void nextFrame();
+        uint32_t frame() const;
+
+        void setEnabled(bool enabled);
+        bool enabled() const;
+
+        /// Names the scopes with the given id, unnamed ids are exported by number.
+        ///@note Must not be called while exporting.
+        void setName(uint32_t id, const char* name);
+        /// Names the calling thread in the exported trace.
+        void setThreadName(const char* name);
+
+        /// Returns the scopes that ended in the last frameCount frames as Chrome trace JSON.
+        ///@note Can be called while recording, the scopes overwritten during the copy are dropped.
+        std::string chromeTrace(uint32_t frameCount) const;
+        bool dumpChromeTrace(const char* path, uint32_t frameCount) const;
+
+    private:
+        struct Event
+        {
+            uint64_t begin;
+            uint64_t end;
+            uint32_t frame;
+            uint32_t id;
+        };
+
+        struct ThreadRing
+        {
+            std::atomic<uint32_t> head;  // count of recorded events, wraps around
+            uint32_t              index;
+            std::thread::id       threadId;
+            std::string           name;
+            std::vector<Event>    events;
+        };
+
+        struct ThreadCache
+        {
+            uint32_t    recorderId;
+            ThreadRing* ring;
+        };
+
+        static uint64_t timestamp();
+        static ThreadCache& threadCache();
+
+        ThreadRing* registerThread();
+
+        const uint32_t                           m_id;  // unique per recorder, to validate the thread caches
+        const uint32_t                           m_eventMask;
+        std::atomic<uint32_t>                    m_frame;
+        std::atomic<bool>                        m_enabled;
+        mutable std::mutex                       m_ringsLock;
+        std::vector<std::unique_ptr<ThreadRing>> m_rings;
+        std::vector<std::string>                 m_names;
+        uint64_t                                 m_startTimestamp;
+        uint64_t                                 m_startMicroseconds;
+
+        TraceRecorder(const TraceRecorder&) = delete;
+        void operator=(const TraceRecorder&) = delete;
+    };
+
+    ///@brief Records a scope.
+    struct TraceScope
+    {
+        TraceScope(TraceRecorder& recorder, uint32_t id)
+            : m_recorder(recorder)
+            , m_id(id)
+            , m_begin(recorder.begin())
+        {
+        }
+        ~TraceScope() { m_recorder.end(m_id, m_begin); }
+
+        TraceRecorder& m_recorder;
+        uint32_t       m_id;
+        uint64_t       m_begin;
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline uint64_t TraceRecorder::begin() const
+    {
+        return m_enabled.load(std::memory_order_relaxed) ? timestamp() : 0;
+    }
+
+    inline void TraceRecorder::end(uint32_t id, uint64_t beginTimestamp)
+    {
+        if (!beginTimestamp)
+            return;
+        const uint64_t endTimestamp = timestamp();
+
+        ThreadCache& cache = threadCache();
+        ThreadRing*  ring = cache.recorderId == m_id ? cache.ring : registerThread();
+
+        // single producer, the release publishes the scope to the exporting thread
+        const uint32_t head = ring->head.load(std::memory_order_relaxed);
+        Event&         event = ring->events[head & m_eventMask];
+        event.begin = beginTimestamp;
+        event.end = endTimestamp;
+        event.frame = m_frame.load(std::memory_order_relaxed);
+        event.id = id;
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    inline void TraceRecorder::nextFrame()
+    {
+        m_frame.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline uint32_t TraceRecorder::frame() const
+    {
+        return m_frame.load(std::memory_order_relaxed);
+    }
+
+    inline void TraceRecorder::setEnabled(bool enabled)
+    {
+        m_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    inline bool TraceRecorder::enabled() const
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    inline uint64_t TraceRecorder::timestamp()
+    {
+#if TRACE_RDTSC
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    inline TraceRecorder::ThreadCache& TraceRecorder::threadCache()
+    {
+        static thread_local ThreadCache cache = { 0, nullptr };
+        return cache;
+    }
+
+}
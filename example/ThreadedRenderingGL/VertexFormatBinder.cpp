@@ -33,6 +33,8 @@
 //----------------------------------------------------------------------------------
 #include "VertexFormatBinder.h"
 
+#include <algorithm>
+
 namespace Nv
 {
     bool VertexFormatBinder::AddInstanceAttrib(GLuint attribIndex,
@@ -70,8 +72,13 @@ namespace Nv
         m_instanceAttributes.erase(attribIndex);
     }
 
+    void VertexFormatBinder::AddConstantAttrib(GLuint attribIndex)
+    {
+        m_constantAttributes.push_back(attribIndex);
+    }
+
 
-    void VertexFormatBinder::Activate(NvSharedVBOGL* pInstanceDataStream)
+    void VertexFormatBinder::Activate(NvSharedVBOGL* pInstanceDataStream, const float* pConstants, uint32_t constantCount)
     {
         // Activate the instancing data by binding the instance data stream and setting
         // up all of the offsets into each of the attributes
@@ -100,6 +107,13 @@ namespace Nv
             }
             glVertexAttribDivisor(desc.m_attribIndex, desc.m_divisor);
         }
+
+        // The current values of attributes with disabled arrays are used by all of the vertices
+        constantCount = std::min(constantCount, (uint32_t)m_constantAttributes.size());
+        for (uint32_t i = 0; i < constantCount; ++i)
+        {
+            glVertexAttrib4fv(m_constantAttributes[i], pConstants + i * 4);
+        }
     }
 
     void VertexFormatBinder::UpdatePointers(NvSharedVBOGL* pInstanceDataStream, uint32_t batchOffset)
@@ -36,6 +36,7 @@
 #include "NV/NvPlatformGL.h"
 #include "NvSharedVBOGL.h"
 #include <map>
+#include <vector>
 
 namespace Nv
 {
@@ -88,11 +89,23 @@ namespace Nv
 		/// \param attribIndex Index of the attribute to remove from the vertex definition
         void RemoveInstanceAttrib(GLuint attribIndex);
 
+        /// Adds an attribute that is constant over a draw, its array is left disabled
+        /// and its value is set with glVertexAttrib4fv when the binder is activated
+        /// \param attribIndex Location in the vertex format for this attribute
+        void AddConstantAttrib(GLuint attribIndex);
+
+        /// Retrieves the number of constant attributes
+        /// \return Number of vec4 values expected by Activate()
+        uint32_t GetConstantAttribCount() const { return (uint32_t)m_constantAttributes.size(); }
+
         /// Activates and sets up the vertex attribute arrays and their pointers and divisors
         /// in preparation for using an associated buffer to render.
         /// \param pVertexDataStream Pointer to the Shared VBO object containing the vertex
         ///                          data to use
-        void Activate(NvSharedVBOGL* pVertexDataStream);
+        /// \param pConstants Values of the constant attributes, 4 floats per attribute
+        ///                   in the order they were added
+        /// \param constantCount Number of vec4 values in pConstants
+        void Activate(NvSharedVBOGL* pVertexDataStream, const float* pConstants = nullptr, uint32_t constantCount = 0);
 
         /// The same as Activate(), but assumes the attribute array
         /// is already enabled and the divisor is set so that only
@@ -125,6 +138,9 @@ namespace Nv
         typedef std::map<uint32_t, InstanceAttribDesc> AttribSet;
         AttribSet m_instanceAttributes;
 
+        // Locations of the attributes that are constant over a draw
+        std::vector<GLuint> m_constantAttributes;
+
         // Total size of a single vertex
         GLsizei m_stride;
 	};
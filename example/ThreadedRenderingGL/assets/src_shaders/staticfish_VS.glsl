@@ -47,6 +47,12 @@ layout(location = 8) in vec3 a_vInstanceHeading;
 layout(location = 9) in float a_fInstanceAnimTime;
 layout(location = 10) in uint a_iSchoolId;
 
+// Instance data decoding, constant over a draw (see School::Render).
+// The positions are origin + position * scale, the headings are octahedral
+// encoded when the origin's w is set.
+layout(location = 11) in vec4 a_vInstanceOrigin;
+layout(location = 12) in vec4 a_vInstanceScale;
+
 // OUTPUT
 out vec2 v_vTexcoord;
 out vec4 v_vPosEyeSpace;
@@ -74,13 +80,25 @@ layout(binding=2) uniform ModelBlock {
 	float u_fTailStart;
 };
 
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
-    vec3 basisZ = -a_vInstanceHeading;
+    vec3 instancePos = a_vInstanceOrigin.xyz + a_vInstancePos * a_vInstanceScale.xyz;
+    vec3 instanceHeading = a_vInstanceOrigin.w > 0.5f ? octDecode(a_vInstanceHeading.xy) : a_vInstanceHeading;
+
+    vec3 basisZ = -instanceHeading;
     vec3 basisX = normalize(cross(vec3(0.0f, 1.0f, 0.0f), basisZ));
     vec3 basisY = normalize(cross(basisZ, basisX));
 
-    mat4 instanceXfm = mat4(vec4(basisX, 0.0f), vec4(basisY, 0.0f), vec4(basisZ, 0.0f), vec4(a_vInstancePos, 1.0f));
+    mat4 instanceXfm = mat4(vec4(basisX, 0.0f), vec4(basisY, 0.0f), vec4(basisZ, 0.0f), vec4(instancePos, 1.0f));
 	mat4 modelXfm = u_mModelMatrix;
 	vec4 vPosModelSpace = modelXfm * vec4(a_vPosition.xyz, 1.0);
 
@@ -0,0 +1,108 @@
+//
+//  BitFontTests.cpp
+//
+
+#include "Test.h"
+
+#include "NvBitFontInternal.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    /// Lays out the quads of a string with glyphs of varying size, like NvBFText::PrepareGlyphs does.
+    std::vector<BFVert> layoutString(const char* text, float size)
+    {
+        std::vector<BFVert> verts;
+        const float         scale = size / 32.f;
+        float               penX = 0.f;
+        uint32_t            color = 0xFFFFFFFFu;
+        for (const char* c = text; *c; ++c)
+        {
+            // the color escapes of the stats, their packed values are NaNs and denormals as floats
+            if (*c == '\001')
+            {
+                color = 0xFF0000FFu;
+                continue;
+            }
+            if (*c == '\002')
+            {
+                color = 0x00000001u;
+                continue;
+            }
+
+            const float left = penX + (*c % 3) * scale;
+            const float top = (2 + *c % 5) * scale;
+            const float width = (18 + *c % 5) * scale;
+            const float height = 30.f * scale;
+            const float u = (*c % 16) * 30.f / 512.f;
+            const float v = (*c / 16) * 40.f / 512.f;
+
+            const BFVert quad[VERT_PER_QUAD] = {
+                {{left, top}, {u, v}, color},
+                {{left, top + height}, {u, v + 30.f / 512.f}, color},
+                {{left + width, top + height}, {u + 20.f / 512.f, v + 30.f / 512.f}, color},
+                {{left + width, top}, {u + 20.f / 512.f, v}, color}};
+            verts.insert(verts.end(), quad, quad + VERT_PER_QUAD);
+            penX += (20 + *c % 4) * scale;
+        }
+        return verts;
+    }
+}  // namespace
+
+TEST_CASE(BitFont, CopyGlyphQuadsMatchesThePerStringPath)
+{
+    const char* strings[] = {"Fish 42: \001" "3.70\002 ms", "Draw calls: 1234", "g", "Avoidance \001ON\002 / Occlusion 17%"};
+    const float offsets[][2] = {{0.f, 0.f}, {47.5f, 11.25f}, {-3.125f, 1079.f}, {1919.99f, -0.f}, {1e-3f, 3e7f}};
+
+    for (const char* string : strings)
+    {
+        for (const float* offset : offsets)
+        {
+            const std::vector<BFVert> src = layoutString(string, 14.f);
+            const int32_t             count = int32_t(src.size() / VERT_PER_QUAD);
+            // one more quad, that must be left untouched
+            std::vector<BFVert> scalar(src.size() + VERT_PER_QUAD);
+            std::vector<BFVert> copied(src.size() + VERT_PER_QUAD);
+            memset(scalar.data(), 0xCD, scalar.size() * sizeof(BFVert));
+            memset(copied.data(), 0xCD, copied.size() * sizeof(BFVert));
+
+            CopyGlyphQuadsScalar(scalar.data(), src.data(), count, offset[0], offset[1]);
+            CopyGlyphQuads(copied.data(), src.data(), count, offset[0], offset[1]);
+            CHECK(memcmp(scalar.data(), copied.data(), scalar.size() * sizeof(BFVert)) == 0);
+            CHECK(scalar[0].color == src[0].color);
+            CHECK(scalar[0].pos[0] == src[0].pos[0] + offset[0]);
+        }
+    }
+}
+
+BENCH_CASE(BitFont, CopyGlyphQuads)
+{
+    // the stats texts of the sample, about 20 glyphs each
+    const uint32_t            textCount = 4000;
+    const uint32_t            frames = 200;
+    const std::vector<BFVert> src = layoutString("Fish 42: \001" "3.70\002 ms, 12 batches", 14.f);
+    const int32_t             count = int32_t(src.size() / VERT_PER_QUAD);
+    std::vector<BFVert>       dest(src.size() * textCount);
+
+    for (int simd = 0; simd < 2; ++simd)
+    {
+        const test::Timer timer;
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            for (uint32_t t = 0; t < textCount; ++t)
+            {
+                const float x = (t % 40) * 47.5f;
+                const float y = (t / 40) * 11.25f + f;
+                if (simd)
+                    CopyGlyphQuads(&dest[t * src.size()], src.data(), count, x, y);
+                else
+                    CopyGlyphQuadsScalar(&dest[t * src.size()], src.data(), count, x, y);
+            }
+            test::keep(dest[f].pos[0]);
+        }
+        std::printf("%s: %.2f ns per quad\n", simd ? "CopyGlyphQuads" : "scalar",
+                    timer.ms() * 1e6 / (double(frames) * textCount * count));
+    }
+}
@@ -0,0 +1,301 @@
+//
+//  CommandBufferTests.cpp
+//
+
+#include "Test.h"
+
+#include "CommandBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    /// A draw as it was dispatched, with the material and pass bound at the time and the view.
+    struct Dispatch
+    {
+        uint32_t value;
+        uint32_t material;
+        uint32_t pass;
+        uint32_t view;
+
+        bool operator==(const Dispatch& other) const
+        {
+            return value == other.value && material == other.material && pass == other.pass && view == other.view;
+        }
+    };
+
+    /// The output of a render context, what a deferred context would record.
+    struct Recording
+    {
+        std::vector<Dispatch> dispatches;
+        cb::MaterialId        bound = cb::MaterialId(0, 0);
+        uint32_t              binds = 0;
+    };
+
+    struct Draw
+    {
+        static const cb::RenderContext::function_t kDispatchFunction;
+
+        uint32_t value;
+
+        CB_COMMAND_PACKET_ALIGN()
+    };
+
+    void dispatchDraw(const void* data, cb::RenderContext* rc)
+    {
+        const Draw& cmd = *reinterpret_cast<const Draw*>(data);
+        Recording&  recording = rc->data<Recording>();
+        recording.dispatches.push_back(
+            Dispatch{cmd.value, recording.bound.id, recording.bound.pass, rc->viewportId()});
+    }
+
+    const cb::RenderContext::function_t Draw::kDispatchFunction = &dispatchDraw;
+
+    /// Binds into the recording of its context, with redundancy checks like the sample's binder,
+    /// the materials with an id multiple of 3 have two passes.
+    struct RecordingBinder
+    {
+        bool operator()(cb::MaterialId material) const
+        {
+            if (material.id != active.id || material.pass != active.pass)
+            {
+                recording->bound = material;
+                ++recording->binds;
+                active = material;
+                ++binds;
+            }
+            return material.id % 3 == 0 && material.pass == 0;
+        }
+
+        Recording*             recording = nullptr;
+        mutable cb::MaterialId active = cb::MaterialId(~0u, 0);
+        mutable uint32_t       binds = 0;
+    };
+
+    typedef cb::CommandBuffer<cb::DrawKey, cb::DefaultKeyDecoder, RecordingBinder> RecordingCommandBuffer;
+
+    /// Records runs of draws of the same material, some of them for several views.
+    void recordDraws(RecordingCommandBuffer& buffer, uint32_t count, uint32_t seed)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            cb::DrawKey key = cb::DrawKey::makeDefault(0);
+            key.setMaterialDepth(1 + (seed >> 8) % 13, i);
+            if ((seed >> 4) % 5 == 0)
+                buffer.addMultiViewCommand<Draw>(key, uint8_t(1 + (seed >> 20) % 7))->value = i;
+            else
+                buffer.addCommand<Draw>(key)->value = i;
+        }
+        buffer.sort();
+    }
+
+    void runThreads(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+    {
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < taskCount; ++i)
+            threads.emplace_back(task, i);
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+}  // namespace
+
+TEST_CASE(CommandBuffer, SubmitParallelMatchesSubmit)
+{
+    for (uint32_t count : {0u, 3u, 200u, 3001u})
+    {
+        for (uint32_t chunkCount : {1u, 2u, 3u, 7u, 16u})
+        {
+            RecordingCommandBuffer buffer(4 * count + 1, 256);
+            recordDraws(buffer, count, count + chunkCount);
+
+            // the serial submit, without clearing the buffer
+            Recording         serial;
+            cb::RenderContext serialContext(&serial);
+            buffer.materialBinder() = RecordingBinder();
+            buffer.materialBinder().recording = &serial;
+            buffer.submit(&serialContext, false);
+            const RecordingBinder serialBinder = buffer.materialBinder();
+
+            std::vector<Recording>          recordings(chunkCount);
+            std::vector<cb::RenderContext>  contextStorage;
+            std::vector<cb::RenderContext*> contexts;
+            contextStorage.reserve(chunkCount);
+            for (uint32_t i = 0; i < chunkCount; ++i)
+            {
+                contextStorage.emplace_back(&recordings[i]);
+                contexts.push_back(&contextStorage[i]);
+            }
+
+            // resets the redundancy state of each chunk, then sums up the binds
+            buffer.materialBinder() = RecordingBinder();
+            buffer.submitParallel(contexts.data(), chunkCount, runThreads,
+                                  [&recordings](RecordingBinder& binder, uint32_t chunk) {
+                                      binder = RecordingBinder();
+                                      binder.recording = &recordings[chunk];
+                                  },
+                                  [](RecordingBinder& binder, const RecordingBinder& chunkBinder, uint32_t) {
+                                      binder.binds += chunkBinder.binds;
+                                      binder.active = chunkBinder.active;
+                                  },
+                                  false);
+
+            // joined in chunk order, the chunks dispatched what the serial submit did
+            std::vector<Dispatch> joined;
+            uint32_t              binds = 0;
+            for (const Recording& recording : recordings)
+            {
+                joined.insert(joined.end(), recording.dispatches.begin(), recording.dispatches.end());
+                binds += recording.binds;
+            }
+            CHECK(joined == serial.dispatches);
+            CHECK(buffer.materialBinder().binds == binds);
+            // at most one more bind per chunk, where a material is split
+            CHECK(binds >= serial.binds && binds <= serial.binds + chunkCount - 1);
+            CHECK(buffer.materialBinder().active.id == serialBinder.active.id);
+
+            // without a fold function the binder is the last chunk's one
+            std::vector<Recording> again(chunkCount);
+            for (uint32_t i = 0; i < chunkCount; ++i)
+                contextStorage[i] = cb::RenderContext(&again[i]);
+            buffer.submitParallel(contexts.data(), chunkCount, runThreads,
+                                  [&again](RecordingBinder& binder, uint32_t chunk) {
+                                      binder = RecordingBinder();
+                                      binder.recording = &again[chunk];
+                                  });
+            CHECK(buffer.materialBinder().binds == again.back().binds);
+            CHECK(buffer.materialBinder().recording == &again.back());
+            CHECK(buffer.count() == 0);
+        }
+    }
+}
+
+TEST_CASE(CommandBuffer, MultiViewCommandsSharePackets)
+{
+    RecordingCommandBuffer buffer(64, 64);
+    Recording              recording;
+    cb::RenderContext      context(&recording);
+    buffer.materialBinder().recording = &recording;
+
+    // a single view command and the same command for views 0, 1, 3 and 7
+    cb::DrawKey key = cb::DrawKey::makeDefault(0);
+    key.setMaterialDepth(2, 5);
+    cb::DrawKey farther = key;
+    farther.setDepth(4);
+    buffer.addCommand<Draw>(farther)->value = 1;
+    const size_t singleViewBytes = buffer.allocations();
+    Draw*        draw = buffer.addMultiViewCommand<Draw>(key, 0x8B);
+    draw->value = 2;
+    CHECK(buffer.allocations() == 2 * singleViewBytes);
+    // the chained commands are shared too
+    buffer.appendCommand<Draw>(draw)->value = 3;
+    CHECK(buffer.count() == 5);
+    CHECK(buffer.count(true) == 9);
+
+    buffer.sort();
+    buffer.submit(&context);
+    // the higher viewport ids sort first, each view dispatches the packet and its chain
+    const Dispatch expected[] = {{2, 2, 0, 7}, {3, 2, 0, 7}, {2, 2, 0, 3}, {3, 2, 0, 3}, {2, 2, 0, 1},
+                                 {3, 2, 0, 1}, {2, 2, 0, 0}, {3, 2, 0, 0}, {1, 2, 0, 0}};
+    CHECK(recording.dispatches.size() == 9);
+    CHECK(std::equal(recording.dispatches.begin(), recording.dispatches.end(), expected));
+    CHECK(buffer.count() == 0 && buffer.allocations() == 0);
+}
+
+TEST_CASE(CommandBuffer, DeduplicatesConstantBlocks)
+{
+    struct Block
+    {
+        float values[6];
+    };
+    typedef cb::CommandBuffer<cb::DrawKey> DrawCommandBuffer;
+
+    DrawCommandBuffer buffer(64, 64);
+    const Block       first = {{1.f, 2.f, 3.f, 4.f, 5.f, 6.f}};
+    const Block       second = {{1.f, 2.f, 3.f, 4.f, 5.f, 7.f}};
+
+    // identical blocks share the handle
+    const uint32_t firstHandle = buffer.addConstantBlock(first);
+    CHECK(buffer.addConstantBlock(first) == firstHandle);
+    CHECK(buffer.addConstantBlock(&first, sizeof(first)) == firstHandle);
+    CHECK(buffer.constantBlockCount() == 1);
+    const uint32_t secondHandle = buffer.addConstantBlock(second);
+    CHECK(secondHandle != firstHandle && buffer.constantBlockCount() == 2);
+    // the same bytes with another size are another block
+    const uint32_t prefixHandle = buffer.addConstantBlock(&first, sizeof(float) * 5);
+    CHECK(prefixHandle != firstHandle && buffer.constantBlockCount() == 3);
+    CHECK(memcmp(&buffer.constantBlock<Block>(firstHandle), &first, sizeof(Block)) == 0);
+    CHECK(memcmp(&buffer.constantBlock<Block>(secondHandle), &second, sizeof(Block)) == 0);
+
+    // blocks with the same hash and different contents, the hash consumes a word per step so the
+    // second word of the other block cancels the difference of the first one
+    const uint32_t kPrime = 16777619u;
+    const uint32_t seed = 2166136261u ^ 8u;
+    uint32_t       colliding[2][2] = {{0x12345678u, 0x9ABCDEFu}, {0x0F0F0F0Fu, 0u}};
+    colliding[1][1] = ((seed ^ colliding[0][0]) * kPrime) ^ ((seed ^ colliding[1][0]) * kPrime) ^ colliding[0][1];
+    CHECK(cb::mem::hash(colliding[0], 8) == cb::mem::hash(colliding[1], 8));
+    const uint32_t collidingHandles[2] = {buffer.addConstantBlock(colliding[0], 8),
+                                          buffer.addConstantBlock(colliding[1], 8)};
+    CHECK(collidingHandles[0] != collidingHandles[1] && buffer.constantBlockCount() == 5);
+    for (int i = 0; i < 2; ++i)
+    {
+        CHECK(buffer.addConstantBlock(colliding[i], 8) == collidingHandles[i]);
+        CHECK(memcmp(&buffer.constantBlock<uint32_t>(collidingHandles[i]), colliding[i], 8) == 0);
+    }
+    CHECK(buffer.constantBlockCount() == 5);
+
+    // the blocks are reset when the buffer is cleared
+    cb::RenderContext context(nullptr);
+    buffer.submit(&context);
+    CHECK(buffer.constantBlockCount() == 0 && buffer.allocations() == 0);
+    const uint32_t handle = buffer.addConstantBlock(second);
+    CHECK(buffer.constantBlockCount() == 1);
+    CHECK(memcmp(&buffer.constantBlock<Block>(handle), &second, sizeof(Block)) == 0);
+    CHECK(buffer.addConstantBlock(first) != handle);
+
+    // out of slots the blocks are still stored, only without deduplication
+    buffer.submit(&context);
+    buffer.resizeConstantBlocks(2);
+    std::vector<uint32_t> handles;
+    for (uint32_t i = 0; i < 8; ++i)
+        handles.push_back(buffer.addConstantBlock(i));
+    CHECK(buffer.constantBlockCount() == 4);
+    uint32_t deduplicated = 0;
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        CHECK(buffer.constantBlock<uint32_t>(handles[i]) == i);
+        const uint32_t again = buffer.addConstantBlock(i);
+        deduplicated += again == handles[i] ? 1 : 0;
+        CHECK(buffer.constantBlock<uint32_t>(again) == i);
+    }
+    CHECK(deduplicated == 4);
+}
+
+TEST_CASE(CommandBuffer, DeduplicatesConstantBlocksAcrossThreads)
+{
+    cb::CommandBuffer<cb::DrawKey> buffer(64, 256);
+
+    // the threads add the same values in different orders, the odd strides go through all of them
+    const uint32_t                     threadCount = 4, valueCount = 64;
+    std::vector<std::vector<uint32_t>> handles(threadCount, std::vector<uint32_t>(valueCount));
+    runThreads(threadCount, [&](uint32_t thread) {
+        for (uint32_t i = 0; i < valueCount; ++i)
+        {
+            const uint32_t value = (i * (thread * 2 + 1)) % valueCount;
+            handles[thread][value] = buffer.addConstantBlock(value * 1000);
+        }
+    });
+
+    CHECK(buffer.constantBlockCount() == valueCount);
+    uint32_t mismatches = 0;
+    for (uint32_t value = 0; value < valueCount; ++value)
+    {
+        for (uint32_t thread = 0; thread < threadCount; ++thread)
+            mismatches += handles[thread][value] == handles[0][value] ? 0 : 1;
+        CHECK(buffer.constantBlock<uint32_t>(handles[0][value]) == value * 1000);
+    }
+    CHECK(mismatches == 0);
+}
@@ -0,0 +1,150 @@
+//
+//  FrameComposerTests.cpp
+//
+
+#include "Test.h"
+
+#include "CommandBuffer.h"
+#include "FrameComposer.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Record
+    {
+        static const cb::RenderContext::function_t kDispatchFunction;
+
+        uint32_t value;
+
+        CB_COMMAND_PACKET_ALIGN()
+    };
+
+    void dispatchRecord(const void* data, cb::RenderContext* rc)
+    {
+        rc->data<std::vector<uint32_t>>().push_back(reinterpret_cast<const Record*>(data)->value);
+    }
+
+    const cb::RenderContext::function_t Record::kDispatchFunction = &dispatchRecord;
+
+    typedef cb::CommandBuffer<cb::DrawKey>                              DrawCommandBuffer;
+    typedef cb::CommandBuffer<uint32_t, cb::DummyKeyDecoder<uint32_t>> PriorityCommandBuffer;
+
+    /// Records the values base + count - 1 .. base, their keys sort them back in order.
+    void recordDraws(DrawCommandBuffer& buffer, uint32_t base, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            // the draw keys sort from the highest, i.e. the farthest
+            cb::DrawKey key = cb::DrawKey::makeDefault(0);
+            key.setMaterialDepth(1, i + 1);
+            buffer.addCommand<Record>(key)->value = base + (count - 1 - i);
+        }
+    }
+
+    void recordPriorities(PriorityCommandBuffer& buffer, uint32_t base, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+            buffer.addCommand<Record>(count - 1 - i)->value = base + (count - 1 - i);
+    }
+
+    std::vector<uint32_t> expectedValues(std::initializer_list<uint32_t> bases, uint32_t count)
+    {
+        std::vector<uint32_t> values;
+        for (uint32_t base : bases)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+                values.push_back(base + i);
+        }
+        return values;
+    }
+}  // namespace
+
+TEST_CASE(FrameComposer, SubmitsInRegistrationAndDependencyOrder)
+{
+    // runs each sort on its own thread and checks that they overlap
+    std::atomic<uint32_t> running(0), overlapped(0), sorts(0);
+    auto parallelFunc = [&](uint32_t taskCount, const std::function<void(uint32_t)>& task) {
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < taskCount; ++i)
+        {
+            threads.emplace_back([&, i]() {
+                ++running;
+                while (running.load() < taskCount && overlapped.load() == 0)
+                    std::this_thread::yield();
+                overlapped += running.load() == taskCount ? 1 : 0;
+                task(i);
+                ++sorts;
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+    };
+
+    DrawCommandBuffer     geometry(100, 16);
+    PriorityCommandBuffer lighting(100, 16), post(100, 16);
+    cb::FrameComposer     composer(parallelFunc);
+
+    const uint32_t geometryPass = composer.add(geometry, std::sort<DrawCommandBuffer::command_t*>, "geometry");
+    const uint32_t lightingPass = composer.add(lighting);
+    const uint32_t postPass = composer.add(post, std::stable_sort<PriorityCommandBuffer::command_t*>, "post");
+    CHECK(composer.count() == 3);
+    CHECK(strcmp(composer.name(geometryPass), "geometry") == 0 && strcmp(composer.name(lightingPass), "") == 0);
+
+    std::vector<uint32_t> values;
+    cb::RenderContext     context(&values);
+
+    // in registration order
+    recordDraws(geometry, 100, 20);
+    recordPriorities(lighting, 200, 20);
+    recordPriorities(post, 300, 20);
+    composer.sort();
+    CHECK(sorts.load() == 3 && overlapped.load() > 0);
+    composer.submit(&context);
+    CHECK(values == expectedValues({100, 200, 300}, 20));
+    CHECK(geometry.count() == 0 && lighting.count() == 0 && post.count() == 0);
+    CHECK(composer.timing(postPass).sortTime >= 0.f && composer.timing(postPass).submitTime >= 0.f);
+
+    // the geometry after the post process, the others keep their order
+    composer.addDependency(geometryPass, postPass);
+    values.clear();
+    recordDraws(geometry, 100, 20);
+    recordPriorities(lighting, 200, 20);
+    recordPriorities(post, 300, 20);
+    composer.sort();
+    composer.submit(&context);
+    CHECK(values == expectedValues({200, 300, 100}, 20));
+
+    // and the lighting after the geometry, without clearing the buffers the next submit dispatches them again
+    composer.addDependency(lightingPass, geometryPass);
+    values.clear();
+    recordDraws(geometry, 100, 20);
+    recordPriorities(lighting, 200, 20);
+    recordPriorities(post, 300, 20);
+    composer.sort();
+    composer.submit(&context, false);
+    CHECK(values == expectedValues({300, 100, 200}, 20));
+    composer.submit(&context);
+    CHECK(values == expectedValues({300, 100, 200, 300, 100, 200}, 20));
+}
+
+TEST_CASE(FrameComposer, RunAsyncRunsEveryTask)
+{
+    std::vector<std::atomic<uint32_t>> runs(9);
+    for (std::atomic<uint32_t>& run : runs)
+        run = 0;
+    const std::thread::id caller = std::this_thread::get_id();
+    std::atomic<bool>     firstOnCaller(false);
+    cb::FrameComposer::runAsync(9, [&](uint32_t task) {
+        ++runs[task];
+        if (task == 0)
+            firstOnCaller = std::this_thread::get_id() == caller;
+    });
+    for (std::atomic<uint32_t>& run : runs)
+        CHECK(run.load() == 1);
+    CHECK(firstOnCaller.load());
+    cb::FrameComposer::runAsync(0, [&](uint32_t) { CHECK(false); });
+}
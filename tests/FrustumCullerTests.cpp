@@ -0,0 +1,223 @@
+//
+//  FrustumCullerTests.cpp
+//
+
+#include "Test.h"
+
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace Nv;
+
+namespace
+{
+    // bounds closer to a plane than this may be classified either way
+    const double kTieMargin = 1e-4;
+
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed)
+            : m_state(seed)
+        {
+        }
+
+        float uniform(float min, float max)
+        {
+            m_state = m_state * 1664525u + 1013904223u;
+            return min + (max - min) * float(m_state >> 8) / float(1 << 24);
+        }
+
+    private:
+        uint32_t m_state;
+    };
+
+    FrustumPlanes sampleFrustum()
+    {
+        nv::matrix4f proj, view;
+        nv::perspective(proj, 3.14159f / 3.f, 16.f / 9.f, 0.1f, 200.f);
+        nv::lookAt(view, nv::vec3f(3.f, 12.f, 40.f), nv::vec3f(-5.f, 4.f, -20.f), nv::vec3f(0.f, 1.f, 0.f));
+        return FrustumPlanes::fromMatrix(proj * view);
+    }
+
+    double planeDistance(const FrustumPlanes& f, int p, double x, double y, double z)
+    {
+        return f.nx[p] * x + f.ny[p] * y + f.nz[p] * z + f.d[p];
+    }
+
+    /// The plane distance test, one bound and one plane at a time in double, returns -1 for the bounds
+    /// too close to call, 0 for the culled ones and 1 for the visible ones.
+    int referenceSphere(const FrustumPlanes& f, const SphereBoundsSoA& b, uint32_t i)
+    {
+        double margin = 1e30;
+        for (int p = 0; p < FrustumPlanes::kPlaneCount; ++p)
+            margin = std::min(margin, planeDistance(f, p, b.x[i], b.y[i], b.z[i]) + b.radius[i]);
+        return fabs(margin) < kTieMargin ? -1 : margin >= 0.0;
+    }
+
+    int referenceBox(const FrustumPlanes& f, const BoxBoundsSoA& b, uint32_t i)
+    {
+        double margin = 1e30;
+        for (int p = 0; p < FrustumPlanes::kPlaneCount; ++p)
+        {
+            const double radius = fabs(f.nx[p]) * b.extentX[i] + fabs(f.ny[p]) * b.extentY[i] +
+                                  fabs(f.nz[p]) * b.extentZ[i];
+            margin = std::min(margin, planeDistance(f, p, b.x[i], b.y[i], b.z[i]) + radius);
+        }
+        return fabs(margin) < kTieMargin ? -1 : margin >= 0.0;
+    }
+
+    /// Spheres around and in the frustum, then spheres moved from a point inside the frustum onto each
+    /// plane and off it by -1.5, -0.5, 0.5 and 1.5 radii, i.e. culled, straddling the plane twice and inside.
+    SphereBoundsSoA sampleSpheres(const FrustumPlanes& f, uint32_t randomCount)
+    {
+        Random          random(7);
+        SphereBoundsSoA bounds;
+        bounds.resize(randomCount);
+        for (uint32_t i = 0; i < randomCount; ++i)
+        {
+            const nv::vec3f center(random.uniform(-120.f, 120.f), random.uniform(-40.f, 60.f),
+                                   random.uniform(-220.f, 60.f));
+            bounds.set(i, center, random.uniform(0.1f, 6.f));
+        }
+
+        const nv::vec3f inside(-1.f, 8.f, 10.f);
+        const float     offsets[] = {-1.5f, -0.5f, 0.5f, 1.5f};
+        for (int p = 0; p < FrustumPlanes::kPlaneCount; ++p)
+        {
+            const nv::vec3f normal(f.nx[p], f.ny[p], f.nz[p]);
+            const nv::vec3f onPlane = inside - normal * float(planeDistance(f, p, inside.x, inside.y, inside.z));
+            for (float radius : {0.05f, 0.5f, 4.f})
+            {
+                for (float offset : offsets)
+                {
+                    bounds.resize(bounds.size() + 1);
+                    bounds.set(bounds.size() - 1, onPlane + normal * (offset * radius), radius);
+                }
+            }
+        }
+        return bounds;
+    }
+
+    BoxBoundsSoA sampleBoxes(uint32_t count)
+    {
+        Random       random(11);
+        BoxBoundsSoA bounds;
+        bounds.resize(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const nv::vec3f center(random.uniform(-120.f, 120.f), random.uniform(-40.f, 60.f),
+                                   random.uniform(-220.f, 60.f));
+            bounds.set(i, center, nv::vec3f(random.uniform(0.1f, 6.f), random.uniform(0.1f, 2.f),
+                                            random.uniform(0.1f, 6.f)));
+        }
+        return bounds;
+    }
+
+    /// Culls [begin, end) and checks the indices against the reference, returns the visible count.
+    template <typename Bounds, typename Cull, typename Reference>
+    uint32_t checkRange(const FrustumPlanes& f, const Bounds& bounds, uint32_t begin, uint32_t end, Cull cull,
+                        Reference reference)
+    {
+        std::vector<uint32_t> visible(end - begin + 1);
+        const uint32_t        count = cull(f, bounds, begin, end, visible.data());
+        CHECK(count <= end - begin);
+
+        uint32_t mismatches = 0, next = 0;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const bool culledVisible = next < count && visible[next] == i;
+            next += culledVisible ? 1 : 0;
+            const int expected = reference(f, bounds, i);
+            mismatches += expected >= 0 && expected != int(culledVisible) ? 1 : 0;
+        }
+        // the indices are in ascending order, and all were matched
+        CHECK(next == count);
+        CHECK(mismatches == 0);
+        return count;
+    }
+}  // namespace
+
+TEST_CASE(FrustumCuller, SpheresMatchPlaneDistances)
+{
+    const FrustumPlanes   f = sampleFrustum();
+    const SphereBoundsSoA spheres = sampleSpheres(f, 1000);
+    const uint32_t        count = uint32_t(spheres.size());
+
+    const uint32_t visible = checkRange(f, spheres, 0, count, cullSpheres, referenceSphere);
+    CHECK(visible > 0 && visible < count);
+
+    // the straddling spheres are visible, the ones 1.5 radii out aren't
+    const uint32_t        first = 1000;
+    std::vector<uint32_t> indices(count - first);
+    const uint32_t        planeVisible = cullSpheres(f, spheres, first, count, indices.data());
+    CHECK(planeVisible == FrustumPlanes::kPlaneCount * 3 * 3);
+    for (uint32_t i = 0; i < planeVisible; ++i)
+        CHECK((indices[i] - first) % 4 != 0);
+
+    // the ranges of the workers, with all of the remainders of the 8 and 4 wide loops
+    for (uint32_t begin : {0u, 1u, 3u, 5u, 8u, 13u})
+    {
+        for (uint32_t length : {0u, 1u, 2u, 3u, 4u, 5u, 7u, 8u, 9u, 15u, 17u, 100u})
+            checkRange(f, spheres, begin, std::min(begin + length, count), cullSpheres, referenceSphere);
+        checkRange(f, spheres, begin, count, cullSpheres, referenceSphere);
+    }
+}
+
+TEST_CASE(FrustumCuller, BoxesMatchPlaneDistances)
+{
+    const FrustumPlanes f = sampleFrustum();
+    const BoxBoundsSoA  boxes = sampleBoxes(1003);
+
+    const uint32_t visible = checkRange(f, boxes, 0, 1003, cullBoxes, referenceBox);
+    CHECK(visible > 0 && visible < 1003);
+    for (uint32_t begin : {1u, 6u})
+    {
+        for (uint32_t length : {3u, 4u, 7u, 9u, 31u})
+            checkRange(f, boxes, begin, begin + length, cullBoxes, referenceBox);
+    }
+}
+
+BENCH_CASE(FrustumCuller, CullSpheres)
+{
+    const uint32_t        count = 100000;
+    const int             runs = 50;
+    const FrustumPlanes   f = sampleFrustum();
+    const SphereBoundsSoA spheres = sampleSpheres(f, count);
+    std::vector<uint32_t> visible(spheres.size());
+
+    double   simdMs = 1e30, scalarMs = 1e30;
+    uint32_t visibleCount = 0;
+    for (int run = 0; run < runs; ++run)
+    {
+        {
+            const test::Timer timer;
+            visibleCount = cullSpheres(f, spheres, 0, count, visible.data());
+            simdMs = std::min(simdMs, timer.ms());
+        }
+        {
+            // the branchy loop culling one sphere against one plane at a time
+            const test::Timer timer;
+            uint32_t          n = 0;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                int p = 0;
+                for (; p < FrustumPlanes::kPlaneCount; ++p)
+                {
+                    if (f.nx[p] * spheres.x[i] + f.ny[p] * spheres.y[i] + f.nz[p] * spheres.z[i] + f.d[p] +
+                            spheres.radius[i] < 0.f)
+                        break;
+                }
+                if (p == FrustumPlanes::kPlaneCount)
+                    visible[n++] = i;
+            }
+            scalarMs = std::min(scalarMs, timer.ms());
+            test::keep(n);
+        }
+    }
+    std::printf("%u spheres, %u visible: cullSpheres %.3f ms (%.2f ns per sphere), scalar %.3f ms (%.2f ns)\n",
+                count, visibleCount, simdMs, simdMs * 1e6 / count, scalarMs, scalarMs * 1e6 / count);
+}
@@ -0,0 +1,189 @@
+//
+//  GLSLProgramTests.cpp
+//
+
+#include "Test.h"
+
+#include "NvGLUtils/NvGLSLProgram.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    /// An active uniform of the fake program.
+    struct ActiveUniform
+    {
+        const char* name;
+        GLenum      type;
+        GLint       location;
+    };
+
+    // reported as by a driver, the arrays by their first element and the block members without a location
+    const ActiveUniform kActiveUniforms[] = {{"uMVP", GL_FLOAT_MAT4, 0},
+                                             {"uColor", GL_FLOAT_VEC4, 1},
+                                             {"uLights[0]", GL_FLOAT_VEC4, 2},
+                                             {"uTex", GL_SAMPLER_2D, 7},
+                                             {"Block.member", GL_FLOAT_VEC4, -1}};
+    const GLint kActiveUniformCount = sizeof(kActiveUniforms) / sizeof(kActiveUniforms[0]);
+
+    /// Counts the GL calls of the program.
+    struct GLCalls
+    {
+        uint32_t uniformLocations = 0;
+        uint32_t uploads = 0;
+        GLint    lastLocation = -1;
+    };
+    GLCalls g_calls;
+
+    GLint GLAPIENTRY getUniformLocation(GLuint, const GLchar* name)
+    {
+        ++g_calls.uniformLocations;
+        for (const ActiveUniform& uniform : kActiveUniforms)
+        {
+            const size_t length = strcspn(uniform.name, "[");
+            if (strncmp(uniform.name, name, length) != 0 || uniform.location < 0)
+                continue;
+            if (name[length] == '\0')
+                return uniform.location;
+            if (name[length] == '[' && uniform.name[length] == '[')
+                return uniform.location + atoi(name + length + 1);
+        }
+        return -1;
+    }
+
+    void GLAPIENTRY getProgramiv(GLuint, GLenum pname, GLint* param)
+    {
+        *param = pname == GL_ACTIVE_UNIFORMS ? kActiveUniformCount : pname == GL_ACTIVE_UNIFORM_MAX_LENGTH ? 32 : 1;
+    }
+
+    void GLAPIENTRY getActiveUniform(GLuint, GLuint index, GLsizei maxLength, GLsizei* length, GLint* size,
+                                     GLenum* type, GLchar* name)
+    {
+        const ActiveUniform& uniform = kActiveUniforms[index];
+        *length = (GLsizei)std::min(strlen(uniform.name), size_t(maxLength - 1));
+        memcpy(name, uniform.name, *length);
+        name[*length] = '\0';
+        *size = 1;
+        *type = uniform.type;
+    }
+
+    void GLAPIENTRY uniform1i(GLint location, GLint)
+    {
+        ++g_calls.uploads;
+        g_calls.lastLocation = location;
+    }
+
+    void GLAPIENTRY uniform4fv(GLint location, GLsizei, const GLfloat*)
+    {
+        ++g_calls.uploads;
+        g_calls.lastLocation = location;
+    }
+
+    void GLAPIENTRY uniformMatrix4fv(GLint location, GLsizei, GLboolean, const GLfloat*)
+    {
+        ++g_calls.uploads;
+        g_calls.lastLocation = location;
+    }
+
+    void GLAPIENTRY ignore(GLuint) {}
+    void GLAPIENTRY ignoreEnum(GLenum) {}
+
+    /// Builds the uniform table of the fake program without compiling it.
+    class LinkedProgram : public NvGLSLProgram
+    {
+    public:
+        LinkedProgram()
+        {
+            m_program = 1;
+            cacheUniforms();
+        }
+
+        size_t uniformCount() const { return m_uniforms.size(); }
+    };
+}  // namespace
+
+// The entry points of the GL functions the program calls, only the ones the tests go through count the calls.
+PFNGLACTIVETEXTUREPROC      __glewActiveTexture = ignoreEnum;
+PFNGLATTACHSHADERPROC       __glewAttachShader = nullptr;
+PFNGLCOMPILESHADERPROC      __glewCompileShader = nullptr;
+PFNGLCREATEPROGRAMPROC      __glewCreateProgram = nullptr;
+PFNGLCREATESHADERPROC       __glewCreateShader = nullptr;
+PFNGLDELETEPROGRAMPROC      __glewDeleteProgram = ignore;
+PFNGLDELETESHADERPROC       __glewDeleteShader = nullptr;
+PFNGLGETACTIVEUNIFORMPROC   __glewGetActiveUniform = getActiveUniform;
+PFNGLGETATTRIBLOCATIONPROC  __glewGetAttribLocation = nullptr;
+PFNGLGETPROGRAMINFOLOGPROC  __glewGetProgramInfoLog = nullptr;
+PFNGLGETPROGRAMIVPROC       __glewGetProgramiv = getProgramiv;
+PFNGLGETSHADERINFOLOGPROC   __glewGetShaderInfoLog = nullptr;
+PFNGLGETSHADERIVPROC        __glewGetShaderiv = nullptr;
+PFNGLGETUNIFORMLOCATIONPROC __glewGetUniformLocation = getUniformLocation;
+PFNGLLINKPROGRAMPROC        __glewLinkProgram = nullptr;
+PFNGLSHADERSOURCEPROC       __glewShaderSource = nullptr;
+PFNGLUNIFORM1FPROC          __glewUniform1f = nullptr;
+PFNGLUNIFORM1IPROC          __glewUniform1i = uniform1i;
+PFNGLUNIFORM2FPROC          __glewUniform2f = nullptr;
+PFNGLUNIFORM2IPROC          __glewUniform2i = nullptr;
+PFNGLUNIFORM3FPROC          __glewUniform3f = nullptr;
+PFNGLUNIFORM3FVPROC         __glewUniform3fv = nullptr;
+PFNGLUNIFORM3IPROC          __glewUniform3i = nullptr;
+PFNGLUNIFORM4FPROC          __glewUniform4f = nullptr;
+PFNGLUNIFORM4FVPROC         __glewUniform4fv = uniform4fv;
+PFNGLUNIFORMMATRIX4FVPROC   __glewUniformMatrix4fv = uniformMatrix4fv;
+PFNGLUSEPROGRAMPROC         __glewUseProgram = ignore;
+
+void GLAPIENTRY glBindTexture(GLenum, GLuint) {}
+
+TEST_CASE(GLSLProgram, CachesTheUniforms)
+{
+    LinkedProgram program;
+    // the block member has no location
+    CHECK(program.uniformCount() == 4);
+    const uint32_t tableLocations = g_calls.uniformLocations;
+    NvGLSLProgram::resetUniformStats();
+
+    // the names of the table are found without the GL, but still counted as lookups
+    CHECK(program.getUniformLocation("uColor") == 1);
+    CHECK(program.getUniformLocation("uLights") == 2);
+    CHECK(program.getUniformLocation("Block.member", true) == -1);
+    const NvGLSLProgram::Uniform mvp = program.getUniform("uMVP");
+    const NvGLSLProgram::Uniform color = program.getUniform("uColor");
+    const NvGLSLProgram::Uniform tex = program.getUniform("uTex");
+    CHECK(mvp.slot >= 0 && color.slot >= 0 && tex.slot >= 0 && program.getUniform("uMissing", true).slot == -1);
+    CHECK(g_calls.uniformLocations == tableLocations);
+    CHECK(NvGLSLProgram::getUniformStats().lookups == 7 && NvGLSLProgram::getUniformStats().glLookups == 0);
+
+    // the array elements are resolved by the GL
+    CHECK(program.getUniformLocation("uLights[3]") == 5);
+    CHECK(g_calls.uniformLocations == tableLocations + 1);
+    CHECK(NvGLSLProgram::getUniformStats().lookups == 8 && NvGLSLProgram::getUniformStats().glLookups == 1);
+
+    // the values set by handle are only uploaded when they change
+    const float red[4] = {1.f, 0.f, 0.f, 1.f}, green[4] = {0.f, 1.f, 0.f, 1.f};
+    float       identity[16] = {};
+    identity[0] = identity[5] = identity[10] = identity[15] = 1.f;
+    const uint32_t uploads = g_calls.uploads;
+    program.setUniform4fv(color, red);
+    program.setUniform4fv(color, red);
+    program.setUniformMatrix4fv(mvp, identity);
+    program.setUniformMatrix4fv(mvp, identity);
+    program.bindTexture2D(tex, 3, 11);
+    program.bindTexture2D(tex, 3, 12);
+    CHECK(g_calls.uploads == uploads + 3);
+    CHECK(NvGLSLProgram::getUniformStats().uploads == 3 && NvGLSLProgram::getUniformStats().skipped == 3);
+    program.setUniform4fv(color, green);
+    CHECK(g_calls.uploads == uploads + 4 && g_calls.lastLocation == 1);
+
+    // a location handed out may be set directly, so the handle uploads again
+    program.getUniformLocation("uColor");
+    program.setUniform4fv(color, green);
+    CHECK(g_calls.uploads == uploads + 5);
+    program.invalidateUniforms();
+    program.setUniformMatrix4fv(mvp, identity);
+    CHECK(g_calls.uploads == uploads + 6 && g_calls.lastLocation == 0);
+
+    NvGLSLProgram::resetUniformStats();
+    const NvGLSLProgram::UniformStats& stats = NvGLSLProgram::getUniformStats();
+    CHECK(stats.lookups == 0 && stats.glLookups == 0 && stats.uploads == 0 && stats.skipped == 0);
+}
@@ -0,0 +1,260 @@
+//
+//  ImageDDSTests.cpp
+//
+
+#include "Test.h"
+
+#include "NvImage/NvImage.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    /// The fourcc codes of the block compressed formats and their block sizes.
+    struct BlockFormat
+    {
+        const char* fourCC;
+        uint32_t    blockSize;
+        void (*flipBlocks)(uint8_t*, uint32_t);
+    };
+
+    //
+    // The scalar flips the SSE2 ones replaced, as they were.
+    ////////////////////////////////////////////////////////////
+
+    void flipColorRows(uint8_t* block)
+    {
+        // 2x 16bit endpoints, then a byte per row
+        std::swap(block[4], block[7]);
+        std::swap(block[5], block[6]);
+    }
+
+    void flipDxt5Alpha(uint8_t* block)
+    {
+        uint8_t* row = block + 2;
+        uint8_t  gBits[4][4];
+
+        uint32_t bits = 0;
+        memcpy(&bits, row, 3);
+        for (int i = 0; i < 8; ++i, bits >>= 3)
+            gBits[i / 4][i % 4] = uint8_t(bits & 7);
+        bits = 0;
+        memcpy(&bits, row + 3, 3);
+        for (int i = 0; i < 8; ++i, bits >>= 3)
+            gBits[2 + i / 4][i % 4] = uint8_t(bits & 7);
+
+        uint32_t low = 0, high = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            low |= uint32_t(gBits[3][i]) << (3 * i) | uint32_t(gBits[2][i]) << (12 + 3 * i);
+            high |= uint32_t(gBits[1][i]) << (3 * i) | uint32_t(gBits[0][i]) << (12 + 3 * i);
+        }
+        memcpy(row, &low, 3);
+        memcpy(row + 3, &high, 3);
+    }
+
+    void flipBlocksDxtc1(uint8_t* ptr, uint32_t numBlocks)
+    {
+        for (uint32_t i = 0; i < numBlocks; ++i, ptr += 8)
+            flipColorRows(ptr);
+    }
+
+    void flipBlocksDxtc3(uint8_t* ptr, uint32_t numBlocks)
+    {
+        for (uint32_t i = 0; i < numBlocks; ++i, ptr += 16)
+        {
+            // four 16bit rows of alphas
+            std::swap(ptr[0], ptr[6]);
+            std::swap(ptr[1], ptr[7]);
+            std::swap(ptr[2], ptr[4]);
+            std::swap(ptr[3], ptr[5]);
+            flipColorRows(ptr + 8);
+        }
+    }
+
+    void flipBlocksDxtc5(uint8_t* ptr, uint32_t numBlocks)
+    {
+        for (uint32_t i = 0; i < numBlocks; ++i, ptr += 16)
+        {
+            flipDxt5Alpha(ptr);
+            flipColorRows(ptr + 8);
+        }
+    }
+
+    void flipBlocksBc4(uint8_t* ptr, uint32_t numBlocks)
+    {
+        for (uint32_t i = 0; i < numBlocks; ++i, ptr += 8)
+            flipDxt5Alpha(ptr);
+    }
+
+    void flipBlocksBc5(uint8_t* ptr, uint32_t numBlocks)
+    {
+        flipBlocksBc4(ptr, numBlocks * 2);
+    }
+
+    const BlockFormat kFormats[] = {{"DXT1", 8, flipBlocksDxtc1},
+                                    {"DXT3", 16, flipBlocksDxtc3},
+                                    {"DXT5", 16, flipBlocksDxtc5},
+                                    {"ATI1", 8, flipBlocksBc4},
+                                    {"ATI2", 16, flipBlocksBc5}};
+
+    /// Same as NvImage::flipSurface for the compressed formats, with the scalar block flips.
+    void flipSurfaceScalar(const BlockFormat& format, uint8_t* surf, int32_t width, int32_t height)
+    {
+        width = (width + 3) / 4;
+        height = (height + 3) / 4;
+        const uint32_t       lineSize = width * format.blockSize;
+        std::vector<uint8_t> tempBuf(lineSize);
+
+        uint8_t* top = surf;
+        uint8_t* bottom = surf + (height - 1) * lineSize;
+        for (uint32_t j = 0; j < std::max((uint32_t)height >> 1, (uint32_t)1); j++)
+        {
+            if (top == bottom)
+            {
+                format.flipBlocks(top, width);
+                break;
+            }
+            format.flipBlocks(top, width);
+            format.flipBlocks(bottom, width);
+            memcpy(tempBuf.data(), top, lineSize);
+            memcpy(top, bottom, lineSize);
+            memcpy(bottom, tempBuf.data(), lineSize);
+            top += lineSize;
+            bottom -= lineSize;
+        }
+    }
+
+    uint32_t levelSize(const BlockFormat& format, int32_t width, int32_t height)
+    {
+        return uint32_t((width + 3) / 4) * uint32_t((height + 3) / 4) * format.blockSize;
+    }
+
+    /// Writes a DDS file with the full mip chain of random blocks.
+    std::vector<uint8_t> writeDDS(const BlockFormat& format, int32_t width, int32_t height, int32_t levelCount,
+                                  uint32_t seed)
+    {
+        uint32_t header[32] = {};
+        memcpy(header, "DDS ", 4);
+        header[1] = 124;                               // dwSize
+        header[2] = 0x00000001 | 0x00000002 | 0x00000004 | 0x00001000 | 0x00020000; // caps, size, pixel format, mips
+        header[3] = uint32_t(height);
+        header[4] = uint32_t(width);
+        header[7] = uint32_t(levelCount);
+        header[19] = 32;                               // ddspf.dwSize
+        header[20] = 0x00000004;                       // ddspf.dwFlags, fourcc
+        memcpy(&header[21], format.fourCC, 4);
+        header[27] = 0x00001000;                       // dwCaps1, texture
+
+        std::vector<uint8_t> file((const uint8_t*)header, (const uint8_t*)header + sizeof(header));
+        for (int32_t level = 0, w = width, h = height; level < levelCount; ++level)
+        {
+            for (uint32_t i = 0; i < levelSize(format, w, h); ++i)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                file.push_back(uint8_t(seed >> 24));
+            }
+            w = std::max(w >> 1, 1);
+            h = std::max(h >> 1, 1);
+        }
+        return file;
+    }
+
+    bool loadDDS(NvImage& image, const std::vector<uint8_t>& file, bool flip)
+    {
+        NvImage::VerticalFlip(flip);
+        const bool loaded = image.loadImageFromFileData(file.data(), file.size(), "dds");
+        NvImage::VerticalFlip(true);
+        return loaded;
+    }
+}  // namespace
+
+TEST_CASE(ImageDDS, FlipsMatchScalar)
+{
+    const bool expandDXT = NvImage::getDXTExpansion();
+    NvImage::setDXTExpansion(false);
+
+    // the widths give 1, 2, 3 and more blocks per row, the odd block counts go through the scalar tails,
+    // the chains end in 2 row and 1 row mips
+    const int32_t sizes[][2] = {{4, 4}, {8, 2}, {12, 1}, {20, 12}, {64, 36}, {30, 8}};
+    for (const BlockFormat& format : kFormats)
+    {
+        for (const int32_t* size : sizes)
+        {
+            const int32_t width = size[0], height = size[1];
+            int32_t       levelCount = 1;
+            while ((std::max(width, height) >> levelCount) > 0)
+                ++levelCount;
+
+            const std::vector<uint8_t> file = writeDDS(format, width, height, levelCount, width * 131 + height);
+            NvImage                    original, flipped;
+            CHECK(loadDDS(original, file, false));
+            CHECK(loadDDS(flipped, file, true));
+            CHECK(original.getMipLevels() == levelCount && flipped.getMipLevels() == levelCount);
+            if (original.getMipLevels() != levelCount || flipped.getMipLevels() != levelCount)
+                continue;
+
+            for (int32_t level = 0, w = width, h = height; level < levelCount; ++level)
+            {
+                const uint32_t       bytes = levelSize(format, w, h);
+                const uint8_t*       data = (const uint8_t*)original.getLevel(level);
+                std::vector<uint8_t> reference(data, data + bytes);
+                flipSurfaceScalar(format, reference.data(), w, h);
+                CHECK(memcmp(reference.data(), flipped.getLevel(level), bytes) == 0);
+
+                // and flipping twice gives back the blocks
+                flipSurfaceScalar(format, reference.data(), w, h);
+                CHECK(memcmp(reference.data(), data, bytes) == 0);
+
+                w = std::max(w >> 1, 1);
+                h = std::max(h >> 1, 1);
+            }
+        }
+    }
+
+    NvImage::setDXTExpansion(expandDXT);
+}
+
+BENCH_CASE(ImageDDS, FlipThroughput)
+{
+    const bool expandDXT = NvImage::getDXTExpansion();
+    NvImage::setDXTExpansion(false);
+
+    const int32_t size = 4096;
+    const int     runs = 10;
+    for (const BlockFormat& format : kFormats)
+    {
+        const std::vector<uint8_t> file = writeDDS(format, size, size, 1, 1);
+        const uint32_t             bytes = levelSize(format, size, size);
+        const double               mb = bytes * 1e-6;
+
+        // the flip is the difference between the flipped and the plain loads
+        double plainMs = 1e30, flippedMs = 1e30, scalarMs = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            NvImage plain, flipped;
+            {
+                const test::Timer timer;
+                loadDDS(plain, file, false);
+                plainMs = std::min(plainMs, timer.ms());
+            }
+            {
+                const test::Timer timer;
+                loadDDS(flipped, file, true);
+                flippedMs = std::min(flippedMs, timer.ms());
+            }
+            {
+                const test::Timer timer;
+                flipSurfaceScalar(format, (uint8_t*)plain.getLevel(0), size, size);
+                scalarMs = std::min(scalarMs, timer.ms());
+            }
+            test::keep(*(const uint8_t*)plain.getLevel(0));
+        }
+        std::printf("%s, %.1f MB: flip %.0f MB/s, the scalar flip %.0f MB/s\n", format.fourCC, mb,
+                    mb / (std::max(flippedMs - plainMs, 1e-6) * 1e-3), mb / (scalarMs * 1e-3));
+    }
+
+    NvImage::setDXTExpansion(expandDXT);
+}
@@ -0,0 +1,143 @@
+//
+//  InstancePackingTests.cpp
+//
+
+#include "Test.h"
+
+#include "InstancePacking.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace Nv;
+
+namespace
+{
+    /// Same layout as the sample's FishInstanceData.
+    struct Fish
+    {
+        nv::vec3f position;
+        nv::vec3f heading;
+        float     animTime;
+        float     schoolId;
+    };
+
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed)
+            : m_state(seed)
+        {
+        }
+
+        float uniform(float min, float max)
+        {
+            m_state = m_state * 1664525u + 1013904223u;
+            return min + (max - min) * float(m_state >> 8) / float(1 << 24);
+        }
+
+    private:
+        uint32_t m_state;
+    };
+
+    /// A school spread around center, with the headings along the axes and the octahedron's edges
+    /// and tail times of several periods.
+    std::vector<Fish> generateSchool(uint32_t count, const nv::vec3f& center, float size, uint32_t seed)
+    {
+        Random            random(seed);
+        std::vector<Fish> fish(count);
+        const nv::vec3f   headings[] = {nv::vec3f(0.f, 0.f, -1.f), nv::vec3f(0.f, 0.f, 1.f),   nv::vec3f(0.f, 1.f, 0.f),
+                                      nv::vec3f(-1.f, 0.f, 0.f), nv::vec3f(1.f, -1.f, 0.f),  nv::vec3f(-1.f, 1.f, -1e-7f),
+                                      nv::vec3f(0.f, 0.f, 0.f)};
+        const float       times[] = {0.f, -0.f, 6.2831855f, -12.566371f, 1000.f, -1e-6f, 1e-9f};
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Fish& f = fish[i];
+            f.position = center + nv::vec3f(random.uniform(-size, size), random.uniform(-size, size) * 0.2f,
+                                            random.uniform(-size, size));
+            const nv::vec3f heading(random.uniform(-1.f, 1.f), random.uniform(-1.f, 1.f), random.uniform(-1.f, 1.f));
+            f.heading = i < 7 ? headings[i] : heading;
+            if (nv::length(f.heading) > 0.f)
+                f.heading = nv::normalize(f.heading);
+            f.animTime = i < 7 ? times[i] : random.uniform(-500.f, 500.f);
+            f.schoolId = 1.f;
+        }
+        return fish;
+    }
+
+    PackedInstanceRange rangeOf(const std::vector<Fish>& fish)
+    {
+        nv::vec3f boundsMin = fish[0].position, boundsMax = fish[0].position;
+        for (const Fish& f : fish)
+        {
+            boundsMin = nv::min(boundsMin, f.position);
+            boundsMax = nv::max(boundsMax, f.position);
+        }
+        return PackedInstanceRange::fromBounds(boundsMin, boundsMax);
+    }
+}  // namespace
+
+TEST_CASE(InstancePacking, SSEMatchesScalar)
+{
+    const uint32_t stride = sizeof(Fish) / sizeof(float);
+    for (uint32_t count : {1u, 4u, 7u, 200u, 1003u})
+    {
+        const std::vector<Fish>   fish = generateSchool(count, nv::vec3f(100.f, 10.f, -50.f), 30.f, count);
+        const PackedInstanceRange range = rangeOf(fish);
+
+        // in order, and in a level of detail like order
+        std::vector<uint32_t> order(count);
+        for (uint32_t i = 0; i < count; ++i)
+            order[i] = (i * 7919) % count;
+        for (const uint32_t* packedOrder : {(const uint32_t*)nullptr, (const uint32_t*)order.data()})
+        {
+            std::vector<PackedInstance> scalar(count + 1), packed(count + 1);
+            memset(scalar.data(), 0xCD, scalar.size() * sizeof(PackedInstance));
+            memset(packed.data(), 0xCD, packed.size() * sizeof(PackedInstance));
+            packInstancesScalar(range, &fish[0].position.x, stride, packedOrder, count, scalar.data());
+            packInstances(range, &fish[0].position.x, stride, packedOrder, count, packed.data());
+            CHECK(memcmp(scalar.data(), packed.data(), scalar.size() * sizeof(PackedInstance)) == 0);
+        }
+    }
+}
+
+TEST_CASE(InstancePacking, UnpacksWithinTolerance)
+{
+    const uint32_t            count = 10003;
+    const std::vector<Fish>   fish = generateSchool(count, nv::vec3f(100.f, 10.f, -50.f), 30.f, 7);
+    const PackedInstanceRange range = rangeOf(fish);
+
+    std::vector<uint32_t> order(count);
+    for (uint32_t i = 0; i < count; ++i)
+        order[i] = (i * 7919) % count;
+    std::vector<PackedInstance> packed(count);
+    packInstances(range, &fish[0].position.x, sizeof(Fish) / sizeof(float), order.data(), count, packed.data());
+
+    // half a snorm step of each axis, a few snorm steps of the octahedral heading and half a half float
+    // step of the wrapped time, whose magnitude is below 2pi
+    const nv::vec3f positionTolerance = range.scale * (0.5f / 32767.f) * 1.001f;
+    const float     headingTolerance = 1e-4f;
+    const float     animTimeTolerance = 1.01f / 512.f;
+    bool            positionsOk = true, headingsOk = true, animTimesOk = true;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const Fish& f = fish[order[i]];
+        nv::vec3f   position, heading;
+        float       animTime;
+        unpackInstance(range, packed[i], position, heading, animTime);
+
+        positionsOk &= fabsf(position.x - f.position.x) <= positionTolerance.x &&
+                       fabsf(position.y - f.position.y) <= positionTolerance.y &&
+                       fabsf(position.z - f.position.z) <= positionTolerance.z;
+        // a zero heading decodes to any unit vector
+        if (nv::length(f.heading) > 0.f)
+            headingsOk &= nv::length(heading - f.heading) <= headingTolerance;
+        headingsOk &= fabsf(nv::length(heading) - 1.f) <= 1e-5f;
+        animTimesOk &= fabsf(animTime) < 6.2832f;
+        animTimesOk &= fabsf(sinf(animTime) - sinf(f.animTime)) <= animTimeTolerance;
+    }
+    CHECK(positionsOk);
+    CHECK(headingsOk);
+    CHECK(animTimesOk);
+}
@@ -0,0 +1,109 @@
+//
+//  MaterialRegistryTests.cpp
+//
+
+#include "Test.h"
+
+#include "MaterialRegistry.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+    /// The shaders are only compared by the registry, they're never enabled.
+    NvGLSLProgram* fakeShader(uint32_t index)
+    {
+        static uint64_t storage[4];
+        return reinterpret_cast<NvGLSLProgram*>(&storage[index]);
+    }
+
+    Nv::MaterialBinder::Material makeMaterial(uint32_t index, uint32_t shader, GLuint ubo, GLuint texture)
+    {
+        Nv::MaterialBinder::Material material;
+        material.name = "material" + std::to_string(index);
+        material.location = 1;
+        material.ubo = ubo;
+        material.texture = texture;
+        material.shader = fakeShader(shader);
+        return material;
+    }
+}  // namespace
+
+TEST_CASE(MaterialRegistry, KeepsHandlesAcrossRenumbers)
+{
+    // 12 materials over 2 shaders and 3 textures, each with its own uniform buffer, registered interleaved
+    Nv::MaterialBinder       binder;
+    Nv::MaterialRegistry     registry(binder);
+    std::vector<uint32_t>    handles;
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < 12; ++i)
+    {
+        handles.push_back(registry.add(makeMaterial(i, i % 2, 100 + i, 10 + i % 3)));
+        names.push_back("material" + std::to_string(i));
+    }
+    CHECK(registry.count() == 12 && binder.materials.size() == 13);
+    for (uint32_t i = 0; i < 12; ++i)
+        CHECK(registry.id(handles[i]) == i + 1);
+
+    Nv::MaterialRegistry::Transitions transitions = registry.transitions();
+    CHECK(transitions.shaderChanges == 12 && transitions.uboChanges == 12 && transitions.textureChanges == 12);
+
+    // grouped by shader, then by the texture since the uniform buffers are all different
+    binder.activeMaterial = 5;
+    CHECK(registry.update());
+    transitions = registry.transitions();
+    CHECK(transitions.shaderChanges == 2 && transitions.uboChanges == 12 && transitions.textureChanges == 6);
+    // the binder forgets its redundancy state, the active id is stale
+    CHECK(binder.activeMaterial == -1);
+
+    // the handles resolve to the same materials, the remap table maps the old ids to the new ones
+    for (uint32_t i = 0; i < 12; ++i)
+    {
+        const uint32_t id = registry.id(handles[i]);
+        CHECK(registry.material(handles[i]).name == names[i]);
+        CHECK(binder.materials[id].name == names[i]);
+        CHECK(registry.remap()[i + 1] == id);
+    }
+    CHECK(registry.id(0) == 0 && registry.remap()[0] == 0);
+
+    // ids in state order
+    for (uint32_t id = 2; id < binder.materials.size(); ++id)
+    {
+        const Nv::MaterialBinder::Material& previous = binder.materials[id - 1];
+        const Nv::MaterialBinder::Material& material = binder.materials[id];
+        CHECK(previous.shader <= material.shader);
+        CHECK(previous.shader != material.shader || previous.texture <= material.texture);
+    }
+
+    // already ordered, a second update keeps the ids
+    CHECK(!registry.update());
+    for (uint32_t i = 0; i < 12; ++i)
+        CHECK(registry.material(handles[i]).name == names[i]);
+}
+
+TEST_CASE(MaterialRegistry, GroupsTheSharedState)
+{
+    // a uniform buffer per shader and two textures shared by all the shaders, the materials with the same
+    // state end up next to each other so the binder skips their redundant binds
+    Nv::MaterialBinder    binder;
+    Nv::MaterialRegistry  registry(binder);
+    std::vector<uint32_t> handles;
+    for (uint32_t i = 0; i < 9; ++i)
+        handles.push_back(registry.add(makeMaterial(i, i % 3, 200 + i % 3, 20 + i % 2)));
+
+    CHECK(registry.update());
+    const Nv::MaterialRegistry::Transitions transitions = registry.transitions();
+    CHECK(transitions.shaderChanges == 3 && transitions.uboChanges == 3);
+    // two textures per shader
+    CHECK(transitions.textureChanges == 6);
+
+    // the handles added after an update get the next ids, until the next renumber
+    const uint32_t handle = registry.add(makeMaterial(9, 0, 200, 21));
+    CHECK(registry.id(handle) == 10 && registry.count() == 10);
+    CHECK(registry.update());
+    CHECK(registry.material(handle).name == "material9");
+    CHECK(registry.transitions().shaderChanges == 3 && registry.transitions().textureChanges == 6);
+    for (uint32_t i = 0; i < 9; ++i)
+        CHECK(registry.material(handles[i]).name == "material" + std::to_string(i));
+}
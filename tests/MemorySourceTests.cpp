@@ -0,0 +1,41 @@
+//
+//  MemorySourceTests.cpp
+//
+
+#include "Test.h"
+
+#include "MemorySource.h"
+
+namespace
+{
+    template <class MemorySourceClass>
+    bool allocatesZeroedPages(size_t size)
+    {
+        uint8_t* data = MemorySourceClass::allocate(size);
+        if (!data)
+            return false;
+
+        bool zeroed = true;
+        for (size_t i = 0; i < size; ++i)
+            zeroed &= data[i] == 0;
+        // the whole range is writable
+        data[0] = data[size - 1] = 0xff;
+        MemorySourceClass::deallocate(data, size);
+        return zeroed;
+    }
+}  // namespace
+
+TEST_CASE(MemorySource, HeapZeroed)
+{
+    CHECK(allocatesZeroedPages<cb::HeapMemorySource<cb::kMemoryZeroed>>(12345));
+    CHECK(allocatesZeroedPages<cb::HeapMemorySource<cb::kMemoryZeroed | cb::kMemoryPrefault>>(3 * cb::mem::kPageSize));
+}
+
+TEST_CASE(MemorySource, VirtualPages)
+{
+    CHECK(allocatesZeroedPages<cb::VirtualMemorySource<>>(1));
+    CHECK(allocatesZeroedPages<cb::VirtualMemorySource<cb::kMemoryPrefault>>(5 * cb::mem::kPageSize + 7));
+    // falls back to regular pages without reserved huge pages
+    CHECK(allocatesZeroedPages<cb::VirtualMemorySource<cb::kMemoryHugePages | cb::kMemoryPrefault>>(3 * 1024 * 1024));
+    CHECK(allocatesZeroedPages<cb::VirtualMemorySource<cb::kMemoryLocked>>(2 * cb::mem::kPageSize));
+}
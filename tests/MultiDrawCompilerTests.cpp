@@ -0,0 +1,230 @@
+//
+//  MultiDrawCompilerTests.cpp
+//
+
+#include "Test.h"
+
+#include "CommandBuffer.h"
+#include "cmds/MultiDrawCompiler.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace
+{
+    typedef cb::CommandBuffer<cb::DrawKey> DrawCommandBuffer;
+    typedef DrawCommandBuffer::command_t   command_t;
+
+    /// The draw calls the GL commands would make.
+    struct DrawCall
+    {
+        GLuint   vao;
+        uint32_t drawCount;
+
+        bool operator==(const DrawCall& other) const
+        {
+            return vao == other.vao && drawCount == other.drawCount;
+        }
+    };
+
+    void recordDraw(GLuint vao, uint32_t drawCount, cb::RenderContext* rc)
+    {
+        rc->data<std::vector<DrawCall>>().push_back(DrawCall{vao, drawCount});
+    }
+}  // namespace
+
+// The tests don't link the GL commands, their dispatch functions record the draw calls instead.
+namespace cmds
+{
+    const cb::RenderContext::function_t DrawArrays::kDispatchFunction = [](const void* data, cb::RenderContext* rc) {
+        recordDraw(reinterpret_cast<const DrawArrays*>(data)->vao, 1, rc);
+    };
+    const cb::RenderContext::function_t DrawIndexed::kDispatchFunction = [](const void* data, cb::RenderContext* rc) {
+        recordDraw(reinterpret_cast<const DrawIndexed*>(data)->vao, 1, rc);
+    };
+    const cb::RenderContext::function_t DrawInstanced::kDispatchFunction = [](const void* data,
+                                                                              cb::RenderContext* rc) {
+        recordDraw(reinterpret_cast<const DrawInstanced*>(data)->vao, 1, rc);
+    };
+    const cb::RenderContext::function_t MultiDrawElementsIndirect::kDispatchFunction = [](const void* data,
+                                                                                          cb::RenderContext* rc) {
+        const auto& cmd = *reinterpret_cast<const MultiDrawElementsIndirect*>(data);
+        recordDraw(cmd.vao, cmd.drawCount, rc);
+    };
+    const cb::RenderContext::function_t MultiDrawArraysIndirect::kDispatchFunction = [](const void* data,
+                                                                                        cb::RenderContext* rc) {
+        const auto& cmd = *reinterpret_cast<const MultiDrawArraysIndirect*>(data);
+        recordDraw(cmd.vao, cmd.drawCount, rc);
+    };
+}  // namespace cmds
+
+namespace
+{
+    cb::DrawKey drawKey(uint32_t material, uint32_t view = 0)
+    {
+        cb::DrawKey key = cb::DrawKey::makeDefault(view);
+        key.setMaterial(material);
+        return key;
+    }
+
+    command_t indexed(DrawCommandBuffer& buffer, const cb::DrawKey& key, GLuint vao, uint32_t base, uint32_t count,
+                      bool shortIndices = true, GLenum primitive = GL_TRIANGLES)
+    {
+        cb::CommandPacket* packet = buffer.createCommandPacket<cmds::DrawIndexed>();
+        auto&              cmd = *cb::CommandPacket::getCommandData<cmds::DrawIndexed>(packet);
+        cmd.vao = vao;
+        cmd.base = base;
+        cmd.count = count;
+        cmd.primitive = primitive;
+        cmd.useShortIndices = shortIndices;
+        return command_t{packet, key};
+    }
+
+    command_t arrays(DrawCommandBuffer& buffer, const cb::DrawKey& key, GLuint vao, uint32_t base, uint32_t count,
+                     uint32_t instanceCount = 0)
+    {
+        if (instanceCount)
+        {
+            cb::CommandPacket* packet = buffer.createCommandPacket<cmds::DrawInstanced>();
+            auto&              cmd = *cb::CommandPacket::getCommandData<cmds::DrawInstanced>(packet);
+            cmd.vao = vao;
+            cmd.base = base;
+            cmd.count = count;
+            cmd.primitive = GL_TRIANGLES;
+            cmd.instanceCount = instanceCount;
+            return command_t{packet, key};
+        }
+        cb::CommandPacket* packet = buffer.createCommandPacket<cmds::DrawArrays>();
+        auto&              cmd = *cb::CommandPacket::getCommandData<cmds::DrawArrays>(packet);
+        cmd.vao = vao;
+        cmd.base = base;
+        cmd.count = count;
+        cmd.primitive = GL_TRIANGLES;
+        return command_t{packet, key};
+    }
+
+    bool isElementsRecord(const cmds::DrawElementsIndirectCommand& record, uint32_t count, uint32_t firstIndex)
+    {
+        return record.count == count && record.instanceCount == 1 && record.firstIndex == firstIndex &&
+               record.baseVertex == 0 && record.baseInstance == 0;
+    }
+
+    bool isArraysRecord(const cmds::DrawArraysIndirectCommand& record, uint32_t count, uint32_t instanceCount,
+                        uint32_t first)
+    {
+        return record.count == count && record.instanceCount == instanceCount && record.first == first &&
+               record.baseInstance == 0;
+    }
+}  // namespace
+
+TEST_CASE(MultiDrawCompiler, CompilesRunsOfDraws)
+{
+    DrawCommandBuffer buffer(64, 64);
+
+    // a sorted sequence, the batches are split where the material, view, vao, primitive, index type
+    // or draw type changes, and by chained commands
+    std::vector<command_t> commands = {
+        indexed(buffer, drawKey(1), 5, 0, 30),  // run of 3 short index draws, at byte offsets
+        indexed(buffer, drawKey(1), 5, 60, 12),
+        indexed(buffer, drawKey(1), 5, 100, 6),
+        indexed(buffer, drawKey(1), 5, 400, 36, false),  // 32 bit indices, run of 2
+        indexed(buffer, drawKey(1), 5, 800, 3, false),
+        indexed(buffer, drawKey(1), 6, 0, 9, false),     // another vao, alone
+        indexed(buffer, drawKey(2), 6, 0, 9, false),     // another material, run of 2 with a different primitive
+        indexed(buffer, drawKey(2), 6, 36, 9, false),
+        indexed(buffer, drawKey(2), 6, 72, 9, false, GL_LINES),
+        arrays(buffer, drawKey(3), 7, 0, 300),           // arrays and instanced draws, run of 3
+        arrays(buffer, drawKey(3), 7, 300, 30, 12),
+        arrays(buffer, drawKey(3), 7, 330, 3),
+        arrays(buffer, drawKey(3), 7, 333, 3),           // chained, alone
+        arrays(buffer, drawKey(3, 1), 7, 336, 3),        // another view, run of 2
+        arrays(buffer, drawKey(3, 1), 7, 339, 3),
+        indexed(buffer, drawKey(3, 1), 7, 0, 3),         // another draw type, alone
+    };
+    buffer.appendCommand<cmds::DrawArrays>(commands[12].cmd)->vao = 7;
+
+    // compiled in place, keeps the packets to check the ones left alone
+    std::vector<cb::CommandPacket*> packets;
+    for (const command_t& command : commands)
+        packets.push_back(command.cmd);
+
+    cmds::MultiDrawCompiler<DrawCommandBuffer> compiler(buffer, 17);
+    command_t* begin = commands.data();
+    command_t* end = compiler(begin, begin + commands.size());
+    CHECK(end - begin == 9);
+    // the chained draw isn't a candidate
+    CHECK(compiler.stats().drawCount == 15);
+    CHECK(compiler.stats().mergedCount == 12);
+    CHECK(compiler.stats().multiDrawCount == 5);
+    CHECK(compiler.stats().savedCalls() == 7);
+    if (end - begin != 9)
+        return;
+
+    const auto* elements = cb::CommandPacket::getCommandData<cmds::MultiDrawElementsIndirect>(begin[0].cmd);
+    CHECK(begin[0].cmd->dispatchFunction == cmds::MultiDrawElementsIndirect::kDispatchFunction);
+    CHECK(elements->vao == 5 && elements->primitive == GL_TRIANGLES && elements->useShortIndices);
+    CHECK(elements->drawCount == 3 && elements->indirectBuffer == 17);
+    CHECK(isElementsRecord(elements->data[0], 30, 0) && isElementsRecord(elements->data[1], 12, 30) &&
+          isElementsRecord(elements->data[2], 6, 50));
+    // the compiled entry keeps the run's key
+    CHECK(begin[0].key.value == drawKey(1).value);
+
+    elements = cb::CommandPacket::getCommandData<cmds::MultiDrawElementsIndirect>(begin[1].cmd);
+    CHECK(elements->vao == 5 && !elements->useShortIndices && elements->drawCount == 2);
+    CHECK(isElementsRecord(elements->data[0], 36, 100) && isElementsRecord(elements->data[1], 3, 200));
+
+    CHECK(begin[2].cmd == packets[5]);
+
+    elements = cb::CommandPacket::getCommandData<cmds::MultiDrawElementsIndirect>(begin[3].cmd);
+    CHECK(begin[3].key.value == drawKey(2).value);
+    CHECK(elements->vao == 6 && elements->drawCount == 2);
+    CHECK(isElementsRecord(elements->data[0], 9, 0) && isElementsRecord(elements->data[1], 9, 9));
+
+    CHECK(begin[4].cmd == packets[8]);
+
+    const auto* arrays = cb::CommandPacket::getCommandData<cmds::MultiDrawArraysIndirect>(begin[5].cmd);
+    CHECK(begin[5].cmd->dispatchFunction == cmds::MultiDrawArraysIndirect::kDispatchFunction);
+    CHECK(arrays->vao == 7 && arrays->primitive == GL_TRIANGLES && arrays->drawCount == 3);
+    CHECK(isArraysRecord(arrays->data[0], 300, 1, 0) && isArraysRecord(arrays->data[1], 30, 12, 300) &&
+          isArraysRecord(arrays->data[2], 3, 1, 330));
+
+    CHECK(begin[6].cmd == packets[12]);
+
+    arrays = cb::CommandPacket::getCommandData<cmds::MultiDrawArraysIndirect>(begin[7].cmd);
+    CHECK(begin[7].key.value == drawKey(3, 1).value);
+    CHECK(arrays->drawCount == 2);
+    CHECK(isArraysRecord(arrays->data[0], 3, 1, 336) && isArraysRecord(arrays->data[1], 3, 1, 339));
+
+    CHECK(begin[8].cmd == packets[15]);
+}
+
+TEST_CASE(MultiDrawCompiler, CompilesTheBufferBeforeSubmit)
+{
+    DrawCommandBuffer buffer(64, 64);
+    for (uint32_t material = 1; material <= 3; ++material)
+    {
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            auto* cmd = buffer.addCommand<cmds::DrawIndexed>(drawKey(material));
+            cmd->vao = material + (i == 3 ? 10 : 0);
+            cmd->base = i * 12;
+            cmd->count = 6;
+            cmd->primitive = GL_TRIANGLES;
+            cmd->useShortIndices = true;
+        }
+    }
+    buffer.sort();
+
+    cmds::MultiDrawCompiler<DrawCommandBuffer> compiler(buffer, 0, 3);
+    buffer.compile(std::ref(compiler));
+    CHECK(buffer.count() == 6);
+    CHECK(compiler.stats().multiDrawCount == 3 && compiler.stats().savedCalls() == 6);
+
+    // the materials are submitted from the highest key, each one as a multi draw of 3 then its other vao
+    std::vector<DrawCall> calls;
+    cb::RenderContext     context(&calls);
+    buffer.submit(&context);
+    const DrawCall expected[] = {{3, 3}, {13, 1}, {2, 3}, {12, 1}, {1, 3}, {11, 1}};
+    CHECK(calls.size() == 6 && std::equal(calls.begin(), calls.end(), expected));
+}
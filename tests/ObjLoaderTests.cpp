@@ -0,0 +1,472 @@
+//
+//  ObjLoaderTests.cpp
+//
+
+#include "Test.h"
+
+#include "NvModelExtObj.h"
+#include "NvModelVectorCompactor.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Nv;
+
+namespace
+{
+    /// The constructor of the OBJ model is protected, Create() only loads from files.
+    class ObjModel : public NvModelExtObj
+    {
+    public:
+        ObjModel()
+            : NvModelExtObj(0.01f, 0.001f)
+        {
+        }
+
+        /// Generates the normals, and the tangents if asked, and compiles the vertices and indices of the sub meshes,
+        /// like Create() does.
+        void compile(bool generateTangents = false)
+        {
+            GenerateNormals();
+            if (generateTangents)
+                GenerateTangents();
+            for (uint32_t i = 0; i < GetMeshCount(); ++i)
+            {
+                InitProcessedVerts(i);
+                InitProcessedIndices(i);
+            }
+        }
+    };
+
+    /// The material libraries referenced by the files don't exist.
+    class NullFileLoader : public NvModelFileLoader
+    {
+    public:
+        char* LoadDataFromFile(const char*) override
+        {
+            return nullptr;
+        }
+        void ReleaseData(char*) override {}
+    };
+
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed)
+            : m_state(seed)
+        {
+        }
+
+        uint32_t next(uint32_t count)
+        {
+            m_state = m_state * 1664525u + 1013904223u;
+            return uint32_t((uint64_t(m_state >> 8) * count) >> 24);
+        }
+
+        float uniform(float min, float max)
+        {
+            return min + (max - min) * float(next(1 << 20)) / float(1 << 20);
+        }
+
+    private:
+        uint32_t m_state;
+    };
+
+    /// Writes a number in one of the forms found in exported files, some of them are only converted by strtod.
+    void appendNumber(std::string& text, Random& random)
+    {
+        const float x = random.uniform(-100.f, 100.f);
+        char        number[64];
+        switch (random.next(10))
+        {
+        case 0:
+            snprintf(number, sizeof(number), "%.9g", x);
+            break;
+        case 1:
+            snprintf(number, sizeof(number), "%e", x);
+            break;
+        case 2:
+            snprintf(number, sizeof(number), "%.17g", double(x) / 3.0);
+            break;
+        case 3:
+            snprintf(number, sizeof(number), "%d", int(x));
+            break;
+        case 4:
+            snprintf(number, sizeof(number), "-0");
+            break;
+        case 5:
+            snprintf(number, sizeof(number), "%.25f", x);
+            break;
+        case 6:
+            snprintf(number, sizeof(number), "%.3f", x);
+            break;
+        default:
+            snprintf(number, sizeof(number), "%.6f", x);
+            break;
+        }
+        text += ' ';
+        text += number;
+    }
+
+    /// Generates objects of 50 vertices and 60 faces with materials, smoothing groups, relative indices
+    /// and CRLF line ends. The faces of a material share one of the four formats, the loaders only compile
+    /// sub meshes whose vertices all have the same components.
+    std::string generateObj(uint32_t objectCount, uint32_t seed)
+    {
+        Random      random(seed);
+        std::string text = "# generated\nmtllib missing.mtl\n";
+        int32_t     vertexCount = 0;
+        for (uint32_t object = 0; object < objectCount; ++object)
+        {
+            text += "o object" + std::to_string(object) + "\n";
+            text += "usemtl material" + std::to_string(object % 5) + "\n";
+            static const char* kSmoothing[] = {"off", "0", "1", "2"};
+            text += std::string("s ") + kSmoothing[random.next(4)] + "\n";
+
+            for (uint32_t i = 0; i < 50; ++i)
+            {
+                text += "v";
+                for (int c = 0; c < 3; ++c)
+                    appendNumber(text, random);
+                text += random.next(4) ? "\n" : " 1.0\n";
+                text += "vt";
+                for (int c = 0; c < 2; ++c)
+                    appendNumber(text, random);
+                text += random.next(4) ? "\n" : " 0.5\n";
+                text += "vn";
+                for (int c = 0; c < 3; ++c)
+                    appendNumber(text, random);
+                text += "\n";
+            }
+            vertexCount += 50;
+
+            for (uint32_t i = 0; i < 60; ++i)
+            {
+                const uint32_t cornerCount = 3 + random.next(3);
+                const uint32_t format = (object % 5) % 4;
+                text += "f";
+                for (uint32_t c = 0; c < cornerCount; ++c)
+                {
+                    int32_t position = 1 + (int32_t)random.next(vertexCount);
+                    int32_t texCoord = 1 + (int32_t)random.next(vertexCount);
+                    int32_t normal = 1 + (int32_t)random.next(vertexCount);
+                    if (random.next(5) == 0)
+                    {
+                        position -= vertexCount + 1;
+                        texCoord -= vertexCount + 1;
+                        normal -= vertexCount + 1;
+                    }
+                    char corner[64];
+                    if (format == 0)
+                        snprintf(corner, sizeof(corner), " %d", position);
+                    else if (format == 1)
+                        snprintf(corner, sizeof(corner), " %d/%d", position, texCoord);
+                    else if (format == 2)
+                        snprintf(corner, sizeof(corner), " %d/%d/%d", position, texCoord, normal);
+                    else
+                        snprintf(corner, sizeof(corner), " %d//%d", position, normal);
+                    text += corner;
+                }
+                text += random.next(3) ? "\n" : "\r\n";
+            }
+            text += "\n  \t\n# comment\ng group\n";
+        }
+        return text;
+    }
+
+    /// Generates a grid of quads whose corners are shared by their neighbors, like the meshes of exported models.
+    std::string generateGridObj(uint32_t size)
+    {
+        std::string text = "# generated\n";
+        char        line[128];
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                const float height = float((x * 7 + y * 13) % 17) * 0.1f;
+                snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n", float(x), height,
+                         float(y), float(x) / size, float(y) / size, 0.f, 1.f, 0.f);
+                text += line;
+            }
+        }
+        for (uint32_t y = 0; y + 1 < size; ++y)
+        {
+            for (uint32_t x = 0; x + 1 < size; ++x)
+            {
+                const uint32_t i = y * size + x + 1;
+                const uint32_t j = i + size;
+                snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", i, i, i, i + 1, i + 1, i + 1,
+                         j + 1, j + 1, j + 1, j, j, j);
+                text += line;
+            }
+        }
+        return text;
+    }
+
+    /// Generates a grid of quads whose corners are each written twice, the copies a little apart, with the same
+    /// normal. The faces use either copy, so the positions only weld within the vertex threshold.
+    std::string generateWeldObj(uint32_t size, uint32_t seed)
+    {
+        Random      random(seed);
+        std::string text = "# generated\n";
+        char        line[128];
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                const nv::vec3f normal = nv::normalize(nv::vec3f(float(x % 3) - 1.f, 1.f, float(y % 3) - 1.f));
+                for (uint32_t copy = 0; copy < 2; ++copy)
+                {
+                    snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                             float(x) + random.uniform(-0.002f, 0.002f), random.uniform(-0.002f, 0.002f),
+                             float(y) + random.uniform(-0.002f, 0.002f), normal.x, normal.y, normal.z);
+                    text += line;
+                }
+            }
+        }
+        for (uint32_t y = 0; y + 1 < size; ++y)
+        {
+            for (uint32_t x = 0; x + 1 < size; ++x)
+            {
+                const uint32_t corners[4] = {y * size + x, y * size + x + 1, (y + 1) * size + x + 1,
+                                             (y + 1) * size + x};
+                text += "f";
+                for (uint32_t corner : corners)
+                {
+                    const uint32_t index = 2 * corner + random.next(2) + 1;
+                    snprintf(line, sizeof(line), " %u//%u", index, index);
+                    text += line;
+                }
+                text += "\n";
+            }
+        }
+        return text;
+    }
+
+    uint32_t vertexCount(ObjModel& model)
+    {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < model.GetMeshCount(); ++i)
+            count += model.GetSubMesh(i)->getVertexCount();
+        return count;
+    }
+
+    bool sameModels(ObjModel& a, ObjModel& b)
+    {
+        const nv::vec3f minA = a.GetMinExt(), minB = b.GetMinExt();
+        const nv::vec3f maxA = a.GetMaxExt(), maxB = b.GetMaxExt();
+        if (memcmp(&minA, &minB, sizeof(minA)) || memcmp(&maxA, &maxB, sizeof(maxA)))
+            return false;
+        if (a.GetMeshCount() != b.GetMeshCount() || a.GetMaterialCount() != b.GetMaterialCount())
+            return false;
+
+        for (uint32_t i = 0; i < a.GetMeshCount(); ++i)
+        {
+            const SubMesh* meshA = a.GetSubMesh(i);
+            const SubMesh* meshB = b.GetSubMesh(i);
+            if (meshA->m_materialId != meshB->m_materialId || meshA->getVertexSize() != meshB->getVertexSize() ||
+                meshA->getVertexCount() != meshB->getVertexCount() ||
+                meshA->getIndexCount() != meshB->getIndexCount())
+            {
+                return false;
+            }
+            const size_t vertexBytes = sizeof(float) * meshA->getVertexSize() * meshA->getVertexCount();
+            const size_t indexBytes = sizeof(uint32_t) * meshA->getIndexCount();
+            if (memcmp(meshA->getVertices(), meshB->getVertices(), vertexBytes) ||
+                memcmp(meshA->getIndices(), meshB->getIndices(), indexBytes))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}  // namespace
+
+TEST_CASE(ObjLoader, ChunksMatchTheTokenizer)
+{
+    NullFileLoader loader;
+    NvModelExt::SetFileLoader(&loader);
+
+    for (uint32_t seed = 1; seed <= 3; ++seed)
+    {
+        const std::string text = generateObj(200, seed);
+
+        ObjModel serial;
+        CHECK(serial.LoadObjFromMemory(text.c_str()));
+        serial.compile();
+        CHECK(serial.GetMeshCount() > 1);
+
+        for (uint32_t threadCount = 1; threadCount <= 8; threadCount *= 2)
+        {
+            // not null terminated, like a mapped file
+            std::vector<char> mapped(text.begin(), text.end());
+            ObjModel          chunked;
+            CHECK(chunked.LoadObjFromMemory(mapped.data(), mapped.size(), threadCount));
+            chunked.compile();
+            CHECK(sameModels(serial, chunked));
+        }
+    }
+    NvModelExt::SetFileLoader(nullptr);
+}
+
+TEST_CASE(ObjLoader, FallsBackOnQuirks)
+{
+    NullFileLoader loader;
+    NvModelExt::SetFileLoader(&loader);
+
+    // quoted tokens and "#/#/" faces are only handled by the tokenizer
+    const std::string text =
+        generateObj(20, 7) + "usemtl \"quoted name\"\nf 1 2 3\nusemtl material1\nf 4/4/ 5/5/ 6/6/\n";
+    ObjModel serial;
+    CHECK(serial.LoadObjFromMemory(text.c_str()));
+    serial.compile();
+
+    ObjModel chunked;
+    CHECK(chunked.LoadObjFromMemory(text.data(), text.size(), 4));
+    chunked.compile();
+    CHECK(sameModels(serial, chunked));
+    NvModelExt::SetFileLoader(nullptr);
+}
+
+TEST_CASE(ObjLoader, WeldMethodsMergeThePositionsAlike)
+{
+    const std::string text = generateWeldObj(40, 5);
+    ObjModel          sorted, hashed;
+    hashed.SetWeldMethod(NvModelExt::WeldMethod_HashGrid);
+    CHECK(sorted.LoadObjFromMemory(text.c_str()) && hashed.LoadObjFromMemory(text.c_str()));
+    sorted.compile();
+    hashed.compile();
+
+    // the copies of each corner merge, with the same ids
+    CHECK(vertexCount(sorted) == 40 * 40);
+    CHECK(sameModels(sorted, hashed));
+}
+
+TEST_CASE(ObjLoader, WeldMethodsMergeTheNormalsWithinTheThreshold)
+{
+    typedef NvModelVectorCompactor<nv::vec3f>::Normals Normals;
+    const float                                        threshold = 0.001f;
+
+    // 1 - dot is 0.00045, but the x components are 0.03 apart, only the hash grid merges them
+    const nv::vec3f up(0.f, 1.f, 0.f), tilted(0.03f, sqrtf(1.f - 0.03f * 0.03f), 0.f);
+    Normals         sortedPair(threshold, 2), hashedPair(threshold, 2);
+    hashedPair.SetUseHashGrid(true);
+    for (Normals* normals : {&sortedPair, &hashedPair})
+    {
+        normals->Append(up);
+        normals->Append(tilted);
+    }
+    CHECK(sortedPair.GetVectorCount() == 2 && hashedPair.GetVectorCount() == 1);
+
+    // unit normals scattered around a few directions, both methods only merge the ones within the threshold
+    Random                 random(11);
+    std::vector<nv::vec3f> scattered;
+    for (uint32_t i = 0; i < 4000; ++i)
+    {
+        const nv::vec3f direction(float(i % 5) - 2.f, float(i % 3) - 1.f, 1.f);
+        const nv::vec3f noise(random.uniform(-0.03f, 0.03f), random.uniform(-0.03f, 0.03f),
+                              random.uniform(-0.03f, 0.03f));
+        scattered.push_back(nv::normalize(nv::normalize(direction) + noise));
+    }
+    Normals sorted(threshold, 4000), hashed(threshold, 4000);
+    hashed.SetUseHashGrid(true);
+    for (const nv::vec3f& normal : scattered)
+    {
+        sorted.Append(normal);
+        hashed.Append(normal);
+    }
+
+    Difference_Normal<nv::vec3f> difference;
+    uint32_t                     outOfThreshold = 0;
+    for (uint32_t i = 0; i < scattered.size(); ++i)
+    {
+        nv::vec3f merged;
+        CHECK(sorted.GetObject(sorted.Remap(i), merged));
+        outOfThreshold += difference.ShouldMerge(difference.Diff(scattered[i], merged), threshold) ? 0 : 1;
+        CHECK(hashed.GetObject(hashed.Remap(i), merged));
+        outOfThreshold += difference.ShouldMerge(difference.Diff(scattered[i], merged), threshold) ? 0 : 1;
+    }
+    CHECK(outOfThreshold == 0);
+    CHECK(hashed.GetVectorCount() < sorted.GetVectorCount());
+}
+
+TEST_CASE(ObjLoader, ProcessesOnThreadsLikeSerially)
+{
+    // enough positions and faces for 4 threads, smoothed so the normals are averaged
+    const std::string text = "s 1\n" + generateGridObj(200);
+    ObjModel          serial;
+    serial.SetProcessingThreadCount(1);
+    CHECK(serial.LoadObjFromMemory(text.c_str()));
+    serial.compile(true);
+    CHECK(serial.GetSubMesh(0)->getVertexSize() == 11);
+
+    for (uint32_t threadCount = 2; threadCount <= 4; threadCount *= 2)
+    {
+        ObjModel threaded;
+        threaded.SetProcessingThreadCount(threadCount);
+        CHECK(threaded.LoadObjFromMemory(text.c_str()));
+        threaded.compile(true);
+        CHECK(sameModels(serial, threaded));
+    }
+}
+
+BENCH_CASE(ObjLoader, ProcessingThreads)
+{
+    // the normal and tangent generation of a smoothed grid, without the load
+    const std::string text = "s 1\n" + generateGridObj(400);
+    for (uint32_t threadCount = 1; threadCount <= 4; threadCount *= 2)
+    {
+        ObjModel model;
+        model.SetWeldMethod(NvModelExt::WeldMethod_HashGrid);
+        model.SetProcessingThreadCount(threadCount);
+        model.LoadObjFromMemory(text.c_str());
+        const test::Timer timer;
+        model.compile(true);
+        std::printf("%u threads: %.1f ms\n", threadCount, timer.ms());
+    }
+}
+
+BENCH_CASE(ObjLoader, WeldMethods)
+{
+    // an axis aligned grid whose vertices share their x coordinates, and the same grid with jittered copies
+    const std::string grid = generateGridObj(300);
+    const std::string copies = generateWeldObj(300, 5);
+    for (const std::string* text : {&grid, &copies})
+    {
+        for (NvModelExt::WeldMethod method : {NvModelExt::WeldMethod_SortedAxis, NvModelExt::WeldMethod_HashGrid})
+        {
+            ObjModel model;
+            model.SetWeldMethod(method);
+            const test::Timer timer;
+            model.LoadObjFromMemory(text->c_str());
+            const double ms = timer.ms();
+            model.compile();
+            std::printf("%s, %s: %.1f ms, %u vertices\n", text == &grid ? "grid" : "jittered copies",
+                        method == NvModelExt::WeldMethod_HashGrid ? "hash grid" : "sorted axis", ms,
+                        vertexCount(model));
+        }
+    }
+}
+
+BENCH_CASE(ObjLoader, ChunksVsTokenizer)
+{
+    // includes the serial welding of the vertex components, with the faster of the two methods
+    const std::string text = generateGridObj(500);
+    const double      mb = text.size() / 1e6;
+    {
+        ObjModel model;
+        model.SetWeldMethod(NvModelExt::WeldMethod_HashGrid);
+        const test::Timer timer;
+        model.LoadObjFromMemory(text.c_str());
+        std::printf("%.1f MB, tokenizer: %.1f MB/s\n", mb, mb * 1e3 / timer.ms());
+    }
+    for (uint32_t threadCount = 1; threadCount <= 8; threadCount *= 2)
+    {
+        ObjModel model;
+        model.SetWeldMethod(NvModelExt::WeldMethod_HashGrid);
+        const test::Timer timer;
+        model.LoadObjFromMemory(text.data(), text.size(), threadCount);
+        std::printf("%u threads: %.1f MB/s\n", threadCount, mb * 1e3 / timer.ms());
+    }
+}
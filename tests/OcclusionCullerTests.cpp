@@ -0,0 +1,165 @@
+//
+//  OcclusionCullerTests.cpp
+//
+
+#include "Test.h"
+
+#include "OcclusionCuller.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace Nv;
+
+namespace
+{
+    const uint32_t kLaneCounts[] = {1, 4, 8};
+
+    /// The sample's camera, looking from eye to target.
+    nv::matrix4f projView(const nv::vec3f& eye, const nv::vec3f& target)
+    {
+        nv::matrix4f proj, view;
+        nv::perspective(proj, 3.14159f / 3.f, 16.f / 9.f, 0.1f, 1000.f);
+        nv::lookAt(view, eye, target, nv::vec3f(0.f, 1.f, 0.f));
+        return proj * view;
+    }
+
+    /// Adds the ground quad of the sample, centered under the camera.
+    void beginGround(OcclusionBuffer& buffer, const nv::vec3f& eye, const nv::vec3f& target)
+    {
+        const float     groundSize = 100.f;
+        const nv::vec3f center(eye.x, 0.f, eye.z);
+        buffer.begin(projView(eye, target));
+        buffer.addQuad(center + nv::vec3f(-groundSize, 0.f, -groundSize),
+                       center + nv::vec3f(groundSize, 0.f, -groundSize),
+                       center + nv::vec3f(groundSize, 0.f, groundSize),
+                       center + nv::vec3f(-groundSize, 0.f, groundSize));
+    }
+
+    std::vector<float> depthOf(const OcclusionBuffer& buffer)
+    {
+        return std::vector<float>(buffer.depth(), buffer.depth() + buffer.width() * buffer.height());
+    }
+
+    bool sameDepth(const std::vector<float>& a, const std::vector<float>& b)
+    {
+        return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+    }
+}  // namespace
+
+TEST_CASE(OcclusionCuller, TileOrdersAndLanesMatch)
+{
+    // below the ground looking up at it, above it looking down, and at a grazing angle
+    const nv::vec3f eyes[][2] = {{nv::vec3f(0.f, -2.f, 0.f), nv::vec3f(10.f, 3.f, -30.f)},
+                                 {nv::vec3f(0.f, 15.f, 40.f), nv::vec3f(0.f, 10.f, 0.f)},
+                                 {nv::vec3f(3.3f, 0.7f, -1.1f), nv::vec3f(-20.f, 0.2f, -45.f)}};
+    const uint32_t  sizes[][2] = {{256, 128}, {300, 170}};
+
+    for (const uint32_t* size : sizes)
+    {
+        for (const nv::vec3f* eye : eyes)
+        {
+            // the reference is rasterized one pixel at a time, in order
+            OcclusionBuffer buffer(size[0], size[1]);
+            CHECK(buffer.setLaneCount(1));
+            beginGround(buffer, eye[0], eye[1]);
+            buffer.rasterize();
+            const std::vector<float> reference = depthOf(buffer);
+
+            uint32_t covered = 0;
+            for (float depth : reference)
+                covered += depth > 0.f ? 1 : 0;
+            CHECK(covered > 0 && covered < reference.size());
+
+            const uint32_t tileCount = buffer.tileCount();
+            for (uint32_t laneCount : kLaneCounts)
+            {
+                if (!buffer.setLaneCount(laneCount))
+                    continue;
+
+                // backwards
+                beginGround(buffer, eye[0], eye[1]);
+                for (uint32_t tile = tileCount; tile > 0; --tile)
+                    buffer.rasterizeTile(tile - 1);
+                CHECK(sameDepth(reference, depthOf(buffer)));
+
+                // strided, the stride and the tile counts are coprime, each tile twice
+                beginGround(buffer, eye[0], eye[1]);
+                for (uint32_t i = 0; i < 2 * tileCount; ++i)
+                    buffer.rasterizeTile((i * 7) % tileCount);
+                CHECK(sameDepth(reference, depthOf(buffer)));
+
+                // spread over threads, like the sample's workers
+                beginGround(buffer, eye[0], eye[1]);
+                std::atomic<uint32_t>    nextTile(0);
+                std::vector<std::thread> threads;
+                for (uint32_t t = 0; t < 4; ++t)
+                {
+                    threads.emplace_back([&buffer, &nextTile, tileCount]() {
+                        for (uint32_t tile = nextTile++; tile < tileCount; tile = nextTile++)
+                            buffer.rasterizeTile(tile);
+                    });
+                }
+                for (std::thread& thread : threads)
+                    thread.join();
+                CHECK(sameDepth(reference, depthOf(buffer)));
+            }
+        }
+    }
+}
+
+TEST_CASE(OcclusionCuller, CullsTheBoxesHiddenByTheGround)
+{
+    for (uint32_t laneCount : kLaneCounts)
+    {
+        OcclusionBuffer buffer;
+        if (!buffer.setLaneCount(laneCount))
+            continue;
+
+        // below the ground, the schools above it are hidden
+        {
+            const nv::vec3f eye(0.f, -2.f, 0.f), target(10.f, 3.f, -30.f);
+            beginGround(buffer, eye, target);
+            buffer.rasterize();
+
+            BoxBoundsSoA bounds;
+            bounds.resize(6);
+            bounds.set(0, nv::vec3f(5.f, 10.f, -20.f), nv::vec3f(2.f, 1.f, 2.f));    // hidden
+            bounds.set(1, nv::vec3f(12.f, 4.f, -40.f), nv::vec3f(3.f, 2.f, 3.f));    // hidden
+            bounds.set(2, nv::vec3f(2.f, -1.f, -10.f), nv::vec3f(0.5f, 0.5f, 0.5f)); // under the ground
+            bounds.set(3, nv::vec3f(5.f, 0.f, -20.f), nv::vec3f(2.f, 1.f, 2.f));     // through the ground
+            bounds.set(4, eye, nv::vec3f(1.f, 1.f, 1.f));                             // around the camera
+            bounds.set(5, nv::vec3f(-4.f, 1.f, 30.f), nv::vec3f(1.f, 1.f, 1.f));     // behind the camera
+
+            const uint32_t indices[] = {0, 1, 2, 3, 4, 5};
+            uint32_t       visible[6];
+            CHECK(buffer.cullBoxes(bounds, indices, 6, visible) == 4);
+            CHECK(visible[0] == 2 && visible[1] == 3 && visible[2] == 4 && visible[3] == 5);
+
+            // in place, on a subset
+            uint32_t subset[] = {5, 1, 0, 2};
+            CHECK(buffer.cullBoxes(bounds, subset, 4, subset) == 2);
+            CHECK(subset[0] == 5 && subset[1] == 2);
+        }
+
+        // above the ground, only what is below it is hidden
+        {
+            const nv::vec3f eye(0.f, 15.f, 40.f), target(0.f, 10.f, 0.f);
+            beginGround(buffer, eye, target);
+            buffer.rasterize();
+
+            BoxBoundsSoA bounds;
+            bounds.resize(3);
+            bounds.set(0, nv::vec3f(0.f, -5.f, -20.f), nv::vec3f(2.f, 1.f, 2.f));  // hidden
+            bounds.set(1, nv::vec3f(0.f, 10.f, -20.f), nv::vec3f(2.f, 1.f, 2.f));  // in front of the ground
+            bounds.set(2, nv::vec3f(0.f, -0.5f, 0.f), nv::vec3f(2.f, 1.f, 2.f));   // peeks out of the ground
+
+            const uint32_t indices[] = {0, 1, 2};
+            uint32_t       visible[3];
+            CHECK(buffer.cullBoxes(bounds, indices, 3, visible) == 2);
+            CHECK(visible[0] == 1 && visible[1] == 2);
+        }
+    }
+}
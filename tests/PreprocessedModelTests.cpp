@@ -0,0 +1,210 @@
+//
+//  PreprocessedModelTests.cpp
+//
+
+#include "Test.h"
+
+#include "NvAssetLoader/NvAssetLoader.h"
+#include "NvModel/NvModelSubMesh.h"
+#include "NvModelExtObj.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace Nv;
+
+namespace
+{
+    const char* kModelName = "PreprocessedModelTests.nve";
+
+    /// Same as the sample's loader, reads or maps the files through the asset loader.
+    class AssetFileLoader : public NvModelFileLoader
+    {
+    public:
+        char* LoadDataFromFile(const char* fileName) override
+        {
+            int32_t length;
+            return NvAssetLoaderRead(fileName, length);
+        }
+
+        void ReleaseData(char* pData) override
+        {
+            NvAssetLoaderFree(pData);
+        }
+
+        char* MapDataFromFile(const char* fileName, size_t& length) override
+        {
+            int64_t mappedLength = 0;
+            char*   pData = NvAssetLoaderMap(fileName, mappedLength);
+            length = (size_t)mappedLength;
+            return pData;
+        }
+
+        void UnmapData(char* pData, size_t length) override
+        {
+            NvAssetLoaderUnmap(pData, (int64_t)length);
+        }
+    };
+
+    /// The constructor of the OBJ model is protected, Create() only loads from files.
+    class ObjModel : public NvModelExtObj
+    {
+    public:
+        ObjModel()
+            : NvModelExtObj(0.01f, 0.001f)
+        {
+        }
+
+        void compile()
+        {
+            GenerateNormals();
+            GenerateTangents();
+            for (uint32_t i = 0; i < GetMeshCount(); ++i)
+            {
+                InitProcessedVerts(i);
+                InitProcessedIndices(i);
+            }
+        }
+    };
+
+    /// Writes a grid of size x size vertices to the assets folder of the tests, returns false on failure.
+    bool writeGridModel(uint32_t size)
+    {
+        std::string text = "# generated\nusemtl material0\n";
+        char        line[128];
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                const float height = float((x * 7 + y * 13) % 17) * 0.1f;
+                snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\n", float(x), height, float(y),
+                         float(x) / size, float(y) / size);
+                text += line;
+            }
+        }
+        for (uint32_t y = 0; y + 1 < size; ++y)
+        {
+            for (uint32_t x = 0; x + 1 < size; ++x)
+            {
+                const uint32_t i = y * size + x + 1;
+                const uint32_t j = i + size;
+                snprintf(line, sizeof(line), "f %u/%u %u/%u %u/%u %u/%u\n", i, i, i + 1, i + 1, j + 1, j + 1, j, j);
+                text += line;
+            }
+        }
+
+        ObjModel model;
+        model.SetWeldMethod(NvModelExt::WeldMethod_HashGrid);
+        if (!model.LoadObjFromMemory(text.c_str()))
+            return false;
+        model.compile();
+        return model.WritePreprocessedModel((std::string(TEST_ASSETS_DIR "/assets/") + kModelName).c_str());
+    }
+
+    bool sameModels(NvModelExt& a, NvModelExt& b)
+    {
+        const nv::vec3f minA = a.GetMinExt(), minB = b.GetMinExt();
+        const nv::vec3f maxA = a.GetMaxExt(), maxB = b.GetMaxExt();
+        if (memcmp(&minA, &minB, sizeof(minA)) || memcmp(&maxA, &maxB, sizeof(maxA)))
+            return false;
+        if (a.GetMeshCount() != b.GetMeshCount() || a.GetMaterialCount() != b.GetMaterialCount())
+            return false;
+
+        for (uint32_t i = 0; i < a.GetMeshCount(); ++i)
+        {
+            const SubMesh* meshA = a.GetSubMesh(i);
+            const SubMesh* meshB = b.GetSubMesh(i);
+            if (meshA->getVertexSize() != meshB->getVertexSize() || meshA->getVertexCount() != meshB->getVertexCount() ||
+                meshA->getIndexCount() != meshB->getIndexCount())
+            {
+                return false;
+            }
+            const size_t vertexBytes = sizeof(float) * meshA->getVertexSize() * meshA->getVertexCount();
+            const size_t indexBytes = sizeof(uint32_t) * meshA->getIndexCount();
+            if (memcmp(meshA->getVertices(), meshB->getVertices(), vertexBytes) ||
+                memcmp(meshA->getIndices(), meshB->getIndices(), indexBytes))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Resident memory of the process, in MB, 0 where it isn't known.
+    double residentMB()
+    {
+#ifdef __linux__
+        FILE* fp = fopen("/proc/self/statm", "r");
+        if (!fp)
+            return 0.0;
+        long pages = 0, resident = 0;
+        const int read = fscanf(fp, "%ld %ld", &pages, &resident);
+        fclose(fp);
+        return read == 2 ? resident * (double)sysconf(_SC_PAGESIZE) / 1e6 : 0.0;
+#else
+        return 0.0;
+#endif
+    }
+}  // namespace
+
+TEST_CASE(PreprocessedModel, MappedMatchesCopied)
+{
+    AssetFileLoader loader;
+    NvModelExt::SetFileLoader(&loader);
+    NvAssetLoaderAddSearchPath(TEST_ASSETS_DIR);
+    CHECK(writeGridModel(40));
+
+    std::unique_ptr<NvModelExt> copied(NvModelExt::CreateFromPreprocessed(kModelName, false));
+    std::unique_ptr<NvModelExt> mapped(NvModelExt::CreateFromPreprocessed(kModelName, true));
+    CHECK(copied && mapped);
+    if (copied && mapped)
+    {
+        CHECK(copied->GetMeshCount() == 1);
+        CHECK(copied->GetSubMesh(0)->getIndexCount() == 39 * 39 * 6);
+        CHECK(sameModels(*copied, *mapped));
+
+        // the mapped pages are copy-on-write, the meshes can still be modified in place
+        mapped->GetSubMesh(0)->m_vertices[0] += 1.f;
+        std::unique_ptr<NvModelExt> remapped(NvModelExt::CreateFromPreprocessed(kModelName, true));
+        CHECK(remapped && sameModels(*copied, *remapped));
+    }
+
+    NvAssetLoaderRemoveSearchPath(TEST_ASSETS_DIR);
+    NvModelExt::SetFileLoader(nullptr);
+}
+
+BENCH_CASE(PreprocessedModel, MappedVsCopied)
+{
+    AssetFileLoader loader;
+    NvModelExt::SetFileLoader(&loader);
+    NvAssetLoaderAddSearchPath(TEST_ASSETS_DIR);
+    if (!writeGridModel(700))
+        return;
+
+    // the file was just written, both loads read it from the page cache
+    for (int map = 0; map < 2; ++map)
+    {
+        const double      residentBefore = residentMB();
+        const test::Timer timer;
+        std::unique_ptr<NvModelExt> model(NvModelExt::CreateFromPreprocessed(kModelName, map != 0));
+        const double                loadMs = timer.ms();
+        const double                residentLoaded = residentMB();
+
+        // then touches all of the vertices, like the upload to the vertex buffer does
+        const SubMesh* mesh = model->GetSubMesh(0);
+        float          sum = 0.f;
+        for (int32_t i = 0; i < mesh->getVertexCount() * mesh->getVertexSize(); ++i)
+            sum += mesh->getVertices()[i];
+        test::keep(sum);
+        std::printf("%s: load %.2f ms, resident +%.1f MB after the load, +%.1f MB after reading the vertices\n",
+                    map ? "mapped" : "copied", loadMs, residentLoaded - residentBefore, residentMB() - residentBefore);
+    }
+
+    NvAssetLoaderRemoveSearchPath(TEST_ASSETS_DIR);
+    NvModelExt::SetFileLoader(nullptr);
+}
@@ -0,0 +1,179 @@
+//
+//  RadixSortTests.cpp
+//
+
+#include "Test.h"
+
+#include "CommandBuffer.h"
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed)
+            : m_state(seed)
+        {
+        }
+
+        uint32_t next(uint32_t range)
+        {
+            m_state = m_state * 6364136223846793005ull + 1442695040888963407ull;
+            return uint32_t((m_state >> 33) % range);
+        }
+
+        uint64_t next64()
+        {
+            const uint64_t high = next(0xFFFFFFFFu);
+            return high << 32 | next(0xFFFFFFFFu);
+        }
+
+    private:
+        uint64_t m_state;
+    };
+
+    /// Keys with a few viewports, materials and depths, so most of them have duplicates.
+    cb::DrawKey makeKey(Random& random, cb::DrawKey)
+    {
+        cb::DrawKey key = cb::DrawKey::makeDefault(random.next(4));
+        if (random.next(8) == 0)
+            return cb::DrawKey::makeCustom(random.next(4), cb::ViewLayerType::eHighest, random.next(16));
+        key.setMaterialDepth(random.next(50), random.next(1000));
+        return key;
+    }
+
+    cb::WideDrawKey makeKey(Random& random, cb::WideDrawKey)
+    {
+        if (random.next(8) == 0)
+            return cb::WideDrawKey::makeCustom(random.next(4), cb::ViewLayerType::eHighest, random.next(16));
+        cb::WideDrawKey key = cb::WideDrawKey::makeDefault(random.next(4));
+        // material ids past the 16 bits of the 64-bit key
+        key.setMaterialDepth(random.next(50) << 20, random.next(1000));
+        key.setMesh(random.next(8));
+        return key;
+    }
+
+    uint32_t makeKey(Random& random, uint32_t)
+    {
+        return random.next(3) == 0 ? random.next(0xFFFFFFFFu) : random.next(300);
+    }
+
+    /// Commands with the given keys, the packets are only tags to tell the commands apart.
+    template <typename KeyType>
+    std::vector<cb::CommandPair<KeyType>> makeCommands(uint32_t count, uint32_t seed, std::vector<uint8_t>& tags)
+    {
+        Random random(seed);
+        tags.resize(count + 1);
+        std::vector<cb::CommandPair<KeyType>> commands(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            commands[i].cmd = reinterpret_cast<cb::CommandPacket*>(&tags[i]);
+            commands[i].key = makeKey(random, KeyType());
+        }
+        return commands;
+    }
+
+    template <typename KeyType>
+    void checkMatchesStableSort(uint32_t count, uint32_t seed)
+    {
+        std::vector<uint8_t>                  tags;
+        std::vector<cb::CommandPair<KeyType>> sorted = makeCommands<KeyType>(count, seed, tags);
+        std::vector<cb::CommandPair<KeyType>> expected = sorted;
+
+        cb::radixSort(sorted.data(), sorted.data() + count);
+        std::stable_sort(expected.data(), expected.data() + count);
+        uint32_t mismatches = 0;
+        for (uint32_t i = 0; i < count; ++i)
+            mismatches += sorted[i].cmd == expected[i].cmd ? 0 : 1;
+        CHECK(mismatches == 0);
+    }
+
+    /// Returns the best time of the runs to sort copies of the commands.
+    template <typename KeyType, typename SortFunc>
+    double sortMs(const std::vector<cb::CommandPair<KeyType>>& commands, SortFunc sortFunc, int runs)
+    {
+        double                                best = 1e30;
+        std::vector<cb::CommandPair<KeyType>> sorted;
+        for (int run = 0; run < runs; ++run)
+        {
+            sorted = commands;
+            const test::Timer timer;
+            sortFunc(sorted.data(), sorted.data() + sorted.size());
+            best = std::min(best, timer.ms());
+            test::keep(sorted[0].key);
+        }
+        return best;
+    }
+
+    template <typename KeyType>
+    void benchSorts(const char* keyName, uint32_t count, int runs)
+    {
+        typedef cb::CommandPair<KeyType> command_t;
+
+        std::vector<uint8_t>         tags;
+        const std::vector<command_t> commands = makeCommands<KeyType>(count, 3, tags);
+        const double                 stdMs = sortMs(commands, std::sort<command_t*>, runs);
+        const double                 radixMs = sortMs(commands, cb::radixSort<command_t>, runs);
+        std::printf("%u commands, %s: std::sort %.3f ms, radixSort %.3f ms (%.2fx)\n", count, keyName, stdMs, radixMs,
+                    stdMs / radixMs);
+    }
+}  // namespace
+
+TEST_CASE(RadixSort, MatchesStableSort)
+{
+    // the sizes below 2 return early, the others go through all the digits, some of them skipped
+    for (uint32_t count : {0u, 1u, 2u, 3u, 17u, 256u, 1000u, 20000u})
+    {
+        checkMatchesStableSort<cb::DrawKey>(count, count + 1);
+        checkMatchesStableSort<cb::WideDrawKey>(count, count + 2);
+        checkMatchesStableSort<uint32_t>(count, count + 3);
+    }
+
+    // all the keys the same, every digit is skipped and the commands keep their order
+    std::vector<uint8_t>                      tags(64);
+    std::vector<cb::CommandPair<cb::DrawKey>> same(64);
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        same[i].cmd = reinterpret_cast<cb::CommandPacket*>(&tags[i]);
+        same[i].key = cb::DrawKey::makeDefault(2);
+    }
+    cb::radixSort(same.data(), same.data() + same.size());
+    for (uint32_t i = 0; i < 64; ++i)
+        CHECK(same[i].cmd == reinterpret_cast<cb::CommandPacket*>(&tags[i]));
+}
+
+TEST_CASE(RadixSort, StreamsTheKeys)
+{
+    // the mode fields follow the view without an empty separator
+    cb::DrawKey key = cb::DrawKey::makeDefault(1);
+    key.setMaterialDepth(7, 9);
+    std::ostringstream stream;
+    stream << key;
+    CHECK(stream.str().find(", , ") == std::string::npos);
+    CHECK(stream.str().find("depth: 9, material id: 7") != std::string::npos);
+
+    cb::WideDrawKey wideKey = cb::WideDrawKey::makeDefault(1);
+    wideKey.setMaterialDepth(7, 9);
+    wideKey.setMesh(3);
+    std::ostringstream wideStream;
+    wideStream << wideKey;
+    CHECK(wideStream.str().find(", , ") == std::string::npos);
+    CHECK(wideStream.str().find("depth: 9, material id: 7, mesh id: 3") != std::string::npos);
+}
+
+BENCH_CASE(RadixSort, SortCommands)
+{
+    // the 64 and the 128-bit keys, with the comparison and the radix sorts
+    for (uint32_t count : {1000u, 10000u, 100000u})
+    {
+        const int runs = count < 100000 ? 50 : 10;
+        benchSorts<cb::DrawKey>("64-bit DrawKey", count, runs);
+        benchSorts<cb::WideDrawKey>("128-bit WideDrawKey", count, runs);
+    }
+}
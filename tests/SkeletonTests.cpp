@@ -0,0 +1,185 @@
+//
+//  SkeletonTests.cpp
+//
+
+#include "Test.h"
+
+#include "NvModel/NvSkeleton.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Nv;
+
+namespace
+{
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed)
+            : m_state(seed)
+        {
+        }
+
+        float uniform(float min, float max)
+        {
+            m_state = m_state * 1664525u + 1013904223u;
+            return min + (max - min) * float(m_state >> 8) / float(1 << 24);
+        }
+
+    private:
+        uint32_t m_state;
+    };
+
+    nv::matrix4f randomTransform(Random& random)
+    {
+        nv::matrix4f transform;
+        for (float& value : transform._array)
+            value = random.uniform(-1.f, 1.f);
+        return transform;
+    }
+
+    /// A hierarchy with two roots, each other node's parent one to three nodes before it.
+    std::vector<NvSkeletonNode> makeNodes(uint32_t nodeCount)
+    {
+        std::vector<NvSkeletonNode> nodes(nodeCount);
+        for (uint32_t i = 0; i < nodeCount; ++i)
+        {
+            nodes[i].m_name = "node" + std::to_string(i);
+            nodes[i].m_parentNode = (i == 0 || i == nodeCount / 2) ? -1 : int32_t(i - 1 - i % 3 % i);
+        }
+        return nodes;
+    }
+
+    /// The parent-relative transforms of the instances, stored by node.
+    std::vector<nv::matrix4f> makePoses(uint32_t nodeCount, uint32_t instanceCount, uint32_t seed)
+    {
+        Random                    random(seed);
+        std::vector<nv::matrix4f> poses(nodeCount * instanceCount);
+        for (nv::matrix4f& pose : poses)
+            pose = randomTransform(random);
+        return poses;
+    }
+
+    bool sameTransform(const nv::matrix4f& a, const nv::matrix4f& b)
+    {
+        return memcmp(a._array, b._array, sizeof(a._array)) == 0;
+    }
+
+    /// Poses each instance on its own, like building a skeleton of its transforms would.
+    void evaluateEach(const std::vector<NvSkeletonNode>& nodes, const std::vector<nv::matrix4f>& poses,
+                      uint32_t instanceCount, std::vector<nv::matrix4f>& transforms)
+    {
+        const uint32_t nodeCount = uint32_t(nodes.size());
+        for (uint32_t instance = 0; instance < instanceCount; ++instance)
+        {
+            for (uint32_t node = 0; node < nodeCount; ++node)
+            {
+                const nv::matrix4f& local = poses[node * instanceCount + instance];
+                const int32_t       parent = nodes[node].m_parentNode;
+                transforms[instance * nodeCount + node] =
+                    parent < 0 ? local : transforms[instance * nodeCount + parent] * local;
+            }
+        }
+    }
+}  // namespace
+
+TEST_CASE(Skeleton, EvaluatesPosesLikeEachSkeleton)
+{
+    // instance counts around the blocks of 64
+    const uint32_t                    nodeCount = 13;
+    const std::vector<NvSkeletonNode> nodes = makeNodes(nodeCount);
+    const NvSkeleton                  skeleton(nodes.data(), nodeCount);
+    for (uint32_t instanceCount : {1u, 63u, 64u, 130u})
+    {
+        const std::vector<nv::matrix4f> poses = makePoses(nodeCount, instanceCount, instanceCount);
+        std::vector<nv::matrix4f>       transforms(nodeCount * instanceCount);
+        skeleton.EvaluatePoses(poses.data(), instanceCount, transforms.data());
+
+        // each instance as the model-space transforms of a skeleton with its pose
+        uint32_t mismatches = 0;
+        for (uint32_t instance = 0; instance < instanceCount; ++instance)
+        {
+            std::vector<NvSkeletonNode> posed = nodes;
+            for (uint32_t node = 0; node < nodeCount; ++node)
+                posed[node].m_parentRelTransform = poses[node * instanceCount + instance];
+            NvSkeleton reference(posed.data(), nodeCount);
+            for (uint32_t node = 0; node < nodeCount; ++node)
+                mismatches += sameTransform(*reference.GetTransform(node), transforms[node * instanceCount + instance])
+                                  ? 0
+                                  : 1;
+        }
+        CHECK(mismatches == 0);
+    }
+}
+
+TEST_CASE(Skeleton, WritesTheSkinningTransformsByInstance)
+{
+    const uint32_t                    nodeCount = 9, instanceCount = 100;
+    const std::vector<NvSkeletonNode> nodes = makeNodes(nodeCount);
+    const NvSkeleton                  skeleton(nodes.data(), nodeCount);
+    const std::vector<nv::matrix4f>   poses = makePoses(nodeCount, instanceCount, 3);
+
+    std::vector<nv::matrix4f> expected(nodeCount * instanceCount);
+    evaluateEach(nodes, poses, instanceCount, expected);
+
+    // streamed when 16-byte aligned, copied otherwise
+    std::vector<nv::matrix4f> transforms(nodeCount * instanceCount);
+    std::vector<float>        storage(16 * nodeCount * instanceCount + 8);
+    for (uint32_t offset : {0u, 1u})
+    {
+        float* base = storage.data() + (4 - reinterpret_cast<uintptr_t>(storage.data()) / sizeof(float) % 4) % 4;
+        nv::matrix4f* skinning = reinterpret_cast<nv::matrix4f*>(base + offset);
+        skeleton.EvaluatePoses(poses.data(), instanceCount, transforms.data(), skinning);
+
+        uint32_t mismatches = 0;
+        for (uint32_t instance = 0; instance < instanceCount; ++instance)
+        {
+            for (uint32_t node = 0; node < nodeCount; ++node)
+            {
+                const nv::matrix4f& transform = expected[instance * nodeCount + node];
+                mismatches += sameTransform(transform, transforms[node * instanceCount + instance]) ? 0 : 1;
+                mismatches += sameTransform(transform, skinning[instance * nodeCount + node]) ? 0 : 1;
+            }
+        }
+        CHECK(mismatches == 0);
+    }
+}
+
+BENCH_CASE(Skeleton, EvaluatePoses)
+{
+    for (uint32_t nodeCount : {32u, 64u})
+    {
+        const uint32_t                    instanceCount = nodeCount * 128;
+        const std::vector<NvSkeletonNode> nodes = makeNodes(nodeCount);
+        const NvSkeleton                  skeleton(nodes.data(), nodeCount);
+        const std::vector<nv::matrix4f>   poses = makePoses(nodeCount, instanceCount, 7);
+        std::vector<nv::matrix4f>         transforms(nodeCount * instanceCount), skinning(nodeCount * instanceCount);
+
+        double eachMs = 1e30, batchMs = 1e30, skinningMs = 1e30;
+        for (int run = 0; run < 5; ++run)
+        {
+            {
+                const test::Timer timer;
+                evaluateEach(nodes, poses, instanceCount, skinning);
+                eachMs = std::min(eachMs, timer.ms());
+            }
+            {
+                const test::Timer timer;
+                skeleton.EvaluatePoses(poses.data(), instanceCount, transforms.data());
+                batchMs = std::min(batchMs, timer.ms());
+            }
+            {
+                const test::Timer timer;
+                skeleton.EvaluatePoses(poses.data(), instanceCount, transforms.data(), skinning.data());
+                skinningMs = std::min(skinningMs, timer.ms());
+            }
+            test::keep(transforms[run]._array[0]);
+            test::keep(skinning[run]._array[0]);
+        }
+        std::printf("%u nodes x %u instances: each %.2f ms, EvaluatePoses %.2f ms, with skinning %.2f ms\n",
+                    nodeCount, instanceCount, eachMs, batchMs, skinningMs);
+    }
+}
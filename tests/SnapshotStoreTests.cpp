@@ -0,0 +1,235 @@
+//
+//  SnapshotStoreTests.cpp
+//
+
+#include "Test.h"
+
+#include "SnapshotStore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    /// Each item is derived from its epoch and index, a version rewritten while pinned shows other values.
+    struct Item
+    {
+        uint64_t epoch;
+        uint32_t index;
+        uint32_t check;
+    };
+
+    inline uint32_t checkOf(uint64_t epoch, uint32_t index)
+    {
+        return uint32_t(epoch * 2654435761u) ^ index;
+    }
+
+    uint64_t publishItems(cb::SnapshotStore<Item>& store, Item* items, uint32_t count)
+    {
+        const uint64_t epoch = store.publishedEpoch() + 1;
+        for (uint32_t i = 0; i < count; ++i)
+            items[i] = Item{epoch, i, checkOf(epoch, i)};
+        return store.publish();
+    }
+
+    /// Counts the items that don't match the epoch of the snapshot.
+    uint32_t tornItems(const cb::SnapshotStore<Item>::Snapshot& snapshot)
+    {
+        uint32_t torn = 0;
+        for (uint32_t i = 0; i < snapshot.count(); ++i)
+        {
+            const Item& item = snapshot[i];
+            torn += item.epoch != snapshot.epoch() || item.index != i || item.check != checkOf(snapshot.epoch(), i);
+        }
+        return torn;
+    }
+
+    struct State
+    {
+        float x, y, z, radius, heading;
+    };
+}  // namespace
+
+TEST_CASE(SnapshotStore, WaitsOnlyForTheOldestPinnedVersion)
+{
+    cb::SnapshotStore<Item> store(16, 3);
+    CHECK(!store.acquire().valid());
+
+    Item* items = store.tryBeginWrite(16);
+    CHECK(items != nullptr);
+    const uint64_t first = publishItems(store, items, 16);
+    CHECK(first == 1 && store.publishedEpoch() == 1);
+
+    // with 3 versions, E + 1 and E + 2 are published while E is pinned
+    cb::SnapshotStore<Item>::Snapshot pinned = store.acquire();
+    CHECK(pinned.valid() && pinned.epoch() == first && pinned.count() == 16);
+    for (uint32_t i = 1; i <= 2; ++i)
+    {
+        items = store.tryBeginWrite(8);
+        CHECK(items != nullptr);
+        CHECK(publishItems(store, items, 8) == first + i);
+    }
+    // E + 3 reuses the version of E
+    CHECK(store.tryBeginWrite(8) == nullptr);
+    CHECK(tornItems(pinned) == 0);
+
+    // the latest and the previous versions can be pinned too
+    {
+        cb::SnapshotStore<Item>::Snapshot latest = store.acquire();
+        cb::SnapshotStore<Item>::Snapshot previous = store.acquire(first + 1);
+        CHECK(latest.epoch() == first + 2 && latest.count() == 8 && tornItems(latest) == 0);
+        CHECK(previous.epoch() == first + 1 && tornItems(previous) == 0);
+        CHECK(!store.acquire(first + 3).valid());
+    }
+
+    pinned.release();
+    CHECK(!pinned.valid());
+    items = store.tryBeginWrite(4);
+    CHECK(items != nullptr);
+    // the version being rewritten can't be pinned anymore
+    CHECK(!store.acquire(first).valid());
+    CHECK(publishItems(store, items, 4) == first + 3);
+    CHECK(!store.acquire(first).valid());
+    CHECK(store.acquire().epoch() == first + 3);
+}
+
+TEST_CASE(SnapshotStore, ReadersNeverSeeTornVersions)
+{
+    const uint32_t          capacity = 1000;
+    const uint64_t          epochCount = 20000;
+    const uint32_t          readerCount = std::max(2u, std::thread::hardware_concurrency() - 1);
+    cb::SnapshotStore<Item> store(capacity, 3);
+
+    std::atomic<bool>     stop(false);
+    std::atomic<uint32_t> errors(0);
+    std::atomic<uint64_t> pins(0), writerWaits(0);
+
+    std::vector<std::thread> readers;
+    for (uint32_t r = 0; r < readerCount; ++r)
+    {
+        readers.emplace_back([&store, &stop, &errors, &pins, r]() {
+            uint64_t last = 0;
+            uint32_t spin = r;
+            while (!stop.load())
+            {
+                cb::SnapshotStore<Item>::Snapshot latest = store.acquire();
+                if (!latest.valid())
+                    continue;
+                // the epochs a thread sees never go back
+                errors += latest.epoch() < last ? 1 : 0;
+                last = latest.epoch();
+
+                // also pins the previous epoch when it wasn't recycled yet, then reads both twice
+                cb::SnapshotStore<Item>::Snapshot previous = store.acquire(latest.epoch() - 1);
+                for (uint32_t pass = 0; pass < 2; ++pass)
+                {
+                    errors += tornItems(latest);
+                    if (previous.valid())
+                        errors += tornItems(previous);
+                }
+                // holds some of the snapshots longer, so the writer has to wait for them
+                if (++spin % 8 == 0)
+                    std::this_thread::sleep_for(std::chrono::microseconds(spin % 200));
+                ++pins;
+            }
+        });
+    }
+
+    uint32_t count = 1;
+    for (uint64_t e = 1; e <= epochCount; ++e)
+    {
+        count = (count * 1103515245u + 12345u) % capacity + 1;
+        Item* items = store.tryBeginWrite(count);
+        if (!items)
+        {
+            ++writerWaits;
+            items = store.beginWrite(count);
+        }
+        if (publishItems(store, items, count) != e)
+            ++errors;
+    }
+    stop = true;
+    for (std::thread& reader : readers)
+        reader.join();
+
+    std::printf("%u readers, %llu pins, the writer waited %llu times\n", readerCount,
+                (unsigned long long)pins.load(), (unsigned long long)writerWaits.load());
+    CHECK(errors.load() == 0);
+    CHECK(pins.load() > 0);
+    CHECK(store.publishedEpoch() == epochCount);
+}
+
+BENCH_CASE(SnapshotStore, AcquireLatency)
+{
+    const uint32_t           schoolCount = 1000;
+    const uint32_t           iterations = 2000000;
+    cb::SnapshotStore<State> store(schoolCount, 3);
+    State*                   states = store.beginWrite(schoolCount);
+    for (uint32_t i = 0; i < schoolCount; ++i)
+        states[i] = State{float(i), 0.f, 0.f, 1.f, 0.f};
+    store.publish();
+
+    {
+        const test::Timer timer;
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            cb::SnapshotStore<State>::Snapshot snapshot = store.acquire();
+            test::keep(snapshot[i % schoolCount].x);
+        }
+        std::printf("acquire and release, 1 thread: %.1f ns\n", timer.ms() * 1e6 / iterations);
+    }
+    {
+        // the previous implementation, a mutex guarding the state
+        std::mutex        mutex;
+        const test::Timer timer;
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            test::keep(states[i % schoolCount].x);
+        }
+        std::printf("mutex lock and unlock, 1 thread: %.1f ns\n", timer.ms() * 1e6 / iterations);
+    }
+
+    // readers pinning in a loop while the writer publishes as fast as it can
+    for (uint32_t readerCount = 1; readerCount <= 8; readerCount *= 2)
+    {
+        std::atomic<bool>        stop(false);
+        std::atomic<uint64_t>    pins(0);
+        std::vector<std::thread> readers;
+        for (uint32_t r = 0; r < readerCount; ++r)
+        {
+            readers.emplace_back([&store, &stop, &pins, schoolCount]() {
+                uint64_t n = 0;
+                for (; !stop.load(std::memory_order_relaxed); ++n)
+                {
+                    cb::SnapshotStore<State>::Snapshot snapshot = store.acquire();
+                    test::keep(snapshot[uint32_t(n % schoolCount)].x);
+                }
+                pins += n;
+            });
+        }
+
+        std::vector<double> latencies;
+        const test::Timer   total;
+        while (total.ms() < 500.0)
+        {
+            const test::Timer timer;
+            State*            written = store.beginWrite(schoolCount);
+            written[0].x = 1.f;
+            store.publish();
+            latencies.push_back(timer.ms() * 1e6);
+        }
+        const double ms = total.ms();
+        stop = true;
+        for (std::thread& reader : readers)
+            reader.join();
+
+        std::sort(latencies.begin(), latencies.end());
+        std::printf("%u readers: %.1f M pins/s, beginWrite and publish median %.0f ns, p99 %.0f ns (%zu publishes)\n",
+                    readerCount, pins.load() / ms / 1e3, latencies[latencies.size() / 2],
+                    latencies[latencies.size() * 99 / 100], latencies.size());
+    }
+}
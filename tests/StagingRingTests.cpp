@@ -0,0 +1,139 @@
+//
+//  StagingRingTests.cpp
+//
+
+#include "Test.h"
+
+#include "StagingRing.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    /// Records the frames the ring waited for.
+    struct WaitLog
+    {
+        std::vector<uint32_t> frames;
+
+        cb::StagingRing::wait_func_t func()
+        {
+            return [this](uint32_t frame) { frames.push_back(frame); };
+        }
+    };
+
+    /// Returns the start of the region the ring allocates from in the current frame.
+    uint8_t* regionOf(cb::StagingRing& ring)
+    {
+        uint8_t* data = ring.alloc(1, 1);
+        return data ? data - (ring.frameUsed() - 1) : nullptr;
+    }
+}  // namespace
+
+TEST_CASE(StagingRing, WrapsAroundTheFramesInFlight)
+{
+    cb::StagingRing ring(1024, 3);
+    CHECK(ring.frameIndex() == 0 && ring.frameBytes() == 1024 && ring.framesInFlight() == 3);
+
+    // each frame fills its region, the frames in flight use different regions
+    std::vector<uint8_t*> regions;
+    for (uint32_t frame = 0; frame < 3; ++frame)
+    {
+        uint32_t* values = ring.alloc<uint32_t>(64);
+        CHECK(values != nullptr && reinterpret_cast<uintptr_t>(values) % 16 == 0);
+        for (uint32_t i = 0; i < 64; ++i)
+            values[i] = frame * 1000 + i;
+        regions.push_back(reinterpret_cast<uint8_t*>(values));
+
+        // a full region returns null and keeps its allocations
+        CHECK(ring.alloc(1024 - 256 + 1) == nullptr);
+        CHECK(ring.frameUsed() == 256);
+        CHECK(ring.alloc(1024 - 256) != nullptr);
+        CHECK(ring.frameUsed() == 1024);
+        CHECK(ring.alloc(1) == nullptr);
+        ring.nextFrame();
+    }
+    CHECK(regions[0] != regions[1] && regions[1] != regions[2] && regions[0] != regions[2]);
+
+    // the data of the frames in flight is untouched until their region is reused
+    for (uint32_t frame = 0; frame < 3; ++frame)
+    {
+        const uint32_t* values = reinterpret_cast<const uint32_t*>(regions[frame]);
+        CHECK(values[0] == frame * 1000 && values[63] == frame * 1000 + 63);
+    }
+
+    // the fourth frame wraps around to the region of the first one, from its start
+    CHECK(ring.frameIndex() == 3 && ring.frameUsed() == 0);
+    CHECK(regionOf(ring) == regions[0]);
+    for (uint32_t frame = 4; frame < 9; ++frame)
+    {
+        ring.nextFrame();
+        CHECK(regionOf(ring) == regions[frame % 3]);
+    }
+}
+
+TEST_CASE(StagingRing, WaitsBeforeReusingARegion)
+{
+    WaitLog         waits;
+    cb::StagingRing ring(256, 2, waits.func());
+
+    // the first frames in flight have their own regions
+    ring.nextFrame();
+    CHECK(waits.frames.empty());
+
+    // then each frame waits for the one that used its region
+    for (uint32_t frame = 2; frame < 6; ++frame)
+    {
+        ring.nextFrame();
+        CHECK(waits.frames.size() == frame - 1 && waits.frames.back() == frame - 2);
+    }
+    CHECK(ring.waitCount() == 4);
+
+    // without a wait function the regions are just recycled
+    cb::StagingRing unfenced(256, 2);
+    for (uint32_t frame = 0; frame < 4; ++frame)
+        unfenced.nextFrame();
+    CHECK(unfenced.waitCount() == 0);
+}
+
+TEST_CASE(StagingRing, WaitsForAConsumerThread)
+{
+    // the frames are consumed on another thread, i.e. submitted by a render thread, the ring must not hand
+    // out a region before its frame was consumed
+    const uint32_t        frameCount = 200, valueCount = 32;
+    std::atomic<uint32_t> recorded(0), consumed(0);
+    std::atomic<bool>     corrupted(false);
+    std::vector<uint32_t*> frames(frameCount);
+
+    cb::StagingRing ring(valueCount * sizeof(uint32_t), 3, [&consumed](uint32_t frame) {
+        while (consumed.load(std::memory_order_acquire) <= frame)
+            std::this_thread::yield();
+    });
+
+    std::thread consumer([&]() {
+        for (uint32_t frame = 0; frame < frameCount; ++frame)
+        {
+            while (recorded.load(std::memory_order_acquire) <= frame)
+                std::this_thread::yield();
+            for (uint32_t i = 0; i < valueCount; ++i)
+                corrupted = corrupted || frames[frame][i] != frame * valueCount + i;
+            consumed.store(frame + 1, std::memory_order_release);
+        }
+    });
+
+    for (uint32_t frame = 0; frame < frameCount; ++frame)
+    {
+        uint32_t* values = ring.alloc<uint32_t>(valueCount);
+        CHECK(values != nullptr);
+        for (uint32_t i = 0; i < valueCount; ++i)
+            values[i] = frame * valueCount + i;
+        frames[frame] = values;
+        recorded.store(frame + 1, std::memory_order_release);
+        ring.nextFrame();
+    }
+    consumer.join();
+    CHECK(!corrupted.load());
+    CHECK(ring.waitCount() == frameCount - 2);
+}
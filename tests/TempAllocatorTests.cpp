@@ -0,0 +1,296 @@
+//
+//  TempAllocatorTests.cpp
+//
+
+#include "Test.h"
+
+#include "NsBitUtils.h"
+#include "NsGlobals.h"
+#include "NsMutex.h"
+#include "NsTempAllocator.h"
+#include "NsVersionNumber.h"
+#include "NvAllocatorCallback.h"
+#include "NvErrorCallback.h"
+#include "NvMath.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace nvidia;
+using namespace nvidia::shdfnd;
+
+namespace
+{
+    class CountingAllocator : public NvAllocatorCallback
+    {
+    public:
+        std::atomic<int> live;
+
+        CountingAllocator()
+            : live(0)
+        {
+        }
+
+        void* allocate(size_t size, const char*, const char*, int) override
+        {
+            ++live;
+#ifdef _WIN32
+            return _aligned_malloc(size, 16);
+#else
+            void* ptr = nullptr;
+            return posix_memalign(&ptr, 16, size) == 0 ? ptr : nullptr;
+#endif
+        }
+
+        void deallocate(void* ptr) override
+        {
+            if (!ptr)
+                return;
+            --live;
+#ifdef _WIN32
+            _aligned_free(ptr);
+#else
+            free(ptr);
+#endif
+        }
+    };
+
+    class PrintingErrorCallback : public NvErrorCallback
+    {
+    public:
+        void reportError(NvErrorCode::Enum, const char* message, const char* file, int line) override
+        {
+            std::printf("%s(%d): %s\n", file, line, message);
+        }
+    };
+
+    /// Initializes the shared foundation for a test.
+    struct Foundation
+    {
+        CountingAllocator     allocator;
+        PrintingErrorCallback errors;
+
+        Foundation()
+        {
+            initializeSharedFoundation(NV_FOUNDATION_VERSION, allocator, errors);
+        }
+        ~Foundation()
+        {
+            terminateSharedFoundation();
+        }
+    };
+
+    // 1000 bytes plus the 16 byte chunk header are served from the 1kB class, 2 << 9 bytes
+    const size_t   kChunkBytes = 1000;
+    const uint32_t kChunkClass = 9 - 8;
+
+    void allocateAndFree(uint32_t count)
+    {
+        TempAllocator         alloc;
+        std::vector<void*>    ptrs(count);
+        for (uint32_t i = 0; i < count; ++i)
+            ptrs[i] = alloc.allocate(kChunkBytes, __FILE__, __LINE__);
+        for (uint32_t i = 0; i < count; ++i)
+            alloc.deallocate(ptrs[i]);
+    }
+
+    /// The implementation before the per thread caches, all the free lists are guarded by one mutex.
+    class MutexTempAllocator
+    {
+    public:
+        MutexTempAllocator()
+        {
+            for (Chunk*& list : m_free)
+                list = nullptr;
+        }
+
+        ~MutexTempAllocator()
+        {
+            for (Chunk* chunk : m_free)
+            {
+                while (chunk)
+                {
+                    Chunk* next = chunk->mNext;
+                    NonTrackingAllocator().deallocate(chunk);
+                    chunk = next;
+                }
+            }
+        }
+
+        void* allocate(size_t size)
+        {
+            uint32_t index = NvMax(highestSetBit(uint32_t(size) + sizeof(Chunk) - 1), kMinIndex);
+            Chunk*   chunk = nullptr;
+            {
+                Mutex::ScopedLock lock(m_mutex);
+                uint32_t          it = index - kMinIndex;
+                const uint32_t    end = NvMin(it + 3, kClassCount);
+                while (it < end && !m_free[it])
+                    ++it;
+                if (it < end)
+                {
+                    chunk = m_free[it];
+                    m_free[it] = chunk->mNext;
+                    index = it + kMinIndex;
+                }
+            }
+            if (!chunk)
+                chunk = (Chunk*)NonTrackingAllocator().allocate(size_t(2 << index), __FILE__, __LINE__);
+            chunk->mIndex = index;
+            return chunk + 1;
+        }
+
+        void deallocate(void* ptr)
+        {
+            Chunk*            chunk = reinterpret_cast<Chunk*>(ptr) - 1;
+            const uint32_t    index = chunk->mIndex - kMinIndex;
+            Mutex::ScopedLock lock(m_mutex);
+            chunk->mNext = m_free[index];
+            m_free[index] = chunk;
+        }
+
+    private:
+        typedef TempAllocatorChunk Chunk;
+        static const uint32_t      kMinIndex = 8;
+        static const uint32_t      kClassCount = TempAllocatorSizeClassCount;
+
+        Chunk* m_free[kClassCount];
+        Mutex  m_mutex;
+    };
+
+    /// Each thread keeps up to 16 live allocations of 256B to 64kB, returns the ns per allocate and deallocate pair.
+    template <typename Alloc>
+    double allocationLoop(Alloc& alloc, uint32_t threadCount, uint32_t iterations)
+    {
+        const test::Timer        timer;
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&alloc, t, iterations]() {
+                uint32_t seed = 0x9e3779b9u * (t + 1);
+                void*    live[16] = {};
+                for (uint32_t i = 0; i < iterations; ++i)
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    void*& slot = live[seed >> 28];
+                    if (slot)
+                        alloc.deallocate(slot);
+                    slot = alloc.allocate(size_t(256) << ((seed >> 8) % 9));
+                    static_cast<uint8_t*>(slot)[0] = uint8_t(i);
+                }
+                for (void* ptr : live)
+                {
+                    if (ptr)
+                        alloc.deallocate(ptr);
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+        return timer.ms() * 1e6 / (double(threadCount) * iterations);
+    }
+
+    struct CachedTempAllocator
+    {
+        TempAllocator alloc;
+
+        void* allocate(size_t size)
+        {
+            return alloc.allocate(size, __FILE__, __LINE__);
+        }
+        void deallocate(void* ptr)
+        {
+            alloc.deallocate(ptr);
+        }
+    };
+}  // namespace
+
+TEST_CASE(TempAllocator, ReusesFreedChunks)
+{
+    Foundation foundation;
+
+    TempAllocator alloc;
+    void*         first = alloc.allocate(kChunkBytes, __FILE__, __LINE__);
+    CHECK((size_t(first) & 15) == 0);
+    alloc.deallocate(first);
+    const int live = foundation.allocator.live;
+
+    // the same and smaller sizes are served from the freed chunk
+    void* second = alloc.allocate(kChunkBytes, __FILE__, __LINE__);
+    CHECK(second == first);
+    alloc.deallocate(second);
+    void* smaller = alloc.allocate(300, __FILE__, __LINE__);
+    CHECK(smaller == first);
+    alloc.deallocate(smaller);
+    CHECK(foundation.allocator.live == live);
+
+    // too big for the size classes, forwarded to the base allocator
+    void* big = alloc.allocate(200 * 1024, __FILE__, __LINE__);
+    CHECK(foundation.allocator.live == live + 1);
+    alloc.deallocate(big);
+    CHECK(foundation.allocator.live == live);
+}
+
+TEST_CASE(TempAllocator, ExitedThreadsReturnTheirChunks)
+{
+    Foundation foundation;
+    const int  live = foundation.allocator.live;
+
+    // 12 chunks stay in the thread's cache, on exit 8 go to the shared lists and 4 are freed
+    std::thread(allocateAndFree, 12).join();
+    CHECK(foundation.allocator.live == live + 1 + 8);
+
+    // the next thread reuses the cache and refills it from the shared lists
+    std::thread(allocateAndFree, 8).join();
+    CHECK(foundation.allocator.live == live + 1 + 8);
+
+    uint32_t hits[TempAllocatorSizeClassCount];
+    uint32_t misses[TempAllocatorSizeClassCount];
+    getTempAllocatorStats(hits, misses);
+    CHECK(misses[kChunkClass] == 12 + 1);
+    CHECK(hits[kChunkClass] == 7);
+}
+
+TEST_CASE(TempAllocator, ThreadsShareSpilledChunks)
+{
+    Foundation foundation;
+    const int  live = foundation.allocator.live;
+
+    // past 16 free chunks a batch of 8 is handed to the shared lists while the thread runs
+    std::vector<void*> ptrs;
+    std::thread([&ptrs]() {
+        TempAllocator alloc;
+        for (int i = 0; i < 16; ++i)
+            ptrs.push_back(alloc.allocate(kChunkBytes, __FILE__, __LINE__));
+        for (void* ptr : ptrs)
+            alloc.deallocate(ptr);
+    }).join();
+
+    TempAllocator alloc;
+    void*         ptr = alloc.allocate(kChunkBytes, __FILE__, __LINE__);
+    bool          reused = false;
+    for (void* freed : ptrs)
+        reused |= freed == ptr;
+    CHECK(reused);
+    alloc.deallocate(ptr);
+    // and this thread took over the cache of the exited one
+    CHECK(foundation.allocator.live == live + 1 + 16);
+}
+
+BENCH_CASE(TempAllocator, ThreadCachesVsMutex)
+{
+    Foundation foundation;
+
+    const uint32_t iterations = 200000;
+    for (uint32_t threadCount = 1; threadCount <= 8; threadCount *= 2)
+    {
+        MutexTempAllocator  locked;
+        CachedTempAllocator cached;
+        const double        lockedNs = allocationLoop(locked, threadCount, iterations);
+        const double        cachedNs = allocationLoop(cached, threadCount, iterations);
+        std::printf("%u threads: mutex %.1f ns, thread caches %.1f ns per allocate and deallocate\n", threadCount,
+                    lockedNs, cachedNs);
+    }
+}
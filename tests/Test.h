@@ -0,0 +1,67 @@
+//
+//  Test.h
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace test
+{
+    typedef void (*test_func_t)();
+
+    /// Registers a test function under a group, benchmarks are only run with --bench.
+    struct Registrar
+    {
+        Registrar(const char* group, const char* name, test_func_t func, bool benchmark);
+    };
+
+    /// Records a failed check, the test continues.
+    void fail(const char* file, int line, const char* expression);
+
+    /// Wall clock time for the benchmarks.
+    class Timer
+    {
+    public:
+        Timer()
+            : m_start(std::chrono::high_resolution_clock::now())
+        {
+        }
+
+        double ms() const
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start)
+                .count();
+        }
+
+    private:
+        std::chrono::high_resolution_clock::time_point m_start;
+    };
+
+    /// Keeps a benchmark result alive so the work isn't optimized away.
+    template <typename T>
+    inline void keep(const T& value)
+    {
+        static volatile uint8_t sink;
+        sink = sink + *reinterpret_cast<const volatile uint8_t*>(&value);
+    }
+}  // namespace test
+
+#define TEST_CASE_IMPL(group, name, benchmark)                                                                     \
+    static void                  group##_##name();                                                                  \
+    static const test::Registrar group##_##name##_registrar(#group, #name, group##_##name, benchmark);              \
+    static void                  group##_##name()
+
+/// Defines a test of a group, each group is a ctest test.
+#define TEST_CASE(group, name) TEST_CASE_IMPL(group, name, false)
+/// Defines a benchmark of a group, reports its timings with printf.
+#define BENCH_CASE(group, name) TEST_CASE_IMPL(group, name, true)
+
+#define CHECK(expression)                                    \
+    do                                                       \
+    {                                                        \
+        if (!(expression))                                   \
+            test::fail(__FILE__, __LINE__, #expression);     \
+    } while (0)
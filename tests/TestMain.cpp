@@ -0,0 +1,96 @@
+//
+//  TestMain.cpp
+//
+
+#include "Test.h"
+
+#include "NV/NvLogs.h"
+
+#include <cstdarg>
+#include <cstring>
+#include <vector>
+
+namespace test
+{
+    namespace
+    {
+        struct Case
+        {
+            const char* group;
+            const char* name;
+            test_func_t func;
+            bool        benchmark;
+        };
+
+        std::vector<Case>& cases()
+        {
+            static std::vector<Case> s_cases;
+            return s_cases;
+        }
+
+        int s_failures = 0;
+    }
+
+    Registrar::Registrar(const char* group, const char* name, test_func_t func, bool benchmark)
+    {
+        const Case c = {group, name, func, benchmark};
+        cases().push_back(c);
+    }
+
+    void fail(const char* file, int line, const char* expression)
+    {
+        std::printf("%s(%d): check failed: %s\n", file, line, expression);
+        ++s_failures;
+    }
+}  // namespace test
+
+/// The extensions log through the platform layer of the samples.
+void NVPlatformLog(const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    std::vprintf(fmt, args);
+    va_end(args);
+}
+
+/// Usage: CommandBufferTests [--bench] [group...]
+/// Runs the tests, or the benchmarks with --bench, of the given groups or of all of them.
+int main(int argc, char** argv)
+{
+    bool                     benchmarks = false;
+    std::vector<const char*> groups;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--bench") == 0)
+            benchmarks = true;
+        else
+            groups.push_back(argv[i]);
+    }
+
+    int run = 0;
+    for (const test::Case& c : test::cases())
+    {
+        if (c.benchmark != benchmarks)
+            continue;
+        bool selected = groups.empty();
+        for (const char* group : groups)
+            selected |= std::strcmp(group, c.group) == 0;
+        if (!selected)
+            continue;
+
+        const int failures = test::s_failures;
+        std::printf("[ RUN  ] %s.%s\n", c.group, c.name);
+        std::fflush(stdout);
+        c.func();
+        std::printf("[ %s ] %s.%s\n", failures == test::s_failures ? " OK " : "FAIL", c.group, c.name);
+        ++run;
+    }
+
+    if (!run)
+    {
+        std::printf("no %s matched\n", benchmarks ? "benchmarks" : "tests");
+        return 1;
+    }
+    std::printf("%d run, %d checks failed\n", run, test::s_failures);
+    return test::s_failures ? 1 : 0;
+}
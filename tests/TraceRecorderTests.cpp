@@ -0,0 +1,222 @@
+//
+//  TraceRecorderTests.cpp
+//
+
+#include "Test.h"
+
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    /// A complete event of the exported trace.
+    struct TraceEvent
+    {
+        std::string name;
+        uint32_t    tid;
+        double      ts;
+        double      dur;
+        uint32_t    frame;
+    };
+
+    /// Reads the complete events of a trace, in the exported order.
+    std::vector<TraceEvent> parseEvents(const std::string& json)
+    {
+        std::vector<TraceEvent> events;
+        const std::string       kNameStart = "{\"name\":\"", kNameEnd = "\",\"ph\":\"X\"";
+        for (size_t end = json.find(kNameEnd); end != std::string::npos; end = json.find(kNameEnd, end + 1))
+        {
+            const size_t start = json.rfind(kNameStart, end) + kNameStart.size();
+            TraceEvent   event;
+            event.name = json.substr(start, end - start);
+            if (std::sscanf(json.c_str() + end + kNameEnd.size(),
+                            ",\"pid\":0,\"tid\":%u,\"ts\":%lf,\"dur\":%lf,\"args\":{\"frame\":%u}}", &event.tid,
+                            &event.ts, &event.dur, &event.frame) == 4)
+            {
+                events.push_back(event);
+            }
+        }
+        return events;
+    }
+
+    const TraceEvent* findEvent(const std::vector<TraceEvent>& events, const std::string& name)
+    {
+        for (const TraceEvent& event : events)
+        {
+            if (event.name == name)
+                return &event;
+        }
+        return nullptr;
+    }
+
+    void spin(uint32_t iterations)
+    {
+        for (uint32_t i = 0; i < iterations; ++i)
+            test::keep(i);
+    }
+}  // namespace
+
+TEST_CASE(TraceRecorder, ExportsNestedScopes)
+{
+    Nv::TraceRecorder recorder;
+    recorder.setName(1, "outer");
+    recorder.setName(2, "in\"ner\\");
+    recorder.setThreadName("Main");
+    {
+        Nv::TraceScope outer(recorder, 1);
+        spin(1000);
+        {
+            Nv::TraceScope inner(recorder, 2);
+            spin(1000);
+        }
+        Nv::TraceScope unnamed(recorder, 7);
+        spin(1000);
+    }
+
+    const std::string json = recorder.chromeTrace(1);
+    CHECK(json.compare(0, 39, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") == 0);
+    CHECK(json.compare(json.size() - 2, 2, "]}") == 0);
+    CHECK(json.find("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"Main\"}}") !=
+          std::string::npos);
+
+    // written as they end, the children first, the names escaped and the unnamed ids by number
+    const std::vector<TraceEvent> events = parseEvents(json);
+    CHECK(events.size() == 3);
+    if (events.size() != 3)
+        return;
+    CHECK(events[0].name == "in\\\"ner\\\\" && events[1].name == "7" && events[2].name == "outer");
+
+    const TraceEvent& outer = events[2];
+    for (const TraceEvent& inner : {events[0], events[1]})
+    {
+        CHECK(inner.tid == 0 && inner.frame == 0 && inner.dur > 0.0);
+        // rounded to the nanosecond
+        CHECK(inner.ts >= outer.ts && inner.ts + inner.dur <= outer.ts + outer.dur + 0.002);
+    }
+    CHECK(events[0].ts + events[0].dur <= events[1].ts + 0.001);
+}
+
+TEST_CASE(TraceRecorder, ExportsTheLastFrames)
+{
+    Nv::TraceRecorder recorder;
+    for (uint32_t frame = 0; frame < 4; ++frame)
+    {
+        Nv::TraceScope scope(recorder, frame);
+        recorder.nextFrame();
+    }
+    CHECK(recorder.frame() == 4);
+
+    // a scope is tagged with the frame it ends in
+    std::vector<TraceEvent> events = parseEvents(recorder.chromeTrace(2));
+    CHECK(events.size() == 2 && findEvent(events, "2") && findEvent(events, "3"));
+    CHECK(findEvent(events, "3") && findEvent(events, "3")->frame == 4);
+    CHECK(parseEvents(recorder.chromeTrace(100)).size() == 4);
+
+    // the scopes begun while disabled aren't recorded
+    recorder.setEnabled(false);
+    {
+        Nv::TraceScope scope(recorder, 10);
+        recorder.setEnabled(true);
+    }
+    Nv::TraceScope(recorder, 11);
+    events = parseEvents(recorder.chromeTrace(100));
+    CHECK(events.size() == 5 && !findEvent(events, "10") && findEvent(events, "11"));
+}
+
+TEST_CASE(TraceRecorder, WrapsAroundTheRing)
+{
+    // rounded up to 8 scopes per thread, the oldest ones are overwritten, and the oldest one left is
+    // dropped since its slot is the next one to be written
+    Nv::TraceRecorder recorder(6);
+    for (uint32_t id = 0; id < 5; ++id)
+        Nv::TraceScope(recorder, id);
+    CHECK(parseEvents(recorder.chromeTrace(1)).size() == 5);
+    for (uint32_t id = 5; id < 20; ++id)
+        Nv::TraceScope(recorder, id);
+
+    const std::vector<TraceEvent> events = parseEvents(recorder.chromeTrace(1));
+    CHECK(events.size() == 7);
+    for (uint32_t i = 0; i < events.size(); ++i)
+        CHECK(events[i].name == std::to_string(13 + i));
+}
+
+TEST_CASE(TraceRecorder, RecordsEachThread)
+{
+    Nv::TraceRecorder recorder(64);
+    recorder.setThreadName("Main");
+    Nv::TraceScope(recorder, 0);
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i <= 3; ++i)
+    {
+        threads.emplace_back([&recorder, i]() {
+            recorder.setThreadName(("Worker" + std::to_string(i)).c_str());
+            for (uint32_t scope = 0; scope < 100; ++scope)
+                Nv::TraceScope(recorder, i);
+        });
+    }
+    // exported while the threads record
+    const std::string during = recorder.chromeTrace(1);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    // the full rings of the workers keep 63 scopes
+    const std::vector<TraceEvent> events = parseEvents(recorder.chromeTrace(1));
+    CHECK(events.size() == 1 + 3 * 63);
+    std::vector<uint32_t> counts(4, 0);
+    for (const TraceEvent& event : events)
+    {
+        const uint32_t id = uint32_t(std::stoul(event.name));
+        // each thread records to its own ring
+        for (const TraceEvent& other : events)
+            CHECK(std::stoul(other.name) != id || other.tid == event.tid);
+        ++counts[std::min(id, 3u)];
+    }
+    CHECK(counts[0] == 1 && counts[1] == 63 && counts[2] == 63 && counts[3] == 63);
+    CHECK(during.compare(during.size() - 2, 2, "]}") == 0);
+    for (uint32_t i = 1; i <= 3; ++i)
+        CHECK(recorder.chromeTrace(1).find("\"Worker" + std::to_string(i) + "\"") != std::string::npos);
+}
+
+BENCH_CASE(TraceRecorder, ScopeOverhead)
+{
+    // the scope's clock pair is most of its cost, the difference is recording it
+    const uint32_t    scopeCount = 1000000;
+    Nv::TraceRecorder recorder(1 << 12);
+    double            scopeNs = 1e30, clockNs = 1e30, disabledNs = 1e30;
+    for (int run = 0; run < 10; ++run)
+    {
+        {
+            const test::Timer timer;
+            for (uint32_t i = 0; i < scopeCount; ++i)
+                Nv::TraceScope(recorder, i & 15);
+            scopeNs = std::min(scopeNs, timer.ms() * 1e6 / scopeCount);
+        }
+        {
+            uint64_t          sum = 0;
+            const test::Timer timer;
+            for (uint32_t i = 0; i < scopeCount; ++i)
+            {
+                sum += recorder.begin();
+                sum += recorder.begin();
+            }
+            clockNs = std::min(clockNs, timer.ms() * 1e6 / scopeCount);
+            test::keep(sum);
+        }
+        recorder.setEnabled(false);
+        {
+            const test::Timer timer;
+            for (uint32_t i = 0; i < scopeCount; ++i)
+                Nv::TraceScope(recorder, i & 15);
+            disabledNs = std::min(disabledNs, timer.ms() * 1e6 / scopeCount);
+        }
+        recorder.setEnabled(true);
+    }
+    std::printf("scope %.1f ns, two timestamps %.1f ns, recording %.1f ns, disabled %.1f ns\n", scopeNs, clockNs,
+                scopeNs - clockNs, disabledNs);
+}
@@ -0,0 +1,226 @@
+//
+//  UniformRingTests.cpp
+//
+
+#include "Test.h"
+
+#include "UniformRing.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Light
+    {
+        float position[4];
+        float color[4];
+    };
+
+    /// Records the frames the ring waited for.
+    struct WaitLog
+    {
+        std::vector<uint32_t> frames;
+
+        cb::UniformRing::wait_func_t func()
+        {
+            return [this](uint32_t frame) { frames.push_back(frame); };
+        }
+    };
+
+    /// The previous implementation, each draw orphans its buffer i.e. with glBufferData(GL_STREAM_DRAW).
+    struct OrphaningBuffer
+    {
+        std::unique_ptr<uint8_t[]> data;
+
+        void write(const Light& light)
+        {
+            data.reset(new uint8_t[sizeof(Light)]);
+            memcpy(data.get(), &light, sizeof(Light));
+            test::keep(data[0]);
+        }
+    };
+}  // namespace
+
+TEST_CASE(UniformRing, AlignsBlocksAndFillsTheRegion)
+{
+    WaitLog         waits;
+    cb::UniformRing ring;
+    ring.reset(nullptr, 1000, 3, waits.func(), 256);
+    CHECK(ring.frameBytes() == 1024);
+    CHECK(ring.bufferBytes() == 3 * 1024);
+
+    // the first frame uses the second region
+    const Light       light = {{1.f, 2.f, 3.f, 1.f}, {0.5f, 0.5f, 0.5f, 1.f}};
+    cb::UniformBlock  blocks[4];
+    for (cb::UniformBlock& block : blocks)
+    {
+        block = ring.write(light);
+        CHECK(block.data != nullptr);
+        CHECK(block.size == sizeof(Light));
+        CHECK(block.offset % 256 == 0);
+        CHECK(block.data == ring.data() + block.offset);
+        CHECK(block.offset / ring.frameBytes() == ring.region());
+    }
+    CHECK(memcmp(blocks[3].data, &light, sizeof(Light)) == 0);
+    CHECK(ring.frameUsed() == 1024);
+
+    // a full region returns null blocks, the others are left untouched
+    const cb::UniformBlock full = ring.write(light);
+    CHECK(full.data == nullptr);
+    CHECK(full.size == 0);
+    CHECK(ring.frameUsed() == 1024);
+
+    ring.beginFrame();
+    CHECK(ring.frameUsed() == 0);
+    CHECK(ring.write(light).offset == ring.region() * ring.frameBytes());
+    CHECK(waits.frames.empty());
+}
+
+TEST_CASE(UniformRing, WaitsBeforeReusingARegion)
+{
+    WaitLog         waits;
+    cb::UniformRing ring;
+    ring.reset(nullptr, 256, 3, waits.func(), 256);
+    CHECK(ring.frame() == 1);
+
+    // the two other regions were never used
+    ring.beginFrame();
+    ring.beginFrame();
+    CHECK(waits.frames.empty());
+
+    // the fourth frame reuses the region of the first
+    ring.beginFrame();
+    CHECK(waits.frames.size() == 1 && waits.frames.back() == 1);
+    CHECK(ring.waitCount() == 1);
+
+    // frames known to be completed are reused without waiting
+    ring.frameCompleted(3);
+    ring.beginFrame();
+    ring.beginFrame();
+    CHECK(waits.frames.size() == 1);
+
+    // waiting for a frame also completes the ones before it
+    ring.beginFrame();
+    CHECK(waits.frames.size() == 2 && waits.frames.back() == 4);
+    ring.frameCompleted(2);
+    ring.beginFrame();
+    CHECK(waits.frames.size() == 3 && waits.frames.back() == 5);
+    CHECK(ring.waitCount() == 3);
+
+    // reset discards the frames in flight
+    ring.reset(nullptr, 256, 3, waits.func(), 256);
+    ring.beginFrame();
+    ring.beginFrame();
+    CHECK(waits.frames.size() == 3);
+}
+
+TEST_CASE(UniformRing, ThreadsGetDisjointBlocks)
+{
+    const uint32_t  threadCount = 4;
+    const uint32_t  blockCount = 1000;
+    WaitLog         waits;
+    cb::UniformRing ring;
+    ring.reset(nullptr, blockCount * 64, 2, waits.func(), 64);
+
+    std::vector<std::vector<cb::UniformBlock>> written(threadCount);
+    std::vector<std::thread>                   threads;
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&ring, &written, t]() {
+            // allocates until the region is full
+            for (;;)
+            {
+                const cb::UniformBlock block = ring.alloc(48);
+                if (!block.data)
+                    break;
+                memset(block.data, int(t + 1), block.size);
+                written[t].push_back(block);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    uint32_t total = 0;
+    bool     intact = true;
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        total += (uint32_t)written[t].size();
+        for (const cb::UniformBlock& block : written[t])
+        {
+            for (uint32_t i = 0; i < block.size; ++i)
+                intact &= block.data[i] == uint8_t(t + 1);
+        }
+    }
+    CHECK(total == blockCount);
+    CHECK(intact);
+    CHECK(ring.frameUsed() == ring.frameBytes());
+}
+
+BENCH_CASE(UniformRing, RingVsOrphaning)
+{
+    const uint32_t lightCount = 1024;
+    const uint32_t frames = 2000;
+    const Light    light = {{1.f, 2.f, 3.f, 1.f}, {0.5f, 0.5f, 0.5f, 1.f}};
+
+    // only the CPU side, the driver's reallocation of the orphaned buffers isn't measured
+    OrphaningBuffer orphaning;
+    {
+        const test::Timer timer;
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            for (uint32_t i = 0; i < lightCount; ++i)
+                orphaning.write(light);
+        }
+        std::printf("orphaning: %.1f ns per light\n", timer.ms() * 1e6 / (double(frames) * lightCount));
+    }
+    {
+        uint32_t        waitCount = 0;
+        cb::UniformRing ring;
+        ring.reset(nullptr, lightCount * 256, 3, [&waitCount](uint32_t) { ++waitCount; }, 256);
+
+        const test::Timer timer;
+        for (uint32_t f = 0; f < frames; ++f)
+        {
+            for (uint32_t i = 0; i < lightCount; ++i)
+                test::keep(ring.write(light).offset);
+            ring.beginFrame();
+        }
+        std::printf("ring: %.1f ns per light, %u waits\n", timer.ms() * 1e6 / (double(frames) * lightCount),
+                    waitCount);
+    }
+}
+
+BENCH_CASE(UniformRing, ConcurrentWrites)
+{
+    const uint32_t writeCount = 1 << 18;
+    const Light    light = {{1.f, 2.f, 3.f, 1.f}, {0.5f, 0.5f, 0.5f, 1.f}};
+
+    for (uint32_t threadCount = 1; threadCount <= 8; threadCount *= 2)
+    {
+        // one frame holds all the writes, the threads contend on the region's offset and fault in its pages
+        cb::UniformRing ring;
+        ring.reset(nullptr, writeCount * 64, 2, [](uint32_t) {}, 64);
+
+        std::vector<double>      threadMs(threadCount);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&ring, &light, &threadMs, writeCount, threadCount, t]() {
+                const test::Timer timer;
+                for (uint32_t i = 0; i < writeCount / threadCount; ++i)
+                    test::keep(ring.write(light).offset);
+                threadMs[t] = timer.ms();
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        double ms = 0;
+        for (double m : threadMs)
+            ms += m;
+        std::printf("%u threads: %.1f ns per write and thread\n", threadCount, ms * 1e6 / writeCount);
+    }
+}